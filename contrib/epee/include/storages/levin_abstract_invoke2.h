@@ -271,6 +271,10 @@ namespace epee
   if(is_notify && NOTIFY::ID == command) \
   {handled=true;return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, typename NOTIFY::request>(this, command, in_buff, boost::bind(func, this, _1, _2, _3), context);}
 
+#define HANDLE_NOTIFY_RAW2(NOTIFY, func) \
+  if(is_notify && NOTIFY::ID == command) \
+  {handled=true;return (this->*func)(command, in_buff, context);}
+
 
 #define CHAIN_INVOKE_MAP2(func) \
   { \
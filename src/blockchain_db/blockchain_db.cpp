@@ -247,6 +247,29 @@ uint64_t BlockchainDB::add_block( const block& blk
 
   m_hardfork->add(blk, prev_height);
 
+  if (m_rta_state_provider && has_rta_state())
+  {
+    blobdata stake_txs, blockchain_based_list;
+
+    if (m_rta_state_provider->get_block_rta_state(prev_height, blk, blk_hash, txs, stake_txs, blockchain_based_list))
+    {
+      try
+      {
+        add_block_rta_state(prev_height, stake_txs, blockchain_based_list);
+        block_txn_stop();
+      }
+      catch (...)
+      {
+        m_rta_state_provider->on_block_rta_state_aborted();
+        throw;
+      }
+
+      ++num_calls;
+
+      return prev_height;
+    }
+  }
+
   block_txn_stop();
 
   ++num_calls;
@@ -259,10 +282,45 @@ void BlockchainDB::set_hard_fork(HardFork* hf)
   m_hardfork = hf;
 }
 
+void BlockchainDB::set_rta_state_provider(RtaStateProvider* provider)
+{
+  m_rta_state_provider = provider;
+}
+
+void BlockchainDB::add_block_rta_state(uint64_t height, const blobdata& stake_txs, const blobdata& blockchain_based_list)
+{
+  throw DB_ERROR("RTA state is not supported by the database");
+}
+
+void BlockchainDB::remove_block_rta_state(uint64_t height)
+{
+  throw DB_ERROR("RTA state is not supported by the database");
+}
+
+uint64_t BlockchainDB::get_rta_state_height() const
+{
+  return 0;
+}
+
+bool BlockchainDB::get_block_rta_blockchain_based_list(uint64_t height, blobdata& blockchain_based_list) const
+{
+  return false;
+}
+
+bool BlockchainDB::for_all_rta_stake_txs(std::function<bool(uint64_t height, const blobdata& stake_txs)>) const
+{
+  return true;
+}
+
 void BlockchainDB::pop_block(block& blk, std::vector<transaction>& txs)
 {
   blk = get_top_block();
 
+  const uint64_t blk_height = height() - 1;
+
+  if (has_rta_state())
+    remove_block_rta_state(blk_height);
+
   remove_block();
 
   for (const auto& h : boost::adaptors::reverse(blk.tx_hashes))
@@ -271,6 +329,9 @@ void BlockchainDB::pop_block(block& blk, std::vector<transaction>& txs)
     remove_transaction(h);
   }
   remove_transaction(get_transaction_hash(blk.miner_tx));
+
+  if (m_rta_state_provider)
+    m_rta_state_provider->on_block_rta_state_removed(blk_height);
 }
 
 bool BlockchainDB::is_open() const
@@ -328,6 +328,52 @@ class KEY_IMAGE_EXISTS : public DB_EXCEPTION
  ***********************************/
 
 
+/**
+ * @brief Provider of the RTA state (stake transactions and blockchain based list) of blocks
+ *
+ * The provider is called while a block is being added, so the RTA state of the
+ * block is stored in the same write transaction as the block itself, and is
+ * notified when the state is removed along with a popped block.
+ *
+ * Providers must not throw, an exception would abort addition of the block.
+ */
+class RtaStateProvider
+{
+public:
+  virtual ~RtaStateProvider() { }
+
+  /**
+   * @brief builds the RTA state of the block being added
+   *
+   * @param height the height of the block
+   * @param blk the block
+   * @param blk_hash the hash of the block
+   * @param txs the transactions of the block
+   * @param stake_txs return-by-reference the stake transactions blob (empty if the block has no stake transactions)
+   * @param blockchain_based_list return-by-reference the blockchain based list blob
+   *
+   * @return true if the state has been built, false if it has to be stored later
+   */
+  virtual bool get_block_rta_state(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs,
+    blobdata& stake_txs, blobdata& blockchain_based_list) = 0;
+
+  /**
+   * @brief notifies that the RTA state of the block has been removed along with the block
+   *
+   * @param height the height of the removed block
+   */
+  virtual void on_block_rta_state_removed(uint64_t height) = 0;
+
+  /**
+   * @brief notifies that RTA state built by get_block_rta_state() has been discarded
+   *
+   * Called when the write transaction of the block fails after the state has
+   * been built, so the provider has to roll back its in-memory state.
+   */
+  virtual void on_block_rta_state_aborted() = 0;
+};
+
+
 /**
  * @brief The BlockchainDB backing store interface declaration/contract
  *
@@ -539,12 +585,14 @@ protected:
 
   HardFork* m_hardfork;
 
+  RtaStateProvider* m_rta_state_provider;
+
 public:
 
   /**
    * @brief An empty constructor.
    */
-  BlockchainDB(): m_open(false) { }
+  BlockchainDB(): m_open(false), m_rta_state_provider(nullptr) { }
 
   /**
    * @brief An empty destructor.
@@ -775,6 +823,13 @@ public:
 
   virtual void set_hard_fork(HardFork* hf);
 
+  /**
+   * @brief sets the provider of the RTA state stored along with blocks
+   *
+   * @param provider the provider, nullptr to stop storing the state with blocks
+   */
+  virtual void set_rta_state_provider(RtaStateProvider* provider);
+
   // adds a block with the given metadata to the top of the blockchain, returns the new height
   /**
    * @brief handles the addition of a new block to BlockchainDB
@@ -1435,6 +1490,65 @@ public:
    */
   virtual bool for_all_key_images(std::function<bool(const crypto::key_image&)>) const = 0;
 
+  //
+  // RTA state related storage
+  //
+
+  /**
+   * @brief checks whether the implementation stores the RTA state of blocks
+   *
+   * The default implementation doesn't, RTA state is kept outside of the
+   * database then.
+   */
+  virtual bool has_rta_state() const { return false; }
+
+  /**
+   * @brief stores the RTA state of a block
+   *
+   * Blockchain based lists are kept for the last
+   * config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH blocks only.
+   *
+   * @param height the height of the block
+   * @param stake_txs the stake transactions blob, previously stored transactions are removed if empty
+   * @param blockchain_based_list the blockchain based list blob, nothing is stored if empty
+   */
+  virtual void add_block_rta_state(uint64_t height, const blobdata& stake_txs, const blobdata& blockchain_based_list);
+
+  /**
+   * @brief removes the RTA state of a block
+   *
+   * Called by pop_block() so the state never outlives its block.
+   *
+   * @param height the height of the block
+   */
+  virtual void remove_block_rta_state(uint64_t height);
+
+  /**
+   * @brief gets the height of the block after the last one with stored RTA state
+   *
+   * @return the height, 0 if there is no RTA state
+   */
+  virtual uint64_t get_rta_state_height() const;
+
+  /**
+   * @brief gets the blockchain based list of a block
+   *
+   * @param height the height of the block
+   * @param blockchain_based_list return-by-reference the blockchain based list blob
+   *
+   * @return true if the list has been found, otherwise false
+   */
+  virtual bool get_block_rta_blockchain_based_list(uint64_t height, blobdata& blockchain_based_list) const;
+
+  /**
+   * @brief runs a function over stake transactions of all blocks in height order
+   *
+   * @param std::function fn the function to run, gets the height and the stake transactions blob
+   *
+   * @return false if the function returns false for any block, otherwise true
+   */
+  virtual bool for_all_rta_stake_txs(std::function<bool(uint64_t height, const blobdata& stake_txs)>) const;
+
   /**
    * @brief runs a function over a range of blocks
    *
@@ -41,6 +41,7 @@
 #include "crypto/crypto.h"
 #include "profile_tools.h"
 #include "ringct/rctOps.h"
+#include "graft_rta_config.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db.lmdb"
@@ -178,6 +179,9 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
  *
+ * rta_stake_txs    block height [stake txns]
+ * rta_bbl          block height blockchain based list
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -207,6 +211,9 @@ const char* const LMDB_TXPOOL_BLOB = "txpool_blob";
 const char* const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char* const LMDB_HF_VERSIONS = "hf_versions";
 
+const char* const LMDB_RTA_STAKE_TXS = "rta_stake_txs";
+const char* const LMDB_RTA_BBL = "rta_bbl";
+
 const char* const LMDB_PROPERTIES = "properties";
 
 const char zerokey[8] = {0};
@@ -1222,7 +1229,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   // set up lmdb environment
   if ((result = mdb_env_create(&m_env)))
     throw0(DB_ERROR(lmdb_error("Failed to create lmdb environment: ", result).c_str()));
-  if ((result = mdb_env_set_maxdbs(m_env, 20)))
+  // 19 named dbs are opened on startup, the rest is headroom for migrations and new tables
+  if ((result = mdb_env_set_maxdbs(m_env, 32)))
     throw0(DB_ERROR(lmdb_error("Failed to set max number of dbs: ", result).c_str()));
 
   int threads = tools::get_max_concurrency();
@@ -1302,6 +1310,9 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   lmdb_db_open(txn, LMDB_HF_VERSIONS, MDB_INTEGERKEY | MDB_CREATE, m_hf_versions, "Failed to open db handle for m_hf_versions");
 
+  lmdb_db_open(txn, LMDB_RTA_STAKE_TXS, MDB_INTEGERKEY | MDB_CREATE, m_rta_stake_txs, "Failed to open db handle for m_rta_stake_txs");
+  lmdb_db_open(txn, LMDB_RTA_BBL, MDB_INTEGERKEY | MDB_CREATE, m_rta_bbl, "Failed to open db handle for m_rta_bbl");
+
   lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
@@ -1472,6 +1483,10 @@ void BlockchainLMDB::reset()
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
   if (auto result = mdb_drop(txn, m_hf_versions, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_rta_stake_txs, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_rta_stake_txs: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_rta_bbl, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_rta_bbl: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
 
@@ -2629,6 +2644,150 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
   return fret;
 }
 
+void BlockchainLMDB::add_block_rta_state(uint64_t height, const blobdata& stake_txs, const blobdata& blockchain_based_list)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_BLOCK_PREFIX(0);
+
+  MDB_val_copy<uint64_t> val_key(height);
+  int result;
+
+  if (!stake_txs.empty())
+  {
+    MDB_val val_value = {stake_txs.size(), (void*)stake_txs.data()};
+    result = mdb_put(*txn_ptr, m_rta_stake_txs, &val_key, &val_value, 0);
+    if (result)
+      throw1(DB_ERROR(lmdb_error("Error adding RTA stake transactions to db transaction: ", result).c_str()));
+  }
+  else
+  {
+    // the state may be rewritten after resynchronization
+    result = mdb_del(*txn_ptr, m_rta_stake_txs, &val_key, NULL);
+    if (result && result != MDB_NOTFOUND)
+      throw1(DB_ERROR(lmdb_error("Error removing RTA stake transactions from db transaction: ", result).c_str()));
+  }
+
+  if (!blockchain_based_list.empty())
+  {
+    MDB_val val_value = {blockchain_based_list.size(), (void*)blockchain_based_list.data()};
+    result = mdb_put(*txn_ptr, m_rta_bbl, &val_key, &val_value, 0);
+    if (result)
+      throw1(DB_ERROR(lmdb_error("Error adding blockchain based list to db transaction: ", result).c_str()));
+
+    // only the recent lists are needed to restore the blockchain based list history
+    if (height >= config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH)
+    {
+      MDB_val_copy<uint64_t> val_obsolete_key(height - config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH);
+      result = mdb_del(*txn_ptr, m_rta_bbl, &val_obsolete_key, NULL);
+      if (result && result != MDB_NOTFOUND)
+        throw1(DB_ERROR(lmdb_error("Error removing obsolete blockchain based list from db transaction: ", result).c_str()));
+    }
+  }
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+void BlockchainLMDB::remove_block_rta_state(uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_BLOCK_PREFIX(0);
+
+  MDB_val_copy<uint64_t> val_key(height);
+
+  auto result = mdb_del(*txn_ptr, m_rta_stake_txs, &val_key, NULL);
+  if (result && result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Error removing RTA stake transactions from db transaction: ", result).c_str()));
+  result = mdb_del(*txn_ptr, m_rta_bbl, &val_key, NULL);
+  if (result && result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Error removing blockchain based list from db transaction: ", result).c_str()));
+
+  TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+uint64_t BlockchainLMDB::get_rta_state_height() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(rta_bbl);
+
+  MDB_val k, v;
+  uint64_t ret = 0;
+
+  auto result = mdb_cursor_get(m_cur_rta_bbl, &k, &v, MDB_LAST);
+  if (result == 0)
+    ret = *(const uint64_t*)k.mv_data + 1;
+  else if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to get the last blockchain based list: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+
+  return ret;
+}
+
+bool BlockchainLMDB::get_block_rta_blockchain_based_list(uint64_t height, blobdata& blockchain_based_list) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(rta_bbl);
+
+  MDB_val_copy<uint64_t> val_key(height);
+  MDB_val v;
+
+  auto result = mdb_cursor_get(m_cur_rta_bbl, &val_key, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get blockchain based list: ", result).c_str()));
+
+  blockchain_based_list.assign(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
+bool BlockchainLMDB::for_all_rta_stake_txs(std::function<bool(uint64_t height, const blobdata& stake_txs)> f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(rta_stake_txs);
+
+  MDB_val k, v;
+  bool fret = true;
+  blobdata stake_txs;
+
+  MDB_cursor_op op = MDB_FIRST;
+  while (1)
+  {
+    int ret = mdb_cursor_get(m_cur_rta_stake_txs, &k, &v, op);
+    op = MDB_NEXT;
+    if (ret == MDB_NOTFOUND)
+      break;
+    if (ret)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate RTA stake transactions: ", ret).c_str()));
+    const uint64_t height = *(const uint64_t*)k.mv_data;
+    stake_txs.assign(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+    if (!f(height, stake_txs)) {
+      fret = false;
+      break;
+    }
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  return fret;
+}
+
 bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -2947,6 +3106,9 @@ void BlockchainLMDB::batch_abort()
   m_write_batch_txn = nullptr;
   m_batch_active = false;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
+  // RTA state of the discarded blocks may have been applied in memory already
+  if (m_rta_state_provider)
+    m_rta_state_provider->on_block_rta_state_aborted();
   LOG_PRINT_L3("batch transaction: aborted");
 }
 
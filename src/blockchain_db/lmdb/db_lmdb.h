@@ -62,6 +62,9 @@ typedef struct mdb_txn_cursors
   MDB_cursor *m_txc_txpool_blob;
 
   MDB_cursor *m_txc_hf_versions;
+
+  MDB_cursor *m_txc_rta_stake_txs;
+  MDB_cursor *m_txc_rta_bbl;
 } mdb_txn_cursors;
 
 #define m_cur_blocks	m_cursors->m_txc_blocks
@@ -79,6 +82,8 @@ typedef struct mdb_txn_cursors
 #define m_cur_txpool_meta	m_cursors->m_txc_txpool_meta
 #define m_cur_txpool_blob	m_cursors->m_txc_txpool_blob
 #define m_cur_hf_versions	m_cursors->m_txc_hf_versions
+#define m_cur_rta_stake_txs	m_cursors->m_txc_rta_stake_txs
+#define m_cur_rta_bbl	m_cursors->m_txc_rta_bbl
 
 typedef struct mdb_rflags
 {
@@ -98,6 +103,8 @@ typedef struct mdb_rflags
   bool m_rf_txpool_meta;
   bool m_rf_txpool_blob;
   bool m_rf_hf_versions;
+  bool m_rf_rta_stake_txs;
+  bool m_rf_rta_bbl;
 } mdb_rflags;
 
 typedef struct mdb_threadinfo
@@ -267,6 +274,13 @@ public:
   virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob = false, bool include_unrelayed_txes = true) const;
 
   virtual bool for_all_key_images(std::function<bool(const crypto::key_image&)>) const;
+
+  virtual bool has_rta_state() const { return true; }
+  virtual void add_block_rta_state(uint64_t height, const blobdata& stake_txs, const blobdata& blockchain_based_list);
+  virtual void remove_block_rta_state(uint64_t height);
+  virtual uint64_t get_rta_state_height() const;
+  virtual bool get_block_rta_blockchain_based_list(uint64_t height, blobdata& blockchain_based_list) const;
+  virtual bool for_all_rta_stake_txs(std::function<bool(uint64_t height, const blobdata& stake_txs)>) const;
   virtual bool for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)>) const;
   virtual bool for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>, bool pruned) const;
   virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const;
@@ -423,6 +437,9 @@ private:
   MDB_dbi m_hf_starting_heights;
   MDB_dbi m_hf_versions;
 
+  MDB_dbi m_rta_stake_txs;
+  MDB_dbi m_rta_bbl;
+
   MDB_dbi m_properties;
 
   mutable uint64_t m_cum_size;	// used in batch size estimation
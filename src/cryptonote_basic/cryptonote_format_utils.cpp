@@ -985,15 +985,19 @@ namespace cryptonote
     return get_transaction_hash(t, res, &blob_size);
   }
   //---------------------------------------------------------------
-  blobdata get_block_hashing_blob(const block& b)
+  blobdata get_block_hashing_blob(const block_header& header, const crypto::hash& tx_tree_hash, size_t tx_count)
   {
-    blobdata blob = t_serializable_object_to_blob(static_cast<block_header>(b));
-    crypto::hash tree_root_hash = get_tx_tree_hash(b);
-    blob.append(reinterpret_cast<const char*>(&tree_root_hash), sizeof(tree_root_hash));
-    blob.append(tools::get_varint_data(b.tx_hashes.size()+1));
+    blobdata blob = t_serializable_object_to_blob(header);
+    blob.append(reinterpret_cast<const char*>(&tx_tree_hash), sizeof(tx_tree_hash));
+    blob.append(tools::get_varint_data(tx_count+1));
     return blob;
   }
   //---------------------------------------------------------------
+  blobdata get_block_hashing_blob(const block& b)
+  {
+    return get_block_hashing_blob(static_cast<const block_header&>(b), get_tx_tree_hash(b), b.tx_hashes.size());
+  }
+  //---------------------------------------------------------------
   bool calculate_block_hash(const block& b, crypto::hash& res)
   {
     bool hash_result = get_object_hash(get_block_hashing_blob(b), res);
@@ -1029,19 +1033,22 @@ namespace cryptonote
     return p;
   }
   //---------------------------------------------------------------
-  bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height)
+  bool get_block_longhash(const blobdata& hashing_blob, uint8_t major_version, crypto::hash& res)
   {
-
-    blobdata bd = get_block_hashing_blob(b);
     // variant = 0 for versions less than 8
     // variant = 1 for versions between 8 and 11
     // variant = 2 for versions 11 and greater
-    const int cn_variant = b.major_version < 8 ? 0 : b.major_version >= 11 ? 2 : 1;
-    const int cn_modifier = b.major_version < 12 ? CN_MODIFIER_NONE : CN_MODIFIER_REVERSE_WALTZ;
-    crypto::cn_slow_hash(bd.data(), bd.size(), res, cn_variant, cn_modifier);
+    const int cn_variant = major_version < 8 ? 0 : major_version >= 11 ? 2 : 1;
+    const int cn_modifier = major_version < 12 ? CN_MODIFIER_NONE : CN_MODIFIER_REVERSE_WALTZ;
+    crypto::cn_slow_hash(hashing_blob.data(), hashing_blob.size(), res, cn_variant, cn_modifier);
     return true;
   }
   //---------------------------------------------------------------
+  bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height)
+  {
+    return get_block_longhash(get_block_hashing_blob(b), b.major_version, res);
+  }
+  //---------------------------------------------------------------
   std::vector<uint64_t> relative_output_offsets_to_absolute(const std::vector<uint64_t>& off)
   {
     std::vector<uint64_t> res = off;
@@ -75,6 +75,7 @@
 
 
 #define RTA_TX_FEE                                      COIN
+#define RTA_TX_BLOCK_WEIGHT_SHARE_PERCENT               50 // share of the median block weight reserved for RTA transactions in block templates
 
 #define ORPHANED_BLOCKS_MAX_COUNT                       100
 
@@ -126,7 +127,10 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_RTA_BINARY                     0x02
+#define P2P_SUPPORT_FLAG_TX_INVENTORY                   0x04
+#define P2P_SUPPORT_FLAG_COMPACT_BLOCKS                 0x08
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_RTA_BINARY | P2P_SUPPORT_FLAG_TX_INVENTORY | P2P_SUPPORT_FLAG_COMPACT_BLOCKS)
 
 #define ALLOW_DEBUG_COMMANDS
 
@@ -11,7 +11,28 @@ namespace
 
 const size_t BLOCKCHAIN_BASED_LIST_SIZE = 32; //TODO: configuration parameter
 const size_t PREVIOS_BLOCKCHAIN_BASED_LIST_MAX_SIZE = 16; //TODO: configuration parameter
-const size_t BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH   = 1000;
+
+enum blockchain_based_list_journal_record_type
+{
+  BBL_JOURNAL_ADD_BLOCK = 1,
+  BBL_JOURNAL_REMOVE_BLOCK,
+};
+
+struct blockchain_based_list_journal_record
+{
+  uint8_t type;
+  uint64_t block_height;
+  BlockchainBasedList::supernode_tier_array& tiers;
+
+  blockchain_based_list_journal_record(uint8_t type, uint64_t block_height, BlockchainBasedList::supernode_tier_array& tiers)
+    : type(type), block_height(block_height), tiers(tiers) {}
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(type)
+    VARINT_FIELD(block_height)
+    FIELD(tiers)
+  END_SERIALIZE()
+};
 
 }
 
@@ -19,8 +40,11 @@ BlockchainBasedList::BlockchainBasedList(const std::string& m_storage_file_name,
   : m_storage_file_name(m_storage_file_name)
   , m_block_height(first_block_number)
   , m_history_depth()
+  , m_indexed_snapshot_id()
   , m_first_block_number(first_block_number)
   , m_need_store()
+  , m_journal(m_storage_file_name)
+  , m_journal_enabled(!m_storage_file_name.empty())
 {
   load();
 }
@@ -60,6 +84,135 @@ void BlockchainBasedList::select_supernodes(size_t items_count, const supernode_
   }
 }
 
+void BlockchainBasedList::select_supernodes(size_t items_count, size_t tier, const supernode_stake_snapshot& stakes, supernode_array& dst_list)
+{
+  const tier_index& src_index = m_tier_indexes[tier];
+
+    //supernodes already selected to dst_list are skipped; keys are ordered the same way as the index
+
+  std::vector<tier_index_key> excluded_keys;
+
+  excluded_keys.reserve(dst_list.size());
+
+  for (const supernode& sn : dst_list)
+  {
+    tier_index_entry_map::const_iterator it = m_tier_index_entries.find(sn.supernode_public_id);
+
+    if (it != m_tier_index_entries.end() && it->second.first == tier)
+      excluded_keys.emplace_back(it->second.second, sn.supernode_public_id);
+  }
+
+  std::sort(excluded_keys.begin(), excluded_keys.end());
+
+  size_t src_list_size = src_index.size() - excluded_keys.size();
+
+  if (items_count > src_list_size)
+    items_count = src_list_size;
+
+    //same selection as for the list of valid supernodes, but RNG is not used after the last item has been selected
+
+  std::vector<tier_index_key>::const_iterator excluded_it = excluded_keys.begin();
+  size_t i = 0;
+
+  for (tier_index::const_iterator it=src_index.begin(), end=src_index.end(); it!=end && items_count; ++it)
+  {
+    if (excluded_it != excluded_keys.end() && *excluded_it == *it)
+    {
+      ++excluded_it;
+      continue;
+    }
+
+    size_t random_value = m_rng() % (src_list_size - i++);
+
+    if (random_value >= items_count)
+      continue;
+
+    const supernode_stake* stake = stakes.find(it->second);
+
+    CHECK_AND_ASSERT_THROW_MES(stake, "internal error: supernode " << it->second << " from blockchain based list tier index has no stake");
+
+    supernode sn;
+
+    sn.supernode_public_id      = stake->supernode_public_id;
+    sn.supernode_public_address = stake->supernode_public_address;
+    sn.amount                   = stake->amount;
+    sn.block_height             = stake->block_height;
+    sn.unlock_time              = stake->unlock_time;
+
+    dst_list.emplace_back(std::move(sn));
+
+    items_count--;
+  }
+}
+
+void BlockchainBasedList::update_tier_index(const supernode_stake_snapshot& stakes, const std::string& supernode_public_id)
+{
+  tier_index_entry_map::iterator it = m_tier_index_entries.find(supernode_public_id);
+
+  if (it != m_tier_index_entries.end())
+  {
+    tier_index& index = m_tier_indexes[it->second.first];
+    tier_index::iterator index_it = std::lower_bound(index.begin(), index.end(), tier_index_key(it->second.second, supernode_public_id));
+
+    if (index_it != index.end() && index_it->second == supernode_public_id)
+      index.erase(index_it);
+
+    m_tier_index_entries.erase(it);
+  }
+
+  const supernode_stake* stake = stakes.find(supernode_public_id);
+
+  if (!stake || !stake->amount || !stake->tier || stake->tier > config::graft::TIERS_COUNT)
+    return;
+
+  size_t tier = stake->tier - 1;
+
+  tier_index& index = m_tier_indexes[tier];
+  tier_index_key key(stake->block_height, supernode_public_id);
+
+  index.insert(std::lower_bound(index.begin(), index.end(), key), key);
+
+  m_tier_index_entries.emplace(supernode_public_id, std::make_pair(tier, stake->block_height));
+}
+
+void BlockchainBasedList::update_tier_indexes(const supernode_stake_snapshot& stakes)
+{
+  if (m_indexed_snapshot_id && stakes.id == m_indexed_snapshot_id)
+    return;
+
+  if (m_indexed_snapshot_id && stakes.base_id == m_indexed_snapshot_id)
+  {
+      //apply changes of stakes made since the indexed snapshot
+
+    for (const std::string& supernode_public_id : stakes.changed_supernodes)
+      update_tier_index(stakes, supernode_public_id);
+  }
+  else
+  {
+    MDEBUG("Rebuild blockchain based list tier indexes for block " << stakes.block_number);
+
+    for (tier_index& index : m_tier_indexes)
+      index.clear();
+
+    m_tier_index_entries.clear();
+    m_tier_index_entries.reserve(stakes.stakes.size());
+
+    for (const supernode_stake& stake : stakes.stakes)
+    {
+      if (!stake.amount || !stake.tier || stake.tier > config::graft::TIERS_COUNT)
+        continue;
+
+      m_tier_indexes[stake.tier - 1].emplace_back(stake.block_height, stake.supernode_public_id);
+      m_tier_index_entries.emplace(stake.supernode_public_id, std::make_pair(size_t(stake.tier - 1), stake.block_height));
+    }
+
+    for (tier_index& index : m_tier_indexes)
+      std::sort(index.begin(), index.end());
+  }
+
+  m_indexed_snapshot_id = stakes.id;
+}
+
 void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash& block_hash, StakeTransactionStorage& stake_txs_storage)
 {
   if (block_height <= m_block_height)
@@ -68,17 +221,18 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
   if (block_height != m_block_height + 1)
     throw std::runtime_error("block_height should be next after the block already processed");
 
-  const StakeTransactionStorage::supernode_stake_array& stakes = stake_txs_storage.get_supernode_stakes(block_height);
+  supernode_stake_snapshot_ptr stakes_snapshot = stake_txs_storage.get_supernode_stake_snapshot(block_height);
+
+  update_tier_indexes(*stakes_snapshot);
 
     //build blockchain based list for each tier
 
-  supernode_array prev_supernodes, current_supernodes;
+  supernode_array prev_supernodes;
   supernode_tier_array new_tier;
 
   for (size_t i=0; i<config::graft::TIERS_COUNT; i++)
   {
     prev_supernodes.clear();
-    current_supernodes.clear();
 
       //prepare lists of valid supernodes for this tier
 
@@ -90,7 +244,7 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
       for (const supernode& sn : full_prev_supernodes)
       {
-        const supernode_stake* stake = stake_txs_storage.find_supernode_stake(block_height, sn.supernode_public_id);
+        const supernode_stake* stake = stakes_snapshot->find(sn.supernode_public_id);
 
         if (!stake || !stake->amount)
           continue;
@@ -102,27 +256,6 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
       }
     }
 
-    current_supernodes.reserve(stakes.size());
-
-    for (const supernode_stake& stake : stakes)
-    {
-      if (!stake.amount)
-        continue;
-
-      if (stake.tier != i + 1)
-        continue;
-
-      supernode sn;
-
-      sn.supernode_public_id      = stake.supernode_public_id;
-      sn.supernode_public_address = stake.supernode_public_address;
-      sn.amount                   = stake.amount;
-      sn.block_height             = stake.block_height;
-      sn.unlock_time              = stake.unlock_time;
-
-      current_supernodes.emplace_back(std::move(sn));
-    }
-
       //seed RNG
 
     std::seed_seq seed(reinterpret_cast<const unsigned char*>(&block_hash.data[0]),
@@ -130,12 +263,6 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
     m_rng.seed(seed);
 
-      //sort valid supernodes by the age of stake
-
-    std::stable_sort(current_supernodes.begin(), current_supernodes.end(), [](const supernode& s1, const supernode& s2) {
-      return s1.block_height < s2.block_height || (s1.block_height == s2.block_height && s1.supernode_public_id < s2.supernode_public_id);
-    });
-
       //select supernodes from the previous list
 
     supernode_array new_supernodes;
@@ -144,21 +271,9 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
     if (new_supernodes.size() < BLOCKCHAIN_BASED_LIST_SIZE)
     {
-        //remove supernodes of prev list from current list
-
-      auto duplicates_filter = [&](const supernode& sn1) {
-        for (const supernode& sn2 : new_supernodes)
-          if (sn1.supernode_public_id == sn2.supernode_public_id)
-            return true;
-
-        return false;
-      };
+        //select supernodes from the current list ordered by the age of stake (supernodes of prev list are skipped)
 
-      current_supernodes.erase(std::remove_if(current_supernodes.begin(), current_supernodes.end(), duplicates_filter), current_supernodes.end());
-
-        //select supernodes from the current list
-
-      select_supernodes(BLOCKCHAIN_BASED_LIST_SIZE - new_supernodes.size(), current_supernodes, new_supernodes);
+      select_supernodes(BLOCKCHAIN_BASED_LIST_SIZE - new_supernodes.size(), i, *stakes_snapshot, new_supernodes);
     }
 
       //update tier
@@ -170,9 +285,16 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
     //update history
 
-  m_history.emplace_back(std::move(new_tier));
+  add_journal_record(BBL_JOURNAL_ADD_BLOCK, block_height, new_tier);
+
+  push_history(block_height, std::move(new_tier));
+}
+
+void BlockchainBasedList::push_history(uint64_t block_height, supernode_tier_array&& tiers)
+{
+  m_history.emplace_back(std::move(tiers));
 
-  if (m_history_depth < BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH)
+  if (m_history_depth < config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH)
   {
     m_history_depth++;
   }
@@ -192,6 +314,10 @@ void BlockchainBasedList::remove_latest_block()
 
   m_need_store = true;
 
+  supernode_tier_array no_tiers;
+
+  add_journal_record(BBL_JOURNAL_REMOVE_BLOCK, m_block_height, no_tiers);
+
   m_block_height--;
   m_history_depth--;
 
@@ -201,6 +327,19 @@ void BlockchainBasedList::remove_latest_block()
     m_block_height = m_first_block_number;
 }
 
+void BlockchainBasedList::reset(uint64_t block_height, list_history&& history)
+{
+  while (history.size() > config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH)
+    history.pop_front();
+
+  m_block_height  = history.empty() ? m_first_block_number : block_height;
+  m_history_depth = history.size();
+
+  std::swap(m_history, history);
+
+  m_need_store = true;
+}
+
 namespace
 {
 
@@ -224,31 +363,78 @@ struct blockchain_based_list_container
 
 void BlockchainBasedList::store() const
 {
-  blockchain_based_list_container data(m_block_height, m_history_depth, const_cast<list_history&>(m_history));
+  if (m_storage_file_name.empty())
+  {
+    m_need_store = false;
+    return;
+  }
+
+  if (!m_journal.need_checkpoint())
+  {
+      //per block changes are appended to the journal
 
-  std::ofstream ostr;
-  ostr.open(m_storage_file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    m_journal.flush();
+    m_need_store = false;
+    return;
+  }
 
-  binary_archive<true> oar(ostr);
+  blockchain_based_list_container data(m_block_height, m_history_depth, const_cast<list_history&>(m_history));
 
-  bool success = ::serialization::serialize(oar, data);
+  std::string blob;
+  bool success = ::serialization::dump_binary(data, blob);
 
-  ostr.close();
+  CHECK_AND_ASSERT_THROW_MES(success, "Error at save blockchain based list file '" << m_storage_file_name << "'");
 
-  CHECK_AND_ASSERT_THROW_MES(success && ostr.good(), "Error at save blockchain based list file '" << m_storage_file_name << "'");
+  m_journal.write_checkpoint(blob);
 
   m_need_store = false;
 }
 
-void BlockchainBasedList::load()
+void BlockchainBasedList::add_journal_record(uint8_t type, uint64_t block_height, supernode_tier_array& tiers)
 {
-  if (!boost::filesystem::exists(m_storage_file_name))
+  if (!m_journal_enabled)
     return;
 
+  blockchain_based_list_journal_record record(type, block_height, tiers);
+
+  std::string blob;
+  bool r = ::serialization::dump_binary(record, blob);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to serialize blockchain based list journal record");
+
+  m_journal.add_record(blob);
+}
+
+void BlockchainBasedList::apply_journal_record(const std::string& blob)
+{
+  supernode_tier_array tiers;
+  blockchain_based_list_journal_record record(0, 0, tiers);
+
+  bool r = ::serialization::parse_binary(blob, record);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize blockchain based list journal record of '" << m_storage_file_name << "'");
+
+  switch (record.type)
+  {
+    case BBL_JOURNAL_ADD_BLOCK:
+      CHECK_AND_ASSERT_THROW_MES(record.block_height == m_block_height + 1, "internal error: blockchain based list journal record for block " << record.block_height << " doesn't follow block " << m_block_height);
+      push_history(record.block_height, std::move(tiers));
+      break;
+    case BBL_JOURNAL_REMOVE_BLOCK:
+      remove_latest_block();
+      break;
+    default:
+      throw std::runtime_error("internal error: unknown blockchain based list journal record type");
+  }
+}
+
+void BlockchainBasedList::load()
+{
   std::string buffer;
-  bool r = epee::file_io_utils::load_file_to_string(m_storage_file_name, buffer);
+  std::vector<std::string> journal_records;
 
-  CHECK_AND_ASSERT_THROW_MES(r, "blockchain based list file '" << m_storage_file_name << "' is not found");
+  if (m_storage_file_name.empty() || !m_journal.load(buffer, journal_records))
+    return;
 
   try
   {
@@ -257,7 +443,7 @@ void BlockchainBasedList::load()
     list_history new_history;
     blockchain_based_list_container data(0, 0, new_history);
 
-    r = ::serialization::parse_binary(buffer, data);
+    bool r = ::serialization::parse_binary(buffer, data);
 
     CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize blockchain based list file '" << m_storage_file_name << "'");
 
@@ -266,10 +452,23 @@ void BlockchainBasedList::load()
 
     std::swap(m_history, data.history);
 
+      //apply changes made after the checkpoint
+
+    m_journal_enabled = false;
+
+    for (const std::string& record : journal_records)
+      apply_journal_record(record);
+
+    m_journal_enabled = true;
+
+    if (!journal_records.empty())
+      LOG_PRINT_L0("Blockchain based list has been restored from journal with " << journal_records.size() << " record(s)");
+
     m_need_store = false;
   }
   catch (...)
   {
+    m_journal_enabled = true;
     LOG_PRINT_L0("Can't parse blockchain based list file '" << m_storage_file_name << "'");
     throw;
   }
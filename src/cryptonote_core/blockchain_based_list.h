@@ -1,13 +1,17 @@
 #pragma once
 
+#include <array>
 #include <random>
+#include <unordered_map>
 
 #include "blockchain.h"
+#include "graft_rta_config.h"
 #include "serialization/crypto.h"
 #include "serialization/list.h"
 #include "serialization/vector.h"
 #include "serialization/string.h"
 #include "cryptonote_core/stake_transaction_storage.h"
+#include "cryptonote_core/storage_journal.h"
 
 namespace cryptonote
 {
@@ -36,7 +40,7 @@ public:
   typedef std::vector<supernode_array>     supernode_tier_array;
   typedef std::list<supernode_tier_array>  list_history;
 
-  /// Constructors
+  /// Constructors (list is kept in memory only if file_name is empty)
   BlockchainBasedList(const std::string& file_name, uint64_t first_block_number);
 
   /// List of tiers
@@ -54,27 +58,61 @@ public:
   /// Remove latest block
   void remove_latest_block();
 
+  /// Replace list history with the history restored for the block (the last history item is for the block)
+  void reset(uint64_t block_height, list_history&& history);
+
   /// Save list to file
   void store() const;
 
   /// Is the list requires store
   bool need_store() const { return m_need_store; }
 
+  /// Number of bytes written to the list files
+  uint64_t get_stored_bytes_count() const { return m_journal.get_written_bytes_count(); }
+
 private:
   /// Load list from file
   void load();
 
+  /// Add tiers of the new block to the history
+  void push_history(uint64_t block_height, supernode_tier_array&& tiers);
+
+  /// Add change to the list journal
+  void add_journal_record(uint8_t type, uint64_t block_height, supernode_tier_array& tiers);
+
+  /// Apply change loaded from the list journal
+  void apply_journal_record(const std::string& record);
+
+  typedef std::pair<uint64_t, std::string> tier_index_key; //stake block height, supernode public id
+  typedef std::vector<tier_index_key>      tier_index; //valid supernodes of a tier ordered by the age of stake
+  typedef std::array<tier_index, config::graft::TIERS_COUNT> tier_index_array;
+  typedef std::unordered_map<std::string, std::pair<size_t, uint64_t>> tier_index_entry_map; //supernode public id -> tier, stake block height
+
   /// Select supernodes from a list
   void select_supernodes(size_t max_items_count, const supernode_array& src_list, supernode_array& dst_list);
 
+  /// Select supernodes from a tier index skipping supernodes which are already in dst_list
+  void select_supernodes(size_t max_items_count, size_t tier, const supernode_stake_snapshot& stakes, supernode_array& dst_list);
+
+  /// Bring tier indexes in line with the stakes snapshot (incrementally if the snapshot is based on the indexed one)
+  void update_tier_indexes(const supernode_stake_snapshot& stakes);
+
+  /// Update index entry of the supernode
+  void update_tier_index(const supernode_stake_snapshot& stakes, const std::string& supernode_public_id);
+
 private:
   std::string m_storage_file_name;
   list_history m_history;
   uint64_t m_block_height;
   size_t m_history_depth;
   std::mt19937_64 m_rng;
+  tier_index_array m_tier_indexes;
+  tier_index_entry_map m_tier_index_entries;
+  uint64_t m_indexed_snapshot_id; //identifier of the stakes snapshot tier indexes are built for (0 if none)
   uint64_t m_first_block_number;
   mutable bool m_need_store;
+  mutable StorageJournal m_journal;
+  bool m_journal_enabled;
 };
 
 }
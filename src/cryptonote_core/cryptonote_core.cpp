@@ -358,6 +358,14 @@ namespace cryptonote
     top_id = m_blockchain_storage.get_tail_id(height);
   }
   //-----------------------------------------------------------------------------------------------
+  difficulty_type core::get_difficulty_for_next_block(const crypto::hash& prev_id)
+  {
+    CRITICAL_REGION_LOCAL1(m_blockchain_storage);
+    if (m_blockchain_storage.get_tail_id() != prev_id)
+      return 0;
+    return m_blockchain_storage.get_difficulty_for_next_block();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata,block>>& blocks, std::vector<cryptonote::blobdata>& txs) const
   {
     return m_blockchain_storage.get_blocks(start_offset, count, blocks, txs);
@@ -857,7 +865,9 @@ namespace cryptonote
   bool core::handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay)
   {
     TRY_ENTRY();
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    // parsing and semantics checks (RCT signatures and range proofs) of concurrent callers overlap; input checks
+    // are serialized by the blockchain lock and the pool admission (key images insert) by the pool lock, which is
+    // also held while a batch of blocks is added
 
     struct result { bool res; cryptonote::transaction tx; crypto::hash hash; crypto::hash prefix_hash; bool in_txpool; bool in_blockchain; };
     std::vector<result> results(tx_blobs.size());
@@ -1197,7 +1207,7 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
-  void core::on_transaction_relayed(const cryptonote::blobdata& tx_blob)
+  crypto::hash core::on_transaction_relayed(const cryptonote::blobdata& tx_blob)
   {
     std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
     cryptonote::transaction tx;
@@ -1205,10 +1215,11 @@ namespace cryptonote
     if (!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash))
     {
       LOG_ERROR("Failed to parse relayed transaction");
-      return;
+      return crypto::null_hash;
     }
     txs.push_back(std::make_pair(tx_hash, std::move(tx_blob)));
     m_mempool.set_relayed(txs);
+    return tx_hash;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
@@ -1466,9 +1477,14 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::get_pool_transaction(const crypto::hash &id, cryptonote::blobdata& tx) const
+  bool core::get_pool_transaction(const crypto::hash &id, cryptonote::blobdata& tx, bool include_unrelayed_txes) const
+  {
+    return m_mempool.get_transaction(id, tx, include_unrelayed_txes);
+  }
+  //-----------------------------------------------------------------------------------------------
+  size_t core::get_pool_transactions(const std::vector<crypto::hash>& ids, std::vector<cryptonote::blobdata>& txs) const
   {
-    return m_mempool.get_transaction(id, tx);
+    return m_mempool.get_transactions(ids, txs);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::pool_has_tx(const crypto::hash &id) const
@@ -208,8 +208,10 @@ namespace cryptonote
 
      /**
       * @brief called when a transaction is relayed
+      *
+      * @return the transaction hash, null_hash if the transaction can't be parsed
       */
-     virtual void on_transaction_relayed(const cryptonote::blobdata& tx);
+     virtual crypto::hash on_transaction_relayed(const cryptonote::blobdata& tx);
 
 
      /**
@@ -310,6 +312,15 @@ namespace cryptonote
       */
      void get_blockchain_top(uint64_t& height, crypto::hash& top_id) const;
 
+     /**
+      * @brief get the difficulty a block on top of the given block must meet
+      *
+      * @param prev_id the hash of the previous block of the new block
+      *
+      * @return the difficulty for the next block, or 0 if prev_id is not the most recent block
+      */
+     difficulty_type get_difficulty_for_next_block(const crypto::hash& prev_id);
+
      /**
       * @copydoc Blockchain::get_blocks(uint64_t, size_t, std::vector<std::pair<cryptonote::blobdata,block>>&, std::vector<transaction>&) const
       *
@@ -462,7 +473,14 @@ namespace cryptonote
       *
       * @note see tx_memory_pool::get_transaction
       */
-     bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx) const;
+     bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx, bool include_unrelayed_txes = true) const;
+
+     /**
+      * @copydoc tx_memory_pool::get_transactions(const std::vector<crypto::hash>&, std::vector<cryptonote::blobdata>&) const
+      *
+      * @note see tx_memory_pool::get_transactions
+      */
+     size_t get_pool_transactions(const std::vector<crypto::hash>& ids, std::vector<cryptonote::blobdata>& txs) const;
 
      /**
       * @copydoc tx_memory_pool::get_pool_transactions_and_spent_keys_info
@@ -980,7 +998,7 @@ namespace cryptonote
 
      i_cryptonote_protocol* m_pprotocol; //!< cryptonote protocol instance
 
-     epee::critical_section m_incoming_tx_lock; //!< incoming transaction lock
+     epee::critical_section m_incoming_tx_lock; //!< held while a batch of incoming blocks is added
 
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner; //!< miner instance
@@ -1,6 +1,7 @@
 #include <string_tools.h>
 
 #include "stake_transaction_processor.h"
+#include "serialization/binary_utils.h"
 #include "../graft_rta_config.h"
 
 #include <mutex>
@@ -18,6 +19,66 @@ namespace
 const char* STAKE_TRANSACTION_STORAGE_FILE_NAME = "stake_transactions.v2.bin";
 const char* BLOCKCHAIN_BASED_LIST_FILE_NAME     = "blockchain_based_list.v5.bin";
 
+const uint64_t BULK_SYNC_MIN_BLOCKS_COUNT  = 1000; //blocks count behind the blockchain to start bulk synchronization
+const uint64_t BULK_SYNC_BATCH_SIZE        = 1000; //blocks count applied under locks at once
+const size_t   BULK_SYNC_TASK_BLOCKS_COUNT = 50;   //blocks count loaded by one thread pool task
+
+/// Write transaction for RTA state of blocks processed during synchronization (aborted if not committed)
+class rta_state_db_txn
+{
+public:
+  rta_state_db_txn(BlockchainDB& db) : m_db(db), m_active() {}
+
+  ~rta_state_db_txn()
+  {
+    if (!m_active)
+      return;
+
+    try
+    {
+      m_db.block_txn_abort();
+    }
+    catch (...)
+    {
+    }
+  }
+
+  void start()
+  {
+    if (m_active)
+      return;
+
+    m_db.block_txn_start(false);
+
+    m_active = true;
+  }
+
+  void commit()
+  {
+    if (!m_active)
+      return;
+
+    m_active = false;
+
+    m_db.block_txn_stop();
+  }
+
+private:
+  BlockchainDB& m_db;
+  bool m_active;
+};
+
+/// Resets bulk synchronization flag
+class bulk_synchronization_guard
+{
+public:
+  bulk_synchronization_guard(std::atomic<bool>& flag) : m_flag(flag) {}
+  ~bulk_synchronization_guard() { m_flag = false; }
+
+private:
+  std::atomic<bool>& m_flag;
+};
+
 }
 
 bool stake_transaction::is_valid(uint64_t block_index) const
@@ -38,17 +99,29 @@ StakeTransactionProcessor::StakeTransactionProcessor(Blockchain& blockchain)
   : m_blockchain(blockchain)
   , m_stakes_need_update(true)
   , m_blockchain_based_list_need_update(true)
+  , m_blockchain_based_list_update_depth()
+  , m_db_storage()
 {
 }
 
-const supernode_stake* StakeTransactionProcessor::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id) const
+supernode_stake_snapshot_ptr StakeTransactionProcessor::get_supernode_stake_snapshot(uint64_t block_number) const
 {
+  if (m_storages_initialized.load(std::memory_order_acquire))
+  {
+      //fast path for cached snapshots, no need to wait until synchronization is finished
+
+    supernode_stake_snapshot_ptr snapshot = m_storage->find_supernode_stake_snapshot(block_number);
+
+    if (snapshot)
+      return snapshot;
+  }
+
   CRITICAL_REGION_LOCAL1(m_storage_lock);
 
   if (!m_storage)
     return nullptr;
 
-  return m_storage->find_supernode_stake(block_number, supernode_public_id);
+  return m_storage->get_supernode_stake_snapshot(block_number);
 }
 
 namespace
@@ -144,112 +217,226 @@ void StakeTransactionProcessor::init_storages_impl()
 
   MDEBUG("Initialize stake processing storages. First block height is " << first_block_number);
 
-  m_storage.reset(new StakeTransactionStorage(m_config_dir + "/" + STAKE_TRANSACTION_STORAGE_FILE_NAME, first_block_number));
-  m_blockchain_based_list.reset(new BlockchainBasedList(m_config_dir + "/" + BLOCKCHAIN_BASED_LIST_FILE_NAME, first_block_number));
+  BlockchainDB& db = m_blockchain.get_db();
+
+  m_db_storage = db.has_rta_state();
+
+  if (m_db_storage)
+  {
+      //RTA state is stored with blocks, storages are restored from the database and kept in memory
+
+    m_storage.reset(new StakeTransactionStorage(std::string(), first_block_number));
+    m_blockchain_based_list.reset(new BlockchainBasedList(std::string(), first_block_number));
+
+    if (m_enabled)
+      restore_storages_from_db();
+
+    db.set_rta_state_provider(this);
+  }
+  else
+  {
+    m_storage.reset(new StakeTransactionStorage(m_config_dir + "/" + STAKE_TRANSACTION_STORAGE_FILE_NAME, first_block_number));
+    m_blockchain_based_list.reset(new BlockchainBasedList(m_config_dir + "/" + BLOCKCHAIN_BASED_LIST_FILE_NAME, first_block_number));
+  }
+
+  m_storages_initialized.store(true, std::memory_order_release);
 }
 
-void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+void StakeTransactionProcessor::restore_storages_from_db()
 {
-  if (block_index <= m_storage->get_last_processed_block_index())
+  const BlockchainDB& db = m_blockchain.get_db();
+
+  uint64_t height = std::min(db.get_rta_state_height(), db.height());
+
+  if (!height)
+  {
+    m_storage->reset(0, StakeTransactionStorage::block_hash_list(), StakeTransactionStorage::stake_transaction_array());
+    m_blockchain_based_list->reset(0, BlockchainBasedList::list_history());
     return;
+  }
 
-  if (m_blockchain.get_hard_fork_version(block_index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+  uint64_t last_block_index = height - 1;
+
+    //stake transactions of all blocks
+
+  StakeTransactionStorage::stake_transaction_array stake_txs;
+
+  db.for_all_rta_stake_txs([&](uint64_t block_index, const blobdata& blob) {
+    if (block_index > last_block_index)
+      return false;
+
+    StakeTransactionStorage::stake_transaction_array block_stake_txs;
+
+    bool r = ::serialization::parse_binary(blob, block_stake_txs);
+
+    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize stake transactions of block " << block_index);
+
+    for (stake_transaction& tx : block_stake_txs)
+      stake_txs.emplace_back(std::move(tx));
+
+    return true;
+  });
+
+    //blockchain based lists and hashes of the latest blocks
+
+  BlockchainBasedList::list_history history;
+  StakeTransactionStorage::block_hash_list block_hashes;
+
+  for (uint64_t block_index=last_block_index; history.size()<config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH; block_index--)
   {
-      //analyze block transactions and add new stake transactions if exist
+    blobdata blob;
 
-    stake_transaction stake_tx;
+    if (!db.get_block_rta_blockchain_based_list(block_index, blob))
+      break;
 
-    std::vector<transaction> txs;
-    std::vector<crypto::hash> missed_txs;
-    
-    if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs))
-    {
-      MWARNING("Unable to get transactions for block #" << block_index);
-      return;
-    }
+    BlockchainBasedList::supernode_tier_array tiers;
 
-    if (!missed_txs.empty())
-    {
-      MWARNING("Some transactions for block #" << block_index << " have been missed:");
+    bool r = ::serialization::parse_binary(blob, tiers);
 
-      for (const crypto::hash& tx_hash : missed_txs)
-        MWARNING("  " << tx_hash);
-    }
+    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize blockchain based list of block " << block_index);
 
-    for (const transaction& tx : txs)
-    {
-      const crypto::hash tx_hash = get_transaction_prefix_hash(tx);
+    history.emplace_front(std::move(tiers));
+    block_hashes.push_front(db.get_block_hash_from_height(block_index));
 
-      try
-      {
-        if (!get_graft_stake_tx_extra_from_extra(tx, stake_tx.supernode_public_id, stake_tx.supernode_public_address, stake_tx.supernode_signature, stake_tx.tx_secret_key))
-          continue;
+    if (!block_index)
+      break;
+  }
 
-        crypto::public_key W;
-        if (!epee::string_tools::hex_to_pod(stake_tx.supernode_public_id, W) || !check_key(W))
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash
-            << " because of invalid supernode public identifier '" << stake_tx.supernode_public_id << "'");
-          continue;
-        }
+  MDEBUG("Restore stake processing storages from database: block " << last_block_index << ", " << stake_txs.size()
+    << " stake transaction(s), " << history.size() << " blockchain based list(s)");
 
-        const bool is_subaddress = false;
-        std::string supernode_public_address_str = cryptonote::get_account_address_as_str(m_blockchain.nettype(), is_subaddress, stake_tx.supernode_public_address);
-        std::string data = supernode_public_address_str + ":" + stake_tx.supernode_public_id;
-        crypto::hash hash;
-        crypto::cn_fast_hash(data.data(), data.size(), hash);
+  m_storage->reset(last_block_index, std::move(block_hashes), std::move(stake_txs));
+  m_blockchain_based_list->reset(last_block_index, std::move(history));
+}
 
-        if (!crypto::check_signature(hash, W, stake_tx.supernode_signature))
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because of invalid supernode signature (mismatch)");
-          continue;
-        }
+void StakeTransactionProcessor::get_processed_block_rta_state(uint64_t block_index, blobdata& stake_txs_blob, blobdata& blockchain_based_list_blob, bool include_blockchain_based_list) const
+{
+  stake_txs_blob.clear();
+  blockchain_based_list_blob.clear();
 
-        uint64_t unlock_time = tx.unlock_time - block_index;
+    //stake transactions are appended in order of blocks, so the block transactions are at the end
 
-        if (unlock_time < config::graft::STAKE_MIN_UNLOCK_TIME)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because unlock time " << unlock_time << " is less than minimum allowed " << config::graft::STAKE_MIN_UNLOCK_TIME);
-          continue;
-        }
-        const auto CURRENT_STAKE_MAX_UNLOCK_TIME = m_blockchain.get_current_hard_fork_version() < 16 ? config::graft::STAKE_MAX_UNLOCK_TIME_V15
-                                                                                                     : config::graft::STAKE_MAX_UNLOCK_TIME;
-        if (unlock_time > CURRENT_STAKE_MAX_UNLOCK_TIME)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because unlock time " << unlock_time << " is greater than maximum allowed " << CURRENT_STAKE_MAX_UNLOCK_TIME);
-          continue;
-        }
+  const StakeTransactionStorage::stake_transaction_array& all_stake_txs = m_storage->get_txs();
 
-        uint64_t amount = get_transaction_amount(tx, stake_tx.supernode_public_address, stake_tx.tx_secret_key);
+  auto first_tx = all_stake_txs.end();
 
-        if (!amount)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because of error at parsing amount");
-          continue;
-        }
+  while (first_tx != all_stake_txs.begin() && std::prev(first_tx)->block_height == block_index)
+    --first_tx;
+
+  if (first_tx != all_stake_txs.end())
+  {
+    StakeTransactionStorage::stake_transaction_array stake_txs(first_tx, all_stake_txs.end());
+
+    bool r = ::serialization::dump_binary(stake_txs, stake_txs_blob);
+
+    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to serialize stake transactions of block " << block_index);
+  }
+
+  if (include_blockchain_based_list && m_blockchain_based_list->block_height() == block_index)
+  {
+    BlockchainBasedList::supernode_tier_array tiers = m_blockchain_based_list->tiers();
+
+    bool r = ::serialization::dump_binary(tiers, blockchain_based_list_blob);
+
+    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to serialize blockchain based list of block " << block_index);
+  }
+}
+
+void StakeTransactionProcessor::parse_block_stake_transactions(uint64_t block_index, const std::vector<transaction>& txs, stake_transaction_array& stake_txs) const
+{
+    //analyze block transactions and collect stake transactions if exist
 
-        stake_tx.amount = amount;
-        stake_tx.block_height = block_index;
-        stake_tx.hash = tx_hash;
-        stake_tx.unlock_time = unlock_time;
+  stake_transaction stake_tx;
 
-        m_storage->add_tx(stake_tx);
+  for (const transaction& tx : txs)
+  {
+    const crypto::hash tx_hash = get_transaction_prefix_hash(tx);
+
+    try
+    {
+      if (!get_graft_stake_tx_extra_from_extra(tx, stake_tx.supernode_public_id, stake_tx.supernode_public_address, stake_tx.supernode_signature, stake_tx.tx_secret_key))
+        continue;
 
-        MDEBUG("New stake transaction found at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id
-          << "', amount=" << amount / double(COIN));
+      crypto::public_key W;
+      if (!epee::string_tools::hex_to_pod(stake_tx.supernode_public_id, W) || !check_key(W))
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash
+          << " because of invalid supernode public identifier '" << stake_tx.supernode_public_id << "'");
+        continue;
       }
-      catch (std::exception& e)
+
+      const bool is_subaddress = false;
+      std::string supernode_public_address_str = cryptonote::get_account_address_as_str(m_blockchain.nettype(), is_subaddress, stake_tx.supernode_public_address);
+      std::string data = supernode_public_address_str + ":" + stake_tx.supernode_public_id;
+      crypto::hash hash;
+      crypto::cn_fast_hash(data.data(), data.size(), hash);
+
+      if (!crypto::check_signature(hash, W, stake_tx.supernode_signature))
       {
-        MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because of invalid supernode signature (mismatch)");
+        continue;
       }
-      catch (...)
+
+      uint64_t unlock_time = tx.unlock_time - block_index;
+
+      if (unlock_time < config::graft::STAKE_MIN_UNLOCK_TIME)
       {
-        MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because unlock time " << unlock_time << " is less than minimum allowed " << config::graft::STAKE_MIN_UNLOCK_TIME);
+        continue;
       }
+      const auto CURRENT_STAKE_MAX_UNLOCK_TIME = m_blockchain.get_current_hard_fork_version() < 16 ? config::graft::STAKE_MAX_UNLOCK_TIME_V15
+                                                                                                   : config::graft::STAKE_MAX_UNLOCK_TIME;
+      if (unlock_time > CURRENT_STAKE_MAX_UNLOCK_TIME)
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because unlock time " << unlock_time << " is greater than maximum allowed " << CURRENT_STAKE_MAX_UNLOCK_TIME);
+        continue;
+      }
+
+      uint64_t amount = get_transaction_amount(tx, stake_tx.supernode_public_address, stake_tx.tx_secret_key);
+
+      if (!amount)
+      {
+        MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+          << " because of error at parsing amount");
+        continue;
+      }
+
+      stake_tx.amount = amount;
+      stake_tx.block_height = block_index;
+      stake_tx.hash = tx_hash;
+      stake_tx.unlock_time = unlock_time;
+
+      stake_txs.push_back(stake_tx);
+    }
+    catch (std::exception& e)
+    {
+      MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
+    }
+    catch (...)
+    {
+      MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
+    }
+  }
+}
+
+void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& stake_txs, bool update_storage)
+{
+  if (block_index <= m_storage->get_last_processed_block_index())
+    return;
+
+  if (m_blockchain.get_hard_fork_version(block_index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+  {
+      //add new stake transactions if exist
+
+    for (const stake_transaction& stake_tx : stake_txs)
+    {
+      m_storage->add_tx(stake_tx);
+
+      MDEBUG("New stake transaction found at block #" << block_index << ", tx_hash=" << stake_tx.hash << ", supernode_public_id '" << stake_tx.supernode_public_id
+        << "', amount=" << stake_tx.amount / double(COIN));
     }
 
     m_stakes_need_update = true; //TODO: cache for stakes
@@ -267,12 +454,15 @@ void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_i
     m_storage->store();
 }
 
-void StakeTransactionProcessor::process_block_blockchain_based_list(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+void StakeTransactionProcessor::process_block_blockchain_based_list(uint64_t block_index, const crypto::hash& block_hash, bool update_storage)
 {
   uint64_t prev_block_height = m_blockchain_based_list->block_height();
 
   m_blockchain_based_list->apply_block(block_index, block_hash, *m_storage);
 
+  if (prev_block_height != m_blockchain_based_list->block_height())
+    m_blockchain_based_list_update_depth++;
+
   if (m_blockchain_based_list->need_store() || prev_block_height != m_blockchain_based_list->block_height())
   {
     m_blockchain_based_list_need_update = true;
@@ -282,111 +472,499 @@ void StakeTransactionProcessor::process_block_blockchain_based_list(uint64_t blo
   }
 }
 
-void StakeTransactionProcessor::process_block(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+void StakeTransactionProcessor::process_block(uint64_t block_index, const crypto::hash& block_hash, const std::vector<transaction>& txs, bool update_storage)
 {
-  process_block_stake_transaction(block_index, block, block_hash, update_storage);
-  process_block_blockchain_based_list(block_index, block, block_hash, update_storage);
+  stake_transaction_array stake_txs;
+
+  if (block_index > m_storage->get_last_processed_block_index() &&
+      m_blockchain.get_hard_fork_version(block_index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+    parse_block_stake_transactions(block_index, txs, stake_txs);
+
+  process_block(block_index, block_hash, stake_txs, update_storage);
 }
 
-void StakeTransactionProcessor::synchronize()
+void StakeTransactionProcessor::process_block(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& stake_txs, bool update_storage)
 {
-  std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
-  std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
-  std::lock(storage_lock, blockchain_lock);
+  process_block_stake_transaction(block_index, block_hash, stake_txs, update_storage);
+  process_block_blockchain_based_list(block_index, block_hash, update_storage);
+}
 
-  uint64_t height = m_blockchain.get_current_blockchain_height();
+void StakeTransactionProcessor::remove_last_processed_block()
+{
+  size_t   stake_tx_count = m_storage->get_tx_count();
+  uint64_t last_processed_block_index = m_storage->get_last_processed_block_index();
 
-  if (!height || m_blockchain.get_hard_fork_version(height - 1) < config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+  m_storage->remove_last_processed_block();
+
+  if (stake_tx_count != m_storage->get_tx_count())
+    m_storage->clear_supernode_stakes();
+
+  if (m_blockchain_based_list->block_height() == last_processed_block_index)
+    m_blockchain_based_list->remove_latest_block();
+}
+
+bool StakeTransactionProcessor::get_block_rta_state(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs,
+  blobdata& stake_txs, blobdata& blockchain_based_list)
+{
+    //the block is added under the blockchain lock, don't wait for the storage lock here (synchronize() takes locks
+    //in the other order); blocks which are not processed here are processed and stored by synchronize()
+
+  std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::try_to_lock};
+
+  if (!storage_lock.owns_lock())
+    return false;
+
+  if (!m_db_storage || !m_storage || !m_blockchain_based_list || m_restore_from_db_needed)
+    return false;
+
+  if (m_storage->get_last_processed_block_index() + 1 != height || m_blockchain_based_list->block_height() + 1 != height)
+    return false;
+
+  if (m_storage->has_last_processed_block() && m_storage->get_last_processed_block_hash() != blk.prev_id)
+    return false; //storages are not synchronized with the new chain yet
+
+  try
+  {
+    if (m_blockchain.get_hard_fork_version(height) < config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+      return false;
+
+    process_block(height, blk_hash, txs, false);
+
+    get_processed_block_rta_state(height, stake_txs, blockchain_based_list);
+
+    return true;
+  }
+  catch (const std::exception& e)
+  {
+    MWARNING("Stake transactions processing of block " << height << " failed: " << e.what());
+  }
+  catch (...)
+  {
+    MWARNING("Stake transactions processing of block " << height << " failed");
+  }
+
+    //the block may have been applied in memory partially, synchronize() returns to the stored state and processes it again
+
+  m_restore_from_db_needed = true;
+
+  return false;
+}
+
+void StakeTransactionProcessor::on_block_rta_state_aborted()
+{
+    //called under the blockchain lock with or without the storage lock; the database is not read here because
+    //the write transaction is being aborted, synchronize() restores the storages
+
+  m_restore_from_db_needed = true;
+}
+
+void StakeTransactionProcessor::on_block_rta_state_removed(uint64_t height)
+{
+    //the block is removed under the blockchain lock, see get_block_rta_state; if the storage lock is busy,
+    //synchronize() unrolls the block by comparison of block hashes
+
+  std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::try_to_lock};
+
+  if (!storage_lock.owns_lock())
+    return;
+
+  if (!m_db_storage || !m_storage || !m_blockchain_based_list)
     return;
 
+  if (!m_storage->has_last_processed_block() || m_storage->get_last_processed_block_index() != height)
+    return;
+
+  try
+  {
+    remove_last_processed_block();
+  }
+  catch (const std::exception& e)
+  {
+    MWARNING("Stake transactions processing: unroll of block " << height << " failed: " << e.what());
+  }
+}
+
+bool StakeTransactionProcessor::prepare_synchronization(uint64_t& height, uint64_t& first_block_index)
+{
+  height = m_blockchain.get_current_blockchain_height();
+
+  if (!height || m_blockchain.get_hard_fork_version(height - 1) < config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+    return false;
+
   if (!m_storage || !m_blockchain_based_list)
   {
     init_storages_impl();
   }
 
+  if (m_db_storage && m_restore_from_db_needed.exchange(false))
+  {
+    MWARNING("Stake transactions processing: restore storages after failed block update");
+
+    try
+    {
+      restore_storages_from_db();
+    }
+    catch (...)
+    {
+      m_restore_from_db_needed = true;
+      throw;
+    }
+  }
+
     //unroll already processed blocks for alternative chains
-  
+
+  while (m_storage->has_last_processed_block())
+  {
+    uint64_t last_processed_block_index = m_storage->get_last_processed_block_index();
+
+    if (last_processed_block_index < height)
+    {
+      try
+      {
+        const crypto::hash& last_processed_block_hash  = m_storage->get_last_processed_block_hash();
+        crypto::hash        last_blockchain_block_hash = m_blockchain.get_block_id_by_height(last_processed_block_index);
+
+        if (!memcmp(&last_processed_block_hash.data[0], &last_blockchain_block_hash.data[0], sizeof(last_blockchain_block_hash.data)))
+          break; //latest block hash is the same as processed
+      }
+      catch (BLOCK_DNE&)
+      {
+        //block does not exist, waiting until it will be received
+        return false;
+      }
+    }
+
+    MWARNING("Stake transactions processing: unroll block " << last_processed_block_index << " (height=" << height << ")");
+
+    remove_last_processed_block();
+  }
+
+  first_block_index = get_first_unprocessed_block_index();
+
+  return true;
+}
+
+uint64_t StakeTransactionProcessor::get_first_unprocessed_block_index() const
+{
+  uint64_t first_block_index = m_storage->get_last_processed_block_index() + 1;
+
+  if (first_block_index > m_blockchain_based_list->block_height() + 1)
+    first_block_index = m_blockchain_based_list->block_height() + 1;
+
+  return first_block_index;
+}
+
+void StakeTransactionProcessor::load_block(uint64_t block_index, sync_block& result) const
+{
+    //called from thread pool without locks, so only database is accessed (blockchain may be changed meanwhile,
+    //loaded block is checked against blockchain before applying)
+
   try
   {
-    while (m_storage->has_last_processed_block())
+    const BlockchainDB& db = m_blockchain.get_db();
+    block blk = db.get_block_from_height(block_index);
+
+    result.block_hash = get_block_hash(blk);
+
+    if (db.get_hard_fork_version(block_index) < config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
+    {
+      result.loaded = true;
+      return;
+    }
+
+    std::vector<transaction> txs;
+
+    txs.reserve(blk.tx_hashes.size());
+
+    for (const crypto::hash& tx_hash : blk.tx_hashes)
     {
-      size_t   stake_tx_count = m_storage->get_tx_count();
-      uint64_t last_processed_block_index = m_storage->get_last_processed_block_index();
+      transaction tx;
 
-      if (last_processed_block_index < height)
+      if (!db.get_tx(tx_hash, tx))
       {
-        try
-        {
-          const crypto::hash& last_processed_block_hash  = m_storage->get_last_processed_block_hash();
-          crypto::hash        last_blockchain_block_hash = m_blockchain.get_block_id_by_height(last_processed_block_index);
+        MWARNING("Transaction " << tx_hash << " for block #" << block_index << " has been missed");
+        continue;
+      }
 
-          if (!memcmp(&last_processed_block_hash.data[0], &last_blockchain_block_hash.data[0], sizeof(last_blockchain_block_hash.data)))
-            break; //latest block hash is the same as processed
-        }
-        catch (BLOCK_DNE&)
-        {
-          //block does not exist, waiting until it will be received
-          return;
-        }
+      txs.emplace_back(std::move(tx));
+    }
+
+    parse_block_stake_transactions(block_index, txs, result.stake_txs);
+
+    result.loaded = true;
+  }
+  catch (BLOCK_DNE&)
+  {
+    result.error = "Block #" + std::to_string(block_index) + " has not been found";
+  }
+  catch (const std::exception& e)
+  {
+    result.error = "Error at loading block #" + std::to_string(block_index) + ": " + e.what();
+  }
+  catch (...)
+  {
+    result.error = "Unknown error at loading block #" + std::to_string(block_index);
+  }
+}
+
+void StakeTransactionProcessor::load_blocks(sync_batch& batch, uint64_t first_block_index, size_t blocks_count, tools::threadpool* tpool) const
+{
+  batch.first_block_index = first_block_index;
+  batch.blocks.resize(blocks_count);
+
+  if (!tpool)
+  {
+    for (size_t i=0; i<blocks_count; i++)
+      load_block(first_block_index + i, batch.blocks[i]);
+
+    return;
+  }
+
+  for (size_t begin=0; begin<blocks_count; begin+=BULK_SYNC_TASK_BLOCKS_COUNT)
+  {
+    size_t end = std::min(begin + BULK_SYNC_TASK_BLOCKS_COUNT, blocks_count);
+
+    tpool->submit(&batch.waiter, [this, &batch, begin, end]() {
+      for (size_t i=begin; i<end; i++)
+        load_block(batch.first_block_index + i, batch.blocks[i]);
+    }, true);
+  }
+}
+
+uint64_t StakeTransactionProcessor::apply_blocks(const sync_batch& batch, uint64_t height)
+{
+  static const uint64_t SYNC_DEBUG_LOG_STEP = 10000;
+
+  uint64_t block_index = batch.first_block_index;
+
+    //batch has to continue the processed blocks of the current chain
+
+  if (block_index != get_first_unprocessed_block_index())
+    return block_index;
+
+  if (m_storage->has_last_processed_block() &&
+      m_storage->get_last_processed_block_hash() != m_blockchain.get_block_id_by_height(m_storage->get_last_processed_block_index()))
+    return block_index;
+
+    //blocks which have not been processed while being added to the blockchain are stored in one database transaction
+
+  BlockchainDB& db = m_blockchain.get_db();
+  rta_state_db_txn db_txn(db);
+
+  for (const sync_block& batch_block : batch.blocks)
+  {
+    if (block_index % SYNC_DEBUG_LOG_STEP == 0 || block_index == height - 1)
+      MDEBUG("RTA block sync " << block_index << "/" << (height - 1));
+
+    if (block_index >= height)
+      break; //block does not exist, waiting until it will be received
+
+    const sync_block* loaded_block = &batch_block;
+    sync_block reloaded_block;
+
+    if (!loaded_block->loaded)
+    {
+        //the block may have been changed while being loaded without locks, try again under locks
+
+      load_block(block_index, reloaded_block);
+
+      if (!reloaded_block.loaded)
+      {
+        MWARNING(reloaded_block.error);
+        throw std::runtime_error("Error at parsing blockchain. Block has not been loaded");
       }
-      
-      MWARNING("Stake transactions processing: unroll block " << last_processed_block_index << " (height=" << height << ")");
 
-      m_storage->remove_last_processed_block();
+      loaded_block = &reloaded_block;
+    }
+
+    if (loaded_block->block_hash != m_blockchain.get_block_id_by_height(block_index))
+      break; //blockchain has been changed after the block was loaded
+
+    process_block(block_index, loaded_block->block_hash, loaded_block->stake_txs, false);
+
+    if (m_db_storage)
+    {
+        //blockchain based lists are needed only for the latest blocks
+
+      bool include_blockchain_based_list = block_index + config::graft::BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH >= height;
+      blobdata stake_txs, blockchain_based_list;
 
-      if (stake_tx_count != m_storage->get_tx_count())
-        m_storage->clear_supernode_stakes();
+      get_processed_block_rta_state(block_index, stake_txs, blockchain_based_list, include_blockchain_based_list);
 
-      if (m_blockchain_based_list->block_height() == last_processed_block_index)
-        m_blockchain_based_list->remove_latest_block();
+      db_txn.start();
+      db.add_block_rta_state(block_index, stake_txs, blockchain_based_list);
     }
 
-    //apply new blocks
+    block_index++;
+  }
 
-    uint64_t first_block_index = m_storage->get_last_processed_block_index() + 1;
+  db_txn.commit();
 
-    if (first_block_index > m_blockchain_based_list->block_height() + 1)
-      first_block_index = m_blockchain_based_list->block_height() + 1;
+  if (m_blockchain_based_list->need_store())
+    m_blockchain_based_list->store();
 
-    static const uint64_t SYNC_DEBUG_LOG_STEP  = 10000;
-    static const uint64_t MAX_ITERATIONS_COUNT = 10000;
+  if (m_storage->need_store())
+    m_storage->store();
+
+  return block_index;
+}
+
+void StakeTransactionProcessor::handle_synchronization_error(const std::exception& e)
+{
+  MWARNING(e.what());
+
+  if (!m_db_storage)
+    return;
+
+    //blocks processed in memory may have not been stored, return to the stored state
+
+  try
+  {
+    restore_storages_from_db();
+  }
+  catch (const std::exception &restore_error)
+  {
+    MWARNING("Can't restore stake processing storages from database: " << restore_error.what());
+  }
+}
 
-    uint64_t last_block_index = first_block_index,
-             last_block_index_for_sync = height;
+bool StakeTransactionProcessor::bulk_synchronize()
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+
+  if (tpool.get_max_concurrency() < 2 || !m_blockchain.get_db().can_thread_bulk_indices())
+    return true;
+
+    //blocks are loaded and parsed in the thread pool without locks, the next batch is loaded while
+    //the current one is applied; locks are taken only to apply the loaded blocks in order
 
-    if (last_block_index_for_sync - last_block_index > MAX_ITERATIONS_COUNT)
-      last_block_index_for_sync = first_block_index + MAX_ITERATIONS_COUNT;
+  std::unique_ptr<sync_batch> batch, next_batch;
+  std::unique_ptr<bulk_synchronization_guard> guard;
+  uint64_t height = 0;
+
+    //loading tasks write to their batch, so it can't be dropped before they finish
+
+  auto drop_batch = [&tpool](std::unique_ptr<sync_batch>& dropped_batch) {
+    if (!dropped_batch)
+      return;
 
-    for (; last_block_index<last_block_index_for_sync; last_block_index++)
+    dropped_batch->waiter.wait(&tpool);
+    dropped_batch.reset();
+  };
+
+  for (;;)
+  {
+    if (!batch)
     {
-      if (last_block_index % SYNC_DEBUG_LOG_STEP == 0 || last_block_index == height - 1)
-        MDEBUG("RTA block sync " << last_block_index << "/" << (height - 1));
+      uint64_t first_block_index = 0;
 
-      try
       {
-        crypto::hash block_hash = m_blockchain.get_block_id_by_height(last_block_index);
-        block block;
+        std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
+        std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
+        std::lock(storage_lock, blockchain_lock);
 
-        if (!m_blockchain.get_block_by_hash(block_hash, block))
+        try
+        {
+          if (!prepare_synchronization(height, first_block_index))
+            return false;
+        }
+        catch (const std::exception& e)
         {
-          MWARNING("Block with hash " << block_hash << " has not been found");
-          throw std::runtime_error("Error at parsing blockchain. Block hash has not been found");
+          handle_synchronization_error(e);
+          return false;
         }
+      }
+
+      if (height - first_block_index < BULK_SYNC_MIN_BLOCKS_COUNT)
+        return true; //the rest is synchronized under locks
+
+      if (!guard)
+      {
+        bool expected_bulk_synchronization = false;
+
+        if (!m_bulk_synchronization.compare_exchange_strong(expected_bulk_synchronization, true))
+          return false; //bulk synchronization is in progress in another thread
 
-        process_block(last_block_index, block, block_hash, false);
+        guard.reset(new bulk_synchronization_guard(m_bulk_synchronization));
+
+        MDEBUG("RTA bulk sync from block " << first_block_index << " (height=" << height << ")");
       }
-      catch (BLOCK_DNE&)
+
+      batch.reset(new sync_batch);
+      load_blocks(*batch, first_block_index, std::min(BULK_SYNC_BATCH_SIZE, height - first_block_index), &tpool);
+    }
+
+    batch->waiter.wait(&tpool);
+
+    uint64_t next_first_block_index = batch->first_block_index + batch->blocks.size();
+
+    if (height - next_first_block_index >= BULK_SYNC_MIN_BLOCKS_COUNT)
+    {
+      next_batch.reset(new sync_batch);
+      load_blocks(*next_batch, next_first_block_index, std::min(BULK_SYNC_BATCH_SIZE, height - next_first_block_index), &tpool);
+    }
+
+    uint64_t last_block_index = 0;
+    bool applied = true;
+
+    {
+      std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
+      std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
+      std::lock(storage_lock, blockchain_lock);
+
+      try
       {
-        //block does not exist, waiting until it will be received
-        break;
+        last_block_index = apply_blocks(*batch, m_blockchain.get_current_blockchain_height());
+      }
+      catch (const std::exception& e)
+      {
+        handle_synchronization_error(e);
+        applied = false;
       }
     }
 
-    if (m_blockchain_based_list->need_store())
-      m_blockchain_based_list->store();
+    if (!applied)
+    {
+      drop_batch(next_batch);
+      return false;
+    }
+
+    if (last_block_index != next_first_block_index)
+    {
+        //blockchain has been changed, start from the actual state
+
+      drop_batch(next_batch);
+    }
+
+    batch = std::move(next_batch);
+  }
+}
+
+void StakeTransactionProcessor::synchronize()
+{
+  if (!bulk_synchronize())
+    return;
 
-    if (m_storage->need_store())
-      m_storage->store();
+  std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
+  std::unique_lock<Blockchain> blockchain_lock{m_blockchain, std::defer_lock};
+  std::lock(storage_lock, blockchain_lock);
+
+  try
+  {
+    uint64_t height = 0, first_block_index = 0;
+
+    if (!prepare_synchronization(height, first_block_index))
+      return;
+
+      //apply new blocks
+
+    static const uint64_t MAX_ITERATIONS_COUNT = 10000;
+
+    sync_batch batch;
+
+    load_blocks(batch, first_block_index, std::min(height - first_block_index, MAX_ITERATIONS_COUNT), nullptr);
+
+    uint64_t last_block_index = apply_blocks(batch, height);
 
     if (last_block_index == height)
     {
@@ -394,7 +972,9 @@ void StakeTransactionProcessor::synchronize()
         invoke_update_stakes_handler_impl(last_block_index - 1);
 
       if (m_blockchain_based_list_need_update && m_on_blockchain_based_list_update)
-        invoke_update_blockchain_based_list_handler_impl(last_block_index - first_block_index);
+        invoke_update_blockchain_based_list_handler_impl(m_blockchain_based_list_update_depth);
+
+      m_blockchain_based_list_update_depth = 0;
 
       if (first_block_index != last_block_index)
         MDEBUG("Stake transactions sync OK");
@@ -402,7 +982,7 @@ void StakeTransactionProcessor::synchronize()
   }
   catch (const std::exception &e)
   {
-    MWARNING(e.what());
+    handle_synchronization_error(e);
   }
 }
 
@@ -1,29 +1,32 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 
 #include "blockchain.h"
+#include "common/threadpool.h"
 #include "cryptonote_core/blockchain_based_list.h"
 #include "cryptonote_core/stake_transaction_storage.h"
 
 namespace cryptonote
 {
 
-class StakeTransactionProcessor
+class StakeTransactionProcessor: public RtaStateProvider
 {
 public:
-  typedef StakeTransactionStorage::supernode_stake_array supernode_stake_array;
+  typedef StakeTransactionStorage::supernode_stake_array   supernode_stake_array;
+  typedef StakeTransactionStorage::stake_transaction_array stake_transaction_array;
 
   StakeTransactionProcessor(Blockchain& blockchain);
 
   /// Initialize storages
   void init_storages(const std::string& config_dir);
 
-  /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
-  const supernode_stake* find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id) const;
+  /// Supernode stakes for the block (returns nullptr if storages are not initialized)
+  supernode_stake_snapshot_ptr get_supernode_stake_snapshot(uint64_t block_number) const;
 
-  /// Synchronize with blockchain
+  /// Synchronize with blockchain (far behind blocks are loaded in the thread pool, locks are taken only to apply them)
   void synchronize();
 
   typedef std::function<void(uint64_t block_number, const supernode_stake_array&)> supernode_stakes_update_handler;
@@ -49,13 +52,52 @@ public:
 
   bool is_enabled() const;
 
+  /// RTA state of the block being added to the blockchain (RtaStateProvider)
+  bool get_block_rta_state(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs,
+    blobdata& stake_txs, blobdata& blockchain_based_list) override;
+
+  /// RTA state of the block has been removed from the blockchain (RtaStateProvider)
+  void on_block_rta_state_removed(uint64_t height) override;
+
+  /// RTA state of the block has not been stored, in-memory state is restored from the database (RtaStateProvider)
+  void on_block_rta_state_aborted() override;
+
 private:
+  /// Block loaded for synchronization
+  struct sync_block
+  {
+    bool loaded = false;
+    std::string error;
+    crypto::hash block_hash = crypto::null_hash;
+    stake_transaction_array stake_txs;
+  };
+
+  /// Consecutive blocks loaded for synchronization (waiter is the last member so loading tasks finish before blocks are destroyed)
+  struct sync_batch
+  {
+    uint64_t first_block_index = 0;
+    std::vector<sync_block> blocks;
+    tools::threadpool::waiter waiter;
+  };
+
   void init_storages_impl();
-  void process_block(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
+  void restore_storages_from_db();
+  void get_processed_block_rta_state(uint64_t block_index, blobdata& stake_txs, blobdata& blockchain_based_list, bool include_blockchain_based_list = true) const;
+  void remove_last_processed_block();
+  bool prepare_synchronization(uint64_t& height, uint64_t& first_block_index);
+  uint64_t get_first_unprocessed_block_index() const;
+  void load_block(uint64_t block_index, sync_block& result) const;
+  void load_blocks(sync_batch& batch, uint64_t first_block_index, size_t blocks_count, tools::threadpool* tpool) const;
+  uint64_t apply_blocks(const sync_batch& batch, uint64_t height);
+  bool bulk_synchronize();
+  void handle_synchronization_error(const std::exception& e);
+  void parse_block_stake_transactions(uint64_t block_index, const std::vector<transaction>& txs, stake_transaction_array& stake_txs) const;
+  void process_block(uint64_t block_index, const crypto::hash& block_hash, const std::vector<transaction>& txs, bool update_storage = true);
+  void process_block(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& stake_txs, bool update_storage = true);
   void invoke_update_stakes_handler_impl(uint64_t block_index);
   void invoke_update_blockchain_based_list_handler_impl(size_t depth);
-  void process_block_stake_transaction(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
-  void process_block_blockchain_based_list(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
+  void process_block_stake_transaction(uint64_t block_index, const crypto::hash& block_hash, const stake_transaction_array& stake_txs, bool update_storage = true);
+  void process_block_blockchain_based_list(uint64_t block_index, const crypto::hash& block_hash, bool update_storage = true);
 
 private:
   std::string m_config_dir;
@@ -63,10 +105,15 @@ private:
   std::unique_ptr<StakeTransactionStorage> m_storage;
   std::unique_ptr<BlockchainBasedList> m_blockchain_based_list;
   mutable epee::critical_section m_storage_lock;
+  std::atomic<bool> m_storages_initialized {false};
   supernode_stakes_update_handler m_on_stakes_update;
   blockchain_based_list_update_handler m_on_blockchain_based_list_update;
   bool m_stakes_need_update;
   bool m_blockchain_based_list_need_update;
+  size_t m_blockchain_based_list_update_depth; //number of blocks applied to the list since the last update handler invocation
+  bool m_db_storage; //RTA state is stored in the blockchain database
+  std::atomic<bool> m_bulk_synchronization {false};
+  std::atomic<bool> m_restore_from_db_needed {false}; //in-memory state is ahead of the database after a failed block update
   bool m_enabled {true};
 };
 
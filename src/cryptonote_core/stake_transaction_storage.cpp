@@ -1,3 +1,6 @@
+#include <atomic>
+#include <unordered_set>
+
 #include "blockchain.h"
 #include "file_io_utils.h"
 #include "cryptonote_basic/account_boost_serialization.h"
@@ -16,6 +19,8 @@ namespace
 const uint64_t BLOCK_HASHES_HISTORY_DEPTH       = 1000;
 const uint64_t STAKE_TRANSACTIONS_HISTORY_DEPTH = BLOCK_HASHES_HISTORY_DEPTH + config::graft::STAKE_VALIDATION_PERIOD + config::graft::TRUSTED_RESTAKING_PERIOD;
 
+std::atomic<uint64_t> last_supernode_stake_snapshot_id(0);
+
 struct stake_transaction_file_data
 {
   uint64_t last_processed_block_index;
@@ -40,23 +45,108 @@ struct stake_transaction_file_data
   END_SERIALIZE()
 };
 
+enum stake_transaction_journal_record_type
+{
+  STAKE_JOURNAL_ADD_TXS = 1,
+  STAKE_JOURNAL_ADD_BLOCK,
+  STAKE_JOURNAL_REMOVE_BLOCK,
+};
+
+struct stake_transaction_journal_record
+{
+  uint8_t type;
+  uint64_t block_index;
+  crypto::hash block_hash;
+  StakeTransactionStorage::stake_transaction_array stake_txs;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(type)
+    VARINT_FIELD(block_index)
+    FIELD(block_hash)
+    FIELD(stake_txs)
+  END_SERIALIZE()
+};
+
 }
 
 StakeTransactionStorage::StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number)
   : m_storage_file_name(storage_file_name)
   , m_last_processed_block_index(first_block_number)
   , m_last_processed_block_hashes_count()
-  , m_need_store()
-  , m_supernode_stakes_update_block_number()
+  , m_supernode_stake_snapshots_tx_count()
   , m_first_block_number(first_block_number)
+  , m_need_store()
+  , m_journal(storage_file_name)
+  , m_journal_enabled(!storage_file_name.empty())
 {
   load();
+  reindex_txs();
 }
 
 void StakeTransactionStorage::add_tx(const stake_transaction& tx)
 {
   m_stake_txs.push_back(tx);
 
+  if (m_journal_enabled)
+    m_journal_txs.push_back(tx);
+
+  index_tx(m_stake_txs.size() - 1);
+
+  {
+    boost::unique_lock<boost::shared_mutex> lock(m_supernode_stake_snapshots_lock);
+    m_supernode_stake_snapshots_tx_count = m_stake_txs.size();
+  }
+
+  m_need_store = true;
+}
+
+void StakeTransactionStorage::index_tx(size_t tx_index)
+{
+  const stake_transaction& tx = m_stake_txs[tx_index];
+
+  m_supernode_txs[tx.supernode_public_id].push_back(tx_index);
+
+    //stake transaction becomes valid, becomes obsolete and leaves supernodes history
+
+  m_stake_tx_events.emplace(tx.block_height + config::graft::STAKE_VALIDATION_PERIOD, tx_index);
+  m_stake_tx_events.emplace(tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD, tx_index);
+  m_stake_tx_events.emplace(tx.block_height + tx.unlock_time + config::graft::SUPERNODE_HISTORY_SIZE + 1, tx_index);
+}
+
+void StakeTransactionStorage::reindex_txs()
+{
+  m_supernode_txs.clear();
+  m_stake_tx_events.clear();
+
+  for (size_t i=0, count=m_stake_txs.size(); i<count; i++)
+    index_tx(i);
+
+  clear_supernode_stakes();
+}
+
+void StakeTransactionStorage::reset(uint64_t last_processed_block_index, block_hash_list&& block_hashes, stake_transaction_array&& stake_txs)
+{
+  if (block_hashes.size() > BLOCK_HASHES_HISTORY_DEPTH)
+    block_hashes.erase(block_hashes.begin(), std::next(block_hashes.begin(), block_hashes.size() - BLOCK_HASHES_HISTORY_DEPTH));
+
+  if (block_hashes.empty())
+  {
+      //nothing to continue from - restore from the beginning
+
+    last_processed_block_index = m_first_block_number;
+    stake_txs.clear();
+  }
+
+  m_last_processed_block_index        = last_processed_block_index;
+  m_last_processed_block_hashes_count = block_hashes.size();
+
+  std::swap(m_last_processed_block_hashes, block_hashes);
+  std::swap(m_stake_txs, stake_txs);
+
+  m_journal_txs.clear();
+
+  reindex_txs();
+
   m_need_store = true;
 }
 
@@ -87,6 +177,8 @@ void StakeTransactionStorage::add_last_processed_block(uint64_t index, const cry
   }
 
   m_last_processed_block_index = index;
+
+  add_journal_record(STAKE_JOURNAL_ADD_BLOCK, index, hash);
 }
 
 void StakeTransactionStorage::remove_last_processed_block()
@@ -96,6 +188,10 @@ void StakeTransactionStorage::remove_last_processed_block()
 
   m_need_store = true;
 
+  add_journal_record(STAKE_JOURNAL_REMOVE_BLOCK);
+
+  size_t stake_tx_count = m_stake_txs.size();
+
   m_stake_txs.erase(std::remove_if(m_stake_txs.begin(), m_stake_txs.end(), [&](const stake_transaction& tx) {
     return tx.block_height == m_last_processed_block_index;
   }), m_stake_txs.end());
@@ -113,20 +209,35 @@ void StakeTransactionStorage::remove_last_processed_block()
 
     m_last_processed_block_index = m_first_block_number;
   }
+
+  if (stake_tx_count != m_stake_txs.size())
+    reindex_txs();
+}
+
+const supernode_stake* supernode_stake_snapshot::find(const std::string& supernode_public_id) const
+{
+  supernode_stake_index_map::const_iterator it = indexes.find(supernode_public_id);
+
+  if (it == indexes.end())
+    return nullptr;
+
+  return &stakes[it->second];
 }
 
 const StakeTransactionStorage::supernode_stake_array& StakeTransactionStorage::get_supernode_stakes(uint64_t block_number)
 {
   update_supernode_stakes(block_number);
-  return m_supernode_stakes;
+  return m_last_supernode_stake_snapshot->stakes;
 }
 
 void StakeTransactionStorage::clear_supernode_stakes()
 {
-  m_supernode_stakes.clear();
-  m_supernode_stake_indexes.clear();
+  boost::unique_lock<boost::shared_mutex> lock(m_supernode_stake_snapshots_lock);
+
+  m_supernode_stake_snapshots.clear();
+  m_last_supernode_stake_snapshot.reset();
 
-  m_supernode_stakes_update_block_number = 0;
+  m_supernode_stake_snapshots_tx_count = m_stake_txs.size();
 }
 
 namespace
@@ -143,163 +254,318 @@ unsigned int get_tier(uint64_t stake)
 
 }
 
-void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
+bool StakeTransactionStorage::build_supernode_stake(uint64_t block_number, const std::vector<size_t>& tx_indexes, supernode_stake& stake, size_t& first_tx_index) const
 {
-  if (block_number == m_supernode_stakes_update_block_number)
-    return;
+  bool has_stake = false;
 
-  MDEBUG("Build stakes for block " << block_number);
+  for (size_t tx_index : tx_indexes)
+  {
+    const stake_transaction& tx = m_stake_txs[tx_index];
 
-  m_supernode_stakes.clear();
-  m_supernode_stake_indexes.clear();
+    bool obsolete_stake = false;
 
-  try
-  {
-    m_supernode_stakes.reserve(m_stake_txs.size());
+    if (!tx.is_valid(block_number))
+    {
+      uint64_t first_history_block = block_number - config::graft::SUPERNODE_HISTORY_SIZE;
+
+      if (tx.block_height + tx.unlock_time < first_history_block)
+        continue;
+
+        //add stake transaction with zero amount to indicate correspondent node presense for search in supernode
 
-    for (const stake_transaction& tx : m_stake_txs)
+      obsolete_stake = true;
+    }
+
+      //compute stake validity period
+
+    uint64_t min_tx_block_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
+             max_tx_block_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
+
+    if (!has_stake)
     {
-      bool obsolete_stake = false;
+        //first stake transaction of the supernode
 
-      if (!tx.is_valid(block_number))
+      if (obsolete_stake)
       {
-        uint64_t first_history_block = block_number - config::graft::SUPERNODE_HISTORY_SIZE;
+        stake.amount       = 0;
+        stake.tier         = 0;
+        stake.block_height = 0;
+        stake.unlock_time  = 0;
+      }
+      else
+      {
+        stake.amount       = tx.amount;
+        stake.tier         = get_tier(stake.amount);
+        stake.block_height = min_tx_block_height;
+        stake.unlock_time  = max_tx_block_height - min_tx_block_height;
+      }
 
-        if (tx.block_height + tx.unlock_time < first_history_block)
-          continue;
+      stake.supernode_public_id      = tx.supernode_public_id;
+      stake.supernode_public_address = tx.supernode_public_address;
 
-          //add stake transaction with zero amount to indicate correspondent node presense for search in supernode
+      first_tx_index = tx_index;
+      has_stake      = true;
 
-        obsolete_stake = true;
-      }
+      continue;
+    }
 
-      MDEBUG("...use stake transaction " << tx.hash << " as " << (obsolete_stake ? "obsolete" : "normal") << " stake transaction ");
+      //update existing supernode's stake
 
-        //compute stake validity period
+    if (obsolete_stake)
+      continue; //no need to aggregate fields from obsolete stake
 
-      uint64_t min_tx_block_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
-               max_tx_block_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
+    if (!stake.amount)
+    {
+        //set fields for supernode which has been constructed for obsolete stake
 
-        //search for a stake of the corresponding supernode
+      stake.amount       = tx.amount;
+      stake.tier         = get_tier(stake.amount);
+      stake.block_height = min_tx_block_height;
+      stake.unlock_time  = max_tx_block_height - min_tx_block_height;
 
-      supernode_stake_index_map::iterator it = m_supernode_stake_indexes.find(tx.supernode_public_id);
+      continue;
+    }
 
-      if (it == m_supernode_stake_indexes.end())
-      {
-          //add new supernode stake
+      //aggregate fields for existing stake
 
-        supernode_stake new_stake;
+    stake.amount += tx.amount;
+    stake.tier    = get_tier(stake.amount);
 
-        if (obsolete_stake)
-        {
-          new_stake.amount       = 0;
-          new_stake.tier         = 0;
-          new_stake.block_height = 0;
-          new_stake.unlock_time  = 0;
-        }
-        else
-        {
-          new_stake.amount       = tx.amount;
-          new_stake.tier         = get_tier(new_stake.amount);
-          new_stake.block_height = min_tx_block_height;
-          new_stake.unlock_time  = max_tx_block_height - min_tx_block_height;
+      //find intersection of stake transaction intervals
 
-          MDEBUG("...first stake transaction for supernode " << tx.supernode_public_id << ": amount=" << tx.amount << ", tier=" <<
-            new_stake.tier << ", validity=[" << min_tx_block_height << ";" << max_tx_block_height << ")");
-        }
+    uint64_t min_block_height = stake.block_height,
+             max_block_height = min_block_height + stake.unlock_time;
 
-        new_stake.supernode_public_id      = tx.supernode_public_id;
-        new_stake.supernode_public_address = tx.supernode_public_address;
+    if (min_tx_block_height > min_block_height)
+      min_block_height = min_tx_block_height;
 
-        m_supernode_stakes.emplace_back(std::move(new_stake));
+    if (max_tx_block_height < max_block_height)
+      max_block_height = max_tx_block_height;
 
-        m_supernode_stake_indexes[tx.supernode_public_id] = m_supernode_stakes.size() - 1;
+    if (max_block_height <= min_block_height)
+      max_block_height = min_block_height;
 
-        continue;
-      }
+    stake.block_height = min_block_height;
+    stake.unlock_time  = max_block_height - min_block_height;
+  }
 
-        //update existing supernode's stake
+  return has_stake;
+}
 
-      if (obsolete_stake)
-        continue; //no need to aggregate fields from obsolete stake
+supernode_stake_snapshot_ptr StakeTransactionStorage::build_supernode_stake_snapshot(uint64_t block_number, const supernode_stake_snapshot* base) const
+{
+  typedef std::pair<size_t, supernode_stake> stake_entry; //first stake transaction index, stake
 
-      MDEBUG("...accumulate stake transaction for supernode " << tx.supernode_public_id << ": amount=" << tx.amount <<
-        ", validity=[" << min_tx_block_height << ";" << max_tx_block_height << ")");
+  std::vector<stake_entry> entries;
+  entries.reserve(m_supernode_txs.size());
 
-      supernode_stake& stake = m_supernode_stakes[it->second];
+  std::shared_ptr<supernode_stake_snapshot> snapshot = std::make_shared<supernode_stake_snapshot>();
 
-      if (!stake.amount)
-      {
-          //set fields for supernode which has been constructed for obsolete stake
+  auto add_supernode_stake = [&](const std::vector<size_t>& tx_indexes) {
+    stake_entry entry;
 
-        stake.amount       = tx.amount;
-        stake.tier         = get_tier(stake.amount);
-        stake.block_height = min_tx_block_height;
-        stake.unlock_time  = max_tx_block_height - min_tx_block_height;
+    if (build_supernode_stake(block_number, tx_indexes, entry.second, entry.first))
+      entries.emplace_back(std::move(entry));
+  };
 
-        continue;
-      }
+  if (!base)
+  {
+    MDEBUG("Build stakes for block " << block_number);
+
+    for (const supernode_tx_index_map::value_type& supernode_txs : m_supernode_txs)
+      add_supernode_stake(supernode_txs.second);
+
+    std::sort(entries.begin(), entries.end(), [](const stake_entry& e1, const stake_entry& e2) { return e1.first < e2.first; });
+
+    snapshot->base_id = 0;
+  }
+  else
+  {
+    MDEBUG("Build stakes for block " << block_number << " from stakes for block " << base->block_number);
 
-        //aggregate fields for existing stake
+      //collect supernodes which stakes may differ from the base snapshot
 
-      stake.amount += tx.amount;
-      stake.tier    = get_tier(stake.amount);
+    std::unordered_set<std::string> changed_supernodes;
 
-        //find intersection of stake transaction intervals
+    for (size_t i=base->stake_tx_count, count=m_stake_txs.size(); i<count; i++)
+      changed_supernodes.insert(m_stake_txs[i].supernode_public_id);
 
-      uint64_t min_block_height = stake.block_height,
-               max_block_height = min_block_height + stake.unlock_time;
+    if (base->block_number != block_number)
+    {
+      auto events = m_stake_tx_events.equal_range(block_number);
 
-      if (min_tx_block_height > min_block_height)
-        min_block_height = min_tx_block_height;
+      for (auto it=events.first; it!=events.second; ++it)
+        changed_supernodes.insert(m_stake_txs[it->second].supernode_public_id);
+    }
 
-      if (max_tx_block_height < max_block_height)
-        max_block_height = max_tx_block_height;
+      //copy unchanged stakes (already ordered) and merge recomputed ones
 
-      if (max_block_height <= min_block_height)
-        max_block_height = min_block_height;
+    for (size_t i=0, count=base->stakes.size(); i<count; i++)
+      if (!changed_supernodes.count(base->stakes[i].supernode_public_id))
+        entries.emplace_back(base->first_tx_indexes[i], base->stakes[i]);
 
-      stake.block_height = min_block_height;
-      stake.unlock_time  = max_block_height - min_block_height;
+    size_t unchanged_count = entries.size();
 
-      MDEBUG("...stake for supernode " << tx.supernode_public_id << ": amount=" << stake.amount << ", tier=" << stake.tier <<
-        ", validity=[" << min_block_height << ";" << max_block_height << ")");
+    for (const std::string& supernode_public_id : changed_supernodes)
+    {
+      supernode_tx_index_map::const_iterator it = m_supernode_txs.find(supernode_public_id);
+
+      if (it != m_supernode_txs.end())
+        add_supernode_stake(it->second);
     }
+
+    auto less = [](const stake_entry& e1, const stake_entry& e2) { return e1.first < e2.first; };
+
+    std::sort(entries.begin() + unchanged_count, entries.end(), less);
+    std::inplace_merge(entries.begin(), entries.begin() + unchanged_count, entries.end(), less);
+
+    snapshot->base_id = base->id;
+    snapshot->changed_supernodes.assign(changed_supernodes.begin(), changed_supernodes.end());
   }
-  catch (...)
-  {
-    m_supernode_stakes.clear();
-    m_supernode_stake_indexes.clear();
 
-    m_supernode_stakes_update_block_number = 0;
+  snapshot->id             = ++last_supernode_stake_snapshot_id;
+  snapshot->block_number   = block_number;
+  snapshot->stake_tx_count = m_stake_txs.size();
 
-    throw;
+  snapshot->stakes.reserve(entries.size());
+  snapshot->first_tx_indexes.reserve(entries.size());
+  snapshot->indexes.reserve(entries.size());
+
+  for (stake_entry& entry : entries)
+  {
+    snapshot->indexes[entry.second.supernode_public_id] = snapshot->stakes.size();
+    snapshot->first_tx_indexes.push_back(entry.first);
+    snapshot->stakes.emplace_back(std::move(entry.second));
   }
 
-  m_supernode_stakes_update_block_number = block_number;
+  return snapshot;
 }
 
-const supernode_stake* StakeTransactionStorage::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id)
+supernode_stake_snapshot_ptr StakeTransactionStorage::find_supernode_stake_snapshot(uint64_t block_number) const
 {
-  update_supernode_stakes(block_number);
+  boost::shared_lock<boost::shared_mutex> lock(m_supernode_stake_snapshots_lock);
 
-  supernode_stake_index_map::const_iterator it = m_supernode_stake_indexes.find(supernode_public_id);
+  supernode_stake_snapshot_map::const_iterator it = m_supernode_stake_snapshots.find(block_number);
 
-  if (it == m_supernode_stake_indexes.end())
+  if (it == m_supernode_stake_snapshots.end() || it->second->stake_tx_count != m_supernode_stake_snapshots_tx_count)
     return nullptr;
 
-  return &m_supernode_stakes[it->second];
+  return it->second;
 }
 
-void StakeTransactionStorage::load()
+supernode_stake_snapshot_ptr StakeTransactionStorage::get_supernode_stake_snapshot(uint64_t block_number)
 {
-  if (!boost::filesystem::exists(m_storage_file_name))
+  if (m_last_supernode_stake_snapshot && m_last_supernode_stake_snapshot->block_number == block_number &&
+      m_last_supernode_stake_snapshot->stake_tx_count == m_stake_txs.size())
+    return m_last_supernode_stake_snapshot;
+
+    //snapshots are modified only by the writer so no need to lock them for search here
+
+  supernode_stake_snapshot_ptr base;
+
+  supernode_stake_snapshot_map::const_iterator it = m_supernode_stake_snapshots.find(block_number);
+
+  if (it != m_supernode_stake_snapshots.end())
+  {
+    if (it->second->stake_tx_count == m_stake_txs.size())
+    {
+      m_last_supernode_stake_snapshot = it->second;
+      return it->second;
+    }
+
+    base = it->second; //refresh snapshot with new stake transactions
+  }
+  else if (block_number > config::graft::SUPERNODE_HISTORY_SIZE)
+  {
+    it = m_supernode_stake_snapshots.find(block_number - 1);
+
+    if (it != m_supernode_stake_snapshots.end())
+      base = it->second;
+  }
+
+  supernode_stake_snapshot_ptr snapshot = build_supernode_stake_snapshot(block_number, base.get());
+
+  {
+    boost::unique_lock<boost::shared_mutex> lock(m_supernode_stake_snapshots_lock);
+
+    m_supernode_stake_snapshots[block_number] = snapshot;
+
+    while (m_supernode_stake_snapshots.size() > config::graft::SUPERNODE_HISTORY_SIZE)
+      m_supernode_stake_snapshots.erase(m_supernode_stake_snapshots.begin());
+  }
+
+  m_last_supernode_stake_snapshot = snapshot;
+
+  return snapshot;
+}
+
+void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
+{
+  get_supernode_stake_snapshot(block_number);
+}
+
+const supernode_stake* StakeTransactionStorage::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id)
+{
+  return get_supernode_stake_snapshot(block_number)->find(supernode_public_id);
+}
+
+void StakeTransactionStorage::add_journal_record(uint8_t type, uint64_t block_index, const crypto::hash& block_hash) const
+{
+  if (!m_journal_enabled)
     return;
 
+  if (type == STAKE_JOURNAL_REMOVE_BLOCK && !m_journal_txs.empty())
+    add_journal_record(STAKE_JOURNAL_ADD_TXS);
+
+  stake_transaction_journal_record record;
+
+  record.type        = type;
+  record.block_index = block_index;
+  record.block_hash  = block_hash;
+
+  if (type != STAKE_JOURNAL_REMOVE_BLOCK)
+    std::swap(record.stake_txs, m_journal_txs);
+
+  std::string blob;
+  bool r = ::serialization::dump_binary(record, blob);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to serialize stake transaction journal record");
+
+  m_journal.add_record(blob);
+}
+
+void StakeTransactionStorage::apply_journal_record(const std::string& blob)
+{
+  stake_transaction_journal_record record;
+  bool r = ::serialization::parse_binary(blob, record);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize stake transaction journal record of '" << m_storage_file_name << "'");
+
+  switch (record.type)
+  {
+    case STAKE_JOURNAL_ADD_TXS:
+    case STAKE_JOURNAL_ADD_BLOCK:
+      for (const stake_transaction& tx : record.stake_txs)
+        add_tx(tx);
+
+      if (record.type == STAKE_JOURNAL_ADD_BLOCK)
+        add_last_processed_block(record.block_index, record.block_hash);
+      break;
+    case STAKE_JOURNAL_REMOVE_BLOCK:
+      remove_last_processed_block();
+      break;
+    default:
+      throw std::runtime_error("internal error: unknown stake transaction journal record type");
+  }
+}
+
+void StakeTransactionStorage::load()
+{
   std::string buffer;
-  bool r = epee::file_io_utils::load_file_to_string(m_storage_file_name, buffer);
+  std::vector<std::string> journal_records;
 
-  CHECK_AND_ASSERT_THROW_MES(r, "stake transaction storage file '" << m_storage_file_name << "' is not found");
+  if (m_storage_file_name.empty() || !m_journal.load(buffer, journal_records))
+    return;
 
   try
   {
@@ -309,7 +575,7 @@ void StakeTransactionStorage::load()
     StakeTransactionStorage::block_hash_list tmp_block_hashes;
     stake_transaction_file_data data(0, tmp_stake_txs, 0, tmp_block_hashes);
 
-    r = ::serialization::parse_binary(buffer, data);
+    bool r = ::serialization::parse_binary(buffer, data);
 
     CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize stake transaction storage file '" << m_storage_file_name << "'");
 
@@ -319,10 +585,23 @@ void StakeTransactionStorage::load()
     std::swap(m_stake_txs, data.stake_txs);
     std::swap(m_last_processed_block_hashes, data.block_hashes);
 
+      //apply changes made after the checkpoint
+
+    m_journal_enabled = false;
+
+    for (const std::string& record : journal_records)
+      apply_journal_record(record);
+
+    m_journal_enabled = true;
+
+    if (!journal_records.empty())
+      LOG_PRINT_L0("Stake transaction storage has been restored from journal with " << journal_records.size() << " record(s)");
+
     m_need_store = false;
   }
   catch (...)
   {
+    m_journal_enabled = true;
     LOG_PRINT_L0("Can't parse stake transaction storage file '" << m_storage_file_name << "'");
     throw;
   }
@@ -330,19 +609,33 @@ void StakeTransactionStorage::load()
 
 void StakeTransactionStorage::store() const
 {
+  if (m_storage_file_name.empty())
+  {
+    m_need_store = false;
+    return;
+  }
+
+  if (!m_journal_txs.empty())
+    add_journal_record(STAKE_JOURNAL_ADD_TXS);
+
+  if (!m_journal.need_checkpoint())
+  {
+      //per block changes are appended to the journal
+
+    m_journal.flush();
+    m_need_store = false;
+    return;
+  }
+
   stake_transaction_file_data data(m_last_processed_block_index, const_cast<stake_transaction_array&>(m_stake_txs),
     m_last_processed_block_hashes_count, const_cast<block_hash_list&>(m_last_processed_block_hashes));
 
-  std::ofstream ostr;
-  ostr.open(m_storage_file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-
-  binary_archive<true> oar(ostr);
+  std::string blob;
+  bool success = ::serialization::dump_binary(data, blob);
 
-  bool success = ::serialization::serialize(oar, data);
+  CHECK_AND_ASSERT_THROW_MES(success, "Error at save stake transaction storage file '" << m_storage_file_name << "'");
 
-  ostr.close();
-  
-  CHECK_AND_ASSERT_THROW_MES(success && ostr.good(), "Error at save stake transaction storage file '" << m_storage_file_name << "'");
+  m_journal.write_checkpoint(blob);
 
   m_need_store = false;
 }
@@ -2,7 +2,10 @@
 
 #include <cryptonote_config.h>
 #include <list>
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <boost/thread/shared_mutex.hpp>
 
 #include "crypto/hash.h"
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -10,6 +13,7 @@
 #include "serialization/list.h"
 #include "serialization/vector.h"
 #include "serialization/string.h"
+#include "storage_journal.h"
 
 namespace cryptonote
 {
@@ -49,6 +53,27 @@ struct supernode_stake
   cryptonote::account_public_address supernode_public_address;
 };
 
+/// Immutable list of supernode stakes for a block
+struct supernode_stake_snapshot
+{
+  typedef std::vector<supernode_stake>            supernode_stake_array;
+  typedef std::unordered_map<std::string, size_t> supernode_stake_index_map;
+
+  uint64_t id; //unique identifier of the snapshot
+  uint64_t base_id; //identifier of the snapshot this one has been built from (0 if it has been built from scratch)
+  uint64_t block_number;
+  size_t stake_tx_count; //number of stake transactions the snapshot has been built from
+  supernode_stake_array stakes;
+  std::vector<size_t> first_tx_indexes; //index of the first stake transaction of each stake (defines order of stakes)
+  supernode_stake_index_map indexes;
+  std::vector<std::string> changed_supernodes; //supernodes which stakes may differ from the base snapshot
+
+  /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
+  const supernode_stake* find(const std::string& supernode_public_id) const;
+};
+
+typedef std::shared_ptr<const supernode_stake_snapshot> supernode_stake_snapshot_ptr;
+
 class StakeTransactionStorage
 {
 public:
@@ -56,6 +81,7 @@ public:
   typedef std::list<crypto::hash>        block_hash_list;
   typedef std::vector<supernode_stake>   supernode_stake_array;
 
+  /// Constructors (storage is kept in memory only if storage_file_name is empty)
   StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number);
 
   /// Get number of transactions
@@ -82,9 +108,18 @@ public:
   /// Add transaction
   void add_tx(const stake_transaction&);
 
+  /// Replace storage content with the state restored for the last processed block
+  void reset(uint64_t last_processed_block_index, block_hash_list&& block_hashes, stake_transaction_array&& stake_txs);
+
   /// List of supernode stakes
   const supernode_stake_array& get_supernode_stakes(uint64_t block_number);
 
+  /// Supernode stakes snapshot for the block (builds snapshot if it is not cached)
+  supernode_stake_snapshot_ptr get_supernode_stake_snapshot(uint64_t block_number);
+
+  /// Cached supernode stakes snapshot for the block (returns nullptr if there is no actual snapshot, thread safe)
+  supernode_stake_snapshot_ptr find_supernode_stake_snapshot(uint64_t block_number) const;
+
   /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
   const supernode_stake* find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id);
 
@@ -100,11 +135,34 @@ public:
   /// Is the list requires store
   bool need_store() const { return m_need_store; }
 
+  /// Number of bytes written to the storage files
+  uint64_t get_stored_bytes_count() const { return m_journal.get_written_bytes_count(); }
+
 private:
   /// Load storage from file
   void load();
 
-  typedef std::unordered_map<std::string, size_t> supernode_stake_index_map;
+  /// Add change to the storage journal (pending transactions are added before any other change)
+  void add_journal_record(uint8_t type, uint64_t block_index = 0, const crypto::hash& block_hash = crypto::null_hash) const;
+
+  /// Apply change loaded from the storage journal
+  void apply_journal_record(const std::string& record);
+
+  /// Add transaction to supernode and stake events indexes
+  void index_tx(size_t tx_index);
+
+  /// Rebuild supernode and stake events indexes
+  void reindex_txs();
+
+  /// Compute supernode stake from its stake transactions (returns false if supernode has no stake for the block)
+  bool build_supernode_stake(uint64_t block_number, const std::vector<size_t>& tx_indexes, supernode_stake& stake, size_t& first_tx_index) const;
+
+  /// Build snapshot for the block based on the snapshot for the same or previous block (full build if base is nullptr)
+  supernode_stake_snapshot_ptr build_supernode_stake_snapshot(uint64_t block_number, const supernode_stake_snapshot* base) const;
+
+  typedef std::unordered_map<std::string, std::vector<size_t>> supernode_tx_index_map;
+  typedef std::unordered_multimap<uint64_t, size_t>             stake_tx_event_map;
+  typedef std::map<uint64_t, supernode_stake_snapshot_ptr>      supernode_stake_snapshot_map;
 
 private:
   std::string m_storage_file_name;
@@ -112,11 +170,17 @@ private:
   block_hash_list m_last_processed_block_hashes;
   size_t m_last_processed_block_hashes_count;
   stake_transaction_array m_stake_txs;
-  uint64_t m_supernode_stakes_update_block_number;
-  supernode_stake_array m_supernode_stakes;
-  supernode_stake_index_map m_supernode_stake_indexes;
+  supernode_tx_index_map m_supernode_txs; //stake transaction indexes per supernode
+  stake_tx_event_map m_stake_tx_events; //stake transaction indexes by the block number where the transaction changes its state
+  supernode_stake_snapshot_map m_supernode_stake_snapshots;
+  supernode_stake_snapshot_ptr m_last_supernode_stake_snapshot;
+  size_t m_supernode_stake_snapshots_tx_count;
+  mutable boost::shared_mutex m_supernode_stake_snapshots_lock;
   uint64_t m_first_block_number;
   mutable bool m_need_store;
+  mutable StorageJournal m_journal;
+  mutable stake_transaction_array m_journal_txs; //transactions which have not been added to the journal yet
+  bool m_journal_enabled;
 };
 
 }
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include "file_io_utils.h"
+#include "misc_log_ex.h"
+#include "common/util.h"
+#include "storage_journal.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "storage.journal"
+
+using namespace cryptonote;
+
+namespace
+{
+
+const char     JOURNAL_MAGIC[]         = "GRFTJRN1";
+const size_t   JOURNAL_MAGIC_SIZE      = sizeof(JOURNAL_MAGIC) - 1;
+const size_t   JOURNAL_HEADER_SIZE     = JOURNAL_MAGIC_SIZE + sizeof(crypto::hash);
+const size_t   RECORD_OVERHEAD_SIZE    = 2 * sizeof(uint32_t); //size and checksum
+const uint64_t MIN_JOURNAL_COMPACTION_SIZE = 1024 * 1024;
+
+void put_uint32(std::string& dst, uint32_t value)
+{
+  for (size_t i=0; i<sizeof(uint32_t); i++)
+    dst.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+uint32_t get_uint32(const char* src)
+{
+  uint32_t value = 0;
+
+  for (size_t i=0; i<sizeof(uint32_t); i++)
+    value |= uint32_t(static_cast<unsigned char>(src[i])) << (8 * i);
+
+  return value;
+}
+
+uint32_t get_checksum(const char* data, size_t size)
+{
+  crypto::hash hash = crypto::cn_fast_hash(data, size);
+  return get_uint32(hash.data);
+}
+
+/// Write (or append) data to file and sync it to disk
+void write_file(const std::string& file_name, const std::string& data, bool append)
+{
+  FILE* file = fopen(file_name.c_str(), append ? "ab" : "wb");
+
+  CHECK_AND_ASSERT_THROW_MES(file, "Can't open file '" << file_name << "' for writing");
+
+  bool success = fwrite(data.data(), 1, data.size(), file) == data.size() && fflush(file) == 0;
+
+#ifdef WIN32
+  success = success && _commit(_fileno(file)) == 0;
+#else
+  success = success && fsync(fileno(file)) == 0;
+#endif
+
+  success = fclose(file) == 0 && success;
+
+  CHECK_AND_ASSERT_THROW_MES(success, "Error at writing file '" << file_name << "'");
+}
+
+/// Sync directory entry changes (renames) to disk
+void sync_directory(const std::string& file_name)
+{
+#ifndef WIN32
+  boost::filesystem::path dir = boost::filesystem::path(file_name).parent_path();
+
+  if (dir.empty())
+    dir = ".";
+
+  int fd = open(dir.string().c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return;
+
+  fsync(fd);
+  close(fd);
+#endif
+}
+
+/// Replace file atomically
+void replace_file(const std::string& file_name, const std::string& data)
+{
+  std::string tmp_file_name = file_name + ".tmp";
+
+  write_file(tmp_file_name, data, false);
+
+  std::error_code ec = tools::replace_file(tmp_file_name, file_name);
+
+  CHECK_AND_ASSERT_THROW_MES(!ec, "Can't replace file '" << file_name << "': " << ec.message());
+
+  sync_directory(file_name);
+}
+
+}
+
+StorageJournal::StorageJournal(const std::string& checkpoint_file_name)
+  : m_checkpoint_file_name(checkpoint_file_name)
+  , m_journal_file_name(checkpoint_file_name + ".journal")
+  , m_checkpoint_hash(crypto::null_hash)
+  , m_checkpoint_size()
+  , m_journal_size()
+  , m_has_checkpoint()
+  , m_has_journal()
+  , m_pending_records_dropped()
+  , m_written_bytes_count()
+{
+}
+
+bool StorageJournal::load(std::string& checkpoint, std::vector<std::string>& records)
+{
+  checkpoint.clear();
+  records.clear();
+
+  m_pending_records.clear();
+  m_pending_records_dropped = false;
+  m_has_checkpoint          = false;
+  m_has_journal             = false;
+  m_journal_size            = 0;
+
+  if (!boost::filesystem::exists(m_checkpoint_file_name))
+    return false;
+
+  bool r = epee::file_io_utils::load_file_to_string(m_checkpoint_file_name, checkpoint);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "storage file '" << m_checkpoint_file_name << "' is not found");
+
+  m_checkpoint_hash = crypto::cn_fast_hash(checkpoint.data(), checkpoint.size());
+  m_checkpoint_size = checkpoint.size();
+  m_has_checkpoint  = true;
+
+  load_records(records);
+
+  return true;
+}
+
+void StorageJournal::load_records(std::vector<std::string>& records)
+{
+  if (!boost::filesystem::exists(m_journal_file_name))
+    return;
+
+  std::string buffer;
+
+  if (!epee::file_io_utils::load_file_to_string(m_journal_file_name, buffer))
+  {
+    MWARNING("Can't read storage journal file '" << m_journal_file_name << "', journal is ignored");
+    return;
+  }
+
+  if (buffer.size() < JOURNAL_HEADER_SIZE || memcmp(buffer.data(), JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE) ||
+      memcmp(buffer.data() + JOURNAL_MAGIC_SIZE, m_checkpoint_hash.data, sizeof(crypto::hash)))
+  {
+      //journal has been started for another checkpoint (crash between checkpoint and journal replacement)
+
+    MWARNING("Storage journal file '" << m_journal_file_name << "' doesn't match checkpoint, journal is ignored");
+    return;
+  }
+
+  size_t offset = JOURNAL_HEADER_SIZE;
+
+  while (buffer.size() - offset >= RECORD_OVERHEAD_SIZE)
+  {
+    size_t record_size = get_uint32(buffer.data() + offset);
+
+    if (buffer.size() - offset - RECORD_OVERHEAD_SIZE < record_size)
+      break;
+
+    const char* record = buffer.data() + offset + sizeof(uint32_t);
+
+    if (get_checksum(record, record_size) != get_uint32(record + record_size))
+      break;
+
+    records.emplace_back(record, record_size);
+
+    offset += record_size + RECORD_OVERHEAD_SIZE;
+  }
+
+  if (offset != buffer.size())
+  {
+      //torn write at the end of the journal - cut it off so new records are appended after the last valid one
+
+    MWARNING("Storage journal file '" << m_journal_file_name << "' has " << (buffer.size() - offset) << " byte(s) of incomplete records, truncating");
+
+    boost::system::error_code ec;
+    boost::filesystem::resize_file(m_journal_file_name, offset, ec);
+
+    if (ec)
+    {
+      MWARNING("Can't truncate storage journal file '" << m_journal_file_name << "': " << ec.message() << ", journal is restarted");
+      return;
+    }
+  }
+
+  m_has_journal  = true;
+  m_journal_size = offset;
+}
+
+uint64_t StorageJournal::get_compaction_size() const
+{
+    //compacting when the journal outgrows the checkpoint keeps amortized write cost proportional to the changes
+
+  return std::max(m_checkpoint_size, MIN_JOURNAL_COMPACTION_SIZE);
+}
+
+bool StorageJournal::need_checkpoint() const
+{
+  return !m_has_checkpoint || m_pending_records_dropped || m_journal_size + m_pending_records.size() > get_compaction_size();
+}
+
+void StorageJournal::add_record(const std::string& record)
+{
+  if (m_pending_records_dropped)
+    return;
+
+  if (record.size() > std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("storage journal record is too large");
+
+  put_uint32(m_pending_records, static_cast<uint32_t>(record.size()));
+  m_pending_records.append(record);
+  put_uint32(m_pending_records, get_checksum(record.data(), record.size()));
+
+  if (need_checkpoint())
+  {
+      //the next store will write full checkpoint, no need to keep records in memory
+
+    m_pending_records.clear();
+    m_pending_records_dropped = true;
+  }
+}
+
+void StorageJournal::flush()
+{
+  if (m_pending_records.empty() && m_has_journal)
+    return;
+
+  CHECK_AND_ASSERT_THROW_MES(!need_checkpoint(), "internal error: storage journal '" << m_journal_file_name << "' can't be flushed without checkpoint");
+
+  if (m_has_journal)
+  {
+    write_file(m_journal_file_name, m_pending_records, true);
+  }
+  else
+  {
+      //start journal for the loaded checkpoint
+
+    std::string data(JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE);
+
+    data.append(m_checkpoint_hash.data, sizeof(crypto::hash));
+    data.append(m_pending_records);
+
+    replace_file(m_journal_file_name, data);
+
+    m_has_journal          = true;
+    m_journal_size         = JOURNAL_HEADER_SIZE;
+    m_written_bytes_count += JOURNAL_HEADER_SIZE;
+  }
+
+  m_written_bytes_count += m_pending_records.size();
+  m_journal_size        += m_pending_records.size();
+
+  m_pending_records.clear();
+}
+
+void StorageJournal::write_checkpoint(const std::string& checkpoint)
+{
+    //checkpoint goes first, old journal is ignored after that because it refers to the previous checkpoint hash
+
+  replace_file(m_checkpoint_file_name, checkpoint);
+
+  m_checkpoint_hash = crypto::cn_fast_hash(checkpoint.data(), checkpoint.size());
+  m_checkpoint_size = checkpoint.size();
+  m_has_checkpoint  = true;
+  m_has_journal     = false;
+  m_journal_size    = 0;
+
+  m_pending_records.clear();
+  m_pending_records_dropped = false;
+
+  m_written_bytes_count += checkpoint.size();
+
+  flush();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+
+/// Append-only journal of storage changes on top of a compacted checkpoint file.
+///
+/// The full storage state is kept in the checkpoint file, changes made after it are appended to the
+/// "<file_name>.journal" file as checksummed records. The journal refers to the hash of the checkpoint
+/// it has been started for, so a journal left from the previous checkpoint is ignored on load.
+/// Checkpoints are written to a temporary file and renamed, both files are synced to disk.
+class StorageJournal
+{
+public:
+  StorageJournal(const std::string& checkpoint_file_name);
+
+  /// Load checkpoint and records which have been appended after it (returns false if there is no checkpoint)
+  bool load(std::string& checkpoint, std::vector<std::string>& records);
+
+  /// Add record to be written by the next flush (records are dropped if checkpoint has to be written anyway)
+  void add_record(const std::string& record);
+
+  /// Is the full checkpoint has to be written instead of flushing of pending records
+  bool need_checkpoint() const;
+
+  /// Append pending records to the journal
+  void flush();
+
+  /// Replace checkpoint and start new empty journal
+  void write_checkpoint(const std::string& checkpoint);
+
+  /// Number of bytes written to disk
+  uint64_t get_written_bytes_count() const { return m_written_bytes_count; }
+
+private:
+  /// Load records from the journal file
+  void load_records(std::vector<std::string>& records);
+
+  /// Size of the journal after which it is compacted to the new checkpoint
+  uint64_t get_compaction_size() const;
+
+private:
+  std::string m_checkpoint_file_name;
+  std::string m_journal_file_name;
+  crypto::hash m_checkpoint_hash;
+  uint64_t m_checkpoint_size;
+  uint64_t m_journal_size;
+  std::string m_pending_records;
+  bool m_has_checkpoint;
+  bool m_has_journal;
+  bool m_pending_records_dropped;
+  uint64_t m_written_bytes_count;
+};
+
+}
@@ -115,9 +115,8 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_hash,*/ const crypto::hash &id, size_t tx_weight, tx_verification_context& tvc, bool kept_by_block, bool relayed, bool do_not_relay, uint8_t version)
   {
-    // this should already be called with that lock, but let's make it explicit for clarity
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-
+    // the pool is locked only for the lookups and for the final admission step; RTA signature and fee checks
+    // of concurrent callers overlap, the input (ring signature) checks are serialized by the blockchain lock
     PERF_TIMER(add_tx);
 
     MTRACE("tx_type: " << tx.type);
@@ -133,7 +132,7 @@ namespace cryptonote
 
     // we do not accept transactions that timed out before, unless they're
     // kept_by_block
-    if (!kept_by_block && m_timed_out_transactions.find(id) != m_timed_out_transactions.end())
+    if (!kept_by_block && is_timed_out(id))
     {
       // not clear if we should set that, since verifivation (sic) did not fail before, since
       // the tx was accepted before timing out.
@@ -234,17 +233,8 @@ namespace cryptonote
     // if the transaction came from a block popped from the chain,
     // don't check if we have its key images as spent.
     // TODO: Investigate why not?
-    if(!kept_by_block)
-    {
-      if(have_tx_keyimges_as_spent(tx))
-      {
-        mark_double_spend(tx);
-        LOG_PRINT_L1("Transaction with id= "<< id << " used already spent key images");
-        tvc.m_verifivation_failed = true;
-        tvc.m_double_spend = true;
-        return false;
-      }
-    }
+    if(!kept_by_block && check_double_spend(tx, id, tvc))
+      return false;
 
     if (!m_blockchain.check_tx_outputs(tx, tvc))
     {
@@ -262,7 +252,29 @@ namespace cryptonote
     crypto::hash max_used_block_id = null_hash;
     uint64_t max_used_block_height = 0;
     cryptonote::txpool_tx_meta_t meta;
+    const crypto::hash top_block_id = m_blockchain.get_tail_id();
     bool ch_inp_res = check_tx_inputs([&tx]()->cryptonote::transaction&{ return tx; }, id, max_used_block_height, max_used_block_id, tvc, kept_by_block);
+
+    // admission, key images are checked again as the pool might have changed while the transaction was checked
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (have_tx(id))
+    {
+      // the same transaction was received from another peer and admitted meanwhile
+      LOG_PRINT_L2("tx " << id << " was added to the pool while being checked");
+      tvc.m_verifivation_failed = false;
+      return true;
+    }
+    if(ch_inp_res && !kept_by_block && check_double_spend(tx, id, tvc))
+      return false;
+    // a block spending the same key images might have been added while the transaction was checked
+    if(ch_inp_res && !kept_by_block && m_blockchain.get_tail_id() != top_block_id && m_blockchain.have_tx_keyimges_as_spent(tx))
+    {
+      LOG_PRINT_L1("Transaction with id= "<< id << " used key images spent by a new block");
+      tvc.m_double_spend = true;
+      return false;
+    }
+    const uint64_t cookie_before_add = m_cookie;
+
     if(!ch_inp_res)
     {
       // if the transaction was valid before (kept_by_block), then it
@@ -290,7 +302,7 @@ namespace cryptonote
           m_blockchain.add_txpool_tx(tx, meta);
           if (!insert_key_images(tx, kept_by_block))
             return false;
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+          add_tx_to_sorted_containers(id, fee / (double)tx_weight, receive_time, is_rta_tx);
         }
         catch (const std::exception &e)
         {
@@ -332,7 +344,7 @@ namespace cryptonote
         m_blockchain.add_txpool_tx(tx, meta);
         if (!insert_key_images(tx, kept_by_block))
           return false;
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+        add_tx_to_sorted_containers(id, fee / (double)tx_weight, receive_time, is_rta_tx);
       }
       catch (const std::exception &e)
       {
@@ -350,6 +362,12 @@ namespace cryptonote
     m_txpool_weight += tx_weight;
 
     ++m_cookie;
+    // the template stays actual if nothing but this transaction changed the pool since it was filled
+    if (m_block_template.valid && m_block_template.cookie == cookie_before_add)
+    {
+      m_block_template_added_txs.push_back(std::make_pair(id, is_rta_tx));
+      m_block_template.cookie = m_cookie;
+    }
 
     MINFO("Transaction added to pool: txid " << id << " weight: " << tx_weight << " fee/byte: " << (fee / (double)tx_weight));
 
@@ -422,7 +440,7 @@ namespace cryptonote
         m_txpool_weight -= it->first.second;
         remove_transaction_keyimages(tx);
         MINFO("Pruned tx " << txid << " from txpool: weight: " << it->first.second << ", fee/byte: " << it->first.first);
-        m_txs_by_fee_and_receive_time.erase(it--);
+        remove_tx_from_sorted_containers(it--);
         changed = true;
       }
       catch (const std::exception &e)
@@ -530,7 +548,7 @@ namespace cryptonote
       return false;
     }
 
-    m_txs_by_fee_and_receive_time.erase(sorted_it);
+    remove_tx_from_sorted_containers(sorted_it);
     ++m_cookie;
     return true;
   }
@@ -540,6 +558,43 @@ namespace cryptonote
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::add_tx_to_sorted_containers(const crypto::hash &txid, double fee_per_byte, time_t receive_time, bool is_rta)
+  {
+    m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee_per_byte, receive_time), txid);
+    // RTA transactions are authorized by the auth sample and may carry no fee, they are taken first come first served
+    if (is_rta)
+      m_rta_txs_by_receive_time.emplace(receive_time, txid);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_tx_from_sorted_containers(sorted_tx_container::iterator it)
+  {
+    auto range = m_rta_txs_by_receive_time.equal_range(it->first.second);
+    for (auto rta_it = range.first; rta_it != range.second; ++rta_it)
+    {
+      if (rta_it->second == it->second)
+      {
+        m_rta_txs_by_receive_time.erase(rta_it);
+        break;
+      }
+    }
+    m_parsed_txs.erase(it->second);
+    m_txs_by_fee_and_receive_time.erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  std::shared_ptr<transaction> tx_memory_pool::get_parsed_tx(const crypto::hash &txid) const
+  {
+    auto it = m_parsed_txs.find(txid);
+    if (it != m_parsed_txs.end())
+      return it->second;
+
+    std::shared_ptr<transaction> tx = std::make_shared<transaction>();
+    cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
+    if (!parse_and_validate_tx_from_blob(txblob, *tx))
+      return nullptr;
+    m_parsed_txs.emplace(txid, tx);
+    return tx;
+  }
+  //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
     return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
@@ -569,7 +624,7 @@ namespace cryptonote
         }
         else
         {
-          m_txs_by_fee_and_receive_time.erase(sorted_it);
+          remove_tx_from_sorted_containers(sorted_it);
         }
         m_timed_out_transactions.insert(txid);
         remove.insert(txid);
@@ -932,12 +987,18 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::get_transaction(const crypto::hash& id, cryptonote::blobdata& txblob) const
+  bool tx_memory_pool::get_transaction(const crypto::hash& id, cryptonote::blobdata& txblob, bool include_unrelayed_txes) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     try
     {
+      if (!include_unrelayed_txes)
+      {
+        txpool_tx_meta_t meta;
+        if (!m_blockchain.get_txpool_tx_meta(id, meta) || meta.do_not_relay)
+          return false;
+      }
       return m_blockchain.get_txpool_tx_blob(id, txblob);
     }
     catch (const std::exception &e)
@@ -946,20 +1007,52 @@ namespace cryptonote
     }
   }
   //---------------------------------------------------------------------------------
+  size_t tx_memory_pool::get_transactions(const std::vector<crypto::hash>& hashes, std::vector<cryptonote::blobdata>& txblobs) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    size_t found = 0;
+    txblobs.clear();
+    txblobs.resize(hashes.size());
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+      try
+      {
+        if (m_blockchain.get_txpool_tx_blob(hashes[i], txblobs[i]))
+          ++found;
+        else
+          txblobs[i].clear();
+      }
+      catch (const std::exception &e)
+      {
+        txblobs[i].clear();
+      }
+    }
+    return found;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    m_input_cache.clear();
+    clear_input_cache();
+    invalidate_block_template();
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    m_input_cache.clear();
+    clear_input_cache();
+    invalidate_block_template();
     return true;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::invalidate_block_template()
+  {
+    m_block_template.valid = false;
+    m_block_template_added_txs.clear();
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx(const crypto::hash &id) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -967,6 +1060,25 @@ namespace cryptonote
     return m_blockchain.get_db().txpool_has_tx(id);
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::is_timed_out(const crypto::hash &id) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return m_timed_out_transactions.find(id) != m_timed_out_transactions.end();
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::check_double_spend(const transaction &tx, const crypto::hash &id, tx_verification_context &tvc)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if(!have_tx_keyimges_as_spent(tx))
+      return false;
+
+    mark_double_spend(tx);
+    LOG_PRINT_L1("Transaction with id= "<< id << " used already spent key images");
+    tvc.m_verifivation_failed = true;
+    tvc.m_double_spend = true;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -998,10 +1110,12 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block) const
   {
+    input_cache_shard &shard = get_input_cache_shard(txid);
     if (!kept_by_block)
     {
-      const std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>>::const_iterator i = m_input_cache.find(txid);
-      if (i != m_input_cache.end())
+      boost::lock_guard<boost::mutex> lock(shard.lock);
+      const input_cache_map::const_iterator i = shard.cache.find(txid);
+      if (i != shard.cache.end())
       {
         max_used_block_height = std::get<2>(i->second);
         max_used_block_id = std::get<3>(i->second);
@@ -1009,32 +1123,33 @@ namespace cryptonote
         return std::get<0>(i->second);
       }
     }
+    // the shard isn't locked while the inputs are checked, a transaction checked twice concurrently gets the same result
     bool ret = m_blockchain.check_tx_inputs(get_tx(), max_used_block_height, max_used_block_id, tvc, kept_by_block);
     if (!kept_by_block)
-      m_input_cache.insert(std::make_pair(txid, std::make_tuple(ret, tvc, max_used_block_height, max_used_block_id)));
+    {
+      boost::lock_guard<boost::mutex> lock(shard.lock);
+      shard.cache.insert(std::make_pair(txid, std::make_tuple(ret, tvc, max_used_block_height, max_used_block_id)));
+    }
     return ret;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction &tx) const
+  tx_memory_pool::input_cache_shard& tx_memory_pool::get_input_cache_shard(const crypto::hash &txid) const
+  {
+    // transaction hashes are uniformly distributed, so any byte of them is a good shard index
+    return m_input_cache[static_cast<unsigned char>(txid.data[0]) % INPUT_CACHE_SHARDS_COUNT];
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::clear_input_cache()
   {
-    struct transction_parser
+    for (input_cache_shard &shard: m_input_cache)
     {
-      transction_parser(const cryptonote::blobdata &txblob, transaction &tx): txblob(txblob), tx(tx), parsed(false) {}
-      cryptonote::transaction &operator()()
-      {
-        if (!parsed)
-        {
-          if (!parse_and_validate_tx_from_blob(txblob, tx))
-            throw std::runtime_error("failed to parse transaction blob");
-          parsed = true;
-        }
-        return tx;
-      }
-      const cryptonote::blobdata &txblob;
-      transaction &tx;
-      bool parsed;
-    } lazy_tx(txblob, tx);
-
+      boost::lock_guard<boost::mutex> lock(shard.lock);
+      shard.cache.clear();
+    }
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, transaction &tx) const
+  {
     //not the best implementation at this time, sorry :(
     //check is ring_signature already checked ?
     if(txd.max_used_block_id == null_hash)
@@ -1044,7 +1159,7 @@ namespace cryptonote
         return false;//we already sure that this tx is broken for this height
 
       tx_verification_context tvc;
-      if(!check_tx_inputs([&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
+      if(!check_tx_inputs([&tx]()->cryptonote::transaction&{ return tx; }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
       {
         txd.last_failed_height = m_blockchain.get_current_blockchain_height()-1;
         txd.last_failed_id = m_blockchain.get_block_id_by_height(txd.last_failed_height);
@@ -1061,7 +1176,7 @@ namespace cryptonote
           return false;
         //check ring signature again, it is possible (with very small chance) that this transaction become again valid
         tx_verification_context tvc;
-        if(!check_tx_inputs([&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
+        if(!check_tx_inputs([&tx]()->cryptonote::transaction&{ return tx; }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
         {
           txd.last_failed_height = m_blockchain.get_current_blockchain_height()-1;
           txd.last_failed_id = m_blockchain.get_block_id_by_height(txd.last_failed_height);
@@ -1070,7 +1185,7 @@ namespace cryptonote
       }
     }
     //if we here, transaction seems valid, but, anyway, check for key_images collisions with blockchain, just to be sure
-    if(m_blockchain.have_tx_keyimges_as_spent(lazy_tx()))
+    if(m_blockchain.have_tx_keyimges_as_spent(tx))
     {
       txd.double_spend_seen = true;
       return false;
@@ -1177,126 +1292,205 @@ namespace cryptonote
   }
   //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
-  bool tx_memory_pool::fill_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward, uint8_t version)
+  bool tx_memory_pool::add_block_template_tx(block_template_state &t, const crypto::hash &txid, bool rta_lane)
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-
-    uint64_t best_coinbase = 0, coinbase = 0;
-    total_weight = 0;
-    fee = 0;
-    
-    //baseline empty block
-    get_block_reward(median_weight, total_weight, already_generated_coins, best_coinbase, version);
-
-
-    size_t max_total_weight_pre_v5 = (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
-    size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
-    size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
-    std::unordered_set<crypto::key_image> k_images;
-
-    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
-
-    LockedTXN lock(m_blockchain);
-
-    auto sorted_it = m_txs_by_fee_and_receive_time.begin();
-    for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
+    txpool_tx_meta_t meta;
+    if (!m_blockchain.get_txpool_tx_meta(txid, meta))
     {
-      txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
-      {
-        MERROR("  failed to find tx meta");
-        continue;
-      }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
+      MERROR("  failed to find tx meta");
+      return false;
+    }
+    const size_t max_weight = rta_lane ? t.max_rta_weight : t.max_total_weight;
+    LOG_PRINT_L2("Considering " << (rta_lane ? "RTA " : "") << txid << ", weight " << meta.weight << ", current block weight " << t.total_weight << "/" << max_weight << ", current coinbase " << print_money(t.best_coinbase));
 
-      // Can not exceed maximum block weight
-      if (max_total_weight < total_weight + meta.weight)
-      {
-        LOG_PRINT_L2("  would exceed maximum block weight");
-        continue;
-      }
+    // Can not exceed maximum block weight
+    if (max_weight < t.total_weight + meta.weight)
+    {
+      LOG_PRINT_L2("  would exceed maximum block weight");
+      return false;
+    }
 
+    // within the RTA share of the median weight there is no reward penalty
+    uint64_t coinbase = t.best_coinbase + meta.fee;
+    if (!rta_lane)
+    {
       // start using the optimal filling algorithm from v5
-      if (version >= 5)
+      if (t.version >= 5)
       {
         // If we're getting lower coinbase tx,
         // stop including more tx
         uint64_t block_reward;
-        if(!get_block_reward(median_weight, total_weight + meta.weight, already_generated_coins, block_reward, version))
+        if(!get_block_reward(t.median_weight, t.total_weight + meta.weight, t.already_generated_coins, block_reward, t.version))
         {
           LOG_PRINT_L2("  would exceed maximum block weight");
-          continue;
+          return false;
         }
-        coinbase = block_reward + fee + meta.fee;
-        if (coinbase < template_accept_threshold(best_coinbase))
+        coinbase = block_reward + t.fee + meta.fee;
+        if (coinbase < template_accept_threshold(t.best_coinbase))
         {
           LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
-          continue;
+          return false;
         }
       }
       else
       {
         // If we've exceeded the penalty free weight,
         // stop including more tx
-        if (total_weight > median_weight)
+        if (t.total_weight > t.median_weight)
         {
           LOG_PRINT_L2("  would exceed median block weight");
-          break;
+          t.full = true;
+          return false;
         }
       }
+    }
 
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second);
-      cryptonote::transaction tx;
-
-      // Skip transactions that are not ready to be
-      // included into the blockchain or that are
-      // missing key images
-      const cryptonote::txpool_tx_meta_t original_meta = meta;
-      bool ready = false;
+    // Skip transactions that are not ready to be
+    // included into the blockchain or that are
+    // missing key images
+    std::shared_ptr<transaction> tx;
+    const cryptonote::txpool_tx_meta_t original_meta = meta;
+    bool ready = false;
+    try
+    {
+      tx = get_parsed_tx(txid);
+      if (!tx)
+        throw std::runtime_error("failed to parse transaction blob");
+      ready = is_transaction_ready_to_go(meta, txid, *tx);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to check transaction readiness: " << e.what());
+      // continue, not fatal
+    }
+    if (memcmp(&original_meta, &meta, sizeof(meta)))
+    {
       try
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
+        m_blockchain.update_txpool_tx(txid, meta);
       }
       catch (const std::exception &e)
       {
-        MERROR("Failed to check transaction readiness: " << e.what());
+        MERROR("Failed to update tx meta: " << e.what());
         // continue, not fatal
       }
-      if (memcmp(&original_meta, &meta, sizeof(meta)))
+    }
+    if (!ready)
+    {
+      LOG_PRINT_L2("  not ready to go");
+      return false;
+    }
+    if (have_key_images(t.k_images, *tx))
+    {
+      LOG_PRINT_L2("  key images already seen");
+      return false;
+    }
+
+    t.tx_hashes.push_back(txid);
+    t.total_weight += meta.weight;
+    t.fee += meta.fee;
+    t.best_coinbase = coinbase;
+    if (!rta_lane)
+      t.min_fee_per_byte = std::min(t.min_fee_per_byte, meta.fee / (double)meta.weight);
+    append_key_images(t.k_images, *tx);
+    LOG_PRINT_L2("  added, new block weight " << t.total_weight << "/" << max_weight << ", coinbase " << print_money(t.best_coinbase));
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::fill_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward, uint8_t version)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    block_template_state &t = m_block_template;
+    const bool same_block = t.valid && t.median_weight == median_weight && t.already_generated_coins == already_generated_coins && t.version == version;
+
+    // the template is kept while only new transactions are added to the pool (add_tx moves the template cookie
+    // along), any other change of the pool or of the chain makes it to be rebuilt
+    bool rebuild = !same_block || t.cookie != m_cookie;
+    if (!rebuild && !m_block_template_added_txs.empty())
+    {
+      LOG_PRINT_L2("Updating block template with " << m_block_template_added_txs.size() << " new txes");
+
+      LockedTXN lock(m_blockchain);
+      for (const auto &added: m_block_template_added_txs)
       {
-        try
-	{
-	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
-	}
-        catch (const std::exception &e)
-	{
-	  MERROR("Failed to update tx meta: " << e.what());
-	  // continue, not fatal
-	}
+        if (added.second && add_block_template_tx(t, added.first, true))
+          continue;
+        if (!t.full && add_block_template_tx(t, added.first, false))
+          continue;
+        // a transaction paying more than the cheapest one already chosen might replace it
+        txpool_tx_meta_t meta;
+        if (m_blockchain.get_txpool_tx_meta(added.first, meta) && meta.weight > 0 && meta.fee / (double)meta.weight > t.min_fee_per_byte)
+        {
+          LOG_PRINT_L2("Better paying tx " << added.first << " does not fit the block template, rebuilding it");
+          rebuild = true;
+          break;
+        }
       }
-      if (!ready)
+    }
+    else if (!rebuild)
+    {
+      LOG_PRINT_L2("Using cached block template");
+    }
+
+    if (rebuild)
+    {
+      t = block_template_state();
+      t.median_weight = median_weight;
+      t.already_generated_coins = already_generated_coins;
+      t.version = version;
+
+      //baseline empty block
+      get_block_reward(median_weight, 0, already_generated_coins, t.best_coinbase, version);
+
+      size_t max_total_weight_pre_v5 = (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+      size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+      t.max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
+      t.max_rta_weight = std::min(t.max_total_weight, median_weight * RTA_TX_BLOCK_WEIGHT_SHARE_PERCENT / 100);
+
+      LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
+
+      LockedTXN lock(m_blockchain);
+
+      // RTA transactions go first, they are added regardless of their fee
+      std::unordered_set<crypto::hash> rta_added;
+      for (const auto &rta_entry: m_rta_txs_by_receive_time)
       {
-        LOG_PRINT_L2("  not ready to go");
-        continue;
+        if (add_block_template_tx(t, rta_entry.second, true))
+          rta_added.insert(rta_entry.second);
       }
-      if (have_key_images(k_images, tx))
+
+      for (auto sorted_it = m_txs_by_fee_and_receive_time.begin(); sorted_it != m_txs_by_fee_and_receive_time.end() && !t.full; ++sorted_it)
       {
-        LOG_PRINT_L2("  key images already seen");
-        continue;
+        if (!rta_added.count(sorted_it->second))
+          add_block_template_tx(t, sorted_it->second, false);
       }
+    }
+    t.cookie = m_cookie;
+    t.valid = true;
+    m_block_template_added_txs.clear();
 
-      bl.tx_hashes.push_back(sorted_it->second);
-      total_weight += meta.weight;
-      fee += meta.fee;
-      best_coinbase = coinbase;
-      append_key_images(k_images, tx);
-      LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
+    // only template members are kept parsed, so the cache is bounded by the block weight rather than by the pool
+    if (m_parsed_txs.size() > t.tx_hashes.size())
+    {
+      std::unordered_map<crypto::hash, std::shared_ptr<transaction>> parsed_txs;
+      parsed_txs.reserve(t.tx_hashes.size());
+      for (const crypto::hash &txid: t.tx_hashes)
+      {
+        auto it = m_parsed_txs.find(txid);
+        if (it != m_parsed_txs.end())
+          parsed_txs.emplace(txid, std::move(it->second));
+      }
+      m_parsed_txs.swap(parsed_txs);
     }
 
-    expected_reward = best_coinbase;
+    bl.tx_hashes.insert(bl.tx_hashes.end(), t.tx_hashes.begin(), t.tx_hashes.end());
+    total_weight = t.total_weight;
+    fee = t.fee;
+    expected_reward = t.best_coinbase;
     LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
-        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
+        << total_weight << "/" << t.max_total_weight << ", coinbase " << print_money(expected_reward)
         << " (including " << print_money(fee) << " in fees)");
     return true;
   }
@@ -1348,7 +1542,7 @@ namespace cryptonote
           }
           else
           {
-            m_txs_by_fee_and_receive_time.erase(sorted_it);
+            remove_tx_from_sorted_containers(sorted_it);
           }
           ++n_removed;
         }
@@ -1371,6 +1565,9 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
+    m_rta_txs_by_receive_time.clear();
+    m_parsed_txs.clear();
+    invalidate_block_template();
     m_spent_key_images.clear();
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
@@ -1395,7 +1592,7 @@ namespace cryptonote
           MFATAL("Failed to insert key images from txpool tx");
           return false;
         }
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.weight, meta.receive_time), txid);
+        add_tx_to_sorted_containers(txid, meta.fee / (double)meta.weight, meta.receive_time, tx.type == transaction::tx_type_rta);
         m_txpool_weight += meta.weight;
         return true;
       }, true);
@@ -1446,6 +1643,8 @@ namespace cryptonote
       return false;
     }
 
+    // signatures are checked one by one: the challenge is the hash of r*G + c*P, so every commitment
+    // has to be computed on its own and there is no linear combination to check them with one multiexp
     for (const auto &rta_sign : rta_signs) {
       // check if key index is in range
       if (rta_sign.key_index >= rta_hdr.keys.size()) {
@@ -1462,8 +1661,10 @@ namespace cryptonote
       }
     }
 #endif
+    // the stakes snapshot is the same for all the keys of the auth sample
+    const supernode_stake_snapshot_ptr stakes = m_stp->get_supernode_stake_snapshot(rta_hdr.auth_sample_height);
     for (const crypto::public_key &key : rta_hdr.keys) {
-      result &= validate_supernode(rta_hdr.auth_sample_height, key);
+      result &= validate_supernode(stakes.get(), key);
       if (!result) {
         MERROR("Failed to validate rta tx: " << epee::string_tools::pod_to_hex(txid) << ", key: " << key << " doesn't belong to a valid supernode");
         break;
@@ -1473,9 +1674,9 @@ namespace cryptonote
     return result;
   }
 
-  bool tx_memory_pool::validate_supernode(uint64_t height, const public_key &id) const
+  bool tx_memory_pool::validate_supernode(const supernode_stake_snapshot *stakes, const public_key &id) const
   {
-    supernode_stake * stake = const_cast<supernode_stake*>(m_stp->find_supernode_stake(height, epee::string_tools::pod_to_hex(id)));
+    const supernode_stake* stake = stakes ? stakes->find(epee::string_tools::pod_to_hex(id)) : nullptr;
     return stake ? stake->amount >= config::graft::TIER1_STAKE_AMOUNT : false;
   };
 }
@@ -31,6 +31,9 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <limits>
+#include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -52,6 +55,7 @@ namespace cryptonote
 {
   class Blockchain;
   class StakeTransactionProcessor;
+  struct supernode_stake_snapshot;
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -307,10 +311,21 @@ namespace cryptonote
      *
      * @param h the hash of the transaction to get
      * @param tx return-by-reference the transaction blob requested
+     * @param include_unrelayed_txes return the transaction even if it must not be relayed
      *
      * @return true if the transaction is found, otherwise false
      */
-    bool get_transaction(const crypto::hash& h, cryptonote::blobdata& txblob) const;
+    bool get_transaction(const crypto::hash& h, cryptonote::blobdata& txblob, bool include_unrelayed_txes = true) const;
+
+    /**
+     * @brief get several transactions from the pool under one lock
+     *
+     * @param hashes the hashes of the transactions to get
+     * @param txblobs return-by-reference the transaction blobs, empty for the transactions which are not in the pool
+     *
+     * @return the number of transactions found
+     */
+    size_t get_transactions(const std::vector<crypto::hash>& hashes, std::vector<cryptonote::blobdata>& txblobs) const;
 
     /**
      * @brief get a list of all relayable transactions and their hashes
@@ -514,12 +529,85 @@ namespace cryptonote
      *
      * @param txd the transaction to check (and info about it)
      * @param txid the txid of the transaction to check
-     * @param txblob the transaction blob to check
-     * @param tx the parsed transaction, if successful
+     * @param tx the parsed transaction
      *
      * @return true if the transaction is good to go, otherwise false
      */
-    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction &tx) const;
+    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, transaction &tx) const;
+
+    //! transactions chosen for the block template and the state of the filling algorithm
+    struct block_template_state
+    {
+      bool valid = false;
+      uint64_t cookie = 0; //!< pool cookie the template is actual for
+      size_t median_weight = 0;
+      uint64_t already_generated_coins = 0;
+      uint8_t version = 0;
+      size_t max_total_weight = 0;
+      size_t max_rta_weight = 0;
+      bool full = false; //!< no more transactions can be added (pre v5 rules)
+      std::vector<crypto::hash> tx_hashes;
+      std::unordered_set<crypto::key_image> k_images;
+      size_t total_weight = 0;
+      uint64_t fee = 0;
+      uint64_t best_coinbase = 0;
+      double min_fee_per_byte = std::numeric_limits<double>::max(); //!< cheapest transaction added outside of the RTA share
+    };
+
+    /**
+     * @brief try to add a pool transaction to the block template
+     *
+     * @param t the block template
+     * @param txid the txid of the transaction
+     * @param rta_lane true to add the transaction within the RTA share of the block weight, regardless of its fee
+     *
+     * @return true if the transaction has been added
+     */
+    bool add_block_template_tx(block_template_state &t, const crypto::hash &txid, bool rta_lane);
+
+    /**
+     * @brief drop the block template, so it is rebuilt from scratch on the next request
+     */
+    void invalidate_block_template();
+
+    /**
+     * @brief get parsed pool transaction, parsing its blob only on the first request
+     *
+     * @param txid the txid of the transaction
+     *
+     * @return the parsed transaction, or nullptr if the blob can't be parsed
+     */
+    std::shared_ptr<transaction> get_parsed_tx(const crypto::hash &txid) const;
+
+    /**
+     * @brief add a transaction to the sorted containers (and to the RTA lane for RTA transactions)
+     */
+    void add_tx_to_sorted_containers(const crypto::hash &txid, double fee_per_byte, time_t receive_time, bool is_rta);
+
+    /**
+     * @brief remove a transaction from the sorted containers, the RTA lane and the parsed transactions cache
+     *
+     * @param it iterator to the transaction in m_txs_by_fee_and_receive_time
+     */
+    void remove_tx_from_sorted_containers(sorted_tx_container::iterator it);
+
+    /**
+     * @brief check if a transaction was dropped from the pool because of its age
+     */
+    bool is_timed_out(const crypto::hash &id) const;
+
+    /**
+     * @brief check if key images of a transaction are spent by transactions in the pool
+     *
+     * Transactions spending the same key images are marked as double spends.
+     *
+     * @param tx the transaction to check
+     * @param id the txid of the transaction
+     * @param tvc return-by-reference verification result, updated if the key images are spent
+     *
+     * @return true if any key image is already spent
+     */
+    bool check_double_spend(const transaction &tx, const crypto::hash &id, tx_verification_context &tvc);
 
     /**
      * @brief mark all transactions double spending the one passed
@@ -536,7 +624,7 @@ namespace cryptonote
 
     bool validate_rta_tx(const crypto::hash &txid, const std::vector<cryptonote::rta_signature> &rta_signs, const cryptonote::rta_header &rta_hdr) const;
 
-    bool validate_supernode(uint64_t height, const crypto::public_key &id) const;
+    bool validate_supernode(const supernode_stake_snapshot *stakes, const crypto::public_key &id) const;
 
     //TODO: confirm the below comments and investigate whether or not this
     //      is the desired behavior
@@ -568,6 +656,19 @@ private:
     //!< container for transactions organized by fee per size and receive time
     sorted_tx_container m_txs_by_fee_and_receive_time;
 
+    //! RTA transactions (also present in m_txs_by_fee_and_receive_time) by receive time
+    std::multimap<std::time_t, crypto::hash> m_rta_txs_by_receive_time;
+
+    //! parsed members of the block template, so they aren't deserialized again when the template is updated or
+    //! rebuilt; other transactions are dropped after each fill_block_template, and members when they leave the pool
+    mutable std::unordered_map<crypto::hash, std::shared_ptr<transaction>> m_parsed_txs;
+
+    //! last block template, updated incrementally when transactions are added to the pool
+    block_template_state m_block_template;
+
+    //! transactions (and whether they are RTA) added to the pool since the block template has been built
+    std::vector<std::pair<crypto::hash, bool>> m_block_template_added_txs;
+
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
     /**
@@ -593,7 +694,25 @@ private:
     size_t m_txpool_max_weight;
     size_t m_txpool_weight;
 
-    mutable std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> m_input_cache;
+    typedef std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> input_cache_map;
+
+    //! part of the check_tx_inputs results cache, guarded by its own lock
+    struct input_cache_shard
+    {
+      boost::mutex lock;
+      input_cache_map cache;
+    };
+
+    static constexpr size_t INPUT_CACHE_SHARDS_COUNT = 16;
+
+    //! check_tx_inputs results sharded by txid, so transactions are checked without the pool lock
+    mutable input_cache_shard m_input_cache[INPUT_CACHE_SHARDS_COUNT];
+
+    //! get the input cache shard for the transaction
+    input_cache_shard& get_input_cache_shard(const crypto::hash &txid) const;
+
+    //! clear all the input cache shards
+    void clear_input_cache();
 
     StakeTransactionProcessor * m_stp = nullptr;
   };
@@ -31,9 +31,13 @@
 #pragma once
 
 #include <list>
+#include <unordered_map>
+#include <string.h>
 #include "serialization/keyvalue_serialization.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/blobdatatype.h"
+#include "common/int-util.h"
+#include "crypto/hash.h"
 namespace cryptonote
 {
 
@@ -280,5 +284,137 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
   }; 
+
+  /************************************************************************/
+  /* Announces hashes of new transactions, sent instead of                */
+  /* NOTIFY_NEW_TRANSACTIONS to peers with P2P_SUPPORT_FLAG_TX_INVENTORY  */
+  /************************************************************************/
+  struct NOTIFY_NEW_TRANSACTION_HASHES
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+
+    struct request
+    {
+      std::vector<crypto::hash> tx_hashes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tx_hashes)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /* Requests announced transactions missing in the pool, the peer        */
+  /* answers with NOTIFY_NEW_TRANSACTIONS                                 */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TRANSACTIONS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request
+    {
+      std::vector<crypto::hash> tx_hashes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tx_hashes)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /* Block with salted short ids instead of tx hashes, sent instead of    */
+  /* NOTIFY_NEW_FLUFFY_BLOCK to peers with P2P_SUPPORT_FLAG_COMPACT_BLOCKS */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    static const size_t SHORT_TX_ID_SIZE = 6;
+
+    struct request
+    {
+      blobdata block;                      // block with empty tx_hashes, the miner tx is inside
+      crypto::hash block_hash;             // checks the block rebuilt from short ids
+      crypto::hash tx_tree_hash;           // lets the header be hashed and its PoW checked before the txs are rebuilt
+      uint64_t current_blockchain_height;
+      uint64_t salt;
+      std::string short_tx_ids;            // SHORT_TX_ID_SIZE little endian bytes per tx which is not prefilled, in block order
+      std::vector<uint64_t> prefilled_tx_indices; // ascending indices in block tx_hashes
+      std::vector<blobdata> prefilled_txs; // txs the peer likely doesn't have
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(tx_tree_hash)
+        KV_SERIALIZE(current_blockchain_height)
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(short_tx_ids)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(prefilled_tx_indices)
+        KV_SERIALIZE(prefilled_txs)
+      END_KV_SERIALIZE_MAP()
+
+      size_t get_short_tx_ids_count() const { return short_tx_ids.size() / SHORT_TX_ID_SIZE; }
+
+      void add_short_tx_id(uint64_t short_id)
+      {
+        short_id = SWAP64LE(short_id);
+        short_tx_ids.append(reinterpret_cast<const char*>(&short_id), SHORT_TX_ID_SIZE);
+      }
+
+      uint64_t get_short_tx_id(size_t index) const
+      {
+        uint64_t short_id = 0;
+        memcpy(&short_id, short_tx_ids.data() + index * SHORT_TX_ID_SIZE, SHORT_TX_ID_SIZE);
+        return SWAP64LE(short_id);
+      }
+    };
+
+    /// Short id of the transaction: first SHORT_TX_ID_SIZE bytes of H(block hash || salt || tx hash)
+    static uint64_t get_short_tx_id(const crypto::hash& block_hash, uint64_t salt, const crypto::hash& tx_hash)
+    {
+      char data[sizeof(crypto::hash) * 2 + sizeof(uint64_t)];
+      salt = SWAP64LE(salt);
+      memcpy(data, &block_hash, sizeof(crypto::hash));
+      memcpy(data + sizeof(crypto::hash), &salt, sizeof(uint64_t));
+      memcpy(data + sizeof(crypto::hash) + sizeof(uint64_t), &tx_hash, sizeof(crypto::hash));
+      crypto::hash h;
+      crypto::cn_fast_hash(data, sizeof(data), h);
+      uint64_t short_id = 0;
+      memcpy(&short_id, &h, SHORT_TX_ID_SIZE);
+      return SWAP64LE(short_id);
+    }
+
+    /// Fills the block tx hashes which are not prefilled with the pool txs matching their short ids.
+    /// Short ids shared by several pool txs are ambiguous, their txs go to need_tx_indices like the unmatched ones.
+    static void match_short_tx_ids(const request& arg, const std::vector<size_t>& prefilled_tx_indices, const std::vector<crypto::hash>& pool_tx_hashes,
+        std::vector<crypto::hash>& tx_hashes, std::vector<uint64_t>& need_tx_indices, std::vector<size_t>& found_tx_indices)
+    {
+      std::unordered_map<uint64_t, crypto::hash> pool_index;
+      pool_index.reserve(pool_tx_hashes.size());
+      for(const crypto::hash& tx_hash: pool_tx_hashes)
+      {
+        auto inserted = pool_index.emplace(get_short_tx_id(arg.block_hash, arg.salt, tx_hash), tx_hash);
+        if(!inserted.second && inserted.first->second != tx_hash)
+          inserted.first->second = crypto::null_hash;
+      }
+
+      for(size_t tx_idx = 0, short_idx = 0, prefilled_idx = 0; tx_idx < tx_hashes.size(); ++tx_idx)
+      {
+        if(prefilled_idx < prefilled_tx_indices.size() && prefilled_tx_indices[prefilled_idx] == tx_idx)
+        {
+          ++prefilled_idx;
+          continue;
+        }
+        const auto it = pool_index.find(arg.get_short_tx_id(short_idx++));
+        if(it == pool_index.end() || it->second == crypto::null_hash)
+        {
+          need_tx_indices.push_back(tx_idx);
+          continue;
+        }
+        tx_hashes[tx_idx] = it->second;
+        found_tx_indices.push_back(tx_idx);
+      }
+    }
+  };
     
 }
@@ -36,6 +36,8 @@
 
 #include <boost/program_options/variables_map.hpp>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "math_helper.h"
 #include "storages/levin_abstract_invoke2.h"
@@ -43,6 +45,7 @@
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
 #include "block_queue.h"
+#include "tx_inventory.h"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_basic/cryptonote_stat_info.h"
 #include <boost/circular_buffer.hpp>
@@ -90,6 +93,9 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, &cryptonote_protocol_handler::handle_response_chain_entry)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_TRANSACTION_HASHES, &cryptonote_protocol_handler::handle_notify_new_transaction_hashes)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TRANSACTIONS, &cryptonote_protocol_handler::handle_request_transactions)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -119,11 +125,20 @@ namespace cryptonote
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_transaction_hashes(int command, NOTIFY_NEW_TRANSACTION_HASHES::request& arg, cryptonote_connection_context& context);
+    int handle_request_transactions(int command, NOTIFY_REQUEST_TRANSACTIONS::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    // adds block received as fluffy or compact one with all its txs (resumes mining), prefilled_tx_indices are passed to relay_block
+    int handle_reconstructed_block(block_complete_entry& b, uint64_t current_blockchain_height, const std::vector<size_t>& prefilled_tx_indices, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context);
     //----------------------------------------------------------------------------------
+    // prefilled_tx_indices are block txs which peers are likely to miss, compact blocks carry them in full
+    bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::vector<size_t>& prefilled_tx_indices);
+    bool make_compact_block(const NOTIFY_NEW_BLOCK::request& arg, const std::vector<size_t>& prefilled_tx_indices, NOTIFY_NEW_COMPACT_BLOCK::request& compact_arg);
+    //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
     bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks, bool force_next_span = false);
     size_t get_synchronizing_connections_count();
@@ -131,6 +146,7 @@ namespace cryptonote
     bool should_download_next_span(cryptonote_connection_context& context) const;
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     bool kick_idle_peers();
+    bool request_timed_out_txs();
     int try_add_next_blocks(cryptonote_connection_context &context);
 
     t_core& m_core;
@@ -148,6 +164,10 @@ namespace cryptonote
     double get_avg_block_size();
     boost::circular_buffer<size_t> m_avg_buffer = boost::circular_buffer<size_t>(10);
 
+    // announced transactions requested from peers, the same transaction is not requested again until the request times out
+    tx_inventory m_tx_inventory;
+    epee::math_helper::once_a_time_seconds<5> m_tx_inventory_checker;
+
     template<class t_parameter>
       bool post_notify(typename t_parameter::request& arg, cryptonote_connection_context& context)
       {
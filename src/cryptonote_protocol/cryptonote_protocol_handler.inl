@@ -40,6 +40,7 @@
 #include <ctime>
 
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/difficulty.h"
 #include "profile_tools.h"
 #include "net/network_throttle-detail.hpp"
 
@@ -53,6 +54,9 @@
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD (5 * 1000000) // microseconds
 #define IDLE_PEER_KICK_TIME (600 * 1000000) // microseconds
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000) // microseconds
+#define TX_INVENTORY_MAX_HASHES 1000 // per announce or request
+#define TX_INVENTORY_REQUEST_TIMEOUT 30 // seconds, then the transaction is requested from another peer
+#define TX_INVENTORY_MAX_ANNOUNCERS 8 // peers remembered per requested transaction
 
 namespace cryptonote
 {
@@ -65,7 +69,8 @@ namespace cryptonote
                                                                                                               m_p2p(p_net_layout),
                                                                                                               m_syncronized_connections_count(0),
                                                                                                               m_synchronized(offline),
-                                                                                                              m_stopping(false)
+                                                                                                              m_stopping(false),
+                                                                                                              m_tx_inventory(TX_INVENTORY_REQUEST_TIMEOUT, TX_INVENTORY_MAX_ANNOUNCERS)
 
   {
     if(!m_p2p)
@@ -447,6 +452,9 @@ namespace cryptonote
       // Also, remember to pepper some whitespace changes around to bother
       // moneromooo ... only because I <3 him. 
       std::vector<uint64_t> need_tx_indices;
+
+      // txs we didn't have are likely missing for our peers too
+      std::unordered_set<crypto::hash> received_tx_hashes;
         
       transaction tx;
       crypto::hash tx_hash;
@@ -516,6 +524,7 @@ namespace cryptonote
           if(!m_core.pool_has_tx(tx_hash))
           {
             MDEBUG("Incoming tx " << tx_hash << " not in pool, adding");
+            received_tx_hashes.insert(tx_hash);
             cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);                        
             if(!m_core.handle_incoming_tx(tx_blob, tvc, true, true, false) || tvc.m_verifivation_failed)
             {
@@ -568,8 +577,11 @@ namespace cryptonote
       }      
       
       size_t tx_idx = 0;
+      std::vector<size_t> prefilled_tx_indices;
       for(auto& tx_hash: new_block.tx_hashes)
       {
+        if(received_tx_hashes.count(tx_hash))
+          prefilled_tx_indices.push_back(tx_idx);
         cryptonote::blobdata txblob;
         if(m_core.get_pool_transaction(tx_hash, txblob))
         {
@@ -624,44 +636,8 @@ namespace cryptonote
 
         block_complete_entry b;
         b.block = arg.b.block;
-        b.txs = have_tx;
-
-        std::vector<block_complete_entry> blocks;
-        blocks.push_back(b);
-        m_core.prepare_handle_incoming_blocks(blocks);
-          
-        block_verification_context bvc = boost::value_initialized<block_verification_context>();
-        m_core.handle_incoming_block(arg.b.block, bvc); // got block from handle_notify_new_block
-        if (!m_core.cleanup_handle_incoming_blocks(true))
-        {
-          LOG_PRINT_CCONTEXT_L0("Failure in cleanup_handle_incoming_blocks");
-          m_core.resume_mine();
-          return 1;
-        }
-        m_core.resume_mine();
-        
-        if( bvc.m_verifivation_failed )
-        {
-          LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
-          drop_connection(context, true, false);
-          return 1;
-        }
-        if( bvc.m_added_to_main_chain )
-        {
-          //TODO: Add here announce protocol usage
-          NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
-          reg_arg.current_blockchain_height = arg.current_blockchain_height;
-          reg_arg.b = b;
-          relay_block(reg_arg, context);
-        }
-        else if( bvc.m_marked_as_orphaned )
-        {
-          context.m_state = cryptonote_connection_context::state_synchronizing;
-          NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-          m_core.get_short_chain_history(r.block_ids);
-          LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
-          post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
-        }            
+        b.txs = std::move(have_tx);
+        return handle_reconstructed_block(b, arg.current_blockchain_height, prefilled_tx_indices, context);
       }
     } 
     else
@@ -681,6 +657,212 @@ namespace cryptonote
         
     return 1;
   }  
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK (height " << arg.current_blockchain_height << ", " << arg.get_short_tx_ids_count()
+        << " short ids, " << arg.prefilled_txs.size() << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received new block while syncing, ignored");
+      return 1;
+    }
+
+    if(m_core.have_block(arg.block_hash))
+    {
+      LOG_DEBUG_CC(context, "Received known compact block " << arg.block_hash << ", ignored");
+      return 1;
+    }
+
+    block new_block;
+    if(!parse_and_validate_block_from_blob(arg.block, new_block) || !new_block.tx_hashes.empty()
+        || arg.short_tx_ids.size() % NOTIFY_NEW_COMPACT_BLOCK::SHORT_TX_ID_SIZE != 0
+        || arg.prefilled_tx_indices.size() != arg.prefilled_txs.size())
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block " << arg.block_hash << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    const size_t tx_count = arg.get_short_tx_ids_count() + arg.prefilled_txs.size();
+    for(size_t i = 0; i < arg.prefilled_tx_indices.size(); ++i)
+    {
+      if(arg.prefilled_tx_indices[i] >= tx_count || (i > 0 && arg.prefilled_tx_indices[i] <= arg.prefilled_tx_indices[i - 1]))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong compact block " << arg.block_hash << ": bad prefilled tx index " << arg.prefilled_tx_indices[i]
+            << ", dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+    }
+
+    // check the header before any tx is parsed or looked up, the tx tree hash gives the block hash and PoW without the txs
+    const blobdata hashing_blob = get_block_hashing_blob(new_block, arg.tx_tree_hash, tx_count);
+    crypto::hash header_hash;
+    if(!get_object_hash(hashing_blob, header_hash) || header_hash != arg.block_hash)
+    {
+      LOG_ERROR_CCONTEXT("sent compact block " << arg.block_hash << " with a wrong header hash " << header_hash << ", dropping connection");
+      drop_connection(context, true, false);
+      return 1;
+    }
+
+    const difficulty_type difficulty = m_core.get_difficulty_for_next_block(new_block.prev_id);
+    if(difficulty)
+    {
+      crypto::hash pow;
+      get_block_longhash(hashing_blob, new_block.major_version, pow);
+      if(!check_hash(pow, difficulty))
+      {
+        LOG_ERROR_CCONTEXT("sent compact block " << arg.block_hash << " without enough PoW, dropping connection");
+        drop_connection(context, true, false);
+        return 1;
+      }
+    }
+    else if(!m_core.have_block(new_block.prev_id))
+    {
+      // orphan, sync with the peer instead of rebuilding a block we can't add
+      LOG_DEBUG_CC(context, "Received compact block " << arg.block_hash << " with unknown prev_id " << new_block.prev_id);
+      context.m_state = cryptonote_connection_context::state_synchronizing;
+      NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+      m_core.get_short_chain_history(r.block_ids);
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+      return 1;
+    }
+    // otherwise an alternative block, its PoW is checked by the core
+
+    m_core.pause_mine();
+
+    std::vector<crypto::hash> tx_hashes(tx_count);
+    std::vector<blobdata> txs(tx_count);
+    std::vector<size_t> prefilled_tx_indices;
+    prefilled_tx_indices.reserve(arg.prefilled_txs.size());
+    for(size_t i = 0; i < arg.prefilled_txs.size(); ++i)
+    {
+      const size_t tx_idx = arg.prefilled_tx_indices[i];
+      transaction tx;
+      crypto::hash tx_prefix_hash;
+      if(!parse_and_validate_tx_from_blob(arg.prefilled_txs[i], tx, tx_hashes[tx_idx], tx_prefix_hash))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong tx: failed to parse and validate transaction of compact block " << arg.block_hash << ", dropping connection");
+        drop_connection(context, false, false);
+        m_core.resume_mine();
+        return 1;
+      }
+      if(!m_core.pool_has_tx(tx_hashes[tx_idx]))
+      {
+        MDEBUG("Incoming tx " << tx_hashes[tx_idx] << " not in pool, adding");
+        cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        if(!m_core.handle_incoming_tx(arg.prefilled_txs[i], tvc, true, true, false) || tvc.m_verifivation_failed)
+        {
+          LOG_PRINT_CCONTEXT_L1("Block verification failed: transaction verification failed, dropping connection");
+          drop_connection(context, false, false);
+          m_core.resume_mine();
+          return 1;
+        }
+      }
+      txs[tx_idx] = std::move(arg.prefilled_txs[i]);
+      prefilled_tx_indices.push_back(tx_idx);
+    }
+
+    // match short ids against the pool
+    std::vector<crypto::hash> pool_tx_hashes;
+    m_core.get_pool_transaction_hashes(pool_tx_hashes);
+    std::vector<uint64_t> need_tx_indices;
+    std::vector<size_t> found_tx_indices;
+    NOTIFY_NEW_COMPACT_BLOCK::match_short_tx_ids(arg, prefilled_tx_indices, pool_tx_hashes, tx_hashes, need_tx_indices, found_tx_indices);
+
+    if(need_tx_indices.empty())
+    {
+      // txs may have left the pool since the index was built
+      std::vector<crypto::hash> found_tx_hashes;
+      found_tx_hashes.reserve(found_tx_indices.size());
+      for(size_t tx_idx: found_tx_indices)
+        found_tx_hashes.push_back(tx_hashes[tx_idx]);
+      std::vector<blobdata> found_txs;
+      m_core.get_pool_transactions(found_tx_hashes, found_txs);
+      for(size_t i = 0; i < found_txs.size(); ++i)
+      {
+        if(found_txs[i].empty())
+          need_tx_indices.push_back(found_tx_indices[i]);
+        else
+          txs[found_tx_indices[i]] = std::move(found_txs[i]);
+      }
+    }
+
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    if(!need_tx_indices.empty())
+    {
+      // the peer answers with a fluffy block carrying the missing txs
+      MDEBUG("We are missing " << need_tx_indices.size() << " txes for compact block " << arg.block_hash);
+      missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+      m_core.resume_mine();
+      post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+      return 1;
+    }
+
+    new_block.tx_hashes = std::move(tx_hashes);
+    if(get_block_hash(new_block) != arg.block_hash)
+    {
+      // short id collision with a tx which is not in the block, fall back to the fluffy block with full tx hashes
+      MDEBUG("Compact block " << arg.block_hash << " doesn't match its txs, requesting fluffy block");
+      m_core.resume_mine();
+      post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+      return 1;
+    }
+
+    MDEBUG("We have all needed txes for compact block " << arg.block_hash);
+    block_complete_entry b;
+    b.block = block_to_blob(new_block);
+    b.txs = std::move(txs);
+    return handle_reconstructed_block(b, arg.current_blockchain_height, prefilled_tx_indices, context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_reconstructed_block(block_complete_entry& b, uint64_t current_blockchain_height, const std::vector<size_t>& prefilled_tx_indices, cryptonote_connection_context& context)
+  {
+    std::vector<block_complete_entry> blocks;
+    blocks.push_back(b);
+    m_core.prepare_handle_incoming_blocks(blocks);
+
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    m_core.handle_incoming_block(b.block, bvc); // got block from handle_notify_new_block
+    if (!m_core.cleanup_handle_incoming_blocks(true))
+    {
+      LOG_PRINT_CCONTEXT_L0("Failure in cleanup_handle_incoming_blocks");
+      m_core.resume_mine();
+      return 1;
+    }
+    m_core.resume_mine();
+
+    if( bvc.m_verifivation_failed )
+    {
+      LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
+      drop_connection(context, true, false);
+      return 1;
+    }
+    if( bvc.m_added_to_main_chain )
+    {
+      NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
+      reg_arg.current_blockchain_height = current_blockchain_height;
+      reg_arg.b = std::move(b);
+      relay_block(reg_arg, context, prefilled_tx_indices);
+    }
+    else if( bvc.m_marked_as_orphaned )
+    {
+      context.m_state = cryptonote_connection_context::state_synchronizing;
+      NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+      m_core.get_short_chain_history(r.block_ids);
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+    }
+    return 1;
+  }
   //------------------------------------------------------------------------------------------------------------------------  
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context)
@@ -793,7 +975,6 @@ namespace cryptonote
 
     if(arg.txs.size())
     {
-      //TODO: add announce usage here
       relay_transactions(arg, context);
     }
 
@@ -801,6 +982,79 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transaction_hashes(int command, NOTIFY_NEW_TRANSACTION_HASHES::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTION_HASHES (" << arg.tx_hashes.size() << " hashes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received new tx hashes while syncing, ignored");
+      return 1;
+    }
+
+    if(arg.tx_hashes.size() > TX_INVENTORY_MAX_HASHES)
+    {
+      LOG_ERROR_CCONTEXT("NOTIFY_NEW_TRANSACTION_HASHES has too many hashes: " << arg.tx_hashes.size() << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    NOTIFY_REQUEST_TRANSACTIONS::request req;
+    const time_t now = time(nullptr);
+    for(const crypto::hash& tx_hash: arg.tx_hashes)
+    {
+      if(m_core.pool_has_tx(tx_hash))
+        continue;
+      if(m_tx_inventory.on_announce(tx_hash, context.m_connection_id, now))
+        req.tx_hashes.push_back(tx_hash);
+    }
+
+    if(!req.tx_hashes.empty())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_TRANSACTIONS: tx_hashes.size()=" << req.tx_hashes.size());
+      post_notify<NOTIFY_REQUEST_TRANSACTIONS>(req, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_transactions(int command, NOTIFY_REQUEST_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TRANSACTIONS (" << arg.tx_hashes.size() << " hashes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if(arg.tx_hashes.size() > TX_INVENTORY_MAX_HASHES)
+    {
+      LOG_ERROR_CCONTEXT("NOTIFY_REQUEST_TRANSACTIONS has too many hashes: " << arg.tx_hashes.size() << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // transactions may leave the pool after they have been announced, those are skipped;
+    // the ones which must not be relayed are never sent
+    NOTIFY_NEW_TRANSACTIONS::request rsp;
+    rsp.txs.reserve(arg.tx_hashes.size());
+    for(const crypto::hash& tx_hash: arg.tx_hashes)
+    {
+      cryptonote::blobdata tx_blob;
+      if(m_core.get_pool_transaction(tx_hash, tx_blob, false))
+        rsp.txs.push_back(std::move(tx_blob));
+      else
+        MDEBUG("Requested tx " << tx_hash << " is not in the pool");
+    }
+
+    if(!rsp.txs.empty())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << rsp.txs.size());
+      post_notify<NOTIFY_NEW_TRANSACTIONS>(rsp, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_GET_OBJECTS (" << arg.blocks.size() << " blocks, " << arg.txs.size() << " txes)");
@@ -1208,10 +1462,29 @@ skip:
   bool t_cryptonote_protocol_handler<t_core>::on_idle()
   {
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
+    m_tx_inventory_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::request_timed_out_txs, this));
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::request_timed_out_txs()
+  {
+    tx_inventory::peer_requests requests;
+    m_tx_inventory.get_timed_out_requests(time(nullptr), [this](const crypto::hash &tx_hash) { return m_core.pool_has_tx(tx_hash); }, requests);
+    for (auto &peer_request : requests)
+    {
+      NOTIFY_REQUEST_TRANSACTIONS::request req;
+      req.tx_hashes = std::move(peer_request.second);
+      m_p2p->for_connection(peer_request.first, [&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+        LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_TRANSACTIONS (timed out elsewhere): tx_hashes.size()=" << req.tx_hashes.size());
+        post_notify<NOTIFY_REQUEST_TRANSACTIONS>(req, context);
+        return true;
+      });
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::kick_idle_peers()
   {
     MTRACE("Checking for idle peers...");
@@ -1676,6 +1949,48 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    return relay_block(arg, exclude_context, std::vector<size_t>());
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::make_compact_block(const NOTIFY_NEW_BLOCK::request& arg, const std::vector<size_t>& prefilled_tx_indices, NOTIFY_NEW_COMPACT_BLOCK::request& compact_arg)
+  {
+    block b;
+    if(!parse_and_validate_block_from_blob(arg.b.block, b))
+      return false;
+
+    compact_arg.block_hash = get_block_hash(b);
+    compact_arg.tx_tree_hash = get_tx_tree_hash(b);
+    compact_arg.current_blockchain_height = arg.current_blockchain_height;
+    compact_arg.salt = crypto::rand<uint64_t>();
+
+    // prefilled txs are taken by index, so the block txs have to be complete and in block order
+    const bool can_prefill = arg.b.txs.size() == b.tx_hashes.size();
+    size_t prefilled_idx = 0;
+    compact_arg.short_tx_ids.reserve(b.tx_hashes.size() * NOTIFY_NEW_COMPACT_BLOCK::SHORT_TX_ID_SIZE);
+    for(size_t tx_idx = 0; tx_idx < b.tx_hashes.size(); ++tx_idx)
+    {
+      while(prefilled_idx < prefilled_tx_indices.size() && prefilled_tx_indices[prefilled_idx] < tx_idx)
+        ++prefilled_idx;
+      if(can_prefill && prefilled_idx < prefilled_tx_indices.size() && prefilled_tx_indices[prefilled_idx] == tx_idx)
+      {
+        compact_arg.prefilled_tx_indices.push_back(tx_idx);
+        compact_arg.prefilled_txs.push_back(arg.b.txs[tx_idx]);
+      }
+      else
+      {
+        compact_arg.add_short_tx_id(NOTIFY_NEW_COMPACT_BLOCK::get_short_tx_id(compact_arg.block_hash, compact_arg.salt, b.tx_hashes[tx_idx]));
+      }
+    }
+
+    b.tx_hashes.clear();
+    compact_arg.block = block_to_blob(b);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::vector<size_t>& prefilled_tx_indices)
   {
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
@@ -1683,13 +1998,18 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::list<boost::uuids::uuid> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy ones and others
+    std::list<boost::uuids::uuid> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING BLOCK WITH SHORT TX IDS");
+          compactConnections.push_back(context.m_connection_id);
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back(context.m_connection_id);
@@ -1703,7 +2023,22 @@ skip:
       return true;
     });
 
-    // send fluffy ones first, we want to encourage people to run that
+    // send compact ones first, they are the smallest ones
+    if (!compactConnections.empty())
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      if (make_compact_block(arg, prefilled_tx_indices, compact_arg))
+      {
+        std::string compactBlob;
+        epee::serialization::store_t_to_binary(compact_arg, compactBlob);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, compactBlob, compactConnections);
+      }
+      else
+      {
+        MERROR("Failed to make compact block, relaying fluffy block instead");
+        fluffyConnections.splice(fluffyConnections.end(), compactConnections);
+      }
+    }
     if (!fluffyConnections.empty())
     {
       std::string fluffyBlob;
@@ -1724,9 +2059,44 @@ skip:
   bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
   {
     // no check for success, so tell core they're relayed unconditionally
+    NOTIFY_NEW_TRANSACTION_HASHES::request hashes_arg;
+    hashes_arg.tx_hashes.reserve(arg.txs.size());
+    bool hashes_valid = true;
     for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tx_blob_it)
-      m_core.on_transaction_relayed(*tx_blob_it);
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+    {
+      const crypto::hash tx_hash = m_core.on_transaction_relayed(*tx_blob_it);
+      hashes_valid = hashes_valid && tx_hash != crypto::null_hash;
+      hashes_arg.tx_hashes.push_back(tx_hash);
+    }
+
+    // sort peers between the ones which fetch announced transactions and others
+    std::list<boost::uuids::uuid> fullConnections, inventoryConnections;
+    m_p2p->for_each_connection([&](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
+      {
+        if(hashes_valid && hashes_arg.tx_hashes.size() <= TX_INVENTORY_MAX_HASHES && (support_flags & P2P_SUPPORT_FLAG_TX_INVENTORY))
+          inventoryConnections.push_back(context.m_connection_id);
+        else
+          fullConnections.push_back(context.m_connection_id);
+      }
+      return true;
+    });
+
+    bool ret = true;
+    if (!inventoryConnections.empty())
+    {
+      std::string hashesBlob;
+      epee::serialization::store_t_to_binary(hashes_arg, hashesBlob);
+      ret = m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTION_HASHES::ID, hashesBlob, inventoryConnections) && ret;
+    }
+    if (!fullConnections.empty())
+    {
+      std::string fullBlob;
+      epee::serialization::store_t_to_binary(arg, fullBlob);
+      ret = m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, fullBlob, fullConnections) && ret;
+    }
+    return ret;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
@@ -1760,6 +2130,7 @@ skip:
     }
 
     m_block_queue.flush_spans(context.m_connection_id, false);
+    m_tx_inventory.remove_peer(context.m_connection_id);
   }
 
   //------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,100 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "misc_log_ex.h"
+#include "tx_inventory.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "cn.tx_inventory"
+
+namespace cryptonote
+{
+
+bool tx_inventory::on_announce(const crypto::hash &txid, const boost::uuids::uuid &peer, time_t now)
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  auto inserted = m_requests.emplace(txid, request());
+  request &r = inserted.first->second;
+  if (!inserted.second && r.time + m_request_timeout > now)
+  {
+    // some other peer is already sending it
+    if (r.peer != peer && r.announcers.size() < m_max_announcers && std::find(r.announcers.begin(), r.announcers.end(), peer) == r.announcers.end())
+      r.announcers.push_back(peer);
+    return false;
+  }
+  r.time = now;
+  r.peer = peer;
+  return true;
+}
+
+void tx_inventory::get_timed_out_requests(time_t now, const std::function<bool(const crypto::hash&)> &have_tx, peer_requests &requests)
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  for (auto it = m_requests.begin(); it != m_requests.end(); )
+  {
+    request &r = it->second;
+    if (r.time + m_request_timeout > now)
+    {
+      ++it;
+      continue;
+    }
+    if (r.announcers.empty() || have_tx(it->first))
+    {
+      it = m_requests.erase(it);
+      continue;
+    }
+    r.peer = r.announcers.front();
+    r.announcers.pop_front();
+    r.time = now;
+    MDEBUG("Request of tx " << it->first << " has timed out, requesting it from the next peer");
+    requests[r.peer].push_back(it->first);
+    ++it;
+  }
+}
+
+void tx_inventory::remove_peer(const boost::uuids::uuid &peer)
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  for (auto &e : m_requests)
+  {
+    std::deque<boost::uuids::uuid> &announcers = e.second.announcers;
+    announcers.erase(std::remove(announcers.begin(), announcers.end(), peer), announcers.end());
+    // the request to the closed connection won't be answered
+    if (e.second.peer == peer)
+      e.second.time = 0;
+  }
+}
+
+size_t tx_inventory::size() const
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  return m_requests.size();
+}
+
+}
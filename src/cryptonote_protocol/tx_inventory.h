@@ -0,0 +1,90 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /*!
+   * \brief tx_inventory - announced transactions requested from peers
+   *
+   * A transaction is requested from the first peer which announced it. Other peers announcing it meanwhile are
+   * remembered, so when the request times out the transaction is requested from the next of them instead of
+   * waiting for a new announce.
+   */
+  class tx_inventory
+  {
+  public:
+    typedef std::map<boost::uuids::uuid, std::vector<crypto::hash>> peer_requests;
+
+    tx_inventory(time_t request_timeout, size_t max_announcers): m_request_timeout(request_timeout), m_max_announcers(max_announcers) {}
+
+    /*!
+     * \brief on_announce - registers the transaction announced by the peer
+     * \return            - true if the transaction has to be requested from the peer now
+     */
+    bool on_announce(const crypto::hash &txid, const boost::uuids::uuid &peer, time_t now);
+
+    /*!
+     * \brief get_timed_out_requests - moves timed out requests to the next announcing peers
+     * \param have_tx  - true if the transaction has been received meanwhile, it is forgotten
+     * \param requests - transactions to request by peer
+     */
+    void get_timed_out_requests(time_t now, const std::function<bool(const crypto::hash&)> &have_tx, peer_requests &requests);
+
+    //! forgets the peer, its announces are not requested anymore
+    void remove_peer(const boost::uuids::uuid &peer);
+
+    size_t size() const;
+
+  private:
+    struct request
+    {
+      time_t time;
+      boost::uuids::uuid peer;
+      std::deque<boost::uuids::uuid> announcers; // peers to request the transaction from if the request times out
+    };
+
+    const time_t m_request_timeout;
+    const size_t m_max_announcers;
+    mutable boost::mutex m_lock;
+    std::unordered_map<crypto::hash, request> m_requests;
+  };
+}
@@ -121,6 +121,12 @@ namespace daemon_args
     }
   };
 
+  const command_line::arg_descriptor<std::string> arg_zmq_stream_bind_port = {
+    "zmq-stream-bind-port"
+  , "Port for ZMQ RTA event stream to listen on (on zmq-rpc-bind-ip), stream is disabled if not set"
+  , ""
+  };
+
 }  // namespace daemon_args
 
 #endif // DAEMON_COMMAND_LINE_ARGS_H
@@ -105,6 +105,7 @@ t_daemon::t_daemon(
 {
   zmq_rpc_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_port);
   zmq_rpc_bind_address = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_ip);
+  zmq_stream_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_stream_bind_port);
 }
 
 t_daemon::~t_daemon() = default;
@@ -183,6 +184,21 @@ bool t_daemon::run(bool interactive)
       return false;
     }
 
+    if (!zmq_stream_bind_port.empty() &&
+        !zmq_server.addStreamSocket(zmq_rpc_bind_address, zmq_stream_bind_port, mp_internals->p2p.get().get_rta_event_stream()))
+    {
+      LOG_ERROR(std::string("Failed to add ZMQ stream socket (") + zmq_rpc_bind_address
+          + ":" + zmq_stream_bind_port + ")");
+
+      if (rpc_commands)
+        rpc_commands->stop_handling();
+
+      for(auto& rpc : mp_internals->rpcs)
+        rpc->stop();
+
+      return false;
+    }
+
     MINFO("Starting ZMQ server...");
     zmq_server.run();
 
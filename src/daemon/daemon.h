@@ -45,6 +45,7 @@ private:
   std::unique_ptr<t_internals> mp_internals;
   std::string zmq_rpc_bind_address;
   std::string zmq_rpc_bind_port;
+  std::string zmq_stream_bind_port;
 public:
   t_daemon(
       boost::program_options::variables_map const & vm
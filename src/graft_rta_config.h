@@ -19,6 +19,7 @@ constexpr uint64_t STAKE_MIN_UNLOCK_TIME_FOR_WALLET = 60;
 constexpr uint64_t STAKE_VALIDATION_PERIOD = 6;
 constexpr uint64_t TRUSTED_RESTAKING_PERIOD = 6;
 constexpr uint64_t SUPERNODE_HISTORY_SIZE = 100;
+constexpr uint64_t BLOCKCHAIN_BASED_LIST_HISTORY_DEPTH = 1000;
 
 //  50,000 GRFT –  tier 1
 //  90,000 GRFT –  tier 2
@@ -0,0 +1,443 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "misc_log_ex.h"
+#include "net/http_client.h"
+#include "net/jsonrpc_structs.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
+#include "rta_metrics.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief local_supernode - graft_server registered at this daemon
+   *
+   * Requests to the supernode are not sent from the caller thread. They are serialized,
+   * put into a bounded queue and delivered by a dedicated worker thread which keeps
+   * the http connection alive between requests, so p2p handlers never wait for
+   * the supernode http round-trip.
+   */
+  class local_supernode
+  {
+  public:
+    // sometimes supernode gets very busy so it doesn't respond within 1 second, increasing timeout to 3s
+    static constexpr size_t HTTP_TIMEOUT_MILLIS = 3 * 1000;
+    // max number of requests waiting for delivery, the oldest one is dropped on overflow
+    static constexpr size_t MAX_QUEUE_SIZE = 1024;
+    // max number of requests sent back-to-back over the kept alive connection per queue wakeup
+    static constexpr size_t MAX_BATCH_SIZE = 32;
+    // max number of attempts to deliver request in case of transport error
+    static constexpr unsigned MAX_ATTEMPTS = 2;
+    // number of consecutive transport errors after which delivery is paused
+    static constexpr unsigned MAX_FAILURES = 3;
+    static constexpr size_t FAILURE_PAUSE_MILLIS = 5 * 1000;
+
+    //! state feed a request belongs to, the feed version is reset if the request is not delivered
+    enum feed_type { feed_none, feed_stakes, feed_list };
+
+    local_supernode(std::string public_id, std::string host, uint64_t port, std::string uri)
+      : m_public_id(std::move(public_id))
+      , m_http_host(std::move(host))
+      , m_http_port(port)
+      , m_uri(std::move(uri))
+    {
+      m_client.set_server(m_http_host, std::to_string(m_http_port), {});
+      m_worker = boost::thread([this]() { run(); });
+    }
+
+    ~local_supernode()
+    {
+      {
+        boost::lock_guard<boost::mutex> guard(m_queue_lock);
+        m_stop = true;
+      }
+      m_queue_cond.notify_all();
+      if (m_worker.joinable())
+        m_worker.join();
+    }
+
+    local_supernode(const local_supernode&) = delete;
+    local_supernode& operator=(const local_supernode&) = delete;
+
+    const std::string &get_public_id() const { return m_public_id; }
+
+    /*!
+     * \brief update - changes supernode endpoint, takes effect for the next delivered request
+     */
+    void update(const std::string &new_host, uint64_t new_port, const std::string &new_uri)
+    {
+      boost::lock_guard<boost::mutex> guard(m_queue_lock);
+      if (new_host != m_http_host || new_port != m_http_port) {
+        m_http_host = new_host;
+        m_http_port = new_port;
+        m_uri = new_uri;
+        m_endpoint_changed = true;
+      }
+    }
+
+    /*!
+     * \brief post - enqueues JSON-RPC request for the asynchronous delivery
+     * \param method   - JSON-RPC method name
+     * \param body     - request params
+     * \param endpoint - uri relative to the supernode uri, "/<method>" if empty
+     * \return         - true if request was enqueued
+     */
+    template<class request_struct>
+    bool post(const std::string &method, const typename request_struct::request &body, const std::string &endpoint = std::string())
+    {
+      std::string json;
+      if (!serialize<request_struct>(method, body, json))
+        return false;
+      return post_serialized(endpoint.empty() ? "/" + method : endpoint, std::move(json));
+    }
+
+    /*!
+     * \brief post_serialized - enqueues request serialized by the caller, so one update is serialized once for all supernodes
+     * \param endpoint - uri relative to the supernode uri
+     * \param body     - JSON-RPC request or epee binary storage
+     * \param binary   - body is epee binary storage, the response is expected in the same encoding
+     * \param feed     - state feed of the update, its version is reset to 0 if the request is dropped or fails
+     * \param delta    - body is a delta of the feed state, it is discarded if an earlier request of the feed
+     *                   was not delivered and no full state has been posted since
+     * \return         - true if request was enqueued
+     */
+    bool post_serialized(const std::string &endpoint, std::string body, bool binary = false, feed_type feed = feed_none, bool delta = false)
+    {
+      request r;
+      r.endpoint = endpoint;
+      r.body = std::move(body);
+      r.binary = binary;
+      r.feed = feed;
+      r.delta = delta;
+      if (rta_metrics::is_enabled())
+        r.enqueued = std::chrono::steady_clock::now();
+      return enqueue(std::move(r));
+    }
+
+    /*!
+     * \brief serialize - serializes JSON-RPC request for post_serialized
+     */
+    template<class request_struct>
+    static bool serialize(const std::string &method, const typename request_struct::request &body, std::string &json)
+    {
+      boost::value_initialized<epee::json_rpc::request<typename request_struct::request> > init_req;
+      epee::json_rpc::request<typename request_struct::request>& req = static_cast<epee::json_rpc::request<typename request_struct::request> &>(init_req);
+      req.jsonrpc = "2.0";
+      req.id = 0;
+      req.method = method;
+      req.params = body;
+
+      if (!epee::serialization::store_t_to_json(req, json))
+      {
+        MERROR("Failed to serialize " << method << " request to supernode");
+        return false;
+      }
+      return true;
+    }
+
+    // delta feed state, changed only under the node_server supernodes lock
+    bool supports_delta() const { return m_supports_delta; }
+    void set_supports_delta(bool supports_delta) { m_supports_delta = supports_delta; }
+    // versions of the stakes and blockchain based list known by the supernode, 0 if the full state has to be sent;
+    // advanced when an update is queued and reset by the worker when an update is not delivered
+    uint64_t get_stakes_version() const { return m_stakes_version; }
+    void set_stakes_version(uint64_t version) { m_stakes_version = version; }
+    uint64_t get_list_version() const { return m_list_version; }
+    void set_list_version(uint64_t version) { m_list_version = version; }
+    // false if the version was reset after it has been read (an earlier update was not delivered)
+    bool advance_feed_version(feed_type feed, uint64_t from, uint64_t to)
+    {
+      std::atomic<uint64_t> *version = get_feed_version(feed);
+      return !version || version->compare_exchange_strong(from, to);
+    }
+    void reset_feed_version(feed_type feed)
+    {
+      std::atomic<uint64_t> *version = get_feed_version(feed);
+      if (version)
+        *version = 0;
+    }
+    // supernode accepts all announces of the flush in one request, changed only under the node_server supernodes lock
+    bool supports_announce_batches() const { return m_supports_announce_batches; }
+    void set_supports_announce_batches(bool supports_announce_batches) { m_supports_announce_batches = supports_announce_batches; }
+
+    uint64_t get_delivered_count() const { return m_delivered; }
+    uint64_t get_failed_count() const { return m_failed; }
+    uint64_t get_dropped_count() const { return m_dropped; }
+    // time from enqueueing to the successful delivery, microseconds (recorded only while metrics are enabled)
+    const rta_metrics::histogram &get_delivery_us() const { return m_delivery_us; }
+    size_t get_queue_size() const
+    {
+      boost::lock_guard<boost::mutex> guard(m_queue_lock);
+      return m_queue.size();
+    }
+
+  private:
+    struct request
+    {
+      std::string endpoint;
+      std::string body;
+      bool binary = false;
+      feed_type feed = feed_none;
+      bool delta = false;
+      std::chrono::steady_clock::time_point enqueued; // default if metrics were disabled at enqueueing
+    };
+
+    struct response
+    {
+      int64_t status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    enum class delivery_result { ok, rejected, transport_error };
+
+    std::atomic<uint64_t> *get_feed_version(feed_type feed)
+    {
+      switch (feed)
+      {
+        case feed_stakes: return &m_stakes_version;
+        case feed_list: return &m_list_version;
+        default: return nullptr;
+      }
+    }
+
+    bool enqueue(request &&r)
+    {
+      {
+        boost::lock_guard<boost::mutex> guard(m_queue_lock);
+        if (m_stop)
+          return false;
+        if (m_queue.size() >= MAX_QUEUE_SIZE)
+        {
+          const feed_type dropped_feed = m_queue.front().feed;
+          m_queue.pop_front();
+          ++m_dropped;
+          discard_feed_deltas(dropped_feed);
+          MWARNING("Supernode " << m_http_host << ":" << m_http_port << " delivery queue is full, dropping oldest request");
+        }
+        if (r.feed != feed_none)
+        {
+          if (!r.delta)
+          {
+            m_feed_discarded[r.feed] = false;
+          }
+          else if (m_feed_discarded[r.feed])
+          {
+            ++m_dropped;
+            return false;
+          }
+        }
+        m_queue.emplace_back(std::move(r));
+      }
+      m_queue_cond.notify_one();
+      return true;
+    }
+
+    /*!
+     * \brief discard_feed_deltas - a request of the feed was dropped or not delivered, the supernode can't apply
+     *        the following deltas of the feed, so the queued ones and the ones posted later are discarded until
+     *        the next full state. Caller holds m_queue_lock.
+     */
+    void discard_feed_deltas(feed_type feed)
+    {
+      if (feed == feed_none)
+        return;
+      reset_feed_version(feed);
+      for (auto it = m_queue.begin(); it != m_queue.end();)
+      {
+        if (it->feed != feed)
+        {
+          ++it;
+          continue;
+        }
+        if (!it->delta)
+          return; // the supernode is resynchronized by the queued full state
+        it = m_queue.erase(it);
+        ++m_dropped;
+      }
+      m_feed_discarded[feed] = true;
+    }
+
+    static bool has_full_state(const std::vector<request> &requests, size_t from, feed_type feed)
+    {
+      for (size_t i = from; i < requests.size(); ++i)
+        if (requests[i].feed == feed && !requests[i].delta)
+          return true;
+      return false;
+    }
+
+    delivery_result deliver(const std::string &full_uri, const request &r)
+    {
+      epee::net_utils::http::fields_list additional_params;
+      additional_params.push_back(std::make_pair("Content-Type", r.binary ? "application/octet-stream" : "application/json; charset=utf-8"));
+
+      const epee::net_utils::http::http_response_info *pri = nullptr;
+      if (!m_client.invoke(full_uri, "POST", r.body, std::chrono::milliseconds(uint64_t(HTTP_TIMEOUT_MILLIS)), std::addressof(pri), std::move(additional_params)) || !pri)
+      {
+        // drop connection so the next attempt starts from the clean state
+        m_client.disconnect();
+        return delivery_result::transport_error;
+      }
+
+      if (pri->m_response_code != 200)
+      {
+        LOG_PRINT_L1("Failed to invoke http request to " << full_uri << ", wrong response code: " << pri->m_response_code);
+        return delivery_result::rejected;
+      }
+
+      response resp = AUTO_VAL_INIT(resp);
+      const bool loaded = r.binary ? epee::serialization::load_t_from_binary(resp, pri->m_body) : epee::serialization::load_t_from_json(resp, pri->m_body);
+      if (!loaded || resp.status == 0)
+        return delivery_result::rejected;
+      return delivery_result::ok;
+    }
+
+    void run()
+    {
+      std::vector<request> batch;
+      batch.reserve(MAX_BATCH_SIZE);
+      std::string base_uri;
+      unsigned failures = 0;
+
+      for (;;)
+      {
+        {
+          boost::unique_lock<boost::mutex> lock(m_queue_lock);
+          while (!m_stop && m_queue.empty())
+            m_queue_cond.wait(lock);
+          if (m_stop)
+            break;
+
+          if (m_endpoint_changed)
+          {
+            m_client.set_server(m_http_host, std::to_string(m_http_port), {});
+            m_endpoint_changed = false;
+            failures = 0;
+          }
+          base_uri = m_uri;
+
+          while (!m_queue.empty() && batch.size() < MAX_BATCH_SIZE)
+          {
+            batch.emplace_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+          }
+        }
+
+        // feeds with an undelivered request in this batch, their deltas are skipped until the next full state
+        bool skip_deltas[feed_list + 1] = {};
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+          if (batch[i].feed != feed_none)
+          {
+            if (!batch[i].delta)
+            {
+              skip_deltas[batch[i].feed] = false;
+            }
+            else if (skip_deltas[batch[i].feed])
+            {
+              ++m_dropped;
+              continue;
+            }
+          }
+
+          const std::string full_uri = base_uri + batch[i].endpoint;
+          delivery_result result = delivery_result::transport_error;
+          for (unsigned attempt = 0; attempt < MAX_ATTEMPTS && result == delivery_result::transport_error && !m_stop; ++attempt)
+            result = deliver(full_uri, batch[i]);
+
+          if (result == delivery_result::ok)
+          {
+            ++m_delivered;
+            if (batch[i].enqueued != std::chrono::steady_clock::time_point())
+              m_delivery_us.observe(rta_metrics::get_elapsed_us(batch[i].enqueued));
+            failures = 0;
+            continue;
+          }
+
+          ++m_failed;
+          skip_deltas[batch[i].feed] = true;
+          if (result == delivery_result::transport_error && ++failures >= MAX_FAILURES)
+          {
+            // supernode looks dead, don't spend the rest of the batch on connect timeouts,
+            // the queue drops the oldest requests while delivery is paused
+            MWARNING("Supernode " << full_uri << " is not available, pausing delivery for " << FAILURE_PAUSE_MILLIS << " ms");
+            boost::unique_lock<boost::mutex> lock(m_queue_lock);
+            m_dropped += batch.size() - i - 1;
+            for (size_t j = i; j < batch.size(); ++j)
+              discard_feed_deltas(batch[j].feed);
+            m_queue_cond.wait_for(lock, boost::chrono::milliseconds(uint64_t(FAILURE_PAUSE_MILLIS)), [this]() { return m_stop.load(); });
+            failures = 0;
+            break;
+          }
+          if (!has_full_state(batch, i + 1, batch[i].feed))
+          {
+            boost::lock_guard<boost::mutex> guard(m_queue_lock);
+            discard_feed_deltas(batch[i].feed);
+          }
+        }
+        batch.clear();
+      }
+      m_client.disconnect();
+    }
+
+    const std::string m_public_id;
+    std::string m_http_host;
+    uint64_t m_http_port;
+    std::string m_uri;
+    epee::net_utils::http::http_simple_client m_client;
+    mutable boost::mutex m_queue_lock;
+    boost::condition_variable m_queue_cond;
+    std::deque<request> m_queue;
+    bool m_endpoint_changed = false;
+    bool m_supports_delta = false;
+    bool m_supports_announce_batches = false;
+    std::atomic<uint64_t> m_stakes_version {0};
+    std::atomic<uint64_t> m_list_version {0};
+    bool m_feed_discarded[feed_list + 1] = {}; // deltas of the feed are discarded until its next full state
+    std::atomic<bool> m_stop {false};
+    std::atomic<uint64_t> m_delivered {0};
+    std::atomic<uint64_t> m_failed {0};
+    std::atomic<uint64_t> m_dropped {0};
+    rta_metrics::histogram m_delivery_us;
+    boost::thread m_worker;
+  };
+}
@@ -45,6 +45,14 @@
 #include "net_peerlist.h"
 #include "math_helper.h"
 #include "net_node_common.h"
+#include "local_supernode.h"
+#include "supernode_state_feed.h"
+#include "rta_event_stream.h"
+#include "rta_metrics.h"
+#include "supernode_route_table.h"
+#include "request_id_cache.h"
+#include "supernode_announce_batch.h"
+#include "rta_message.h"
 #include "common/command_line.h"
 #include "net/jsonrpc_structs.h"
 #include "storages/http_abstract_invoke.h"
@@ -72,27 +80,6 @@ namespace nodetool
     bool m_in_timedsync;
   };
 
-  struct local_supernode {
-    local_supernode(std::string host, uint64_t port, std::string uri) : http_host(std::move(host)), http_port(port), uri(std::move(uri)) {
-        client.set_server(http_host, std::to_string(http_port), {});
-    }
-
-    void update(const std::string &new_host, uint64_t new_port, const std::string &new_uri) {
-        if (new_host != http_host || new_port != http_port) {
-            if (client.is_connected()) client.disconnect();
-            client.set_server(new_host, std::to_string(new_port), {});
-            http_host = new_host;
-            http_port = new_port;
-            uri = new_uri;
-        }
-    }
-
-    std::string http_host;
-    uint64_t http_port;
-    std::string uri;
-    epee::net_utils::http::http_simple_client client;
-  };
-
   template<class t_payload_net_handler>
   class node_server: public epee::levin::levin_commands_handler<p2p_connection_context_t<typename t_payload_net_handler::connection_context> >,
                      public i_p2p_endpoint<typename t_payload_net_handler::connection_context>,
@@ -201,6 +188,7 @@ namespace nodetool
       HANDLE_NOTIFY_T2(COMMAND_BROADCAST, &node_server::handle_broadcast)
       HANDLE_NOTIFY_T2(COMMAND_MULTICAST, &node_server::handle_multicast)
       HANDLE_NOTIFY_T2(COMMAND_UNICAST, &node_server::handle_unicast)
+      HANDLE_NOTIFY_RAW2(COMMAND_RTA_MESSAGE, &node_server::handle_rta_message)
 
       HANDLE_INVOKE_T2(COMMAND_HANDSHAKE, &node_server::handle_handshake)
       HANDLE_INVOKE_T2(COMMAND_TIMED_SYNC, &node_server::handle_timed_sync)
@@ -217,57 +205,81 @@ namespace nodetool
     enum PeerType { anchor = 0, white, gray };
 
     //----------------- helper functions ------------------------------------------------
-    bool multicast_send(int command, const std::string &data, const std::list<std::string> &addresses,
+    /*!
+     * \brief rta_blob_builder - serializes RTA message, leaves the blob empty if the message can't be serialized in the form
+     */
+    typedef std::function<void(std::string &blob)> rta_blob_builder;
+
+    /*!
+     * \brief rta_connection - connection to relay RTA message to
+     */
+    struct rta_connection
+    {
+      boost::uuids::uuid id;
+      peerid_type peer_id;
+      bool binary; // peer accepts COMMAND_RTA_MESSAGE
+    };
+
+    /*!
+     * \brief relay_rta_message - sends RTA message in binary framing to the connections which support it and as
+     *                            legacy command to the others; each form is serialized once and only if it is needed
+     * \return                   - number of bytes sent
+     */
+    uint64_t relay_rta_message(int command, const rta_blob_builder &make_blob, const rta_blob_builder &make_binary_blob,
+                               const std::vector<rta_connection> &connections);
+    std::vector<rta_connection> get_rta_connections(const boost::uuids::uuid *exclude_connection_id = nullptr);
+    bool multicast_send(int command, const rta_blob_builder &make_blob, const rta_blob_builder &make_binary_blob,
+                        const std::list<std::string> &addresses,
                         const std::list<peerid_type> &exclude_peerids = std::list<peerid_type>());
     uint64_t get_max_hop(const std::list<std::string> &addresses);
     std::list<std::string> get_routes();
 
-    // sometimes supernode gets very busy so it doesn't respond within 1 second, increasing timeout to 3s
-    static constexpr size_t SUPERNODE_HTTP_TIMEOUT_MILLIS = 3 * 1000;
+    /*!
+     * \brief post_request_to_supernode - hands the request over to the supernode event stream subscription or
+     *                                    to the local_supernode delivery queue, caller must hold m_supernode_lock
+     * \return                          - 1 if the request has been queued (not delivered, delivery is asynchronous
+     *                                    and may still fail or be dropped on queue overflow), 0 otherwise
+     */
     template<class request_struct>
     int post_request_to_supernode(local_supernode &supernode, const std::string &method, const typename request_struct::request &body,
                                   const std::string &endpoint = std::string())
     {
-        boost::value_initialized<epee::json_rpc::request<typename request_struct::request> > init_req;
-        epee::json_rpc::request<typename request_struct::request>& req = static_cast<epee::json_rpc::request<typename request_struct::request> &>(init_req);
-        req.jsonrpc = "2.0";
-        req.id = 0;
-        req.method = method;
-        req.params = body;
-
-        std::string uri = "/" + method;
-        if (!endpoint.empty())
-        {
-            uri = endpoint;
-        }
-        typename request_struct::response resp = AUTO_VAL_INIT(resp);
-        bool r = epee::net_utils::invoke_http_json(supernode.uri + uri,
-                                                   req, resp, supernode.client,
-                                                   std::chrono::milliseconds(size_t(SUPERNODE_HTTP_TIMEOUT_MILLIS)), "POST");
-        if (!r || resp.status == 0)
+        rta_metrics::timer post_timer(m_rta_metrics.get_supernode_post_us());
+        if (m_rta_events.is_subscribed(supernode.get_public_id(), rta_event_stream::topic_message))
         {
-            return 0;
+            // supernode gets messages from the event stream
+            std::string json;
+            if (!local_supernode::serialize<request_struct>(method, body, json))
+                return 0;
+            m_rta_events.publish(rta_event_stream::topic_message, std::move(json), endpoint.empty() ? "/" + method : endpoint,
+                                 supernode.get_public_id());
+            return 1;
         }
-        return 1;
+        // delivery is asynchronous, local_supernode worker thread sends the request
+        return supernode.post<request_struct>(method, body, endpoint) ? 1 : 0;
     }
 
+    /*!
+     * \brief post_request_to_supernodes - queues the request for all local supernodes, caller must hold m_supernode_lock
+     * \return                           - number of supernodes the request has been queued for
+     */
     template<class request_struct>
     int post_request_to_supernodes(const std::string &method, const typename request_struct::request &body,
                                    const std::string &endpoint = std::string())
     {
         int ret = 0;
         for (auto &supernode : m_supernodes)
-            ret += post_request_to_supernode<request_struct>(supernode.second, method, body, endpoint);
+            ret += post_request_to_supernode<request_struct>(*supernode.second, method, body, endpoint);
         return ret;
     }
 
-    void remove_old_request_cache();
 
     //----------------- commands handlers ----------------------------------------------
     int handle_supernode_announce(int command, typename COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context);
     int handle_broadcast(int command, typename COMMAND_BROADCAST::request &arg, p2p_connection_context &context);
     int handle_multicast(int command, typename COMMAND_MULTICAST::request &arg, p2p_connection_context &context);
     int handle_unicast(int command, typename COMMAND_UNICAST::request &arg, p2p_connection_context &context);
+    int handle_rta_message(int command, const std::string &buffer, p2p_connection_context &context);
     int handle_handshake(int command, typename COMMAND_HANDSHAKE::request& arg, typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context);
     int handle_timed_sync(int command, typename COMMAND_TIMED_SYNC::request& arg, typename COMMAND_TIMED_SYNC::response& rsp, p2p_connection_context& context);
     int handle_ping(int command, COMMAND_PING::request& arg, COMMAND_PING::response& rsp, p2p_connection_context& context);
@@ -313,6 +325,7 @@ namespace nodetool
         const boost::program_options::variables_map& vm
       );
     bool idle_worker();
+    bool process_supernode_announces();
     bool handle_remote_peerlist(const std::list<peerlist_entry>& peerlist, time_t local_time, const epee::net_utils::connection_context_base& context);
     bool get_local_node_data(basic_node_data& node_data);
     // bool get_local_handshake_data(handshake_data& hshd);
@@ -407,22 +420,25 @@ namespace nodetool
     {
         epee::net_utils::http::url_content parsed{};
         bool ret = epee::net_utils::parse_url(url, parsed);
-        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+        // removed supernode is destroyed after unlocking, its destructor joins the delivery thread
+        std::unique_ptr<local_supernode> removed;
+        supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
         auto it = m_supernodes.find(addr);
         if (!ret) {
-            if (it != m_supernodes.end()) m_supernodes.erase(it);
+            if (it != m_supernodes.end()) {
+                removed = std::move(it->second);
+                m_supernodes.erase(it);
+            }
         } else if (it == m_supernodes.end()) {
             LOG_PRINT_L0("Adding supernode " << addr << " at " << parsed.host << ":" << parsed.port);
-            m_supernodes.emplace(std::piecewise_construct,
-                    std::forward_as_tuple(addr),
-                    std::forward_as_tuple(std::move(parsed.host), parsed.port, std::move(parsed.uri)));
+            m_supernodes.emplace(addr, std::unique_ptr<local_supernode>(new local_supernode(addr, std::move(parsed.host), parsed.port, std::move(parsed.uri))));
         } else {
-            it->second.update(parsed.host, parsed.port, parsed.uri);
+            it->second->update(parsed.host, parsed.port, parsed.uri);
         }
     }
 
     std::vector<std::string> get_supernodes_addresses() {
-        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+        supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
         std::vector<std::string> addrs;
         addrs.reserve(m_supernodes.size());
         for (auto &sn : m_supernodes) {
@@ -442,14 +458,50 @@ namespace nodetool
         return s.str();
     }
 
+    /*!
+     * \brief request_supernode_full_state - sets supernode delta support and makes the next update send it the full state
+     */
+    void request_supernode_full_state(const std::string &addr, bool binary_delta, bool stakes, bool list) {
+        supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+        auto it = m_supernodes.find(addr);
+        if (it == m_supernodes.end())
+            return;
+        it->second->set_supports_delta(binary_delta);
+        if (stakes)
+            it->second->set_stakes_version(0);
+        if (list)
+            it->second->set_list_version(0);
+    }
+
+    void set_supernode_announce_batches(const std::string &addr, bool batch_announces) {
+        supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+        auto it = m_supernodes.find(addr);
+        if (it != m_supernodes.end())
+            it->second->set_supports_announce_batches(batch_announces);
+    }
+
     bool remove_supernode(const std::string &addr) {
-        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-        return m_supernodes.erase(addr);
+        std::unique_ptr<local_supernode> removed;
+        {
+            supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+            auto it = m_supernodes.find(addr);
+            if (it == m_supernodes.end())
+                return false;
+            removed = std::move(it->second);
+            m_supernodes.erase(it);
+        }
+        // joins the delivery thread, which can take up to MAX_ATTEMPTS http timeouts, so it is done without the lock
+        removed.reset();
+        return true;
     }
 
     void reset_supernodes() {
-        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-        m_supernodes.clear();
+        std::unordered_map<std::string, std::unique_ptr<local_supernode>> removed;
+        {
+            supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+            removed.swap(m_supernodes);
+        }
+        removed.clear();
     }
 
     bool notify_peer_list(int command, const std::string& buf, const std::vector<peerlist_entry>& peers_to_send, bool try_connect = false);
@@ -457,6 +509,13 @@ namespace nodetool
     void send_stakes_to_supernode();
     void send_blockchain_based_list_to_supernode(uint64_t last_received_block_height);
 
+    rta_event_stream &get_rta_event_stream() { return m_rta_events; }
+
+    /*!
+     * \brief get_rta_metrics - fills RTA path metrics, the first call enables recording of latencies and lock waits
+     */
+    void get_rta_metrics(cryptonote::COMMAND_RPC_RTA_METRICS::response &res);
+
     uint64_t get_announce_bytes_in() const { return m_announce_bytes_in; }
     uint64_t get_announce_bytes_out() const { return m_announce_bytes_out; }
     uint64_t get_broadcast_bytes_in() const { return m_broadcast_bytes_in; }
@@ -467,14 +526,25 @@ namespace nodetool
   private:
     void handle_stakes_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes);
     void handle_blockchain_based_list_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers);
+    typedef rta_metrics::timed_lock_guard<boost::recursive_mutex> supernode_lock_guard;
+
+    static rta_metrics::message_type get_rta_metrics_type(int command);
+    std::vector<supernode_state_feed::supernode_state> get_supernode_feed_states(bool list);
+    void post_supernode_feed_update(const supernode_state_feed::update &update, bool list);
 
   private:
-    std::multimap<int, std::string> m_supernode_requests_timestamps;
-    std::set<std::string> m_supernode_requests_cache;
-    std::map<std::string, nodetool::supernode_route> m_supernode_routes;
-    std::unordered_map<std::string, local_supernode> m_supernodes;
+    request_id_cache m_supernode_requests_cache;
+    supernode_route_table m_supernode_routes;
+    supernode_announce_batch m_supernode_announces;
+    std::unordered_map<std::string, std::unique_ptr<local_supernode>> m_supernodes;
     boost::recursive_mutex m_supernode_lock;
-    boost::recursive_mutex m_request_cache_lock;
+    supernode_state_feed m_supernode_feed;
+    boost::mutex m_supernode_feed_lock; //serializes stakes and blockchain based list updates
+    rta_event_stream m_rta_events;
+    rta_metrics m_rta_metrics;
+    uint64_t m_rta_events_stakes_version = 0; //feed versions known by the event stream subscribers
+    uint64_t m_rta_events_list_version = 0;
+    uint64_t m_rta_events_block_height = 0;
     std::vector<epee::net_utils::network_address> m_custom_seed_nodes;
 
     std::string m_config_folder;
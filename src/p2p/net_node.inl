@@ -68,8 +68,8 @@
 #define MIN_WANTED_SEED_NODES 12
 
 #define MAX_TUNNEL_PEERS (3u)
-#define REQUEST_CACHE_TIME 2 * 60 * 1000
 #define HOP_RETRIES_MULTIPLIER 2
+#define SUPERNODE_ANNOUNCES_PROCESSING_PERIOD_MS 250
 
 namespace nodetool
 {
@@ -102,6 +102,7 @@ namespace nodetool
     const command_line::arg_descriptor<int64_t> arg_limit_rate = {"limit-rate", "set limit-rate [kB/s]", -1};
 
     const command_line::arg_descriptor<bool> arg_save_graph = {"save-graph", "Save data for dr monero", false};
+    const command_line::arg_descriptor<bool> arg_check_supernode_announce_signatures = {"check-supernode-announce-signatures", "Drop supernode announces not signed by the supernode id key", false};
     const command_line::arg_descriptor<Uuid> arg_p2p_net_id = {"net-id", "The way to replace hardcoded NETWORK_ID. Effective only with --testnet, ex.: 'net-id = 54686520-4172-7420-6f77-205761722037'"};
 
     // helper struct used to notify peers by uuid
@@ -166,6 +167,7 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate);
     command_line::add_arg(desc, arg_save_graph);
     command_line::add_arg(desc, arg_p2p_net_id);
+    command_line::add_arg(desc, arg_check_supernode_announce_signatures);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -348,6 +350,7 @@ namespace nodetool
     m_allow_local_ip = command_line::get_arg(vm, arg_p2p_allow_local_ip);
     m_no_igd = command_line::get_arg(vm, arg_no_igd);
     m_offline = command_line::get_arg(vm, cryptonote::arg_offline);
+    m_supernode_announces.set_check_signatures(command_line::get_arg(vm, arg_check_supernode_announce_signatures));
 
     if (command_line::has_arg(vm, arg_p2p_add_peer))
     {
@@ -554,6 +557,25 @@ namespace nodetool
       [&](uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers) { handle_blockchain_based_list_update(block_height, tiers); }
     );
 
+    m_rta_events.set_full_state_request_handler([this](unsigned topics) {
+      {
+        boost::lock_guard<boost::mutex> feed_guard(m_supernode_feed_lock);
+        if (topics & rta_event_stream::topic_stakes)
+          m_rta_events_stakes_version = 0;
+        if (topics & rta_event_stream::topic_tiers)
+          m_rta_events_list_version = 0;
+      }
+      if (topics & rta_event_stream::topic_stakes)
+        send_stakes_to_supernode();
+      if (topics & rta_event_stream::topic_tiers)
+        send_blockchain_based_list_to_supernode(m_payload_handler.get_core().get_current_blockchain_height() - 1);
+    });
+
+    m_rta_events.set_supernode_check_handler([this](const std::string &supernode_public_id) -> bool {
+      supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+      return m_supernodes.count(supernode_public_id) != 0;
+    });
+
     std::set<std::string> full_addrs;
 
     bool res = handle_command_line(vm);
@@ -761,6 +783,7 @@ namespace nodetool
 
     m_net_server.add_idle_handler(boost::bind(&node_server<t_payload_net_handler>::idle_worker, this), 1000);
     m_net_server.add_idle_handler(boost::bind(&t_payload_net_handler::on_idle, &m_payload_handler), 1000);
+    m_net_server.add_idle_handler(boost::bind(&node_server<t_payload_net_handler>::process_supernode_announces, this), SUPERNODE_ANNOUNCES_PROCESSING_PERIOD_MS);
 
     boost::thread::attributes attrs;
     attrs.set_stack_size(THREAD_STACK_SIZE);
@@ -787,6 +810,8 @@ namespace nodetool
   bool node_server<t_payload_net_handler>::deinit()
   {
     kill();
+    // stops delivery workers of local supernodes
+    reset_supernodes();
     m_peerlist.deinit();
     m_net_server.deinit_server();
     // remove UPnP port mapping
@@ -885,133 +910,129 @@ namespace nodetool
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::multicast_send(int command, const std::string &data, const std::list<std::string> &addresses, const std::list<peerid_type> &exclude_peerids)
+  bool node_server<t_payload_net_handler>::multicast_send(int command, const rta_blob_builder &make_blob, const rta_blob_builder &make_binary_blob,
+                                                          const std::list<std::string> &addresses, const std::list<peerid_type> &exclude_peerids)
   {
       MDEBUG("P2P Request: multicast_send: Start tunneling for addresses: "
                    << boost::algorithm::join(addresses, ", "));
-      std::vector<peerlist_entry> tunnels;
+
+      // connected peers are collected once instead of looking for a connection per tunnel
+      std::unordered_map<peerid_type, rta_connection> connections;
+      for (const rta_connection &c : get_rta_connections())
+          connections.emplace(c.peer_id, c);
+
+      std::unordered_set<peerid_type> used_peerids(exclude_peerids.begin(), exclude_peerids.end());
+      std::vector<rta_connection> tunnels;
+      for (const std::string &addr : addresses)
       {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
+          MDEBUG("P2P Request: multicast_send: looking for tunnel for " << addr);
+          supernode_route_table::route_ptr route = m_supernode_routes.find(addr);
+          if (!route)
           {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto addr : addresses)
-          {
-              MDEBUG("P2P Request: multicast_send: looking for tunnel for " << addr);
-              auto it = local_supernode_routes.find(addr);
-              if (it == local_supernode_routes.end())
-              {
-                  MWARNING("no tunnel found for address: " << addr);
-                  continue;
-              }
-              // peers for address
-              std::vector<peerlist_entry> addr_tunnels = (*it).second.peers;
-              unsigned int count = 0;
-              for (auto peer_it = addr_tunnels.begin(); peer_it != addr_tunnels.end(); ++peer_it)
-              {
-                  peerlist_entry addr_tunnel = *peer_it;
-
-
-                  // check if peer connected connections
-                  boost::uuids::uuid dummy;
-                  if (!find_connection_id_by_peer(addr_tunnel, dummy))
-                    continue;
-
-                  // don't allow duplicate entries
-                  auto tunnel_it = std::find_if(tunnels.begin(), tunnels.end(),
-                                                [addr_tunnel](const peerlist_entry &entry) -> bool {
-                      return entry.id == addr_tunnel.id;
-                  });
-                  // check if our peer is in excluded peers
-                  auto exclude_it = std::find(exclude_peerids.begin(), exclude_peerids.end(),
-                                              addr_tunnel.id);
-                  if (tunnel_it == tunnels.end() && exclude_it == exclude_peerids.end())
-                  {
-                      MDEBUG("found tunnel for address: " << addr << ":  " << addr_tunnel.adr.str());
-                      tunnels.push_back(addr_tunnel);
-                      count++;
-                  }
-                  if (count >= MAX_TUNNEL_PEERS)
-                  {
-                      break;
-                  }
-              }
+              MWARNING("no tunnel found for address: " << addr);
+              continue;
           }
+          supernode_route_table::select_peers(*route, MAX_TUNNEL_PEERS, [&](const peerlist_entry &addr_tunnel) -> bool {
+              // check if peer connected connections
+              auto conn_it = connections.find(addr_tunnel.id);
+              if (conn_it == connections.end())
+                return false;
+
+              // don't allow duplicate entries and excluded peers
+              if (!used_peerids.insert(addr_tunnel.id).second)
+                return false;
+
+              MDEBUG("found tunnel for address: " << addr << ":  " << addr_tunnel.adr.str());
+              tunnels.push_back(conn_it->second);
+              return true;
+          });
       }
       MDEBUG("P2P Request: multicast_send: End tunneling, tunnels found: " << tunnels.size());
-      m_multicast_bytes_out += data.size() * tunnels.size();
-
-      return notify_peer_list(command, data, tunnels);
+      m_multicast_bytes_out += relay_rta_message(command, make_blob, make_binary_blob, tunnels);
+      return true;
   }
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  uint64_t node_server<t_payload_net_handler>::get_max_hop(const std::list<std::string> &addresses)
+  uint64_t node_server<t_payload_net_handler>::relay_rta_message(int command, const rta_blob_builder &make_blob, const rta_blob_builder &make_binary_blob,
+                                                                 const std::vector<rta_connection> &connections)
   {
-      uint64_t max_hop = 0;
+      std::string blob, binary_blob;
+      bool binary = false;
+      if (std::any_of(connections.begin(), connections.end(), [](const rta_connection &c) { return c.binary; }))
       {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
+          make_binary_blob(binary_blob);
+          binary = !binary_blob.empty();
+      }
+      if (!binary || std::any_of(connections.begin(), connections.end(), [](const rta_connection &c) { return !c.binary; }))
+          make_blob(blob);
+
+      uint64_t bytes_sent = 0, peers_sent = 0;
+      for (const rta_connection &c : connections)
+      {
+          const bool send_binary = binary && c.binary;
+          const std::string &data = send_binary ? binary_blob : blob;
+          if (relay_notify(send_binary ? COMMAND_RTA_MESSAGE::ID : command, data, c.id))
           {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto addr : addresses)
-          {
-              auto it = local_supernode_routes.find(addr);
-              if (it != local_supernode_routes.end() && max_hop < (*it).second.max_hop)
-              {
-                  max_hop = (*it).second.max_hop;
-              }
+              bytes_sent += data.size();
+              ++peers_sent;
           }
+          else
+              MWARNING("P2P Request: relay_rta_message: sending to " << c.id << " FAILED");
       }
-      return max_hop;
+      const rta_metrics::message_type type = get_rta_metrics_type(command);
+      if (type != rta_metrics::message_types_count)
+          m_rta_metrics.record_relay(type, peers_sent);
+      return bytes_sent;
   }
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  std::list<std::string> node_server<t_payload_net_handler>::get_routes()
+  std::vector<typename node_server<t_payload_net_handler>::rta_connection> node_server<t_payload_net_handler>::get_rta_connections(const boost::uuids::uuid *exclude_connection_id)
   {
-      std::list<std::string> routes;
-      {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
-          {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto it = local_supernode_routes.begin(); it != local_supernode_routes.end(); ++it)
-          {
-              routes.push_back((*it).first);
-          }
-      }
-      return routes;
+      const bool binary_enabled = (m_config.m_support_flags & P2P_SUPPORT_FLAG_RTA_BINARY) != 0;
+      std::vector<rta_connection> connections;
+      m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt) {
+          if (cntxt.peer_id == 0 || (exclude_connection_id && cntxt.m_connection_id == *exclude_connection_id))
+              return true;
+          connections.push_back({cntxt.m_connection_id, cntxt.peer_id, binary_enabled && (cntxt.support_flags & P2P_SUPPORT_FLAG_RTA_BINARY) != 0});
+          return true;
+      });
+      return connections;
   }
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  void node_server<t_payload_net_handler>::remove_old_request_cache()
+  rta_metrics::message_type node_server<t_payload_net_handler>::get_rta_metrics_type(int command)
   {
-      int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-      for (auto it = m_supernode_requests_timestamps.begin(); it != m_supernode_requests_timestamps.end();)
+      switch (command)
       {
-          if ((*it).first + REQUEST_CACHE_TIME < timestamp)
-          {
-              m_supernode_requests_cache.erase((*it).second);
-              it = m_supernode_requests_timestamps.erase(it);
-          }
-          else
-          {
-              break;
-          }
+      case COMMAND_SUPERNODE_ANNOUNCE::ID: return rta_metrics::announce;
+      case COMMAND_BROADCAST::ID: return rta_metrics::broadcast;
+      case COMMAND_MULTICAST::ID: return rta_metrics::multicast;
+      case COMMAND_UNICAST::ID: return rta_metrics::unicast;
+      default: return rta_metrics::message_types_count;
       }
   }
 
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  uint64_t node_server<t_payload_net_handler>::get_max_hop(const std::list<std::string> &addresses)
+  {
+      return m_supernode_routes.max_hop(addresses);
+  }
+
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  std::list<std::string> node_server<t_payload_net_handler>::get_routes()
+  {
+      std::list<std::string> routes;
+      m_supernode_routes.for_each([&routes](const std::string &addr, const supernode_route &) {
+          routes.push_back(addr);
+      });
+      return routes;
+  }
+
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   int node_server<t_payload_net_handler>::handle_supernode_announce(int command, COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context)
@@ -1028,137 +1049,165 @@ namespace nodetool
 #ifdef LOCK_RTA_SENDING
     return 1;
 #endif
-      static std::string supernode_endpoint("send_supernode_announce");
-      std::string supernode_str = arg.supernode_public_id;
+      rta_metrics::message_metrics &metrics = m_rta_metrics.get(rta_metrics::announce);
+      ++metrics.received;
+      rta_metrics::timer handling_timer(metrics.handling_us);
+
+      const std::string &supernode_str = arg.supernode_public_id;
 
       bool is_local;
       {
-          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
           is_local = m_supernodes.count(supernode_str) > 0;
       }
-      if (!is_local) {
-          MDEBUG("P2P Request: handle_supernode_announce: update tunnels for " << arg.supernode_public_id << " Hop: " << arg.hop << " Address: " << arg.network_address);
+      if (is_local) {
+          m_supernode_announces.add(arg, nullptr);
+          return 1;
+      }
 
-          peerlist_entry pe;
-          // TODO: Need to investigate it and mechanism for adding peer to the peerlist
-          if (!m_peerlist.find_peer(context.peer_id, pe))
-          { // unknown peer, alternative handshake with it
-              MDEBUG("unknown peer, alternative handshake with it " << context.peer_id);
-              return 1;
-          }
+      MDEBUG("P2P Request: handle_supernode_announce: update tunnels for " << arg.supernode_public_id << " Hop: " << arg.hop << " Address: " << arg.network_address);
+
+      peerlist_entry pe;
+      // TODO: Need to investigate it and mechanism for adding peer to the peerlist
+      if (!m_peerlist.find_peer(context.peer_id, pe))
+      { // unknown peer, alternative handshake with it
+          MDEBUG("unknown peer, alternative handshake with it " << context.peer_id);
+          return 1;
+      }
+
+      // announce which has been already processed only adds the peer to the route, no need to queue it
+      const time_t now = time(nullptr);
+      bool existing_announce = false;
+      m_supernode_routes.update(supernode_str, [&](const supernode_route *route) -> supernode_route_table::route_ptr {
+          if (!route || !supernode_route_table::is_actual(*route, arg.height, now))
+              return nullptr;
+          MDEBUG("existing announce, height: " << arg.height << ", last_announce_time: " << route->last_announce_time
+                 << ", current time: " << now);
+          existing_announce = true;
+          return supernode_route_table::add_route_peers(*route, arg.hop, std::vector<peerlist_entry>(1, pe));
+      });
+
+      if (existing_announce)
+      {
+          ++metrics.duplicates;
+      }
+      else if (!m_supernode_announces.add(arg, &pe))
+      {
+          ++metrics.duplicates;
+          MDEBUG("P2P Request: handle_supernode_announce: announce is stale or already queued");
+      }
+
+      MDEBUG("P2P Request: handle_supernode_announce: end");
+      return 1;
+  }
+
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::process_supernode_announces()
+  {
+      if (m_supernode_announces.size() == 0)
+          return true;
+
+      static std::string supernode_endpoint("send_supernode_announce");
+      static std::string supernode_batch_endpoint("send_supernode_announces");
+      std::vector<supernode_announce_batch::entry> announces = m_supernode_announces.take();
+      MDEBUG("P2P Request: process_supernode_announces: start, announces: " << announces.size());
+
+      // update routes; announces which have been processed concurrently with the batch are skipped
+      const time_t now = time(nullptr);
+      std::vector<const supernode_announce_batch::entry*> new_announces;
+      new_announces.reserve(announces.size());
+      for (const supernode_announce_batch::entry &e : announces)
+      {
+          if (!e.valid)
           {
-              MDEBUG("P2P Request: handle_supernode_announce: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-              MDEBUG("P2P Request: handle_supernode_announce: unlock");
-              remove_old_request_cache();
+              MWARNING("P2P Request: process_supernode_announces: invalid announce from " << e.announce.supernode_public_id);
+              continue;
           }
-          MDEBUG("P2P Request: handle_supernode_announce: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-          MDEBUG("P2P Request: handle_supernode_announce: unlock");
-
-          MDEBUG("P2P Request: handle_supernode_announce: routes number - " << m_supernode_routes.size());
-          for (auto it2 = m_supernode_routes.begin(); it2 != m_supernode_routes.end(); ++it2)
+          if (e.local)
           {
-              MDEBUG("P2P Request: handle_supernode_announce: " << (*it2).first << " " << (*it2).second.peers.size());
+              new_announces.push_back(&e);
+              continue;
           }
 
+          bool existing_announce = false;
+          m_supernode_routes.update(e.announce.supernode_public_id, [&](const supernode_route *route) -> supernode_route_table::route_ptr {
+              return supernode_route_table::make_announced_route(route, e.announce.height, e.announce.hop, e.peers, now, existing_announce);
+          });
+          if (!existing_announce)
+              new_announces.push_back(&e);
+      }
+      MDEBUG("P2P Request: process_supernode_announces: routes number - " << m_supernode_routes.size());
 
-          auto it = m_supernode_routes.find(supernode_str);
-          if (it == m_supernode_routes.end())
-          {
-              std::vector<peerlist_entry> peer_vec;
-              peer_vec.push_back(pe);
-              nodetool::supernode_route route;
-              route.last_announce_height = arg.height;
-              route.last_announce_time = time(nullptr);
-              route.max_hop = arg.hop;
-              route.peers = peer_vec;
-              m_supernode_routes[supernode_str] = route;
-          }
-          else {
-              auto &route = it->second;
-#if 0
-              // this check is not correct in case stake transactions if older tx has greater lock time than newer one
-              if (route.last_announce_height > arg.height)
-              {
-                  MINFO("SUPERNODE_ANNOUNCE from " << context.peer_id
-                        << " too old, corrent route height " << (*it).second.last_announce_height);
-                  return 1;
-              }
-#endif
+      if (new_announces.empty())
+          return true;
 
-              if (route.last_announce_height == arg.height && route.last_announce_time + DIFFICULTY_TARGET_V2 > (unsigned)time(nullptr))
+      {
+          LOG_PRINT_L3("P2P Request: process_supernode_announces: lock");
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+          LOG_PRINT_L3("P2P Request: process_supernode_announces: unlock");
+          for (auto &sn : m_supernodes)
+          {
+              if (!sn.second->supports_announce_batches())
               {
-                  MDEBUG("existing announce, height: " << arg.height << ", last_announce_time: " << (*it).second.last_announce_time
-                         << ", current time: " << time(nullptr));
-                  auto peer_it = std::find_if(route.peers.begin(), route.peers.end(),
-                                              [pe](const peerlist_entry &p) -> bool { return pe.id == p.id; });
-                  if (peer_it == route.peers.end())
+                  for (const supernode_announce_batch::entry *e : new_announces)
                   {
-                      route.peers.push_back(pe);
-                      if (route.max_hop < arg.hop)
-                      {
-                          route.max_hop = arg.hop;
-                      }
+                      if (sn.first != e->announce.supernode_public_id)
+                          post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>(*sn.second, supernode_endpoint, e->announce);
                   }
-                  return 1;
+                  continue;
               }
-              route.peers.clear();
-              route.peers.push_back(pe);
-              route.last_announce_height = arg.height;
-              route.last_announce_time = time(nullptr);
-              route.max_hop = arg.hop;
+
+              // one request per supernode with all announces of the flush but its own
+              cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES::request req;
+              if (!supernode_announce_batch::make_supernode_request(new_announces, sn.first, req))
+                  continue;
+              LOG_PRINT_L1("P2P Request: process_supernode_announces: post " << req.announces.size() << " announce(s) to supernode " << sn.first);
+              post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES>(*sn.second, supernode_batch_endpoint, req);
           }
       }
 
-      std::list<std::reference_wrapper<local_supernode>> post_to_sn;
+      // Notify neighbours about new ANNOUNCEs
+      std::list<boost::uuids::uuid> all_connections;
+      m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
       {
-          LOG_PRINT_L3("P2P Request: handle_supernode_announce: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-          LOG_PRINT_L3("P2P Request: handle_supernode_announce: unlock");
-          for (auto &sn : m_supernodes) {
-              if (sn.first != supernode_str)
-                  post_to_sn.push_back(std::ref(sn.second));
-          }
-      }
-      for (auto &sn : post_to_sn) {
-          LOG_PRINT_L1("P2P Request: handle_supernode_announce: post to supernode");
-          post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>(sn, supernode_endpoint, arg);
+        // skip ourself connections
+        if(cntxt.peer_id == m_config.m_peer_id)
+          return true;
+        all_connections.push_back(cntxt.m_connection_id);
+        return true;
+      });
+
+      if (all_connections.empty()) {
+        MWARNING("P2P Request: no connections to relay announces");
+        return true;
       }
 
-      if (!is_local) {
-          // Notify neighbours about new ANNOUNCE
+      const double relay_probability = 1.0 / all_connections.size();
+      std::string arg_buff;
+      std::list<boost::uuids::uuid> random_connections;
+      for (const supernode_announce_batch::entry *e : new_announces)
+      {
+          if (e->local)
+              continue;
+          COMMAND_SUPERNODE_ANNOUNCE::request arg = e->announce;
           arg.hop++;
-          MDEBUG("P2P Request: handle_supernode_announce: notify peers " << arg.hop);
-
-          std::list<boost::uuids::uuid> all_connections, random_connections;
-          m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
-          {
-            // skip ourself connections
-            if(cntxt.peer_id == m_config.m_peer_id)
-              return true;
-            all_connections.push_back(cntxt.m_connection_id);
-            return true;
-          });
 
-          if (all_connections.empty()) {
-            MWARNING("P2P Request: no connections to relay announce");
-            return 1;
-          }
+          random_connections.clear();
+          select_subset_with_probability(relay_probability, all_connections, random_connections);
 
-          select_subset_with_probability(1.0 / all_connections.size(), all_connections, random_connections);
-
-          std::string arg_buff;
+          arg_buff.clear();
           epee::serialization::store_t_to_binary(arg, arg_buff);
 
-          MDEBUG("P2P Request: handle_supernode_announce: relaying to neighbours: " << random_connections.size());
+          MDEBUG("P2P Request: process_supernode_announces: relaying " << arg.supernode_public_id << " hop " << arg.hop << " to neighbours: " << random_connections.size());
 
-          relay_notify_to_list(command, arg_buff, random_connections);
+          relay_notify_to_list(COMMAND_SUPERNODE_ANNOUNCE::ID, arg_buff, random_connections);
           m_announce_bytes_out += arg_buff.size() * random_connections.size();
+          m_rta_metrics.record_relay(rta_metrics::announce, random_connections.size());
       }
 
-      MDEBUG("P2P Request: handle_supernode_announce: end");
-      return 1;
+      MDEBUG("P2P Request: process_supernode_announces: end");
+      return true;
   }
 
   template<class t_payload_net_handler>
@@ -1177,43 +1226,44 @@ namespace nodetool
     return 1;
 #endif
 
+      rta_metrics::message_metrics &metrics = m_rta_metrics.get(rta_metrics::broadcast);
+      ++metrics.received;
+      if (!m_supernode_requests_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_broadcast: request found in cache, skipping");
+          ++metrics.duplicates;
+          return 1;
+      }
+      rta_metrics::timer handling_timer(metrics.handling_us);
+
       {
           MDEBUG("P2P Request: handle_broadcast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
           MDEBUG("P2P Request: handle_broadcast: unlock");
           MDEBUG("P2P Request: handle_broadcast: sender_address: " << arg.sender_address
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_broadcast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
+          MDEBUG("P2P Request: handle_broadcast: post to supernodes");
 
-              post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", arg, arg.callback_uri);
-
-              if (arg.hop > 0)
-              {
-                  MDEBUG("P2P Request: handle_broadcast: notify broadcast from " << arg.sender_address
-                               << " to peers. Hop level: " << arg.hop);
-                  arg.hop--;
-                  std::string buff;
-                  epee::serialization::store_t_to_binary(arg, buff);
+          post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", arg, arg.callback_uri);
 
-                  m_broadcast_bytes_out += buff.size() * get_connections_count();
-
-                  relay_notify_to_all(command, buff, context);
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_broadcast: hop counter ended for broadcast from "
-                               << arg.sender_address);
-              }
+          if (arg.hop > 0)
+          {
+              MDEBUG("P2P Request: handle_broadcast: notify broadcast from " << arg.sender_address
+                           << " to peers. Hop level: " << arg.hop);
+              arg.hop--;
+              m_broadcast_bytes_out += relay_rta_message(command,
+                  [&arg](std::string &blob) { epee::serialization::store_t_to_binary(arg, blob); },
+                  [&arg](std::string &blob) {
+                      rta_message::serialize(rta_message::broadcast, arg.hop, arg.message_id, std::list<std::string>(),
+                                             arg.sender_address, arg.callback_uri, arg.data, arg.wait_answer, blob);
+                  },
+                  get_rta_connections(&context.m_connection_id));
+          }
+          else
+          {
+              MDEBUG("P2P Request: handle_broadcast: hop counter ended for broadcast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_broadcast: clean request cache");
-          remove_old_request_cache();
       }
       MDEBUG("P2P Request: handle_broadcast: end");
       return 1;
@@ -1237,49 +1287,47 @@ namespace nodetool
 
       std::list<std::string> addresses = arg.receiver_addresses;
       bool forward = false;
+      rta_metrics::message_metrics &metrics = m_rta_metrics.get(rta_metrics::multicast);
+      ++metrics.received;
+      if (!m_supernode_requests_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_multicast: request found in cache, skipping");
+          ++metrics.duplicates;
+          return 1;
+      }
+      rta_metrics::timer handling_timer(metrics.handling_us);
+
       {
           MDEBUG("P2P Request: handle_multicast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
 
           MDEBUG("P2P Request: handle_multicast: unlock");
           MDEBUG("P2P Request: handle_multicast: sender_address: " << arg.sender_address
                        << ", receiver_addresses: " << boost::algorithm::join(arg.receiver_addresses, ", ")
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_multicast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-              for (auto it = addresses.begin(); it != addresses.end(); ) {
-                  auto snit = m_supernodes.find(*it);
-                  if (snit != m_supernodes.end()) {
-                      MDEBUG("P2P Request: handle_multicast: posting to local supernode " << snit->first);
-                      post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(snit->second, "multicast", arg, arg.callback_uri);
-                      it = addresses.erase(it);
-                  } else {
-                      ++it;
-                  }
+          MDEBUG("P2P Request: handle_multicast: post to supernodes");
+          for (auto it = addresses.begin(); it != addresses.end(); ) {
+              auto snit = m_supernodes.find(*it);
+              if (snit != m_supernodes.end()) {
+                  if (post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(*snit->second, "multicast", arg, arg.callback_uri))
+                      MDEBUG("P2P Request: handle_multicast: queued for local supernode " << snit->first);
+                  else
+                      MWARNING("P2P Request: handle_multicast: failed to queue for local supernode " << snit->first);
+                  it = addresses.erase(it);
+              } else {
+                  ++it;
               }
+          }
 
-              if (arg.hop > 0)
-              {
-                  forward = true;
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_multicast: hop counter ended for multicast from "
-                               << arg.sender_address);
-              }
+          if (arg.hop > 0)
+          {
+              forward = true;
           }
           else
           {
-              MDEBUG("P2P Request: handle_multicast: request found in cache, skipping");
+              MDEBUG("P2P Request: handle_multicast: hop counter ended for multicast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_multicast: clean request cache");
-          remove_old_request_cache();
       }
       if (forward)
       {
@@ -1289,9 +1337,13 @@ namespace nodetool
           std::list<peerid_type> exclude_peers;
           exclude_peers.push_back(context.peer_id);
 
-          std::string buff;
-          epee::serialization::store_t_to_binary(arg, buff);
-          multicast_send(command, buff, addresses, exclude_peers);
+          multicast_send(command,
+              [&arg](std::string &blob) { epee::serialization::store_t_to_binary(arg, blob); },
+              [&arg](std::string &blob) {
+                  rta_message::serialize(rta_message::multicast, arg.hop, arg.message_id, arg.receiver_addresses,
+                                         arg.sender_address, arg.callback_uri, arg.data, arg.wait_answer, blob);
+              },
+              addresses, exclude_peers);
       }
       MDEBUG("P2P Request: handle_multicast: end");
       return 1;
@@ -1313,43 +1365,41 @@ namespace nodetool
 
       std::string address = arg.receiver_address;
       bool forward = false;
+      rta_metrics::message_metrics &metrics = m_rta_metrics.get(rta_metrics::unicast);
+      ++metrics.received;
+      if (!m_supernode_requests_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_unicast: request found in cache, skipping");
+          ++metrics.duplicates;
+          return 1;
+      }
+      rta_metrics::timer handling_timer(metrics.handling_us);
+
       {
           MDEBUG("P2P Request: handle_unicast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
           MDEBUG("P2P Request: handle_unicast: unlock");
           MDEBUG("P2P Request: handle_unicast: sender_address: " << arg.sender_address
                        << ", receiver_address: " << arg.receiver_address
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_unicast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-              auto it = m_supernodes.find(address);
-              bool local_sn = it != m_supernodes.end();
-              if (local_sn) {
-                  MDEBUG("P2P Request: handle_unicast: sending to local supernode " << address);
-                  post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(it->second, "unicast", arg, arg.callback_uri);
-              }
-              else if (arg.hop > 0)
-              {
-                  forward = true;
-              }
+          MDEBUG("P2P Request: handle_unicast: post to supernodes");
+          auto it = m_supernodes.find(address);
+          bool local_sn = it != m_supernodes.end();
+          if (local_sn) {
+              if (post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(*it->second, "unicast", arg, arg.callback_uri))
+                  MDEBUG("P2P Request: handle_unicast: queued for local supernode " << address);
               else
-              {
-                  MDEBUG("P2P Request: handle_unicast: hop counter ended for unicast from "
-                               << arg.sender_address);
-              }
+                  MWARNING("P2P Request: handle_unicast: failed to queue for local supernode " << address);
+          }
+          else if (arg.hop > 0)
+          {
+              forward = true;
           }
           else
           {
-              MDEBUG("P2P Request: handle_unicast: request found in cache, skipping");
+              MDEBUG("P2P Request: handle_unicast: hop counter ended for unicast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_unicast: clean request cache");
-          remove_old_request_cache();
       }
 
       if (forward)
@@ -1363,14 +1413,155 @@ namespace nodetool
           std::list<peerid_type> exclude_peers;
           exclude_peers.push_back(context.peer_id);
 
-          std::string buff;
-          epee::serialization::store_t_to_binary(arg, buff);
-          multicast_send(command, buff, addresses, exclude_peers);
+          multicast_send(command,
+              [&arg](std::string &blob) { epee::serialization::store_t_to_binary(arg, blob); },
+              [&arg, &addresses](std::string &blob) {
+                  rta_message::serialize(rta_message::unicast, arg.hop, arg.message_id, addresses,
+                                         arg.sender_address, arg.callback_uri, arg.data, arg.wait_answer, blob);
+              },
+              addresses, exclude_peers);
       }
       MDEBUG("P2P Request: handle_unicast: end");
       return 1;
   }
 
+  template<class t_payload_net_handler>
+  int node_server<t_payload_net_handler>::handle_rta_message(int command, const std::string &buffer, p2p_connection_context &context)
+  {
+      MDEBUG("P2P Request: handle_rta_message: start");
+
+      rta_message msg;
+      const bool parsed = msg.parse(buffer);
+      if (parsed && msg.type == rta_message::broadcast)
+          m_broadcast_bytes_in += buffer.size();
+      else
+          m_multicast_bytes_in += buffer.size();
+
+      if (context.m_state != p2p_connection_context::state_normal) {
+          MWARNING(context << " invalid connection (no handshake)");
+          return 1;
+      }
+
+#ifdef LOCK_RTA_SENDING
+    return 1;
+#endif
+
+      if (!parsed || (msg.type == rta_message::unicast && msg.receivers_count != 1)) {
+          MWARNING(context << " invalid RTA message");
+          return 1;
+      }
+
+      rta_metrics::message_metrics &metrics = m_rta_metrics.get(msg.type == rta_message::broadcast ? rta_metrics::broadcast :
+                                                                msg.type == rta_message::multicast ? rta_metrics::multicast : rta_metrics::unicast);
+      ++metrics.received;
+      if (!m_supernode_requests_cache.insert(msg.message_id))
+      {
+          MDEBUG("P2P Request: handle_rta_message: request found in cache, skipping");
+          ++metrics.duplicates;
+          return 1;
+      }
+      rta_metrics::timer handling_timer(metrics.handling_us);
+
+      const std::string message_id = epee::string_tools::pod_to_hex(msg.message_id);
+      std::list<std::string> addresses = msg.get_receiver_addresses();
+      const std::list<std::string> receiver_addresses = addresses;
+      {
+          LOG_PRINT_L3("P2P Request: handle_rta_message: lock");
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+          LOG_PRINT_L3("P2P Request: handle_rta_message: unlock");
+          MDEBUG("P2P Request: handle_rta_message: type: " << int(msg.type) << ", sender_address: " << msg.sender_address
+                       << ", our address(es): " << join_supernodes_addresses(", "));
+          if (msg.type == rta_message::broadcast)
+          {
+              if (!m_supernodes.empty())
+              {
+                  cryptonote::COMMAND_RPC_BROADCAST::request req;
+                  msg.to_request(req);
+                  post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", req, req.callback_uri);
+              }
+          }
+          else
+          {
+              for (auto it = addresses.begin(); it != addresses.end(); ) {
+                  auto snit = m_supernodes.find(*it);
+                  if (snit == m_supernodes.end()) {
+                      ++it;
+                      continue;
+                  }
+                  int queued = 0;
+                  if (msg.type == rta_message::multicast) {
+                      cryptonote::COMMAND_RPC_MULTICAST::request req;
+                      msg.to_request(req);
+                      req.receiver_addresses = receiver_addresses;
+                      queued = post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(*snit->second, "multicast", req, req.callback_uri);
+                  } else {
+                      cryptonote::COMMAND_RPC_UNICAST::request req;
+                      msg.to_request(req);
+                      req.receiver_address = *it;
+                      queued = post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(*snit->second, "unicast", req, req.callback_uri);
+                  }
+                  if (queued)
+                      MDEBUG("P2P Request: handle_rta_message: queued for local supernode " << snit->first);
+                  else
+                      MWARNING("P2P Request: handle_rta_message: failed to queue for local supernode " << snit->first);
+                  it = addresses.erase(it);
+              }
+          }
+      }
+
+      if (msg.hop == 0 || (msg.type != rta_message::broadcast && addresses.empty()))
+      {
+          MDEBUG("P2P Request: handle_rta_message: hop counter ended or no more receivers for message from " << msg.sender_address);
+          return 1;
+      }
+
+      // relays forward the received buffer with the hop decremented, legacy form is built only for peers which need it
+      const uint32_t hop = msg.hop - 1;
+      MDEBUG("P2P Request: handle_rta_message: notify message from " << msg.sender_address << " to peers. Hop level: " << hop);
+      const rta_blob_builder make_binary_blob = [&buffer, hop](std::string &blob) {
+          blob = buffer;
+          rta_message::set_hop(blob, hop);
+      };
+      if (msg.type == rta_message::broadcast)
+      {
+          m_broadcast_bytes_out += relay_rta_message(COMMAND_BROADCAST::ID, [&](std::string &blob) {
+              COMMAND_BROADCAST::request req;
+              msg.to_request(req);
+              req.hop = hop;
+              req.message_id = message_id;
+              epee::serialization::store_t_to_binary(req, blob);
+          }, make_binary_blob, get_rta_connections(&context.m_connection_id));
+          return 1;
+      }
+
+      std::list<peerid_type> exclude_peers;
+      exclude_peers.push_back(context.peer_id);
+      if (msg.type == rta_message::multicast)
+      {
+          multicast_send(COMMAND_MULTICAST::ID, [&](std::string &blob) {
+              COMMAND_MULTICAST::request req;
+              msg.to_request(req);
+              req.receiver_addresses = receiver_addresses;
+              req.hop = hop;
+              req.message_id = message_id;
+              epee::serialization::store_t_to_binary(req, blob);
+          }, make_binary_blob, addresses, exclude_peers);
+      }
+      else
+      {
+          multicast_send(COMMAND_UNICAST::ID, [&](std::string &blob) {
+              COMMAND_UNICAST::request req;
+              msg.to_request(req);
+              req.receiver_address = receiver_addresses.front();
+              req.hop = hop;
+              req.message_id = message_id;
+              epee::serialization::store_t_to_binary(req, blob);
+          }, make_binary_blob, addresses, exclude_peers);
+      }
+      MDEBUG("P2P Request: handle_rta_message: end");
+      return 1;
+  }
+
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::do_handshake_with_peer(peerid_type& pi, p2p_connection_context& context_, bool just_take_peerlist)
@@ -2481,7 +2672,7 @@ namespace nodetool
 
     MDEBUG("P2P Request: do_supernode_announce: start");
 
-    COMMAND_SUPERNODE_ANNOUNCE::request p2p_req;
+    COMMAND_SUPERNODE_ANNOUNCE::request p2p_req = AUTO_VAL_INIT(p2p_req);
     p2p_req.supernode_public_id = req.supernode_public_id;
     p2p_req.height = req.height;
     p2p_req.signature = req.signature;
@@ -2491,7 +2682,7 @@ namespace nodetool
     MDEBUG("P2P Request: do_supernode_announce: announce to me");
     {
         MDEBUG("P2P Request: do_supernode_announce: lock");
-        boost::unique_lock<boost::recursive_mutex> guard(m_supernode_lock);
+        supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
         MDEBUG("P2P Request: do_supernode_announce: lock acquired");
         post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>("send_supernode_announce", p2p_req);
     }
@@ -2580,7 +2771,7 @@ namespace nodetool
       MDEBUG("P2P Request: do_broadcast: broadcast to me");
       {
           LOG_PRINT_L3("P2P Request: do_broadcast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
           LOG_PRINT_L3("P2P Request: do_broadcast: unlock");
           post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", req, req.callback_uri);
       }
@@ -2594,20 +2785,10 @@ namespace nodetool
       p2p_req.callback_uri = req.callback_uri;
       p2p_req.data = req.data;
       p2p_req.wait_answer = req.wait_answer;
-      p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(get_routes());
+      p2p_req.hop = HOP_RETRIES_MULTIPLIER * m_supernode_routes.max_hop();
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_broadcast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_broadcast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_broadcast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_supernode_requests_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_broadcast: prepare peerlist");
 
@@ -2615,32 +2796,17 @@ namespace nodetool
       epee::serialization::store_t_to_binary(p2p_req, blob);
       std::set<peerid_type> announced_peers;
 
-      // send to peers
-      std::list<connection_info> connections;
-      m_net_server.get_config_object().foreach_connection([&](p2p_connection_context& context) {
-          // TODO: isn't all rta peers have peer_id = 0?
-          if (context.peer_id == 0) {
-              LOG_INFO_CC(context, "invalid connection [COMMAND_BROADCAST]");
-              return true;
-          }
-
-          connections.push_back(
-          {context.m_connection_id,
-           context.peer_id,
-           epee::net_utils::print_connection_context_short(context)} );
-          return true;
-      });
-
-      for (const auto &c: connections) {
-          MTRACE("[" << c.info << "] invoking COMMAND_BROADCAST");
-          if (m_net_server.get_config_object().notify(COMMAND_BROADCAST::ID, blob, c.id)) {
-              MTRACE("[" << c.info << "] COMMAND_BROADCAST invoked, peer_id: " << c.peer_id);
-              announced_peers.insert(c.peer_id);
-          }
-          else
-              LOG_ERROR("[" << c.info << "] failed to invoke COMMAND_BROADCAST");
-      }
-      m_broadcast_bytes_out += blob.size() * announced_peers.size();
+      // send to connected peers, binary framing to the peers which support it
+      const std::vector<rta_connection> connections = get_rta_connections();
+      for (const rta_connection &c : connections)
+          announced_peers.insert(c.peer_id);
+      m_broadcast_bytes_out += relay_rta_message(COMMAND_BROADCAST::ID,
+          [&blob](std::string &legacy_blob) { legacy_blob = blob; },
+          [&p2p_req](std::string &binary_blob) {
+              rta_message::serialize(rta_message::broadcast, p2p_req.hop, p2p_req.message_id, std::list<std::string>(),
+                                     p2p_req.sender_address, p2p_req.callback_uri, p2p_req.data, p2p_req.wait_answer, binary_blob);
+          },
+          connections);
 
       std::list<peerlist_entry> peerlist_white, peerlist_gray;
       m_peerlist.get_peerlist_full(peerlist_gray, peerlist_white);
@@ -2681,13 +2847,15 @@ namespace nodetool
       MDEBUG("P2P Request: do_multicast: multicast to me");
       {
           MDEBUG("P2P Request: do_multicast: lock");
-          boost::unique_lock<boost::recursive_mutex> guard(m_supernode_lock);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
           MDEBUG("P2P Request: do_multicast: unlock");
           for (auto &addr : req.receiver_addresses) {
               auto it = m_supernodes.find(addr);
               if (it != m_supernodes.end()) {
-                  MDEBUG("P2P Request: do_multicast: multicast to " << addr);
-                  post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(it->second, "multicast", req, req.callback_uri);
+                  if (post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(*it->second, "multicast", req, req.callback_uri))
+                      MDEBUG("P2P Request: do_multicast: queued for " << addr);
+                  else
+                      MWARNING("P2P Request: do_multicast: failed to queue for " << addr);
               }
               else {
                   remaining_addresses.push_back(addr);
@@ -2713,23 +2881,17 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(p2p_req.receiver_addresses);
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_multicast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_multicast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_multicast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_supernode_requests_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_multicast: multicast send");
-      std::string blob;
-      epee::serialization::store_t_to_binary(p2p_req, blob);
       // stat counter updated in multicast_send
-      multicast_send(COMMAND_MULTICAST::ID, blob, p2p_req.receiver_addresses);
+      multicast_send(COMMAND_MULTICAST::ID,
+          [&p2p_req](std::string &blob) { epee::serialization::store_t_to_binary(p2p_req, blob); },
+          [&p2p_req](std::string &blob) {
+              rta_message::serialize(rta_message::multicast, p2p_req.hop, p2p_req.message_id, p2p_req.receiver_addresses,
+                                     p2p_req.sender_address, p2p_req.callback_uri, p2p_req.data, p2p_req.wait_answer, blob);
+          },
+          p2p_req.receiver_addresses);
       MDEBUG("P2P Request: do_multicast: End");
   }
 
@@ -2760,14 +2922,15 @@ namespace nodetool
       LOG_PRINT_L2("P2P Request: do_unicast: checking unicast to me");
       {
           LOG_PRINT_L3("P2P Request: do_unicast: lock");
-          boost::unique_lock<boost::recursive_mutex> guard(m_supernode_lock);
+          supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
           LOG_PRINT_L3("P2P Request: do_unicast: unlock");
           const std::string &addr = req.receiver_address;
           auto it = m_supernodes.find(addr);
           if (it != m_supernodes.end()) {
-              LOG_PRINT_L2("P2P Request: do_unicast: unicast to local supernode " << addr);
-              post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(it->second, "unicast", req, req.callback_uri);
-              LOG_PRINT_L2("P2P request: do_unicast: End (unicast recipient was local)");
+              if (post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(*it->second, "unicast", req, req.callback_uri))
+                  LOG_PRINT_L2("P2P request: do_unicast: End (queued for local supernode " << addr << ")");
+              else
+                  MWARNING("P2P request: do_unicast: failed to queue for local supernode " << addr);
               return;
           }
       }
@@ -2781,22 +2944,16 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(addresses);
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_unicast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_unicast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_unicast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_supernode_requests_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_unicast: unicast send");
-      std::string blob;
-      epee::serialization::store_t_to_binary(p2p_req, blob);
-      multicast_send(COMMAND_UNICAST::ID, blob, addresses);
+      multicast_send(COMMAND_UNICAST::ID,
+          [&p2p_req](std::string &blob) { epee::serialization::store_t_to_binary(p2p_req, blob); },
+          [&p2p_req, &addresses](std::string &blob) {
+              rta_message::serialize(rta_message::unicast, p2p_req.hop, p2p_req.message_id, addresses,
+                                     p2p_req.sender_address, p2p_req.callback_uri, p2p_req.data, p2p_req.wait_answer, blob);
+          },
+          addresses);
       MDEBUG("P2P Request: do_unicast: End");
   }
 
@@ -2805,14 +2962,14 @@ namespace nodetool
   std::vector<cryptonote::route_data> node_server<t_payload_net_handler>::get_tunnels() const
   {
       std::vector<cryptonote::route_data> tunnels;
-      for (auto it = m_supernode_routes.begin(); it != m_supernode_routes.end(); ++it)
+      m_supernode_routes.for_each([&tunnels](const std::string &addr, const supernode_route &sn_route)
       {
           cryptonote::route_data route;
-          route.address = it->first;
-          route.last_announce_height = it->second.last_announce_height;
-          route.max_hop = it->second.max_hop;
+          route.address = addr;
+          route.last_announce_height = sn_route.last_announce_height;
+          route.max_hop = sn_route.max_hop;
           std::vector<cryptonote::peer_data> peers;
-          for (auto pit = it->second.peers.begin(); pit != it->second.peers.end(); ++pit)
+          for (auto pit = sn_route.peers.begin(); pit != sn_route.peers.end(); ++pit)
           {
               cryptonote::peer_data peer;
               peer.host = pit->adr.host_str();
@@ -2823,7 +2980,7 @@ namespace nodetool
           }
           route.peers = peers;
           tunnels.push_back(route);
-      }
+      });
       return tunnels;
   }
 
@@ -3164,36 +3321,40 @@ namespace nodetool
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::handle_stakes_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes)
   {
-    static std::string supernode_endpoint("send_supernode_stakes");
+    // announces of supernodes without stakes are not relayed
+    std::shared_ptr<supernode_announce_batch::supernode_id_set> staked_supernodes = std::make_shared<supernode_announce_batch::supernode_id_set>();
+    staked_supernodes->reserve(stakes.size());
+    for (const cryptonote::supernode_stake &stake : stakes)
+      staked_supernodes->insert(stake.supernode_public_id);
+    m_supernode_announces.set_staked_supernodes(std::move(staked_supernodes));
 
-    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    boost::lock_guard<boost::mutex> feed_guard(m_supernode_feed_lock);
 
-    if (m_supernodes.empty())
-      return;
-
-    MDEBUG("handle_stakes_update to supernode for block #" << block_height);
+    if (m_rta_events.is_enabled() && block_height != m_rta_events_block_height)
+    {
+      rta_event_stream::block_event block;
+      block.block_height = block_height;
+      block.block_hash = epee::string_tools::pod_to_hex(m_payload_handler.get_core().get_block_id_by_height(block_height));
+      m_rta_events.publish(rta_event_stream::topic_block, epee::serialization::store_t_to_json(block), std::string());
+      m_rta_events_block_height = block_height;
+    }
 
-    cryptonote::COMMAND_RPC_SUPERNODE_STAKES::request request;
+    std::vector<supernode_state_feed::supernode_state> supernodes = get_supernode_feed_states(false);
 
-    request.block_height = block_height;
+    if (supernodes.empty())
+      return;
 
-    request.stakes.reserve(stakes.size());
+    MDEBUG("handle_stakes_update to supernode for block #" << block_height);
 
-    for (const cryptonote::supernode_stake& src_stake : stakes)
+    // requests are built and serialized without the supernodes lock
+    supernode_state_feed::update update;
+    if (!m_supernode_feed.make_stakes_update(m_nettype, block_height, stakes, supernodes, update))
     {
-      cryptonote::COMMAND_RPC_SUPERNODE_STAKES::supernode_stake dst_stake;
-
-      dst_stake.amount = src_stake.amount;
-      dst_stake.tier = src_stake.tier;
-      dst_stake.block_height = src_stake.block_height;
-      dst_stake.unlock_time = src_stake.unlock_time;
-      dst_stake.supernode_public_id = src_stake.supernode_public_id;
-      dst_stake.supernode_public_address = cryptonote::get_account_address_as_str(m_nettype, false, src_stake.supernode_public_address);
-
-      request.stakes.emplace_back(std::move(dst_stake));
+      MERROR("Failed to serialize stakes update for block #" << block_height);
+      return;
     }
 
-    post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_STAKES>(supernode_endpoint, request);
+    post_supernode_feed_update(update, false);
   }
 
   template<class t_payload_net_handler>
@@ -3205,41 +3366,139 @@ namespace nodetool
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::handle_blockchain_based_list_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers)
   {
-    static std::string supernode_endpoint("blockchain_based_list");
+    boost::lock_guard<boost::mutex> feed_guard(m_supernode_feed_lock);
 
-    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    std::vector<supernode_state_feed::supernode_state> supernodes = get_supernode_feed_states(true);
 
-    if (m_supernodes.empty())
+    if (supernodes.empty())
       return;
 
     MDEBUG("handle_blockchain_based_list_update to supernode for block #" << block_height);
 
-    cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request request;
+    supernode_state_feed::update update;
+    if (!m_supernode_feed.make_list_update(m_nettype, block_height, tiers, supernodes, update))
+    {
+      MERROR("Failed to serialize blockchain based list update for block #" << block_height);
+      return;
+    }
+
+    post_supernode_feed_update(update, true);
+  }
 
-    request.block_height = block_height;
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::get_rta_metrics(cryptonote::COMMAND_RPC_RTA_METRICS::response &res)
+  {
+    res.recording = rta_metrics::is_enabled();
+    rta_metrics::enable();
 
-    for (size_t i=0; i<tiers.size(); i++)
+    res.messages.resize(rta_metrics::message_types_count);
+    for (size_t i = 0; i < rta_metrics::message_types_count; ++i)
     {
-      const cryptonote::StakeTransactionProcessor::supernode_tier_array::value_type& src_tier = tiers[i];
-      cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::tier                  dst_tier;
+      const rta_metrics::message_type type = static_cast<rta_metrics::message_type>(i);
+      const rta_metrics::message_metrics &metrics = m_rta_metrics.get(type);
+      cryptonote::COMMAND_RPC_RTA_METRICS::message_type_metrics &m = res.messages[i];
+      m.type = rta_metrics::get_message_type_name(type);
+      m.received = metrics.received;
+      m.duplicates = metrics.duplicates;
+      m.relayed = metrics.relayed;
+      metrics.handling_us.get(m.handling_us);
+      metrics.fanout.get(m.fanout);
+    }
+    m_rta_metrics.get_supernode_post_us().get(res.supernode_post_us);
+    m_rta_metrics.get_supernode_lock_wait_us().get(res.supernode_lock_wait_us);
 
-      dst_tier.supernodes.reserve(src_tier.size());
+    supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+    res.supernodes.reserve(m_supernodes.size());
+    for (const auto &sn : m_supernodes)
+    {
+      cryptonote::COMMAND_RPC_RTA_METRICS::supernode_metrics m;
+      m.supernode_public_id = sn.first;
+      m.delivered = sn.second->get_delivered_count();
+      m.failed = sn.second->get_failed_count();
+      m.dropped = sn.second->get_dropped_count();
+      m.queue_size = sn.second->get_queue_size();
+      sn.second->get_delivery_us().get(m.delivery_us);
+      res.supernodes.push_back(std::move(m));
+    }
+  }
+
+  template<class t_payload_net_handler>
+  std::vector<supernode_state_feed::supernode_state> node_server<t_payload_net_handler>::get_supernode_feed_states(bool list)
+  {
+    supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+
+    const rta_event_stream::topic topic = list ? rta_event_stream::topic_tiers : rta_event_stream::topic_stakes;
 
-      for (const cryptonote::BlockchainBasedList::supernode& src_supernode : src_tier)
+    std::vector<supernode_state_feed::supernode_state> supernodes;
+    supernodes.reserve(m_supernodes.size() + 1);
+    for (const auto &sn : m_supernodes)
+      if (!m_rta_events.is_subscribed(sn.first, topic))
+        supernodes.push_back({sn.second->supports_delta(), list ? sn.second->get_list_version() : sn.second->get_stakes_version()});
+    // event stream takes the same binary updates as supernodes with delta support
+    if (m_rta_events.is_enabled())
+      supernodes.push_back({true, list ? m_rta_events_list_version : m_rta_events_stakes_version});
+    return supernodes;
+  }
+
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::post_supernode_feed_update(const supernode_state_feed::update &update, bool list)
+  {
+    const std::string json_endpoint = std::string("/") + (list ? supernode_state_feed::LIST_METHOD : supernode_state_feed::STAKES_METHOD);
+    const std::string binary_endpoint = list ? supernode_state_feed::LIST_BINARY_ENDPOINT : supernode_state_feed::STAKES_BINARY_ENDPOINT;
+    const rta_event_stream::topic topic = list ? rta_event_stream::topic_tiers : rta_event_stream::topic_stakes;
+
+    if (m_rta_events.is_enabled())
+    {
+      uint64_t &version = list ? m_rta_events_list_version : m_rta_events_stakes_version;
+      const bool full = update.is_full_needed(version);
+      if (full ? !update.full.empty() : update.version != update.base_version)
+        m_rta_events.publish(topic, full ? update.full : update.delta, binary_endpoint);
+      if (!update.history && (!full || !update.full.empty()))
+        version = update.version;
+    }
+
+    supernode_lock_guard guard(m_supernode_lock, m_rta_metrics.get_supernode_lock_wait_us());
+
+    for (auto &sn : m_supernodes)
+    {
+      local_supernode &supernode = *sn.second;
+
+      if (m_rta_events.is_subscribed(sn.first, topic))
+        continue; //supernode gets updates from the event stream
+
+      if (!supernode.supports_delta())
       {
-        cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::supernode dst_supernode;
+        if (!update.json.empty())
+          supernode.post_serialized(json_endpoint, update.json);
+        continue;
+      }
 
-        dst_supernode.supernode_public_id      = src_supernode.supernode_public_id;
-        dst_supernode.supernode_public_address = cryptonote::get_account_address_as_str(m_nettype, false, src_supernode.supernode_public_address);
-        dst_supernode.amount                   = src_supernode.amount;
+      const uint64_t version = list ? supernode.get_list_version() : supernode.get_stakes_version();
 
-        dst_tier.supernodes.emplace_back(std::move(dst_supernode));
+      const std::string *body = nullptr;
+      if (!update.is_full_needed(version))
+      {
+        if (update.version != update.base_version)
+          body = &update.delta;
+      }
+      else if (!update.full.empty())
+      {
+        body = &update.full;
+      }
+      else
+      {
+        continue; //supernode has been registered after the update was built, it gets full state with the next update
       }
 
-      request.tiers.emplace_back(std::move(dst_tier));
-    }
+      // the version is advanced when the update is queued, the supernode worker resets it to 0 and discards
+      // the following deltas if the update is dropped or not delivered, so the next update sends the full state
+      const local_supernode::feed_type feed = update.history ? local_supernode::feed_none : list ? local_supernode::feed_list : local_supernode::feed_stakes;
+      if (!supernode.advance_feed_version(feed, version, update.version))
+        continue; //an earlier update has not been delivered, the next update sends the full state
 
-    post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>(supernode_endpoint, request);
+      if (body && !supernode.post_serialized(binary_endpoint, *body, true, feed, body == &update.delta))
+        supernode.reset_feed_version(feed);
+    }
   }
 
   template<class t_payload_net_handler>
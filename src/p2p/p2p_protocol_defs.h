@@ -266,6 +266,15 @@ namespace nodetool
       struct response : public cryptonote::COMMAND_RPC_UNICAST::response { };
   };
 
+  /*!
+   * \brief COMMAND_RTA_MESSAGE - broadcast, multicast or unicast in binary framing (see rta_message.h),
+   *        sent only to peers with P2P_SUPPORT_FLAG_RTA_BINARY support flag
+   */
+  struct COMMAND_RTA_MESSAGE
+  {
+      const static int ID = P2P_COMMANDS_POOL_BASE + 24;
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
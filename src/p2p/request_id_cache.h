@@ -0,0 +1,243 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "misc_log_ex.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief request_id_cache - ids of the recently seen RTA messages (broadcast/multicast/unicast duplicate suppression)
+   *
+   * Memory is allocated once. Ids are kept as 32-byte binary values in rotating generations of fixed size
+   * open addressing tables spread over shards; a generation is cleared in O(1) by bumping its tag. An id is
+   * remembered for at least LIFETIME_MILLIS (and less than LIFETIME_MILLIS + GENERATION_MILLIS) unless a
+   * generation overflows under a message storm, in which case generations are rotated earlier.
+   */
+  class request_id_cache
+  {
+  public:
+    static constexpr size_t LIFETIME_MILLIS = 2 * 60 * 1000;
+    static constexpr size_t GENERATIONS_COUNT = 3;
+    static constexpr size_t GENERATION_MILLIS = LIFETIME_MILLIS / (GENERATIONS_COUNT - 1);
+    static constexpr size_t SHARDS_COUNT = 16;
+    static constexpr size_t GENERATION_SLOTS_COUNT = 4096; // per shard, power of 2
+    static constexpr size_t GENERATION_MAX_IDS_COUNT = GENERATION_SLOTS_COUNT / 2;
+
+    request_id_cache()
+      : m_salt(crypto::rand<uint64_t>())
+    {
+      const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      for (shard &s : m_shards)
+      {
+        for (generation &g : s.generations)
+        {
+          g.ids.resize(GENERATION_SLOTS_COUNT);
+          g.tags.resize(GENERATION_SLOTS_COUNT, 0);
+        }
+        s.current_generation_start = now;
+      }
+    }
+
+    request_id_cache(const request_id_cache&) = delete;
+    request_id_cache& operator=(const request_id_cache&) = delete;
+
+    /*!
+     * \brief insert - remembers message id
+     * \return       - false if the id has already been seen
+     */
+    bool insert(const std::string &message_id)
+    {
+      return insert(get_id(message_id), std::chrono::steady_clock::now());
+    }
+
+    /*!
+     * \brief insert - remembers binary message id (same as its hex encoded form)
+     * \return       - false if the id has already been seen
+     */
+    bool insert(const crypto::hash &id)
+    {
+      return insert(id, std::chrono::steady_clock::now());
+    }
+
+    /*!
+     * \brief insert - remembers message id seen at the given time (tests use it to move the clock)
+     * \return       - false if the id has already been seen
+     */
+    bool insert(const std::string &message_id, const std::chrono::steady_clock::time_point &now)
+    {
+      return insert(get_id(message_id), now);
+    }
+
+    bool insert(const crypto::hash &id, const std::chrono::steady_clock::time_point &now)
+    {
+      const uint64_t hash = get_salted_hash(id);
+      shard &s = m_shards[(hash >> 32) % SHARDS_COUNT];
+      const size_t slot = hash % GENERATION_SLOTS_COUNT;
+
+      boost::lock_guard<boost::mutex> guard(s.lock);
+
+      expire(s, now);
+
+      for (const generation &g : s.generations)
+        if (g.contains(id, slot))
+          return false;
+
+      if (s.generations[s.current_generation].count >= GENERATION_MAX_IDS_COUNT)
+      {
+        MINFO("Too many RTA messages, request id cache generation is rotated before its time");
+        rotate(s);
+      }
+
+      s.generations[s.current_generation].add(id, slot);
+      return true;
+    }
+
+  private:
+    struct generation
+    {
+      std::vector<crypto::hash> ids;
+      std::vector<uint32_t> tags; // slot is used if its tag equals to the generation tag
+      uint32_t tag = 1;
+      size_t count = 0;
+
+      bool contains(const crypto::hash &id, size_t slot) const
+      {
+        for (size_t i = 0; i < count + 1; ++i, slot = (slot + 1) % GENERATION_SLOTS_COUNT)
+        {
+          if (tags[slot] != tag)
+            return false;
+          if (ids[slot] == id)
+            return true;
+        }
+        return false;
+      }
+
+      void add(const crypto::hash &id, size_t slot)
+      {
+        while (tags[slot] == tag)
+          slot = (slot + 1) % GENERATION_SLOTS_COUNT;
+        ids[slot] = id;
+        tags[slot] = tag;
+        ++count;
+      }
+
+      void clear()
+      {
+        count = 0;
+        if (++tag == 0)
+        {
+          std::fill(tags.begin(), tags.end(), 0);
+          tag = 1;
+        }
+      }
+    };
+
+    struct shard
+    {
+      boost::mutex lock;
+      std::array<generation, GENERATIONS_COUNT> generations;
+      size_t current_generation = 0;
+      std::chrono::steady_clock::time_point current_generation_start;
+    };
+
+    // message ids are hex encoded hashes, other ids are hashed to the same size
+    static crypto::hash get_id(const std::string &message_id)
+    {
+      crypto::hash id;
+      if (message_id.size() == sizeof(id.data) * 2)
+      {
+        bool valid = true;
+        for (size_t i = 0; i < sizeof(id.data) && valid; ++i)
+        {
+          const int hi = get_hex_digit(message_id[2 * i]), lo = get_hex_digit(message_id[2 * i + 1]);
+          valid = hi >= 0 && lo >= 0;
+          id.data[i] = static_cast<char>(hi << 4 | lo);
+        }
+        if (valid)
+          return id;
+      }
+      return crypto::cn_fast_hash(message_id.data(), message_id.size());
+    }
+
+    static int get_hex_digit(char c)
+    {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      return -1;
+    }
+
+    // slots depend on the salt so peers can't choose ids which collide in a table
+    uint64_t get_salted_hash(const crypto::hash &id) const
+    {
+      uint64_t result = m_salt;
+      for (size_t i = 0; i < sizeof(id.data); i += sizeof(uint64_t))
+      {
+        uint64_t word;
+        memcpy(&word, id.data + i, sizeof(word));
+        result = (result ^ word) * 0x9e3779b97f4a7c15ull;
+        result ^= result >> 29;
+      }
+      return result;
+    }
+
+    static void rotate(shard &s)
+    {
+      s.current_generation = (s.current_generation + 1) % GENERATIONS_COUNT;
+      s.generations[s.current_generation].clear();
+    }
+
+    static void expire(shard &s, const std::chrono::steady_clock::time_point &now)
+    {
+      const std::chrono::milliseconds period(GENERATION_MILLIS);
+      for (size_t i = 0; i < GENERATIONS_COUNT && now - s.current_generation_start >= period; ++i)
+      {
+        rotate(s);
+        s.current_generation_start += period;
+      }
+      if (now - s.current_generation_start >= period)
+        s.current_generation_start = now;
+    }
+
+    const uint64_t m_salt;
+    std::array<shard, SHARDS_COUNT> m_shards;
+  };
+}
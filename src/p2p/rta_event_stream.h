@@ -0,0 +1,293 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "serialization/keyvalue_serialization.h"
+#include "string_tools.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief rta_event_stream - sequenced RTA events for subscribers of the daemon event stream
+   *
+   * Events are numbered by one sequence for all topics and kept in a bounded buffer, so a subscriber which
+   * reconnects continues from the last sequence it has received. Message events are addressed to one supernode.
+   * Supernodes with an active subscription to a topic get its events from the stream instead of http requests.
+   * Events are only recorded after the first subscription, daemons without subscribers don't pay for the stream.
+   */
+  class rta_event_stream
+  {
+  public:
+    enum topic : unsigned
+    {
+      topic_block   = 1,
+      topic_stakes  = 2,
+      topic_tiers   = 4,
+      topic_message = 8
+    };
+
+    static constexpr unsigned ALL_TOPICS = topic_block | topic_stakes | topic_tiers | topic_message;
+    // max number of events kept for subscribers which continue from the previous sequence
+    static constexpr size_t MAX_EVENTS_COUNT = 4096;
+    // subscription has to be renewed within this number of seconds
+    static constexpr unsigned SUBSCRIPTION_TIMEOUT_SECONDS = 30;
+
+    struct event
+    {
+      uint64_t sequence;
+      topic type;
+      std::string supernode_public_id; // recipient of the message event, empty for events of all subscribers
+      std::string uri;                 // supernode uri the payload would be posted to
+      std::string payload;             // block_event JSON, binary stakes or list update, JSON-RPC message
+    };
+
+    typedef std::shared_ptr<const event> event_ptr;
+
+    struct block_event
+    {
+      uint64_t block_height;
+      std::string block_hash;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(block_hash)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    typedef std::function<void(unsigned topics)> full_state_request_handler;
+    typedef std::function<bool(const std::string &supernode_public_id)> supernode_check_handler;
+
+    static const char *get_topic_name(topic t)
+    {
+      switch (t)
+      {
+        case topic_block:   return "block";
+        case topic_stakes:  return "stakes";
+        case topic_tiers:   return "tiers";
+        case topic_message: return "message";
+      }
+      return "";
+    }
+
+    /*!
+     * \brief parse_topics - parses comma separated topic names
+     * \return             - topics mask, 0 if any name is unknown
+     */
+    static unsigned parse_topics(const std::string &names)
+    {
+      unsigned topics = 0;
+      size_t begin = 0;
+      while (begin <= names.size())
+      {
+        size_t end = names.find(',', begin);
+        if (end == std::string::npos)
+          end = names.size();
+        const std::string name = names.substr(begin, end - begin);
+        unsigned t = 0;
+        for (unsigned bit = 1; bit <= ALL_TOPICS; bit <<= 1)
+          if (name == get_topic_name(static_cast<topic>(bit)))
+            t = bit;
+        if (!t)
+          return 0;
+        topics |= t;
+        begin = end + 1;
+      }
+      return topics;
+    }
+
+    /*!
+     * \brief get_subscription_hash - hash of the subscription challenge signed by the supernode id key
+     */
+    static crypto::hash get_subscription_hash(const std::string &nonce, const std::string &supernode_public_id)
+    {
+      const std::string data = "subscribe:" + nonce + ":" + supernode_public_id;
+      crypto::hash hash;
+      crypto::cn_fast_hash(data.data(), data.size(), hash);
+      return hash;
+    }
+
+    /*!
+     * \brief check_subscription_signature - checks the challenge signature (hex) by the supernode id key
+     */
+    static bool check_subscription_signature(const std::string &nonce, const std::string &supernode_public_id, const std::string &signature_hex)
+    {
+      crypto::public_key id;
+      crypto::signature signature;
+      if (!epee::string_tools::hex_to_pod(supernode_public_id, id) || !epee::string_tools::hex_to_pod(signature_hex, signature))
+        return false;
+      return crypto::check_signature(get_subscription_hash(nonce, supernode_public_id), id, signature);
+    }
+
+    bool is_enabled() const { return m_enabled; }
+
+    /*!
+     * \brief is_local_supernode - supernode is registered at this daemon, only such supernodes may subscribe by id
+     */
+    bool is_local_supernode(const std::string &supernode_public_id) const
+    {
+      supernode_check_handler handler;
+      {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        handler = m_supernode_check_handler;
+      }
+      return handler && handler(supernode_public_id);
+    }
+
+    /*!
+     * \brief publish - adds event to the stream
+     * \return        - sequence of the event, 0 if the stream has no subscribers yet
+     */
+    uint64_t publish(topic type, std::string payload, const std::string &uri, const std::string &supernode_public_id = std::string())
+    {
+      if (!m_enabled)
+        return 0;
+      std::shared_ptr<event> e = std::make_shared<event>();
+      e->type = type;
+      e->supernode_public_id = supernode_public_id;
+      e->uri = uri;
+      e->payload = std::move(payload);
+
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      e->sequence = m_first_sequence + m_events.size();
+      if (m_events.size() >= MAX_EVENTS_COUNT)
+      {
+        m_events.pop_front();
+        ++m_first_sequence;
+      }
+      m_events.emplace_back(std::move(e));
+      return m_events.back()->sequence;
+    }
+
+    uint64_t get_next_sequence() const
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      return m_first_sequence + m_events.size();
+    }
+
+    /*!
+     * \brief get_events - events of the topics for the supernode starting from the sequence
+     * \param gap        - events after from_sequence have been dropped, the subscriber has to reload the state
+     * \return           - sequence to continue from
+     */
+    uint64_t get_events(uint64_t from_sequence, unsigned topics, const std::string &supernode_public_id, size_t max_count,
+                        std::vector<event_ptr> &events, bool &gap) const
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      gap = from_sequence < m_first_sequence;
+      uint64_t sequence = std::max(from_sequence, m_first_sequence);
+      const uint64_t next_sequence = m_first_sequence + m_events.size();
+      for (; sequence < next_sequence && events.size() < max_count; ++sequence)
+      {
+        const event_ptr &e = m_events[sequence - m_first_sequence];
+        if ((e->type & topics) && (e->supernode_public_id.empty() || e->supernode_public_id == supernode_public_id))
+          events.push_back(e);
+      }
+      return sequence;
+    }
+
+    /*!
+     * \brief subscribe - registers or renews subscription of the supernode (empty id for subscribers which are not supernodes)
+     * \param full_state - subscriber starts without the previous state, full stakes and list are pushed to the stream
+     */
+    void subscribe(const std::string &supernode_public_id, unsigned topics, bool full_state)
+    {
+      full_state_request_handler handler;
+      {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        m_enabled = true;
+        if (!supernode_public_id.empty())
+          m_subscriptions[supernode_public_id] = subscription{topics, std::chrono::steady_clock::now()};
+        if (full_state)
+          handler = m_full_state_request_handler;
+      }
+      if (handler && (topics & (topic_stakes | topic_tiers)))
+        handler(topics & (topic_stakes | topic_tiers));
+    }
+
+    void unsubscribe(const std::string &supernode_public_id)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_subscriptions.erase(supernode_public_id);
+    }
+
+    /*!
+     * \brief is_subscribed - supernode has subscription to the topic which has been renewed in time
+     */
+    bool is_subscribed(const std::string &supernode_public_id, topic type) const
+    {
+      if (!m_enabled)
+        return false;
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      auto it = m_subscriptions.find(supernode_public_id);
+      return it != m_subscriptions.end() && (it->second.topics & type) &&
+        std::chrono::steady_clock::now() - it->second.renewed < std::chrono::seconds(uint64_t(SUBSCRIPTION_TIMEOUT_SECONDS));
+    }
+
+    void set_full_state_request_handler(const full_state_request_handler &handler)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_full_state_request_handler = handler;
+    }
+
+    void set_supernode_check_handler(const supernode_check_handler &handler)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_supernode_check_handler = handler;
+    }
+
+  private:
+    struct subscription
+    {
+      unsigned topics;
+      std::chrono::steady_clock::time_point renewed;
+    };
+
+    mutable boost::mutex m_lock;
+    std::atomic<bool> m_enabled {false};
+    std::deque<event_ptr> m_events;
+    uint64_t m_first_sequence = 1; // sequence of m_events.front()
+    std::unordered_map<std::string, subscription> m_subscriptions;
+    full_state_request_handler m_full_state_request_handler;
+    supernode_check_handler m_supernode_check_handler;
+  };
+}
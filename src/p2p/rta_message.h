@@ -0,0 +1,205 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <string>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "common/int-util.h"
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "string_tools.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief rta_message - binary framing of RTA broadcast, multicast and unicast messages (COMMAND_RTA_MESSAGE)
+   *
+   * Layout, integers are little endian:
+   *   header  - version (1 byte), type (1 byte), flags (1 byte), reserved (1 byte), hop (4 bytes),
+   *             message id (32 bytes), receivers count, sender address size, callback uri size, data size (4 bytes each)
+   *   body    - receivers (32-byte supernode public keys), sender address, callback uri, data
+   *
+   * A parsed message refers to the buffer it has been parsed from. Relays forward the received
+   * buffer with only the hop patched in place.
+   */
+  struct rta_message
+  {
+    enum message_type : uint8_t
+    {
+      broadcast = 0,
+      multicast = 1,
+      unicast = 2
+    };
+
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint8_t FLAG_WAIT_ANSWER = 0x01;
+    static constexpr size_t HOP_OFFSET = 4;
+    static constexpr size_t MESSAGE_ID_OFFSET = 8;
+    static constexpr size_t SIZES_OFFSET = MESSAGE_ID_OFFSET + sizeof(crypto::hash);
+    static constexpr size_t HEADER_SIZE = SIZES_OFFSET + 4 * sizeof(uint32_t);
+
+    message_type type = broadcast;
+    bool wait_answer = false;
+    uint32_t hop = 0;
+    crypto::hash message_id = crypto::null_hash;
+    const crypto::public_key *receivers = nullptr;
+    size_t receivers_count = 0;
+    boost::string_ref sender_address;
+    boost::string_ref callback_uri;
+    boost::string_ref data;
+
+    /*!
+     * \brief parse - parses message from the buffer, the buffer must outlive the message
+     * \return      - false if the buffer is not a valid message of the supported version
+     */
+    bool parse(const std::string &buffer)
+    {
+      if (buffer.size() < HEADER_SIZE || static_cast<uint8_t>(buffer[0]) != VERSION || static_cast<uint8_t>(buffer[1]) > unicast)
+        return false;
+
+      const char *header = buffer.data();
+      type = static_cast<message_type>(header[1]);
+      wait_answer = (static_cast<uint8_t>(header[2]) & FLAG_WAIT_ANSWER) != 0;
+      hop = read_uint32(header + HOP_OFFSET);
+      memcpy(message_id.data, header + MESSAGE_ID_OFFSET, sizeof(message_id.data));
+
+      const uint64_t receivers_size = uint64_t(read_uint32(header + SIZES_OFFSET)) * sizeof(crypto::public_key);
+      const uint64_t sender_address_size = read_uint32(header + SIZES_OFFSET + 4);
+      const uint64_t callback_uri_size = read_uint32(header + SIZES_OFFSET + 8);
+      const uint64_t data_size = read_uint32(header + SIZES_OFFSET + 12);
+      if (HEADER_SIZE + receivers_size + sender_address_size + callback_uri_size + data_size != buffer.size())
+        return false;
+
+      const char *body = header + HEADER_SIZE;
+      receivers = reinterpret_cast<const crypto::public_key*>(body);
+      receivers_count = receivers_size / sizeof(crypto::public_key);
+      body += receivers_size;
+      sender_address = boost::string_ref(body, sender_address_size);
+      body += sender_address_size;
+      callback_uri = boost::string_ref(body, callback_uri_size);
+      body += callback_uri_size;
+      data = boost::string_ref(body, data_size);
+      return true;
+    }
+
+    /*!
+     * \brief get_receiver_addresses - receivers in the form used by RPC (hex encoded public keys)
+     */
+    std::list<std::string> get_receiver_addresses() const
+    {
+      std::list<std::string> addresses;
+      for (size_t i = 0; i < receivers_count; ++i)
+        addresses.push_back(epee::string_tools::pod_to_hex(receivers[i]));
+      return addresses;
+    }
+
+    /*!
+     * \brief set_hop - patches hop of the serialized message
+     */
+    static void set_hop(std::string &buffer, uint32_t hop)
+    {
+      hop = SWAP32LE(hop);
+      memcpy(&buffer[HOP_OFFSET], &hop, sizeof(hop));
+    }
+
+    /*!
+     * \brief serialize - builds message from the RPC request fields
+     * \param message_id - hex encoded message hash
+     * \param receivers  - hex encoded supernode public keys
+     * \return           - false (and empty buffer) if message id or any of receivers can't be represented in binary form
+     */
+    static bool serialize(message_type type, uint64_t hop, const std::string &message_id, const std::list<std::string> &receivers,
+                          const std::string &sender_address, const std::string &callback_uri, const std::string &data, bool wait_answer,
+                          std::string &buffer)
+    {
+      buffer.clear();
+      crypto::hash id;
+      if (!epee::string_tools::hex_to_pod(message_id, id))
+        return false;
+
+      buffer.reserve(HEADER_SIZE + receivers.size() * sizeof(crypto::public_key) + sender_address.size() + callback_uri.size() + data.size());
+      buffer.push_back(static_cast<char>(VERSION));
+      buffer.push_back(static_cast<char>(type));
+      buffer.push_back(static_cast<char>(wait_answer ? FLAG_WAIT_ANSWER : 0));
+      buffer.push_back(0);
+      append_uint32(buffer, static_cast<uint32_t>(std::min<uint64_t>(hop, UINT32_MAX)));
+      buffer.append(id.data, sizeof(id.data));
+      append_uint32(buffer, static_cast<uint32_t>(receivers.size()));
+      append_uint32(buffer, static_cast<uint32_t>(sender_address.size()));
+      append_uint32(buffer, static_cast<uint32_t>(callback_uri.size()));
+      append_uint32(buffer, static_cast<uint32_t>(data.size()));
+      for (const std::string &receiver : receivers)
+      {
+        crypto::public_key key;
+        if (!epee::string_tools::hex_to_pod(receiver, key))
+        {
+          buffer.clear();
+          return false;
+        }
+        buffer.append(reinterpret_cast<const char*>(&key), sizeof(key));
+      }
+      buffer.append(sender_address);
+      buffer.append(callback_uri);
+      buffer.append(data);
+      return true;
+    }
+
+    /*!
+     * \brief to_request - fills common fields of RPC and legacy p2p requests
+     */
+    template<class t_request>
+    void to_request(t_request &req) const
+    {
+      req.sender_address.assign(sender_address.data(), sender_address.size());
+      req.callback_uri.assign(callback_uri.data(), callback_uri.size());
+      req.data.assign(data.data(), data.size());
+      req.wait_answer = wait_answer;
+    }
+
+  private:
+    static uint32_t read_uint32(const char *p)
+    {
+      uint32_t value;
+      memcpy(&value, p, sizeof(value));
+      return SWAP32LE(value);
+    }
+
+    static void append_uint32(std::string &buffer, uint32_t value)
+    {
+      value = SWAP32LE(value);
+      buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+  };
+}
@@ -0,0 +1,254 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief rta_metrics - counters and histograms of the RTA message path
+   *
+   * All values are relaxed atomics, recording never takes a lock. Recording is off until the metrics are
+   * requested for the first time (is_enabled() is the only cost on the hot path before that), so daemons
+   * which are never scraped don't even read the clock.
+   */
+  class rta_metrics
+  {
+  public:
+    enum message_type
+    {
+      announce,
+      broadcast,
+      multicast,
+      unicast,
+      message_types_count
+    };
+
+    static const char *get_message_type_name(message_type type)
+    {
+      static const char *const names[message_types_count] = { "announce", "broadcast", "multicast", "unicast" };
+      return names[type];
+    }
+
+    /*!
+     * \brief histogram - power of two buckets, bucket i counts values in (2^(i-1), 2^i], the last bucket has no upper bound
+     */
+    class histogram
+    {
+    public:
+      static constexpr size_t BOUNDED_BUCKETS_COUNT = 24;
+
+      histogram()
+      {
+        for (std::atomic<uint64_t> &bucket : m_buckets)
+          bucket = 0;
+      }
+
+      void observe(uint64_t value)
+      {
+        size_t bucket = 0;
+        while (bucket < BOUNDED_BUCKETS_COUNT && value > (uint64_t(1) << bucket))
+          ++bucket;
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      void get(cryptonote::COMMAND_RPC_RTA_METRICS::histogram &res) const
+      {
+        res.bounds.resize(BOUNDED_BUCKETS_COUNT);
+        res.buckets.resize(BOUNDED_BUCKETS_COUNT + 1);
+        for (size_t i = 0; i <= BOUNDED_BUCKETS_COUNT; ++i)
+        {
+          if (i < BOUNDED_BUCKETS_COUNT)
+            res.bounds[i] = get_bucket_bound(i);
+          res.buckets[i] = get_bucket(i);
+        }
+        res.sum = get_sum();
+        res.count = get_count();
+      }
+
+      static uint64_t get_bucket_bound(size_t bucket) { return uint64_t(1) << bucket; }
+      uint64_t get_bucket(size_t bucket) const { return m_buckets[bucket].load(std::memory_order_relaxed); }
+      uint64_t get_sum() const { return m_sum.load(std::memory_order_relaxed); }
+      uint64_t get_count() const { return m_count.load(std::memory_order_relaxed); }
+
+    private:
+      std::array<std::atomic<uint64_t>, BOUNDED_BUCKETS_COUNT + 1> m_buckets;
+      std::atomic<uint64_t> m_sum {0};
+      std::atomic<uint64_t> m_count {0};
+    };
+
+    struct message_metrics
+    {
+      std::atomic<uint64_t> received {0};
+      std::atomic<uint64_t> duplicates {0}; // dropped by the message id cache
+      std::atomic<uint64_t> relayed {0};    // messages sent to peers
+      histogram handling_us;                // from receipt to local delivery and relay, microseconds
+      histogram fanout;                     // peers a message is relayed to
+    };
+
+    /*!
+     * \brief timer - records microseconds elapsed from construction to destruction if metrics are enabled
+     */
+    class timer
+    {
+    public:
+      explicit timer(histogram &h)
+        : m_histogram(is_enabled() ? &h : nullptr)
+      {
+        if (m_histogram)
+          m_start = std::chrono::steady_clock::now();
+      }
+
+      ~timer()
+      {
+        if (m_histogram)
+          m_histogram->observe(get_elapsed_us(m_start));
+      }
+
+      timer(const timer&) = delete;
+      timer& operator=(const timer&) = delete;
+
+    private:
+      histogram *m_histogram;
+      std::chrono::steady_clock::time_point m_start;
+    };
+
+    /*!
+     * \brief timed_lock_guard - lock guard which records time spent waiting for the lock
+     */
+    template<class mutex_type>
+    class timed_lock_guard
+    {
+    public:
+      timed_lock_guard(mutex_type &mutex, histogram &wait_us)
+        : m_mutex(mutex)
+      {
+        if (!is_enabled())
+        {
+          m_mutex.lock();
+          return;
+        }
+        if (m_mutex.try_lock())
+        {
+          wait_us.observe(0);
+          return;
+        }
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        m_mutex.lock();
+        wait_us.observe(get_elapsed_us(start));
+      }
+
+      ~timed_lock_guard() { m_mutex.unlock(); }
+
+      timed_lock_guard(const timed_lock_guard&) = delete;
+      timed_lock_guard& operator=(const timed_lock_guard&) = delete;
+
+    private:
+      mutex_type &m_mutex;
+    };
+
+    /*!
+     * \brief is_enabled/enable - recording is process wide and is turned on by the first metrics request
+     */
+    static bool is_enabled() { return get_enabled_flag().load(std::memory_order_relaxed); }
+    static void enable() { get_enabled_flag().store(true, std::memory_order_relaxed); }
+
+    static uint64_t get_elapsed_us(std::chrono::steady_clock::time_point start)
+    {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /*!
+     * \brief write_histogram - writes histogram in the Prometheus text format, graft_rta_<name>_bucket series
+     *        with cumulative counts and the le label, then _sum and _count
+     * \param labels - comma separated labels of all the series, may be empty
+     */
+    static void write_histogram(std::ostream &out, const std::string &name, const std::string &labels,
+                                const cryptonote::COMMAND_RPC_RTA_METRICS::histogram &h)
+    {
+      const std::string separator = labels.empty() ? "" : ",";
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i < h.buckets.size(); ++i)
+      {
+        cumulative += h.buckets[i];
+        out << "graft_rta_" << name << "_bucket{" << labels << separator << "le=\"";
+        if (i < h.bounds.size())
+          out << h.bounds[i];
+        else
+          out << "+Inf";
+        out << "\"} " << cumulative << '\n';
+      }
+      const std::string braced = labels.empty() ? "" : "{" + labels + "}";
+      out << "graft_rta_" << name << "_sum" << braced << ' ' << h.sum << '\n';
+      out << "graft_rta_" << name << "_count" << braced << ' ' << h.count << '\n';
+    }
+
+    message_metrics &get(message_type type) { return m_messages[type]; }
+    const message_metrics &get(message_type type) const { return m_messages[type]; }
+
+    /*!
+     * \brief record_relay - counts message sent to the peers, peers is the number of successful sends
+     */
+    void record_relay(message_type type, uint64_t peers)
+    {
+      message_metrics &metrics = m_messages[type];
+      metrics.relayed.fetch_add(peers, std::memory_order_relaxed);
+      metrics.fanout.observe(peers);
+    }
+
+    histogram &get_supernode_lock_wait_us() { return m_supernode_lock_wait_us; }
+    const histogram &get_supernode_lock_wait_us() const { return m_supernode_lock_wait_us; }
+
+    // time spent in posting a request to a local supernode (serialization and queueing)
+    histogram &get_supernode_post_us() { return m_supernode_post_us; }
+    const histogram &get_supernode_post_us() const { return m_supernode_post_us; }
+
+  private:
+    static std::atomic<bool> &get_enabled_flag()
+    {
+      static std::atomic<bool> enabled(false);
+      return enabled;
+    }
+
+    std::array<message_metrics, message_types_count> m_messages;
+    histogram m_supernode_lock_wait_us;
+    histogram m_supernode_post_us;
+  };
+}
@@ -0,0 +1,232 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/threadpool.h"
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "string_tools.h"
+#include "p2p_protocol_defs.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief supernode_announce_batch - supernode announces received since the last flush
+   *
+   * Announces are coalesced by supernode: an announce for an older height than the pending one is stale,
+   * an announce for the same height only adds the peer it came from. Pending announces are validated
+   * in parallel (stake of the supernode and, if enabled, its signature) and then processed (routes update,
+   * relay and delivery to local supernodes) together.
+   */
+  class supernode_announce_batch
+  {
+  public:
+    typedef COMMAND_SUPERNODE_ANNOUNCE::request announce_request;
+    typedef std::unordered_set<std::string> supernode_id_set;
+    typedef std::shared_ptr<const supernode_id_set> supernode_id_set_ptr;
+
+    struct entry
+    {
+      announce_request announce;
+      std::vector<peerlist_entry> peers; // peers the announce has been received from
+      bool local = false;                // announce of the supernode registered at this daemon
+      bool valid = false;
+    };
+
+    // number of announces validated by one thread pool task
+    static constexpr size_t VALIDATION_TASK_SIZE = 32;
+    // announces of new supernodes are dropped when the batch is full
+    static constexpr size_t MAX_ENTRIES_COUNT = 65536;
+
+    /*!
+     * \brief add - adds announce received from the peer (nullptr for local supernodes) to the batch
+     * \return    - false if the announce is stale, already pending or the batch is full
+     */
+    bool add(const announce_request &announce, const peerlist_entry *peer)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      auto it = m_entries.find(announce.supernode_public_id);
+      if (it == m_entries.end())
+      {
+        if (m_entries.size() >= MAX_ENTRIES_COUNT)
+          return false;
+        entry &e = m_entries[announce.supernode_public_id];
+        e.announce = announce;
+        e.local = !peer;
+        if (peer)
+          e.peers.push_back(*peer);
+        return true;
+      }
+      entry &e = it->second;
+      if (announce.height < e.announce.height)
+        return false;
+      if (announce.height > e.announce.height)
+      {
+        e.announce = announce;
+        e.peers.clear();
+      }
+      else
+      {
+        if (!peer || std::any_of(e.peers.begin(), e.peers.end(), [peer](const peerlist_entry &p) { return p.id == peer->id; }))
+          return false;
+        e.announce.hop = std::max(e.announce.hop, announce.hop);
+      }
+      e.local = e.local || !peer;
+      if (peer)
+        e.peers.push_back(*peer);
+      return true;
+    }
+
+    /*!
+     * \brief set_staked_supernodes - sets ids of supernodes with stakes, announces of other supernodes are not relayed
+     */
+    void set_staked_supernodes(supernode_id_set_ptr ids)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_staked_supernodes = std::move(ids);
+    }
+
+    /*!
+     * \brief set_check_signatures - enables check of announce signatures; disabled by default as the signed
+     *                               message has to match the one supernodes sign (see get_signed_hash)
+     */
+    void set_check_signatures(bool check_signatures)
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_check_signatures = check_signatures;
+    }
+
+    /*!
+     * \brief take - removes pending announces from the batch and validates them
+     */
+    std::vector<entry> take()
+    {
+      std::vector<entry> entries;
+      supernode_id_set_ptr staked_supernodes;
+      bool check_signatures = false;
+      {
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        entries.reserve(m_entries.size());
+        for (auto &e : m_entries)
+          entries.emplace_back(std::move(e.second));
+        m_entries.clear();
+        staked_supernodes = m_staked_supernodes;
+        check_signatures = m_check_signatures;
+      }
+
+      const supernode_id_set *ids = staked_supernodes.get();
+      tools::threadpool &tpool = tools::threadpool::getInstance();
+      tools::threadpool::waiter waiter;
+      for (size_t first = 0; first < entries.size(); first += VALIDATION_TASK_SIZE)
+      {
+        const size_t last = std::min(first + VALIDATION_TASK_SIZE, entries.size());
+        tpool.submit(&waiter, [&entries, ids, check_signatures, first, last]() {
+          for (size_t i = first; i < last; ++i)
+            entries[i].valid = check(entries[i].announce, entries[i].local ? nullptr : ids, check_signatures);
+        }, true);
+      }
+      waiter.wait(&tpool);
+      return entries;
+    }
+
+    size_t size() const
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      return m_entries.size();
+    }
+
+    /*!
+     * \brief make_supernode_request - makes request with the announces for the local supernode but its own one
+     * \return                       - false if there is nothing to send
+     */
+    static bool make_supernode_request(const std::vector<const entry*> &entries, const std::string &supernode_public_id,
+                                       cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES::request &req)
+    {
+      req.announces.clear();
+      req.announces.reserve(entries.size());
+      for (const entry *e : entries)
+      {
+        if (e->announce.supernode_public_id == supernode_public_id)
+          continue;
+        req.announces.emplace_back();
+        cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES::announce &a = req.announces.back();
+        a.supernode_public_id = e->announce.supernode_public_id;
+        a.height = e->announce.height;
+        a.signature = e->announce.signature;
+        a.network_address = e->announce.network_address;
+      }
+      return !req.announces.empty();
+    }
+
+    /*!
+     * \brief get_signed_hash - hash of "<supernode_public_id>:<height>:<network_address>" signed by the supernode id key
+     */
+    static crypto::hash get_signed_hash(const announce_request &announce)
+    {
+      const std::string data = announce.supernode_public_id + ":" + std::to_string(announce.height) + ":" + announce.network_address;
+      crypto::hash hash;
+      crypto::cn_fast_hash(data.data(), data.size(), hash);
+      return hash;
+    }
+
+    /*!
+     * \brief check - checks the announce supernode id, its stake and signature
+     * \param staked_supernodes - supernodes with stakes, the supernode has to be one of them (not checked if nullptr,
+     *                            i.e. for local supernodes and until stakes are known)
+     * \param check_signature   - whether to check the signature by the supernode id key or only its format
+     */
+    static bool check(const announce_request &announce, const supernode_id_set *staked_supernodes, bool check_signature)
+    {
+      crypto::public_key id;
+      crypto::signature signature;
+      if (!epee::string_tools::hex_to_pod(announce.supernode_public_id, id) || !crypto::check_key(id) ||
+          !epee::string_tools::hex_to_pod(announce.signature, signature))
+        return false;
+      if (staked_supernodes && !staked_supernodes->count(announce.supernode_public_id))
+        return false;
+      return !check_signature || crypto::check_signature(get_signed_hash(announce), id, signature);
+    }
+
+  private:
+    mutable boost::mutex m_lock;
+    std::unordered_map<std::string, entry> m_entries;
+    supernode_id_set_ptr m_staked_supernodes;
+    bool m_check_signatures = false;
+  };
+}
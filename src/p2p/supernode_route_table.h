@@ -0,0 +1,246 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "p2p_protocol_defs.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief supernode_route_table - routes to the announced supernodes
+   *
+   * Routes are immutable and shared: readers get a pointer to the current version of a route
+   * and use it without any lock, writers publish a modified copy instead of changing the route
+   * in place. Routes are spread over shards by the hash of the supernode public id, so lookups
+   * lock only one shard for the time of a hash table search and never copy the table.
+   */
+  class supernode_route_table
+  {
+  public:
+    typedef std::shared_ptr<const supernode_route> route_ptr;
+    typedef std::function<route_ptr(const supernode_route *current_route)> update_function;
+
+    static constexpr size_t SHARDS_COUNT = 16;
+    static constexpr uint64_t ANNOUNCE_LIFETIME = DIFFICULTY_TARGET_V2;
+
+    supernode_route_table() : m_size(0) {}
+
+    supernode_route_table(const supernode_route_table&) = delete;
+    supernode_route_table& operator=(const supernode_route_table&) = delete;
+
+    /*!
+     * \brief find - current version of the route to the supernode
+     * \return     - nullptr if supernode has not been announced
+     */
+    route_ptr find(const std::string &supernode_public_id) const
+    {
+      const shard &s = get_shard(supernode_public_id);
+      boost::shared_lock<boost::shared_mutex> lock(s.lock);
+      auto it = s.routes.find(supernode_public_id);
+      return it != s.routes.end() ? it->second : route_ptr();
+    }
+
+    /*!
+     * \brief update - replaces route to the supernode atomically with respect to other updates of the same route
+     * \param f      - builds new version of the route from the current one (nullptr if there is no route);
+     *                 returns nullptr to keep the current route; called under the shard lock
+     */
+    void update(const std::string &supernode_public_id, const update_function &f)
+    {
+      shard &s = get_shard(supernode_public_id);
+      boost::unique_lock<boost::shared_mutex> lock(s.lock);
+      auto it = s.routes.find(supernode_public_id);
+      route_ptr new_route = f(it != s.routes.end() ? it->second.get() : nullptr);
+      if (!new_route)
+        return;
+      if (it != s.routes.end())
+      {
+        it->second = std::move(new_route);
+        return;
+      }
+      s.routes.emplace(supernode_public_id, std::move(new_route));
+      ++m_size;
+    }
+
+    /*!
+     * \brief for_each - calls f(supernode_public_id, route) for each route; routes are collected shard by shard,
+     *                   f is called without locks
+     */
+    template<class F>
+    void for_each(F f) const
+    {
+      std::vector<std::pair<std::string, route_ptr>> routes;
+      for (const shard &s : m_shards)
+      {
+        {
+          boost::shared_lock<boost::shared_mutex> lock(s.lock);
+          routes.assign(s.routes.begin(), s.routes.end());
+        }
+        for (const auto &route : routes)
+          f(route.first, *route.second);
+      }
+    }
+
+    /*!
+     * \brief max_hop - max hop among the routes to the given supernodes
+     */
+    template<class Container>
+    uint64_t max_hop(const Container &supernode_public_ids) const
+    {
+      uint64_t result = 0;
+      for (const std::string &id : supernode_public_ids)
+      {
+        route_ptr route = find(id);
+        if (route && result < route->max_hop)
+          result = route->max_hop;
+      }
+      return result;
+    }
+
+    /*!
+     * \brief max_hop - max hop among all routes
+     */
+    uint64_t max_hop() const
+    {
+      uint64_t result = 0;
+      for (const shard &s : m_shards)
+      {
+        boost::shared_lock<boost::shared_mutex> lock(s.lock);
+        for (const auto &route : s.routes)
+          if (result < route.second->max_hop)
+            result = route.second->max_hop;
+      }
+      return result;
+    }
+
+    size_t size() const { return m_size; }
+
+    /*!
+     * \brief is_actual - the route has been announced for the height less than ANNOUNCE_LIFETIME seconds ago;
+     *                    announces of an actual route only add peers to it
+     */
+    static bool is_actual(const supernode_route &route, uint64_t height, uint64_t now)
+    {
+      return route.last_announce_height == height && route.last_announce_time + ANNOUNCE_LIFETIME > now;
+    }
+
+    /*!
+     * \brief add_route_peers - copy of the route with the new peers appended and max hop updated
+     * \return                - nullptr if the route doesn't change
+     */
+    static route_ptr add_route_peers(const supernode_route &route, uint64_t hop, const std::vector<peerlist_entry> &peers)
+    {
+      std::shared_ptr<supernode_route> new_route;
+      for (const peerlist_entry &pe : peers)
+      {
+        const supernode_route &current = new_route ? *new_route : route;
+        if (std::any_of(current.peers.begin(), current.peers.end(), [&pe](const peerlist_entry &p) { return pe.id == p.id; }))
+          continue;
+        if (!new_route)
+          new_route = std::make_shared<supernode_route>(route);
+        new_route->peers.push_back(pe);
+      }
+      if (route.max_hop < hop)
+      {
+        if (!new_route)
+          new_route = std::make_shared<supernode_route>(route);
+        new_route->max_hop = hop;
+      }
+      return new_route;
+    }
+
+    /*!
+     * \brief make_announced_route - route after an announce received from the peers: the peers are added to
+     *                               the actual route, a missing or expired route is replaced by a new one
+     * \param existing             - return-by-reference, true if the route has been actual
+     * \return                     - nullptr if the route doesn't change
+     */
+    static route_ptr make_announced_route(const supernode_route *route, uint64_t height, uint64_t hop,
+                                          const std::vector<peerlist_entry> &peers, uint64_t now, bool &existing)
+    {
+      existing = route && is_actual(*route, height, now);
+      if (existing)
+        return add_route_peers(*route, hop, peers);
+      std::shared_ptr<supernode_route> new_route = std::make_shared<supernode_route>();
+      new_route->last_announce_height = height;
+      new_route->last_announce_time = now;
+      new_route->max_hop = hop;
+      for (const peerlist_entry &pe : peers)
+      {
+        if (std::none_of(new_route->peers.begin(), new_route->peers.end(), [&pe](const peerlist_entry &p) { return pe.id == p.id; }))
+          new_route->peers.push_back(pe);
+      }
+      return new_route;
+    }
+
+    /*!
+     * \brief select_peers - calls f(peer) for the route peers in announce order (the first announcer is the closest one)
+     *                       until max_count of them have been accepted
+     * \return             - number of accepted peers
+     */
+    template<class F>
+    static size_t select_peers(const supernode_route &route, size_t max_count, F f)
+    {
+      size_t count = 0;
+      for (const peerlist_entry &pe : route.peers)
+      {
+        if (count >= max_count)
+          break;
+        if (f(pe))
+          ++count;
+      }
+      return count;
+    }
+
+  private:
+    struct shard
+    {
+      mutable boost::shared_mutex lock;
+      std::unordered_map<std::string, route_ptr> routes;
+    };
+
+    shard &get_shard(const std::string &supernode_public_id) { return m_shards[std::hash<std::string>()(supernode_public_id) % SHARDS_COUNT]; }
+    const shard &get_shard(const std::string &supernode_public_id) const { return m_shards[std::hash<std::string>()(supernode_public_id) % SHARDS_COUNT]; }
+
+    std::array<shard, SHARDS_COUNT> m_shards;
+    std::atomic<size_t> m_size;
+  };
+}
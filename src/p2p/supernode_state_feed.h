@@ -0,0 +1,406 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_core/stake_transaction_processor.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+#include "local_supernode.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief supernode_state_feed - stakes and blockchain based list updates prepared for local supernodes
+   *
+   * The feed keeps the last pushed state and builds a versioned delta against it (added, changed and removed
+   * entries) in epee binary encoding for supernodes which know the previous version, and a full snapshot for the others.
+   * Full snapshots are also pushed to everybody every FULL_SNAPSHOT_PERIOD updates, so supernodes which have missed
+   * a delta are resynchronized. JSON requests with full state are built only for supernodes without delta support.
+   * Each request is serialized once for all supernodes. Address strings are cached by supernode id.
+   *
+   * The feed is not thread safe, updates have to be serialized by the caller.
+   */
+  class supernode_state_feed
+  {
+  public:
+    typedef cryptonote::StakeTransactionProcessor::supernode_stake_array stake_array;
+    typedef cryptonote::StakeTransactionProcessor::supernode_tier_array  tier_array;
+    typedef cryptonote::COMMAND_RPC_SUPERNODE_STAKES_DELTA                stakes_delta;
+    typedef cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA list_delta;
+
+    // number of consecutive deltas after which the full state is pushed to all supernodes
+    static constexpr size_t FULL_SNAPSHOT_PERIOD = 100;
+
+    static constexpr const char *STAKES_METHOD = "send_supernode_stakes";
+    static constexpr const char *STAKES_BINARY_ENDPOINT = "/send_supernode_stakes.bin";
+    static constexpr const char *LIST_METHOD = "blockchain_based_list";
+    static constexpr const char *LIST_BINARY_ENDPOINT = "/blockchain_based_list.bin";
+
+    /*!
+     * \brief supernode_state - feed related state of a local supernode collected under the supernodes lock
+     */
+    struct supernode_state
+    {
+      bool supports_delta;
+      uint64_t version;
+    };
+
+    /*!
+     * \brief update - serialized requests of one state update
+     */
+    struct update
+    {
+      uint64_t version = 0;      // version of the state after the update
+      uint64_t base_version = 0; // version the delta has to be applied to, equal to version if the state hasn't changed
+      bool history = false;      // update for the past block, it doesn't change the feed state
+      std::string delta;         // binary delta, empty if full state has to be sent to all supernodes
+      std::string full;          // binary full state, empty if no supernode needs it
+      std::string json;          // JSON-RPC full state, empty if there are no supernodes without delta support
+
+      /*!
+       * \brief is_full_needed - supernode which knows supernode_version can't apply the delta
+       */
+      bool is_full_needed(uint64_t supernode_version) const
+      {
+        return history || !supernode_version || supernode_version != base_version || (version != base_version && delta.empty());
+      }
+
+      bool is_full_needed(const std::vector<supernode_state> &supernodes) const
+      {
+        for (const supernode_state &sn : supernodes)
+          if (sn.supports_delta && is_full_needed(sn.version))
+            return true;
+        return false;
+      }
+
+      static bool is_json_needed(const std::vector<supernode_state> &supernodes)
+      {
+        for (const supernode_state &sn : supernodes)
+          if (!sn.supports_delta)
+            return true;
+        return false;
+      }
+    };
+
+    supernode_state_feed()
+      // versions start at random so the versions of the previous daemon run are never taken as the base
+      : m_last_version(crypto::rand<uint64_t>() >> 1)
+    {
+    }
+
+    uint64_t get_stakes_version() const { return m_stakes.version; }
+    uint64_t get_list_version() const { return m_list.version; }
+    uint64_t get_list_block_height() const { return m_list.block_height; }
+
+    /*!
+     * \brief make_stakes_update - updates stakes state and serializes requests for it
+     * \param supernodes - supernodes the update is built for
+     */
+    bool make_stakes_update(cryptonote::network_type nettype, uint64_t block_height, const stake_array &stakes,
+                            const std::vector<supernode_state> &supernodes, update &result)
+    {
+      stakes_delta::request delta = AUTO_VAL_INIT(delta);
+      std::unordered_map<std::string, stakes_delta::supernode_stake> new_stakes;
+      new_stakes.reserve(stakes.size());
+
+      for (const cryptonote::supernode_stake &src : stakes)
+      {
+        stakes_delta::supernode_stake dst;
+        dst.amount                   = src.amount;
+        dst.tier                     = src.tier;
+        dst.block_height             = src.block_height;
+        dst.unlock_time              = src.unlock_time;
+        dst.supernode_public_id      = src.supernode_public_id;
+        dst.supernode_public_address = src.supernode_public_address;
+
+        auto it = m_stakes.entries.find(src.supernode_public_id);
+        if (it == m_stakes.entries.end() || !equal(it->second, dst))
+          delta.stakes.push_back(dst);
+        new_stakes.emplace(src.supernode_public_id, std::move(dst));
+      }
+
+      for (const auto &entry : m_stakes.entries)
+        if (!new_stakes.count(entry.first))
+          delta.removed_supernodes.push_back(entry.first);
+
+      const bool changed = !delta.stakes.empty() || !delta.removed_supernodes.empty() || block_height != m_stakes.block_height;
+      result = update();
+      result.base_version = result.version = m_stakes.version;
+
+      if (changed || !m_stakes.version)
+      {
+        const bool has_delta = m_stakes.version && m_stakes.deltas_count + 1 < FULL_SNAPSHOT_PERIOD;
+        delta.base_version = m_stakes.version;
+        delta.version = result.version = ++m_last_version;
+        delta.block_height = block_height;
+        if (has_delta && !epee::serialization::store_t_to_binary(delta, result.delta))
+          return false;
+        m_stakes.deltas_count = has_delta ? m_stakes.deltas_count + 1 : 0;
+        m_stakes.version = result.version;
+        m_stakes.block_height = block_height;
+        m_stakes.entries = std::move(new_stakes);
+      }
+
+      if (result.is_full_needed(supernodes))
+      {
+        stakes_delta::request full = AUTO_VAL_INIT(full);
+        full.version = m_stakes.version;
+        full.block_height = m_stakes.block_height;
+        full.stakes.reserve(stakes.size());
+        for (const cryptonote::supernode_stake &src : stakes)
+          full.stakes.push_back(m_stakes.entries[src.supernode_public_id]);
+        if (!epee::serialization::store_t_to_binary(full, result.full))
+          return false;
+      }
+
+      if (update::is_json_needed(supernodes))
+      {
+        cryptonote::COMMAND_RPC_SUPERNODE_STAKES::request request;
+        request.block_height = block_height;
+        request.stakes.reserve(stakes.size());
+        for (const cryptonote::supernode_stake &src : stakes)
+        {
+          cryptonote::COMMAND_RPC_SUPERNODE_STAKES::supernode_stake dst;
+          dst.amount                   = src.amount;
+          dst.tier                     = src.tier;
+          dst.block_height             = src.block_height;
+          dst.unlock_time              = src.unlock_time;
+          dst.supernode_public_id      = src.supernode_public_id;
+          dst.supernode_public_address = get_address_string(nettype, src.supernode_public_id, src.supernode_public_address);
+          request.stakes.emplace_back(std::move(dst));
+        }
+        if (!local_supernode::serialize<cryptonote::COMMAND_RPC_SUPERNODE_STAKES>(STAKES_METHOD, request, result.json))
+          return false;
+      }
+
+      prune_address_strings();
+      return true;
+    }
+
+    /*!
+     * \brief make_list_update - updates blockchain based list state and serializes requests for it
+     *
+     * Lists for blocks below the last pushed one (history requested by supernodes) are sent as full lists and
+     * don't change the feed state.
+     */
+    bool make_list_update(cryptonote::network_type nettype, uint64_t block_height, const tier_array &tiers,
+                          const std::vector<supernode_state> &supernodes, update &result)
+    {
+      std::vector<std::vector<list_delta::supernode>> new_tiers(tiers.size());
+      for (size_t i = 0; i < tiers.size(); i++)
+      {
+        new_tiers[i].reserve(tiers[i].size());
+        for (const cryptonote::BlockchainBasedList::supernode &src : tiers[i])
+        {
+          list_delta::supernode dst;
+          dst.supernode_public_id      = src.supernode_public_id;
+          dst.supernode_public_address = src.supernode_public_address;
+          dst.amount                   = src.amount;
+          new_tiers[i].emplace_back(std::move(dst));
+        }
+      }
+
+      result = update();
+      result.history = m_list.version && block_height < m_list.block_height;
+
+      if (!result.history)
+      {
+        list_delta::request delta = AUTO_VAL_INIT(delta);
+        const bool has_delta = m_list.version && m_list.deltas_count + 1 < FULL_SNAPSHOT_PERIOD && make_tiers_delta(m_list.tiers, new_tiers, delta.tiers);
+        const bool changed = !has_delta || block_height != m_list.block_height || !empty(delta.tiers);
+
+        result.base_version = result.version = m_list.version;
+        if (changed)
+        {
+          delta.base_version = m_list.version;
+          delta.base_block_height = m_list.block_height;
+          delta.version = result.version = ++m_last_version;
+          delta.block_height = block_height;
+          if (has_delta && !epee::serialization::store_t_to_binary(delta, result.delta))
+            return false;
+          m_list.deltas_count = has_delta ? m_list.deltas_count + 1 : 0;
+          m_list.version = result.version;
+          m_list.block_height = block_height;
+          m_list.tiers = new_tiers;
+        }
+      }
+
+      if (result.is_full_needed(supernodes))
+      {
+        list_delta::request full = AUTO_VAL_INIT(full);
+        full.version = result.version;
+        full.block_height = block_height;
+        full.tiers.resize(new_tiers.size());
+        for (size_t i = 0; i < new_tiers.size(); i++)
+          full.tiers[i].added_supernodes = std::move(new_tiers[i]);
+        if (!epee::serialization::store_t_to_binary(full, result.full))
+          return false;
+      }
+
+      if (update::is_json_needed(supernodes))
+      {
+        cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request request;
+        request.block_height = block_height;
+        request.tiers.resize(tiers.size());
+        for (size_t i = 0; i < tiers.size(); i++)
+        {
+          request.tiers[i].supernodes.reserve(tiers[i].size());
+          for (const cryptonote::BlockchainBasedList::supernode &src : tiers[i])
+          {
+            cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::supernode dst;
+            dst.supernode_public_id      = src.supernode_public_id;
+            dst.supernode_public_address = get_address_string(nettype, src.supernode_public_id, src.supernode_public_address);
+            dst.amount                   = src.amount;
+            request.tiers[i].supernodes.emplace_back(std::move(dst));
+          }
+        }
+        if (!local_supernode::serialize<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>(LIST_METHOD, request, result.json))
+          return false;
+      }
+
+      return true;
+    }
+
+    /*!
+     * \brief make_tiers_delta - delta between tiers of two lists
+     * \return - false if the new list can't be expressed as a delta (supernodes kept from the base list are reordered)
+     */
+    static bool make_tiers_delta(const std::vector<std::vector<list_delta::supernode>> &base, const std::vector<std::vector<list_delta::supernode>> &tiers,
+                                 std::vector<list_delta::tier> &delta)
+    {
+      if (base.size() != tiers.size())
+        return false;
+
+      delta.assign(tiers.size(), list_delta::tier());
+
+      for (size_t i = 0; i < tiers.size(); i++)
+      {
+        std::unordered_map<std::string, const list_delta::supernode*> new_supernodes;
+        for (const list_delta::supernode &sn : tiers[i])
+          new_supernodes.emplace(sn.supernode_public_id, &sn);
+
+        // supernodes remaining from the base tier have to be the prefix of the new tier in the same order
+        size_t kept_count = 0;
+        for (const list_delta::supernode &sn : base[i])
+        {
+          auto it = new_supernodes.find(sn.supernode_public_id);
+          if (it == new_supernodes.end())
+          {
+            delta[i].removed_supernodes.push_back(sn.supernode_public_id);
+            continue;
+          }
+          if (kept_count >= tiers[i].size() || tiers[i][kept_count].supernode_public_id != sn.supernode_public_id)
+            return false;
+          if (!equal(sn, *it->second))
+            delta[i].changed_supernodes.push_back(*it->second);
+          kept_count++;
+        }
+
+        delta[i].added_supernodes.assign(tiers[i].begin() + kept_count, tiers[i].end());
+      }
+
+      return true;
+    }
+
+  private:
+    struct stakes_state
+    {
+      uint64_t version = 0;
+      uint64_t block_height = 0;
+      size_t deltas_count = 0; // deltas pushed since the last full snapshot
+      std::unordered_map<std::string, stakes_delta::supernode_stake> entries;
+    };
+
+    struct list_state
+    {
+      uint64_t version = 0;
+      uint64_t block_height = 0;
+      size_t deltas_count = 0; // deltas pushed since the last full list
+      std::vector<std::vector<list_delta::supernode>> tiers;
+    };
+
+    struct address_string
+    {
+      cryptonote::account_public_address address;
+      std::string str;
+    };
+
+    static bool equal(const stakes_delta::supernode_stake &a, const stakes_delta::supernode_stake &b)
+    {
+      return a.amount == b.amount && a.tier == b.tier && a.block_height == b.block_height && a.unlock_time == b.unlock_time &&
+        a.supernode_public_address == b.supernode_public_address;
+    }
+
+    static bool equal(const list_delta::supernode &a, const list_delta::supernode &b)
+    {
+      return a.amount == b.amount && a.supernode_public_address == b.supernode_public_address;
+    }
+
+    static bool empty(const std::vector<list_delta::tier> &tiers)
+    {
+      for (const list_delta::tier &tier : tiers)
+        if (!tier.removed_supernodes.empty() || !tier.changed_supernodes.empty() || !tier.added_supernodes.empty())
+          return false;
+      return true;
+    }
+
+    const std::string &get_address_string(cryptonote::network_type nettype, const std::string &supernode_public_id,
+                                          const cryptonote::account_public_address &address)
+    {
+      address_string &cached = m_address_strings[supernode_public_id];
+      if (cached.str.empty() || cached.address != address)
+      {
+        cached.address = address;
+        cached.str = cryptonote::get_account_address_as_str(nettype, false, address);
+      }
+      return cached.str;
+    }
+
+    // drops cached strings of supernodes which have no stake anymore
+    void prune_address_strings()
+    {
+      if (m_address_strings.size() <= 2 * m_stakes.entries.size())
+        return;
+      for (auto it = m_address_strings.begin(); it != m_address_strings.end();)
+        it = m_stakes.entries.count(it->first) ? std::next(it) : m_address_strings.erase(it);
+    }
+
+    uint64_t m_last_version;
+    stakes_state m_stakes;
+    list_state m_list;
+    std::unordered_map<std::string, address_string> m_address_strings;
+  };
+}
@@ -2207,6 +2207,7 @@ namespace cryptonote
       LOG_PRINT_L0("RPC Request: on_supernode_announce: start");
       // send p2p announce
       m_p2p.add_supernode(req.supernode_public_id, req.network_address);
+      m_p2p.set_supernode_announce_batches(req.supernode_public_id, req.batch_announces);
       m_p2p.do_supernode_announce(req);
       res.status = 0;
       LOG_PRINT_L0("RPC Request: on_supernode_announce: end");
@@ -2219,6 +2220,7 @@ namespace cryptonote
       LOG_PRINT_L0("RPC Request: on_supernode_stakes: start");
       // send p2p stakes
       m_p2p.add_supernode(req.supernode_public_id, req.network_address);
+      m_p2p.request_supernode_full_state(req.supernode_public_id, req.binary_delta, true, false);
       m_p2p.send_stakes_to_supernode();
       res.status = 0;
       LOG_PRINT_L0("RPC Request: on_supernode_stakes: end");
@@ -2231,6 +2233,7 @@ namespace cryptonote
       LOG_PRINT_L0("RPC Request: on_supernode_blockchain_based_list: start");
       // send p2p stake txs
       m_p2p.add_supernode(req.supernode_public_id, req.network_address);
+      m_p2p.request_supernode_full_state(req.supernode_public_id, req.binary_delta, false, true);
       m_p2p.send_blockchain_based_list_to_supernode(req.last_received_block_height);
       res.status = 0;
       LOG_PRINT_L0("RPC Request: on_supernode_blockchain_based_list: end");
@@ -2344,6 +2347,78 @@ namespace cryptonote
 
   //------------------------------------------------------------------------------------------------------------------------------
 
+  bool core_rpc_server::on_get_rta_metrics(const COMMAND_RPC_RTA_METRICS::request &req, COMMAND_RPC_RTA_METRICS::response &res, epee::json_rpc::error &error_resp)
+  {
+      m_p2p.get_rta_metrics(res);
+      return true;
+  }
+
+  //------------------------------------------------------------------------------------------------------------------------------
+
+  std::string core_rpc_server::get_rta_metrics_text()
+  {
+      COMMAND_RPC_RTA_METRICS::response metrics = AUTO_VAL_INIT(metrics);
+      m_p2p.get_rta_metrics(metrics);
+
+      std::ostringstream out;
+      const auto write_type = [&out](const char *name, const char *type, const char *help) {
+          out << "# HELP graft_rta_" << name << ' ' << help << "\n# TYPE graft_rta_" << name << ' ' << type << '\n';
+      };
+
+      write_type("bytes_total", "counter", "RTA bytes received and sent to peers");
+      const std::pair<const char*, uint64_t> bytes[] = {
+          {"type=\"announce\",direction=\"in\"", m_p2p.get_announce_bytes_in()},
+          {"type=\"announce\",direction=\"out\"", m_p2p.get_announce_bytes_out()},
+          {"type=\"broadcast\",direction=\"in\"", m_p2p.get_broadcast_bytes_in()},
+          {"type=\"broadcast\",direction=\"out\"", m_p2p.get_broadcast_bytes_out()},
+          {"type=\"multicast\",direction=\"in\"", m_p2p.get_multicast_bytes_in()},
+          {"type=\"multicast\",direction=\"out\"", m_p2p.get_multicast_bytes_out()}
+      };
+      for (const auto &b : bytes)
+          out << "graft_rta_bytes_total{" << b.first << "} " << b.second << '\n';
+
+      write_type("messages_received_total", "counter", "RTA messages received from peers");
+      for (const auto &m : metrics.messages)
+          out << "graft_rta_messages_received_total{type=\"" << m.type << "\"} " << m.received << '\n';
+      write_type("messages_duplicate_total", "counter", "RTA messages dropped as already seen");
+      for (const auto &m : metrics.messages)
+          out << "graft_rta_messages_duplicate_total{type=\"" << m.type << "\"} " << m.duplicates << '\n';
+      write_type("messages_relayed_total", "counter", "RTA messages sent to peers");
+      for (const auto &m : metrics.messages)
+          out << "graft_rta_messages_relayed_total{type=\"" << m.type << "\"} " << m.relayed << '\n';
+      write_type("message_handling_microseconds", "histogram", "Time from receiving RTA message to its delivery and relay");
+      for (const auto &m : metrics.messages)
+          nodetool::rta_metrics::write_histogram(out, "message_handling_microseconds", "type=\"" + m.type + "\"", m.handling_us);
+      write_type("message_fanout", "histogram", "Number of peers RTA message is relayed to");
+      for (const auto &m : metrics.messages)
+          nodetool::rta_metrics::write_histogram(out, "message_fanout", "type=\"" + m.type + "\"", m.fanout);
+
+      write_type("supernode_post_microseconds", "histogram", "Time spent in posting request to local supernode");
+      nodetool::rta_metrics::write_histogram(out, "supernode_post_microseconds", "", metrics.supernode_post_us);
+      write_type("supernode_lock_wait_microseconds", "histogram", "Time spent in waiting for local supernodes lock");
+      nodetool::rta_metrics::write_histogram(out, "supernode_lock_wait_microseconds", "", metrics.supernode_lock_wait_us);
+
+      write_type("supernode_delivered_total", "counter", "Requests delivered to local supernode");
+      for (const auto &sn : metrics.supernodes)
+          out << "graft_rta_supernode_delivered_total{supernode=\"" << sn.supernode_public_id << "\"} " << sn.delivered << '\n';
+      write_type("supernode_failed_total", "counter", "Requests failed to be delivered to local supernode");
+      for (const auto &sn : metrics.supernodes)
+          out << "graft_rta_supernode_failed_total{supernode=\"" << sn.supernode_public_id << "\"} " << sn.failed << '\n';
+      write_type("supernode_dropped_total", "counter", "Requests dropped from local supernode queue");
+      for (const auto &sn : metrics.supernodes)
+          out << "graft_rta_supernode_dropped_total{supernode=\"" << sn.supernode_public_id << "\"} " << sn.dropped << '\n';
+      write_type("supernode_queue_size", "gauge", "Requests waiting for delivery to local supernode");
+      for (const auto &sn : metrics.supernodes)
+          out << "graft_rta_supernode_queue_size{supernode=\"" << sn.supernode_public_id << "\"} " << sn.queue_size << '\n';
+      write_type("supernode_delivery_microseconds", "histogram", "Time from queueing request to its delivery to local supernode");
+      for (const auto &sn : metrics.supernodes)
+          nodetool::rta_metrics::write_histogram(out, "supernode_delivery_microseconds", "supernode=\"" + sn.supernode_public_id + "\"", sn.delivery_us);
+
+      return out.str();
+  }
+
+  //------------------------------------------------------------------------------------------------------------------------------
+
 
   const command_line::arg_descriptor<std::string, false, true, 2> core_rpc_server::arg_rpc_bind_port = {
       "rpc-bind-port"
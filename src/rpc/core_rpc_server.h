@@ -117,6 +117,7 @@ namespace cryptonote
       MAP_URI_AUTO_JON2_IF("/stop_save_graph", on_stop_save_graph, COMMAND_RPC_STOP_SAVE_GRAPH, !m_restricted)
       MAP_URI_AUTO_JON2("/get_outs", on_get_outs, COMMAND_RPC_GET_OUTPUTS)      
       MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
+      MAP_URI2("/rta_metrics", on_get_rta_metrics_text)
       BEGIN_JSON_RPC_MAP("/json_rpc")
         MAP_JON_RPC("get_block_count",           on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
         MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
@@ -164,6 +165,7 @@ namespace cryptonote
         MAP_JON_RPC_WE_IF("send_supernode_stakes",    on_supernode_stakes,         COMMAND_RPC_SUPERNODE_GET_STAKES, !m_restricted)
         MAP_JON_RPC_WE_IF("send_supernode_blockchain_based_list", on_supernode_blockchain_based_list,  COMMAND_RPC_SUPERNODE_GET_BLOCKCHAIN_BASED_LIST, !m_restricted)
         MAP_JON_RPC_WE_IF("get_stats", on_get_rta_stats,  COMMAND_RPC_RTA_STATS, !m_restricted)
+        MAP_JON_RPC_WE_IF("get_metrics", on_get_rta_metrics,  COMMAND_RPC_RTA_METRICS, !m_restricted)
       END_JSON_RPC_MAP()
     END_URI_MAP2()
 
@@ -237,8 +239,24 @@ namespace cryptonote
 
     bool on_get_tunnels(const COMMAND_RPC_TUNNEL_DATA::request &req, COMMAND_RPC_TUNNEL_DATA::response &res, epee::json_rpc::error &error_resp);
     bool on_get_rta_stats(const COMMAND_RPC_RTA_STATS::request &req, COMMAND_RPC_RTA_STATS::response &res, epee::json_rpc::error &error_resp);
+    bool on_get_rta_metrics(const COMMAND_RPC_RTA_METRICS::request &req, COMMAND_RPC_RTA_METRICS::response &res, epee::json_rpc::error &error_resp);
+
+    // RTA metrics in Prometheus text exposition format
+    template<class t_context>
+    bool on_get_rta_metrics_text(const epee::net_utils::http::http_request_info &query_info, epee::net_utils::http::http_response_info &response_info, t_context &context)
+    {
+      if (m_restricted || query_info.m_URI != "/rta_metrics")
+        return false;
+      response_info.m_body = get_rta_metrics_text();
+      response_info.m_response_code = 200;
+      response_info.m_response_comment = "Ok";
+      response_info.m_mime_tipe = "text/plain; version=0.0.4";
+      response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+      return true;
+    }
 
 private:
+    std::string get_rta_metrics_text();
     bool check_core_busy();
     bool check_core_ready();
     
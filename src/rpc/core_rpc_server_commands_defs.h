@@ -2236,9 +2236,11 @@ namespace cryptonote
     {
       std::string supernode_public_id;
       std::string network_address;
+      bool        binary_delta; //supernode accepts COMMAND_RPC_SUPERNODE_STAKES_DELTA instead of full JSON stakes
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(supernode_public_id)
         KV_SERIALIZE(network_address)
+        KV_SERIALIZE_OPT(binary_delta, false)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2290,6 +2292,52 @@ namespace cryptonote
     };
   };
 
+  // Stakes update for supernodes with delta support (epee binary storage), full snapshot if base_version is 0
+  struct COMMAND_RPC_SUPERNODE_STAKES_DELTA
+  {
+    struct supernode_stake
+    {
+      uint64_t amount;
+      unsigned int tier;
+      uint64_t block_height;
+      uint64_t unlock_time;
+      std::string supernode_public_id;
+      cryptonote::account_public_address supernode_public_address;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(amount)
+        KV_SERIALIZE(tier)
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(unlock_time)
+        KV_SERIALIZE(supernode_public_id)
+        KV_SERIALIZE(supernode_public_address)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request
+    {
+      uint64_t version; //version of the stakes after the update
+      uint64_t base_version; //version of the stakes the update has to be applied to
+      uint64_t block_height;
+      std::vector<supernode_stake> stakes; //added and changed stakes (all stakes for full snapshot)
+      std::vector<std::string> removed_supernodes;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(base_version)
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(stakes)
+        KV_SERIALIZE(removed_supernodes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      int64_t status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_SUPERNODE_GET_BLOCKCHAIN_BASED_LIST
   {
     struct request
@@ -2297,10 +2345,12 @@ namespace cryptonote
       std::string supernode_public_id;
       std::string network_address;
       uint64_t    last_received_block_height;
+      bool        binary_delta; //supernode accepts COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA instead of full JSON lists
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(supernode_public_id)
         KV_SERIALIZE(network_address)
         KV_SERIALIZE(last_received_block_height)
+        KV_SERIALIZE_OPT(binary_delta, false)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2354,11 +2404,92 @@ namespace cryptonote
     };
   };
 
+  // Blockchain based list update for supernodes with delta support (epee binary storage), full list if base_version is 0
+  struct COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA
+  {
+    struct supernode
+    {
+      std::string supernode_public_id;
+      cryptonote::account_public_address supernode_public_address;
+      uint64_t    amount;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(supernode_public_id)
+        KV_SERIALIZE(supernode_public_address)
+        KV_SERIALIZE(amount)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    // Tier of the base list without removed supernodes keeps its order, changed supernodes are updated in place, added ones are appended
+    struct tier
+    {
+      std::vector<std::string> removed_supernodes;
+      std::vector<supernode> changed_supernodes;
+      std::vector<supernode> added_supernodes; //all supernodes of the tier for full list
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(removed_supernodes)
+        KV_SERIALIZE(changed_supernodes)
+        KV_SERIALIZE(added_supernodes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request
+    {
+      uint64_t version; //version of the list after the update
+      uint64_t base_version; //version of the list the update has to be applied to
+      uint64_t block_height;
+      uint64_t base_block_height;
+      std::vector<tier> tiers;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(base_version)
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(base_block_height)
+        KV_SERIALIZE(tiers)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      int64_t status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_SUPERNODE_ANNOUNCE
   {
     struct request
     {
 
+      std::string supernode_public_id;
+      uint64_t height;
+      std::string signature; //signature of "<supernode_public_id>:<height>:<network_address>" hash by the supernode id key, checked with --check-supernode-announce-signatures
+      std::string network_address;
+      bool batch_announces; //supernode accepts COMMAND_RPC_SUPERNODE_ANNOUNCES instead of one request per announce
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(supernode_public_id)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(signature)
+        KV_SERIALIZE(network_address)
+        KV_SERIALIZE_OPT(batch_announces, false)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      int64_t status;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_SUPERNODE_ANNOUNCES
+  {
+    struct announce
+    {
       std::string supernode_public_id;
       uint64_t height;
       std::string signature;
@@ -2372,6 +2503,15 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
 
+    struct request
+    {
+      std::vector<announce> announces;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(announces)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response
     {
       int64_t status;
@@ -2539,6 +2679,81 @@ namespace cryptonote
     };
   };
 
+  struct COMMAND_RPC_RTA_METRICS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct histogram
+    {
+      std::vector<uint64_t> bounds;  //upper bounds of the buckets, inclusive
+      std::vector<uint64_t> buckets; //counts per bucket (not cumulative), the last one has no upper bound
+      uint64_t sum;
+      uint64_t count;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(bounds)
+        KV_SERIALIZE(buckets)
+        KV_SERIALIZE(sum)
+        KV_SERIALIZE(count)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct message_type_metrics
+    {
+      std::string type; //announce, broadcast, multicast or unicast
+      uint64_t received;
+      uint64_t duplicates;
+      uint64_t relayed;
+      histogram handling_us;
+      histogram fanout;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(type)
+        KV_SERIALIZE(received)
+        KV_SERIALIZE(duplicates)
+        KV_SERIALIZE(relayed)
+        KV_SERIALIZE(handling_us)
+        KV_SERIALIZE(fanout)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct supernode_metrics
+    {
+      std::string supernode_public_id;
+      uint64_t delivered;
+      uint64_t failed;
+      uint64_t dropped;
+      uint64_t queue_size;
+      histogram delivery_us;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(supernode_public_id)
+        KV_SERIALIZE(delivered)
+        KV_SERIALIZE(failed)
+        KV_SERIALIZE(dropped)
+        KV_SERIALIZE(queue_size)
+        KV_SERIALIZE(delivery_us)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      bool recording; //latencies and lock waits were recorded before this request (the first request enables recording)
+      std::vector<message_type_metrics> messages;
+      std::vector<supernode_metrics> supernodes;
+      histogram supernode_post_us;
+      histogram supernode_lock_wait_us;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(recording)
+        KV_SERIALIZE(messages)
+        KV_SERIALIZE(supernodes)
+        KV_SERIALIZE(supernode_post_us)
+        KV_SERIALIZE(supernode_lock_wait_us)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_GET_OUTPUT_DISTRIBUTION
   {
     struct request
@@ -29,6 +29,9 @@
 #include "zmq_server.h"
 #include <boost/chrono/chrono.hpp>
 
+#include "crypto/crypto.h"
+#include "string_tools.h"
+
 namespace cryptonote
 {
 
@@ -39,7 +42,8 @@ ZmqServer::ZmqServer(RpcHandler& h) :
     handler(h),
     stop_signal(false),
     running(false),
-    context(DEFAULT_NUM_ZMQ_THREADS) // TODO: make this configurable
+    context(DEFAULT_NUM_ZMQ_THREADS), // TODO: make this configurable
+    stream_events(nullptr)
 {
 }
 
@@ -119,10 +123,299 @@ bool ZmqServer::addTCPSocket(std::string address, std::string port)
   return true;
 }
 
+bool ZmqServer::addStreamSocket(std::string address, std::string port, nodetool::rta_event_stream& events)
+{
+  try
+  {
+    std::string addr_prefix("tcp://");
+
+    stream_socket.reset(new zmq::socket_t(context, ZMQ_ROUTER));
+
+    // report unroutable subscribers instead of dropping their messages silently
+    int mandatory = 1;
+    stream_socket->setsockopt(ZMQ_ROUTER_MANDATORY, &mandatory, sizeof(mandatory));
+    int linger = 0;
+    stream_socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+    if (address.empty())
+      address = "*";
+    std::string bind_address = addr_prefix + address + std::string(":") + port;
+    stream_socket->bind(bind_address.c_str());
+  }
+  catch (const std::exception& e)
+  {
+    MERROR(std::string("Error creating ZMQ stream socket: ") + e.what());
+    stream_socket.reset();
+    return false;
+  }
+  stream_events = &events;
+  return true;
+}
+
+void ZmqServer::serveStream()
+{
+  StreamSubscribers subscribers;
+  StreamChallenges challenges;
+  StreamFullStates full_states;
+
+  while (!stop_signal)
+  {
+    try
+    {
+      zmq::pollitem_t item = { static_cast<void *>(*stream_socket), 0, ZMQ_POLLIN, 0 };
+      zmq::poll(&item, 1, DEFAULT_STREAM_POLL_INTERVAL_MS);
+
+      if (item.revents & ZMQ_POLLIN)
+        receiveStreamRequests(subscribers, challenges, full_states);
+
+      const auto now = std::chrono::steady_clock::now();
+      for (auto it = subscribers.begin(); it != subscribers.end();)
+      {
+        auto next = std::next(it);
+        if (now - it->second.renewed >= std::chrono::seconds(uint64_t(nodetool::rta_event_stream::SUBSCRIPTION_TIMEOUT_SECONDS)))
+        {
+          MDEBUG("RTA event stream subscription of " << it->second.supernode_public_id << " has expired");
+          dropStreamSubscriber(subscribers, it);
+        }
+        else if (!sendStreamEvents(it->first, it->second, full_states))
+        {
+          MDEBUG("RTA event stream subscriber " << it->second.supernode_public_id << " has disconnected");
+          dropStreamSubscriber(subscribers, it);
+        }
+        it = next;
+      }
+    }
+    catch (const zmq::error_t& e)
+    {
+      MERROR(std::string("ZMQ stream error: ") + e.what());
+    }
+    boost::this_thread::interruption_point();
+  }
+}
+
+void ZmqServer::receiveStreamRequests(StreamSubscribers& subscribers, StreamChallenges& challenges, StreamFullStates& full_states)
+{
+  static const std::string challenge_reply("challenge"), subscribed_reply("subscribed"), pong_reply("pong"), error_reply("error");
+
+  std::vector<std::string> frames;
+  while (receiveStreamMessage(frames))
+  {
+    if (frames.size() < 2)
+      continue;
+
+    const std::string& identity = frames[0];
+    const std::string& command = frames[1];
+
+    if (command == "challenge")
+    {
+      const auto now = std::chrono::steady_clock::now();
+      if (challenges.size() >= MAX_STREAM_CHALLENGES && !challenges.count(identity))
+      {
+        // pending challenges are dropped only when they expire, so a flood of challenges can't wipe them
+        for (auto it = challenges.begin(); it != challenges.end();)
+          it = now - it->second.issued >= std::chrono::seconds(uint64_t(STREAM_CHALLENGE_TIMEOUT_SECONDS)) ? challenges.erase(it) : std::next(it);
+        if (challenges.size() >= MAX_STREAM_CHALLENGES)
+        {
+          static const std::string message("too many pending challenges");
+          sendStreamMessage(identity, {&error_reply, &message});
+          continue;
+        }
+      }
+      StreamChallenge& challenge = challenges[identity];
+      challenge.nonce = epee::string_tools::pod_to_hex(crypto::rand<crypto::hash>());
+      challenge.issued = now;
+      sendStreamMessage(identity, {&challenge_reply, &challenge.nonce});
+    }
+    else if (command == "subscribe")
+    {
+      unsigned topics = frames.size() >= 4 ? nodetool::rta_event_stream::parse_topics(frames[2]) : 0;
+      uint64_t from_sequence = 0;
+      if (!topics || !epee::string_tools::get_xtype_from_string(from_sequence, frames[3]) || frames.size() == 5)
+      {
+        static const std::string message("invalid subscribe request");
+        sendStreamMessage(identity, {&error_reply, &message});
+        continue;
+      }
+
+      // messages of a supernode are routed to the stream only for its owner, who proves it by signing the challenge
+      std::string supernode_public_id;
+      if (frames.size() >= 6)
+      {
+        auto challenge = challenges.find(identity);
+        const bool authenticated = challenge != challenges.end() &&
+          std::chrono::steady_clock::now() - challenge->second.issued < std::chrono::seconds(uint64_t(STREAM_CHALLENGE_TIMEOUT_SECONDS)) &&
+          stream_events->is_local_supernode(frames[4]) &&
+          nodetool::rta_event_stream::check_subscription_signature(challenge->second.nonce, frames[4], frames[5]);
+        if (challenge != challenges.end())
+          challenges.erase(challenge);
+        if (!authenticated)
+        {
+          MWARNING("RTA event stream subscription of " << frames[4] << " failed authentication");
+          static const std::string message("supernode authentication failed");
+          sendStreamMessage(identity, {&error_reply, &message});
+          continue;
+        }
+        supernode_public_id = frames[4];
+      }
+
+      auto existing = subscribers.find(identity);
+      if (existing != subscribers.end() && existing->second.supernode_public_id != supernode_public_id)
+        dropStreamSubscriber(subscribers, existing);
+
+      StreamSubscriber& subscriber = subscribers[identity];
+      subscriber.topics = topics;
+      subscriber.supernode_public_id = supernode_public_id;
+      subscriber.next_sequence = from_sequence ? from_sequence : stream_events->get_next_sequence();
+      subscriber.renewed = std::chrono::steady_clock::now();
+      stream_events->subscribe(subscriber.supernode_public_id, topics, !from_sequence && requestStreamFullState(full_states, identity, subscriber));
+
+      const std::string next_sequence = std::to_string(subscriber.next_sequence);
+      sendStreamMessage(identity, {&subscribed_reply, &next_sequence});
+    }
+    else if (command == "ping")
+    {
+      auto it = subscribers.find(identity);
+      if (it == subscribers.end())
+      {
+        static const std::string message("not subscribed");
+        sendStreamMessage(identity, {&error_reply, &message});
+        continue;
+      }
+      it->second.renewed = std::chrono::steady_clock::now();
+      if (!it->second.supernode_public_id.empty() && !stream_events->is_local_supernode(it->second.supernode_public_id))
+      {
+        // supernode has been unregistered, its messages are not routed to this connection anymore
+        MDEBUG("RTA event stream subscriber " << it->second.supernode_public_id << " is not a local supernode anymore");
+        const std::string supernode_public_id = it->second.supernode_public_id;
+        it->second.supernode_public_id.clear();
+        stream_events->unsubscribe(supernode_public_id);
+      }
+      stream_events->subscribe(it->second.supernode_public_id, it->second.topics, false);
+
+      const std::string next_sequence = std::to_string(it->second.next_sequence);
+      sendStreamMessage(identity, {&pong_reply, &next_sequence});
+    }
+    else if (command == "unsubscribe")
+    {
+      auto it = subscribers.find(identity);
+      if (it != subscribers.end())
+        dropStreamSubscriber(subscribers, it);
+    }
+    else
+    {
+      static const std::string message("unknown command");
+      sendStreamMessage(identity, {&error_reply, &message});
+    }
+  }
+}
+
+bool ZmqServer::sendStreamEvents(const std::string& identity, StreamSubscriber& subscriber, StreamFullStates& full_states)
+{
+  static const std::string event_reply("event"), gap_reply("gap");
+
+  try
+  {
+    std::vector<nodetool::rta_event_stream::event_ptr> events;
+    bool gap = false;
+    const uint64_t next_sequence = stream_events->get_events(subscriber.next_sequence, subscriber.topics, subscriber.supernode_public_id,
+      MAX_STREAM_EVENTS_PER_POLL, events, gap);
+
+    if (gap)
+    {
+      if (!sendStreamMessage(identity, {&gap_reply}))
+        return true; // subscriber is slow, retry with the next poll
+      subscriber.next_sequence = events.empty() ? next_sequence : events.front()->sequence;
+      stream_events->subscribe(subscriber.supernode_public_id, subscriber.topics, requestStreamFullState(full_states, identity, subscriber));
+    }
+
+    for (const nodetool::rta_event_stream::event_ptr& e : events)
+    {
+      const std::string topic = nodetool::rta_event_stream::get_topic_name(e->type);
+      const std::string sequence = std::to_string(e->sequence);
+      if (!sendStreamMessage(identity, {&event_reply, &topic, &sequence, &e->uri, &e->payload}))
+        return true; // subscriber is slow, it continues from this event with the next poll
+      subscriber.next_sequence = e->sequence + 1;
+    }
+    subscriber.next_sequence = next_sequence;
+  }
+  catch (const zmq::error_t& e)
+  {
+    // EHOSTUNREACH, subscriber has disconnected
+    return false;
+  }
+  return true;
+}
+
+bool ZmqServer::requestStreamFullState(StreamFullStates& full_states, const std::string& identity, const StreamSubscriber& subscriber)
+{
+  // full state is serialized and pushed to all the subscribers, so it is served only to authenticated supernodes
+  // and not more often than once per interval per connection
+  if (subscriber.supernode_public_id.empty())
+    return false;
+
+  const auto now = std::chrono::steady_clock::now();
+  const auto interval = std::chrono::seconds(uint64_t(MIN_STREAM_FULL_STATE_INTERVAL_SECONDS));
+  for (auto it = full_states.begin(); it != full_states.end();)
+    it = now - it->second >= interval ? full_states.erase(it) : std::next(it);
+
+  auto inserted = full_states.emplace(identity, now);
+  if (!inserted.second)
+  {
+    MDEBUG("RTA event stream full state request of " << subscriber.supernode_public_id << " is rate limited");
+    return false;
+  }
+  return true;
+}
+
+void ZmqServer::dropStreamSubscriber(StreamSubscribers& subscribers, StreamSubscribers::iterator it)
+{
+  const std::string supernode_public_id = it->second.supernode_public_id;
+  subscribers.erase(it);
+  if (supernode_public_id.empty())
+    return;
+  // supernode may have resubscribed from another connection
+  for (const auto& subscriber : subscribers)
+    if (subscriber.second.supernode_public_id == supernode_public_id)
+      return;
+  stream_events->unsubscribe(supernode_public_id);
+}
+
+bool ZmqServer::receiveStreamMessage(std::vector<std::string>& frames)
+{
+  frames.clear();
+  zmq::message_t message;
+  if (!stream_socket->recv(&message, ZMQ_DONTWAIT))
+    return false;
+  frames.emplace_back(static_cast<const char *>(message.data()), message.size());
+  while (message.more())
+  {
+    stream_socket->recv(&message);
+    frames.emplace_back(static_cast<const char *>(message.data()), message.size());
+  }
+  return true;
+}
+
+bool ZmqServer::sendStreamMessage(const std::string& identity, std::initializer_list<const std::string*> frames)
+{
+  zmq::message_t address(identity.data(), identity.size());
+  if (!stream_socket->send(address, ZMQ_SNDMORE | ZMQ_DONTWAIT))
+    return false; // high water mark is reached
+  // the rest of a multipart message is queued together with its first part
+  size_t i = 0;
+  for (const std::string* frame : frames)
+  {
+    zmq::message_t message(frame->data(), frame->size());
+    stream_socket->send(message, ++i < frames.size() ? ZMQ_SNDMORE : 0);
+  }
+  return true;
+}
+
 void ZmqServer::run()
 {
   running = true;
   run_thread = boost::thread(boost::bind(&ZmqServer::serve, this));
+  if (stream_socket)
+    stream_thread = boost::thread(boost::bind(&ZmqServer::serveStream, this));
 }
 
 void ZmqServer::stop()
@@ -134,6 +427,12 @@ void ZmqServer::stop()
   run_thread.interrupt();
   run_thread.join();
 
+  if (stream_thread.joinable())
+  {
+    stream_thread.interrupt();
+    stream_thread.join();
+  }
+
   running = false;
 
   return;
@@ -30,10 +30,15 @@
 
 #include <boost/thread/thread.hpp>
 #include <zmq.hpp>
+#include <chrono>
+#include <initializer_list>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "common/command_line.h"
+#include "p2p/rta_event_stream.h"
 
 #include "rpc_handler.h"
 
@@ -45,6 +50,30 @@ namespace rpc
 
 static constexpr int DEFAULT_NUM_ZMQ_THREADS = 1;
 static constexpr int DEFAULT_RPC_RECV_TIMEOUT_MS = 1000;
+static constexpr int DEFAULT_STREAM_POLL_INTERVAL_MS = 20;
+static constexpr size_t MAX_STREAM_EVENTS_PER_POLL = 256;
+static constexpr size_t MAX_STREAM_CHALLENGES = 1024;
+static constexpr size_t STREAM_CHALLENGE_TIMEOUT_SECONDS = 10;
+static constexpr size_t MIN_STREAM_FULL_STATE_INTERVAL_SECONDS = 60;
+
+/*
+ * RTA event stream protocol (ROUTER socket, clients connect with DEALER sockets):
+ *   client: "challenge"    - requests a nonce for the supernode authentication, it expires after
+ *           STREAM_CHALLENGE_TIMEOUT_SECONDS; refused while MAX_STREAM_CHALLENGES nonces are pending
+ *   client: "subscribe" <topics> <from_sequence> [<supernode_public_id> <signature>]
+ *           topics are comma separated names of rta_event_stream topics, from_sequence 0 subscribes to
+ *           new events only; a supernode registered at the daemon subscribes by its id with the hex signature
+ *           of rta_event_stream::get_subscription_hash(nonce, id) by its id key, the nonce of the last challenge
+ *           is valid for one subscribe request. Full stakes and list are pushed to the stream for authenticated
+ *           supernodes subscribing with from_sequence 0, at most once per MIN_STREAM_FULL_STATE_INTERVAL_SECONDS
+ *           per connection; other subscribers get them with the next full snapshot of the feeds
+ *   client: "ping"         - renews subscription, it expires after rta_event_stream::SUBSCRIPTION_TIMEOUT_SECONDS
+ *   client: "unsubscribe"
+ *   server: "challenge" <nonce> | "subscribed" <next_sequence> | "pong" <next_sequence> | "error" <message>
+ *   server: "event" <topic> <sequence> <uri> <payload>
+ *   server: "gap"          - events have been dropped before the next one, full stakes and list are pushed again
+ *                            (with the same restrictions as for "subscribe")
+ */
 
 class ZmqServer
 {
@@ -60,11 +89,38 @@ class ZmqServer
 
     bool addIPCSocket(std::string address, std::string port);
     bool addTCPSocket(std::string address, std::string port);
+    bool addStreamSocket(std::string address, std::string port, nodetool::rta_event_stream& events);
 
     void run();
     void stop();
 
   private:
+    struct StreamSubscriber
+    {
+      unsigned topics;
+      std::string supernode_public_id;
+      uint64_t next_sequence;
+      std::chrono::steady_clock::time_point renewed;
+    };
+
+    typedef std::unordered_map<std::string, StreamSubscriber> StreamSubscribers;
+    struct StreamChallenge
+    {
+      std::string nonce;
+      std::chrono::steady_clock::time_point issued;
+    };
+
+    typedef std::unordered_map<std::string, StreamChallenge> StreamChallenges; // by connection identity
+    typedef std::unordered_map<std::string, std::chrono::steady_clock::time_point> StreamFullStates; // last full state request by connection identity
+
+    void serveStream();
+    void receiveStreamRequests(StreamSubscribers& subscribers, StreamChallenges& challenges, StreamFullStates& full_states);
+    bool sendStreamEvents(const std::string& identity, StreamSubscriber& subscriber, StreamFullStates& full_states);
+    bool requestStreamFullState(StreamFullStates& full_states, const std::string& identity, const StreamSubscriber& subscriber);
+    void dropStreamSubscriber(StreamSubscribers& subscribers, StreamSubscribers::iterator it);
+    bool receiveStreamMessage(std::vector<std::string>& frames);
+    bool sendStreamMessage(const std::string& identity, std::initializer_list<const std::string*> frames);
+
     RpcHandler& handler;
 
     volatile bool stop_signal;
@@ -75,6 +131,12 @@ class ZmqServer
     boost::thread run_thread;
 
     std::unique_ptr<zmq::socket_t> rep_socket;
+
+    boost::thread stream_thread;
+
+    std::unique_ptr<zmq::socket_t> stream_socket;
+
+    nodetool::rta_event_stream* stream_events;
 };
 
 
@@ -51,7 +51,11 @@ bool supernode::AuthSample::PosProxySale(const rpc_command::POS_PROXY_SALE::requ
 	data->PosIP = in.SenderIP;
 	data->PosPort = in.SenderPort;
 
-	Add(data);
+	if( !Add(data) ) {
+		LOG_PRINT_L4("payment is already in progress: "<<in.PaymentID<<"  in: "<<m_DAPIServer->Port());
+		Remove(data);
+		return false;
+	}
 
     LOG_PRINT_L4("ADD: "<<in.PaymentID<<"  in: "<<m_DAPIServer->Port());
 
@@ -56,6 +56,10 @@ bool supernode::BaseRTAObject::CheckSign(const string& wallet, const string& sig
 	return m_Servant->IsSignValid( TransactionRecord.MessageForSign(), wallet, sign );
 }
 
+vector<bool> supernode::BaseRTAObject::CheckSigns(const vector< pair<string, string> >& walletSigns) {
+	return m_Servant->AreSignsValid( TransactionRecord.MessageForSign(), walletSigns );
+}
+
 void supernode::BaseRTAObject::MarkForDelete() {
 	boost::lock_guard<boost::recursive_mutex> lock(m_HanlderIdxGuard);
 	m_ReadyForDelete = true;
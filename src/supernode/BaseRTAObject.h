@@ -60,13 +60,13 @@ namespace supernode {
 
 		template<class IN_t, class OUT_t>
 		bool SendDAPICall(const string& ip, const string& port, const string& method, IN_t& req, OUT_t& resp) {
-			DAPI_RPC_Client call;
-			call.Set(ip, port);
 			req.PaymentID = TransactionRecord.PaymentID;
-			return call.Invoke(method, req, resp);
+			return DAPI_RPC_ClientPool::Instance().Invoke(ip, port, method, req, resp);
 		}
 
 		bool CheckSign(const string& wallet, const string& sign);
+		// checks signs of the transaction record by several wallets at once, result[i] is for walletSigns[i]
+		vector<bool> CheckSigns(const vector< pair<string, string> >& walletSigns);
 
 		template<class IN_t, class OUT_t>
 		void AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
@@ -30,7 +30,11 @@
 #include "BaseRTAProcessor.h"
 
 
-static const unsigned s_ObjectLifetime = 20*60*1000;//20 min
+static const std::chrono::milliseconds s_ObjectLifetime(20*60*1000);//20 min
+static const std::chrono::milliseconds s_RemovedObjectLifetime(5*60*1000);//5 min
+static const std::chrono::milliseconds s_ExpiryResolution(1000);
+
+supernode::BaseRTAProcessor::BaseRTAProcessor() : m_ObjectsExpiry(s_ObjectLifetime, s_ExpiryResolution), m_RemoveObjects(s_RemovedObjectLifetime, s_ExpiryResolution) {}
 
 supernode::BaseRTAProcessor::~BaseRTAProcessor() {}
 
@@ -43,12 +47,14 @@ void supernode::BaseRTAProcessor::Set(const FSN_ServantBase* ser, DAPI_RPC_Serve
 	Init();
 }
 
-void supernode::BaseRTAProcessor::Add(boost::shared_ptr<BaseRTAObject> obj) {
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		m_Objects.push_back(obj);
-	}
+bool supernode::BaseRTAProcessor::Add(boost::shared_ptr<BaseRTAObject> obj) {
 	Tick();
+	boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
+	// live object with the same payment id is kept, the caller removes the new one
+	auto ins = m_Objects.emplace(obj->TransactionRecord.PaymentID, obj);
+	if( !ins.second ) return ins.first->second==obj;
+	m_ObjectsExpiry.Schedule(obj, s_ObjectLifetime);
+	return true;
 }
 
 void supernode::BaseRTAProcessor::Setup(boost::shared_ptr<BaseRTAObject> obj) {
@@ -56,15 +62,9 @@ void supernode::BaseRTAProcessor::Setup(boost::shared_ptr<BaseRTAObject> obj) {
 }
 
 boost::shared_ptr<supernode::BaseRTAObject> supernode::BaseRTAProcessor::ObjectByPayment(const string& payment_id) {
-	boost::shared_ptr<BaseRTAObject> ret;
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		for(auto& a : m_Objects) if(a->TransactionRecord.PaymentID==payment_id) {
-			ret = a;
-			break;
-		}
-	}
-	return ret;
+	boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
+	auto it = m_Objects.find(payment_id);
+	return it!=m_Objects.end() ? it->second : boost::shared_ptr<BaseRTAObject>();
 }
 
 void supernode::BaseRTAProcessor::Remove(boost::shared_ptr<BaseRTAObject> obj) {
@@ -72,39 +72,43 @@ void supernode::BaseRTAProcessor::Remove(boost::shared_ptr<BaseRTAObject> obj) {
     LOG_PRINT_L4("Remove: "<<obj->TransactionRecord.PaymentID);
 	{
 		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		auto it = find(m_Objects.begin(), m_Objects.end(), obj);
-		if( it!=m_Objects.end() ) m_Objects.erase(it);
-
+		auto it = m_Objects.find(obj->TransactionRecord.PaymentID);
+		if( it!=m_Objects.end() && it->second==obj ) m_Objects.erase(it);
 	}
+	vector< boost::shared_ptr<BaseRTAObject> > deleted;
 	{
 		obj->TimeMark = boost::posix_time::second_clock::local_time();
 		boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
-		m_RemoveObjects.push_back( obj );
+		m_RemoveObjects.Advance(TimerWheel< boost::shared_ptr<BaseRTAObject> >::Clock::now(), deleted);
+		m_RemoveObjects.Schedule(obj, s_RemovedObjectLifetime);
 	}
-
+	// deleted objects are released here, outside of the lock
 }
 
 
 void supernode::BaseRTAProcessor::Tick() {
-	auto now = boost::posix_time::second_clock::local_time();
+	auto now = TimerWheel< boost::shared_ptr<BaseRTAObject> >::Clock::now();
 	{
+		vector< boost::weak_ptr<BaseRTAObject> > expired;
 		vector< boost::shared_ptr<BaseRTAObject> > vv;
 		{
 			boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-			for(auto a: m_Objects) if( (now-a->TimeMark).total_milliseconds()>s_ObjectLifetime ) vv.push_back(a);//20 min
+			m_ObjectsExpiry.Advance(now, expired);
+			for(auto& a : expired) {
+				boost::shared_ptr<BaseRTAObject> obj = a.lock();
+				if(!obj) continue;
+				auto it = m_Objects.find(obj->TransactionRecord.PaymentID);
+				if( it!=m_Objects.end() && it->second==obj ) vv.push_back(obj);
+			}
 		}
 		for(auto a : vv) Remove(a);
 	}
 	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
-		for(int i=0;i<int(m_RemoveObjects.size());i++) if( (now-m_RemoveObjects[i]->TimeMark).total_milliseconds()>(5*60*1000) ) {
-			m_RemoveObjects.erase( m_RemoveObjects.begin()+i );
-			i--;
+		vector< boost::shared_ptr<BaseRTAObject> > deleted;
+		{
+			boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
+			m_RemoveObjects.Advance(now, deleted);
 		}
 	}
 
 }
-
-
-
-
@@ -31,11 +31,15 @@
 #define BASE_RTA_PROCESSOR_H_
 
 #include "BaseRTAObject.h"
+#include "TimerWheel.h"
+#include <boost/weak_ptr.hpp>
+#include <unordered_map>
 
 namespace supernode {
 
 	class BaseRTAProcessor {
 		public:
+		BaseRTAProcessor();
 		virtual ~BaseRTAProcessor();
 
 		virtual void Start();
@@ -45,7 +49,8 @@ namespace supernode {
 		virtual void Tick();
 
 		protected:
-		void Add(boost::shared_ptr<BaseRTAObject> obj);
+		// false if other object with the same payment id is alive
+		bool Add(boost::shared_ptr<BaseRTAObject> obj);
 		void Remove(boost::shared_ptr<BaseRTAObject> obj);
 		void Setup(boost::shared_ptr<BaseRTAObject> obj);
 		boost::shared_ptr<BaseRTAObject> ObjectByPayment(const string& payment_id);
@@ -55,15 +60,14 @@ namespace supernode {
 		protected:
 		const FSN_ServantBase* m_Servant = nullptr;
 		DAPI_RPC_Server* m_DAPIServer = nullptr;
+		// live objects by payment id, expiry of live objects (weak, removed objects are skipped on expiry)
 		mutable boost::recursive_mutex m_ObjectsGuard;
-		vector< boost::shared_ptr<BaseRTAObject> > m_Objects;
+		unordered_map< string, boost::shared_ptr<BaseRTAObject> > m_Objects;
+		TimerWheel< boost::weak_ptr<BaseRTAObject> > m_ObjectsExpiry;
 
+		// removed objects are kept until their pending handlers complete
 		mutable boost::recursive_mutex m_RemoveObjectsGuard;
-		vector< boost::shared_ptr<BaseRTAObject> > m_RemoveObjects;
-
-//		mutable boost::mutex m_DeleteGuard;
-//		map< boost::posix_time::ptime, boost::shared_ptr<BaseRTAObject> > m_ForDelete;
-		// boost::posix_time::second_clock::local_time()
+		TimerWheel< boost::shared_ptr<BaseRTAObject> > m_RemoveObjects;
 
 	};
 
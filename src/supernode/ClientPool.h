@@ -0,0 +1,84 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CLIENT_POOL_H_
+#define CLIENT_POOL_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace supernode {
+
+	// Pool of idle connected clients to one server, clients keep their connections between calls
+	template<class Client>
+	class ClientPool {
+		public:
+		typedef std::unique_ptr<Client> ClientPtr;
+		typedef std::function<ClientPtr ()> Factory;
+
+		ClientPool(Factory factory, size_t maxIdle) : m_Factory(factory), m_MaxIdle(maxIdle) {}
+
+		// idle client or a new one if there are no idle clients; reused is set for idle clients,
+		// their keep-alive connections may have been closed by the server meanwhile
+		ClientPtr Acquire(bool* reused = nullptr) {
+			if(reused) *reused = false;
+			{
+				boost::lock_guard<boost::mutex> lock(m_Guard);
+				if( !m_Idle.empty() ) {
+					ClientPtr client = std::move(m_Idle.back());
+					m_Idle.pop_back();
+					if(reused) *reused = true;
+					return client;
+				}
+			}
+			return m_Factory();
+		}
+
+		// new client with a new connection, i.e. to retry a call failed on a reused connection
+		ClientPtr Create() { return m_Factory(); }
+
+		// returns client to the pool, clients which failed a call are dropped with their connections
+		void Release(ClientPtr client, bool reusable) {
+			if(!client || !reusable) return;
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			if( m_Idle.size()<m_MaxIdle ) m_Idle.push_back(std::move(client));
+		}
+
+		protected:
+		const Factory m_Factory;
+		const size_t m_MaxIdle;
+		boost::mutex m_Guard;
+		std::vector<ClientPtr> m_Idle;
+	};
+
+}
+
+#endif /* CLIENT_POOL_H_ */
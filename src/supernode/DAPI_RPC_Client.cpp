@@ -28,6 +28,7 @@
 //
 
 #include "DAPI_RPC_Client.h"
+#include <boost/make_shared.hpp>
 
 
 void supernode::DAPI_RPC_Client::Set(string ip, string port) {
@@ -36,3 +37,44 @@ void supernode::DAPI_RPC_Client::Set(string ip, string port) {
 	boost::optional<epee::net_utils::http::login> http_login{};
 	set_server(ss, http_login);
 }
+
+static const size_t s_MaxIdleClientsPerEndpoint = 8;
+// endpoints of supernodes which have left the network are evicted with their idle connections
+static const std::chrono::minutes s_EndpointIdleTime(10);
+static const std::chrono::minutes s_EvictionPeriod(1);
+
+supernode::DAPI_RPC_ClientPool& supernode::DAPI_RPC_ClientPool::Instance() {
+	static DAPI_RPC_ClientPool pool;
+	return pool;
+}
+
+supernode::DAPI_RPC_ClientPool::SEndpoint::SEndpoint(const string& ip, const string& port)
+	: Clients([ip, port]() {
+		ClientPool<DAPI_RPC_Client>::ClientPtr client(new DAPI_RPC_Client());
+		client->Set(ip, port);
+		return client;
+	}, s_MaxIdleClientsPerEndpoint), NotAvailCount(0) {}
+
+boost::shared_ptr<supernode::DAPI_RPC_ClientPool::SEndpoint> supernode::DAPI_RPC_ClientPool::Endpoint(const string& ip, const string& port) {
+	string key = ip+string(":")+port;
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	if( now-m_LastEviction>=s_EvictionPeriod ) EvictIdleEndpoints(now);
+	boost::shared_ptr<SEndpoint>& endpoint = m_Endpoints[key];
+	if(!endpoint) endpoint = boost::make_shared<SEndpoint>(ip, port);
+	endpoint->LastUsed = now;
+	return endpoint;
+}
+
+void supernode::DAPI_RPC_ClientPool::EvictIdleEndpoints(std::chrono::steady_clock::time_point now) {
+	m_LastEviction = now;
+	for(auto it = m_Endpoints.begin(); it!=m_Endpoints.end();) {
+		// endpoints in use by calls are kept
+		if( now-it->second->LastUsed>=s_EndpointIdleTime && it->second.use_count()==1 ) it = m_Endpoints.erase(it);
+		else ++it;
+	}
+}
+
+unsigned supernode::DAPI_RPC_ClientPool::NotAvailCount(const string& ip, const string& port) {
+	return Endpoint(ip, port)->NotAvailCount;
+}
@@ -35,7 +35,12 @@
 #include "storages/portable_storage_template_helper.h"
 #include "storages/portable_storage.h"
 #include "supernode_rpc_command.h"
+#include "ClientPool.h"
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <unordered_map>
 using namespace std;
 
 
@@ -99,6 +104,60 @@ namespace supernode {
 
 	};
 
+	// Keep-alive DAPI clients shared by all callers, per endpoint, with endpoint availability tracking
+	class DAPI_RPC_ClientPool {
+		public:
+		static DAPI_RPC_ClientPool& Instance();
+
+		// countCall - false if the invoke is an attempt of a call with retries, the caller counts the call with CountCall
+		template<class t_request, class t_response>
+		bool Invoke(const string& ip, const string& port, const string& call, const t_request& out_struct, t_response& result_struct,
+					std::chrono::milliseconds timeout = std::chrono::seconds(5), bool* wasConnected = nullptr, bool countCall = true) {
+			boost::shared_ptr<SEndpoint> endpoint = Endpoint(ip, port);
+			bool reused = false;
+			ClientPool<DAPI_RPC_Client>::ClientPtr client = endpoint->Clients.Acquire(&reused);
+			bool ret = client->Invoke(call, out_struct, result_struct, timeout);
+			if( !ret && reused && !client->WasConnected ) {
+				// idle connection has been closed by the server, it says nothing about the endpoint availability
+				client = endpoint->Clients.Create();
+				ret = client->Invoke(call, out_struct, result_struct, timeout);
+			}
+			bool connected = client->WasConnected;
+			endpoint->Clients.Release(std::move(client), ret);
+			if(countCall) Count(*endpoint, ret, connected);
+			if(wasConnected) *wasConnected = connected;
+			return ret;
+		}
+
+		// counts the result of a call made of several attempts
+		void CountCall(const string& ip, const string& port, bool ok, bool connected) { Count(*Endpoint(ip, port), ok, connected); }
+
+		// number of sequential calls the endpoint hasn't been connected for
+		unsigned NotAvailCount(const string& ip, const string& port);
+
+		protected:
+		struct SEndpoint {
+			SEndpoint(const string& ip, const string& port);
+			ClientPool<DAPI_RPC_Client> Clients;
+			std::atomic<unsigned> NotAvailCount;
+			std::chrono::steady_clock::time_point LastUsed;// guarded by m_Guard
+		};
+
+		// endpoint of the server, endpoints which haven't been used for a while are evicted with their idle clients
+		boost::shared_ptr<SEndpoint> Endpoint(const string& ip, const string& port);
+		void EvictIdleEndpoints(std::chrono::steady_clock::time_point now);
+
+		static void Count(SEndpoint& endpoint, bool ok, bool connected) {
+			if(ok) endpoint.NotAvailCount = 0;
+			else if(!connected) endpoint.NotAvailCount++;
+		}
+
+		protected:
+		boost::mutex m_Guard;
+		unordered_map< string, boost::shared_ptr<SEndpoint> > m_Endpoints;// ip:port -> endpoint
+		std::chrono::steady_clock::time_point m_LastEviction;
+	};
+
 
 }
 
@@ -103,20 +103,7 @@ bool supernode::DAPI_RPC_Server::HandleRequest(const epee::net_utils::http::http
 
 
 
-    SCallHandler* handler = nullptr;
-
-    {
-    	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
-    	for(unsigned i=0;i<m_vHandlers.size();i++) {
-    		SHandlerData& hh = m_vHandlers[i];
-
-    		if(hh.Name!=callback_name) continue;
-    		if(hh.PaymentID.size() &&  hh.PaymentID!=payment_id) continue;
-
-    		handler = hh.Handler;
-    		break;
-    	}
-    }
+    boost::shared_ptr<SCallHandler> handler = FindHandler(callback_name, payment_id);
     LOG_PRINT_L2(response_info.m_body);
 
     if(!handler) { LOG_ERROR("handler not found for: "<<callback_name); return false; }
@@ -148,19 +135,57 @@ void supernode::DAPI_RPC_Server::Start() { run(m_NumThreads); }
 void supernode::DAPI_RPC_Server::Stop() { send_stop_signal(); }
 
 int supernode::DAPI_RPC_Server::AddHandlerData(const SHandlerData& h) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
+	boost::unique_lock<boost::shared_mutex> lock(m_Handlers_Guard);
 	int idx = m_HandlerIdx;
 	m_HandlerIdx++;
-	m_vHandlers.push_back(h);
-	m_vHandlers.rbegin()->Idx = idx;
+	SMethodHandlers& methods = h.PaymentID.empty() ? m_GlobalHandlers : m_PaymentHandlers[h.PaymentID];
+	SHandlerList& handlers = methods[h.Name];
+	handlers.push_back(h);
+	handlers.rbegin()->Idx = idx;
+	m_HandlerKeys[idx] = make_pair(h.PaymentID, h.Name);
 	return idx;
 }
 
 void supernode::DAPI_RPC_Server::RemoveHandler(int idx) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
-	for(unsigned i=0;i<m_vHandlers.size();i++) if( m_vHandlers[i].Idx==idx ) {
-		m_vHandlers.erase( m_vHandlers.begin()+i );
+	boost::shared_ptr<SCallHandler> removed;// released outside of the lock
+	boost::unique_lock<boost::shared_mutex> lock(m_Handlers_Guard);
+	auto kit = m_HandlerKeys.find(idx);
+	if( kit==m_HandlerKeys.end() ) return;
+	const string& payment_id = kit->second.first;
+	const string& method = kit->second.second;
+
+	auto pit = m_PaymentHandlers.end();
+	SMethodHandlers* methods = &m_GlobalHandlers;
+	if( !payment_id.empty() ) {
+		pit = m_PaymentHandlers.find(payment_id);
+		methods = &pit->second;
+	}
+	auto mit = methods->find(method);
+	SHandlerList& handlers = mit->second;
+	for(unsigned i=0;i<handlers.size();i++) if( handlers[i].Idx==idx ) {
+		removed = handlers[i].Handler;
+		handlers.erase( handlers.begin()+i );
 		break;
 	}
+	if( handlers.empty() ) methods->erase(mit);
+	if( pit!=m_PaymentHandlers.end() && pit->second.empty() ) m_PaymentHandlers.erase(pit);
+	m_HandlerKeys.erase(kit);
+}
+
+boost::shared_ptr<supernode::DAPI_RPC_Server::SCallHandler> supernode::DAPI_RPC_Server::FindHandler(const string& method, const string& payment_id) {
+	boost::shared_lock<boost::shared_mutex> lock(m_Handlers_Guard);
+	const SHandlerData* found = nullptr;
+	auto mit = m_GlobalHandlers.find(method);
+	if( mit!=m_GlobalHandlers.end() ) found = &mit->second.front();
+
+	if( !payment_id.empty() ) {
+		auto pit = m_PaymentHandlers.find(payment_id);
+		if( pit!=m_PaymentHandlers.end() ) {
+			mit = pit->second.find(method);
+			// the earliest registered handler wins, as if all handlers were checked in order of registration
+			if( mit!=pit->second.end() && (!found || mit->second.front().Idx<found->Idx) ) found = &mit->second.front();
+		}
+	}
+	return found ? found->Handler : boost::shared_ptr<SCallHandler>();
 }
 
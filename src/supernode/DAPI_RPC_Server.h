@@ -32,12 +32,15 @@
 
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include "supernode_rpc_command.h"
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 #include "net/http_server_impl_base.h"
 #include "FSN_Servant.h"
 #include <string>
+#include <unordered_map>
 using namespace std;
 
 namespace supernode {
@@ -58,6 +61,7 @@ namespace supernode {
 		protected:
 		class SCallHandler {
 			public:
+			virtual ~SCallHandler() {}
 			virtual bool Process(epee::serialization::portable_storage& in, string& out_js)=0;
 		};
 		template<class IN_t, class OUT_t>
@@ -85,7 +89,7 @@ namespace supernode {
 		};
 
 		struct SHandlerData {
-			SCallHandler* Handler = nullptr;
+			boost::shared_ptr<SCallHandler> Handler;
 			string Name;
 			int Idx = -1;
 			string PaymentID;
@@ -96,7 +100,7 @@ namespace supernode {
 		template<class IN_t, class OUT_t>
 		int AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
 			SHandlerData hh;
-			hh.Handler = new STemplateHandler<IN_t, OUT_t>(handler);
+			hh.Handler.reset( new STemplateHandler<IN_t, OUT_t>(handler) );
 			hh.Name = method;
 			return AddHandlerData(hh);
 		}
@@ -108,7 +112,7 @@ namespace supernode {
 		template<class IN_t, class OUT_t>
 		int Add_UUID_MethodHandler( string paymentid, const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
 			SHandlerData hh;
-			hh.Handler = new STemplateHandler<IN_t, OUT_t>(handler);
+			hh.Handler.reset( new STemplateHandler<IN_t, OUT_t>(handler) );
 			hh.Name = method;
 			hh.PaymentID = paymentid;
 			return AddHandlerData(hh);
@@ -123,10 +127,18 @@ namespace supernode {
 		bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context) override;
 		bool HandleRequest(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& m_conn_context);
 		int AddHandlerData(const SHandlerData& h);
+		// first registered handler for the method and payment id (global handlers match any payment id)
+		boost::shared_ptr<SCallHandler> FindHandler(const string& method, const string& payment_id);
 
 		protected:
-		boost::recursive_mutex m_Handlers_Guard;
-		vector<SHandlerData> m_vHandlers;
+		// handlers registered for the same method (and payment id), in order of registration
+		typedef vector<SHandlerData> SHandlerList;
+		typedef unordered_map<string, SHandlerList> SMethodHandlers;
+
+		boost::shared_mutex m_Handlers_Guard;
+		SMethodHandlers m_GlobalHandlers;
+		unordered_map<string, SMethodHandlers> m_PaymentHandlers;// payment id -> method -> handlers
+		unordered_map< int, pair<string, string> > m_HandlerKeys;// handler index -> (payment id, method)
 		int m_HandlerIdx = 0;
 
 		protected:
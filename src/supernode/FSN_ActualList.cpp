@@ -38,7 +38,7 @@ static const uint64_t s_MinStakeBalance = 0;
 
 namespace supernode {
 
-FSN_ActualList::FSN_ActualList(FSN_ServantBase* servant, P2P_Broadcast* p2p, DAPI_RPC_Server* dapi) : m_All_FSN_Guard(servant->All_FSN_Guard), m_All_FSN(servant->All_FSN) {
+FSN_ActualList::FSN_ActualList(FSN_ServantBase* servant, P2P_Broadcast* p2p, DAPI_RPC_Server* dapi) {
 	m_Servant = servant;
 	m_P2P = p2p;
 	m_DAPIServer = dapi;
@@ -66,8 +66,8 @@ void FSN_ActualList::Stop() {
 }
 
 void FSN_ActualList::GetFSNList(const rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN_LIST::request& in, rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN_LIST::response& out) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
-	for(auto a : m_All_FSN) {
+	FSN_ServantBase::FSN_ListPtr all = m_Servant->GetFsnList();
+	for(auto& a : *all) {
 		rpc_command::BROADCACT_ADD_FULL_SUPER_NODE data;
 		data.IP = a->IP;
 		data.Port = a->Port;
@@ -89,9 +89,9 @@ void FSN_ActualList::Run() {
 		vector<rpc_command::BROADCAST_NEAR_GET_ACTUAL_FSN_LIST::response> outv;
 		m_P2P->SendNear(p2p_call::GetFSNList, in, outv);
 
-		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
+		FSN_ServantBase::FSN_ListPtr all = m_Servant->GetFsnList();
 		for(auto aa : outv)
-			for(auto a : aa.List) _OnAddFSN(a);
+			for(auto a : aa.List) _OnAddFSN(a, *all);
 
 	}
 
@@ -115,15 +115,11 @@ void FSN_ActualList::Run() {
 }
 
 void FSN_ActualList::DoAudit() {
-	vector< boost::shared_ptr<FSN_Data> > all;
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
-		all = m_All_FSN;
-	}
+	FSN_ServantBase::FSN_ListPtr all = m_Servant->GetFsnList();
 
-	for(unsigned i=0;i<all.size() && m_Running;i++) {
-		if( CheckIsFSN(all[i]) ) continue;
-		auto data = m_Servant->FSN_DataByStakeAddr( all[i]->Stake.Addr );
+	for(unsigned i=0;i<all->size() && m_Running;i++) {
+		if( CheckIsFSN((*all)[i]) ) continue;
+		auto data = m_Servant->FSN_DataByStakeAddr( (*all)[i]->Stake.Addr );
 		if( !data ) continue;// was deleted
 
 		rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE in;
@@ -140,11 +136,7 @@ void FSN_ActualList::CheckIfIamFSN(bool checkOnly) {
 
 	if(checkOnly) return;
 
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
-		for(auto a : m_All_FSN) if( a->IP==data->IP && a->Port==data->Port ) return;
-		m_Servant->AddFsnAccount(data);
-	}
+	if( !m_Servant->AddFsnAccountIfNew(data) ) return;
 
 	rpc_command::BROADCACT_ADD_FULL_SUPER_NODE in;
 	in.IP = data->IP;
@@ -157,8 +149,8 @@ void FSN_ActualList::CheckIfIamFSN(bool checkOnly) {
 	m_P2P->Send(p2p_call::AddFSN, in);
 }
 
-boost::shared_ptr<FSN_Data> FSN_ActualList::_OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in ) {
-	for(auto a : m_All_FSN) if( a->IP==in.IP && a->Port==in.Port ) return nullptr;
+boost::shared_ptr<FSN_Data> FSN_ActualList::_OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in, const FSN_ServantBase::FSN_List& all ) {
+	for(auto& a : all) if( a->IP==in.IP && a->Port==in.Port ) return nullptr;
 
 	boost::shared_ptr<FSN_Data> data = boost::shared_ptr<FSN_Data>( new FSN_Data( FSN_WalletData(in.StakeAddr, in.StakeViewKey), FSN_WalletData(in.MinerAddr, in.MinerViewKey), in.IP, in.Port) );
 
@@ -172,13 +164,10 @@ void FSN_ActualList::OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE&
 }
 
 void FSN_ActualList::OnAddFSNFromWorker(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in ) {
-	boost::shared_ptr<FSN_Data> data;
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_All_FSN_Guard);
-		data = _OnAddFSN(in);
-	}
+	// known FSN are skipped before the slow check, the list may change meanwhile, so the insert checks again
+	boost::shared_ptr<FSN_Data> data = _OnAddFSN(in, *m_Servant->GetFsnList());
 
-	if( data && CheckIsFSN(data) ) m_Servant->AddFsnAccount(data);// VERY SLOW!!!
+	if( data && CheckIsFSN(data) ) m_Servant->AddFsnAccountIfNew(data);// VERY SLOW!!!
 }
 
 void FSN_ActualList::OnLostFSNStatus(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in) {
@@ -200,9 +189,7 @@ bool FSN_ActualList::CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const st
 	in.Str = GenStrForSign( data->IP, data->Port, wa );
 	in.WalletAddr = wa;
 
-	DAPI_RPC_Client call;
-	call.Set(data->IP, data->Port);
-	if( !call.Invoke(dapi_call::FSN_CheckWalletOwnership, in, out) ) return false;
+	if( !DAPI_RPC_ClientPool::Instance().Invoke(data->IP, data->Port, dapi_call::FSN_CheckWalletOwnership, in, out) ) return false;
 	return m_Servant->IsSignValid(in.Str, in.WalletAddr, out.Sign);
 
 }
@@ -59,14 +59,12 @@ protected:
 	string GenStrForSign(const string& dapiIP, const string& dapiPort, const string& walletAddr);
 	bool CheckIsFSN(boost::shared_ptr<FSN_Data> data);
 	bool CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const string& wa);
-	boost::shared_ptr<FSN_Data> _OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in );
+	boost::shared_ptr<FSN_Data> _OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in, const FSN_ServantBase::FSN_List& all );
 	void Run();
 	void CheckIfIamFSN(bool checkOnly=false);
 	virtual void DoAudit();
 
 protected:
-    boost::recursive_mutex& m_All_FSN_Guard;// DO NOT block for long time. if need - use copy
-    vector< boost::shared_ptr<FSN_Data> >& m_All_FSN;// access to this data may be done from different threads
     P2P_Broadcast* m_P2P = nullptr;
     DAPI_RPC_Server* m_DAPIServer = nullptr;
     FSN_ServantBase* m_Servant = nullptr;
@@ -33,6 +33,8 @@
 #include <cryptonote_core/tx_pool.h>
 #include <cryptonote_core/blockchain.h>
 #include <crypto/crypto.h>
+#include <common/base58.h>
+#include <common/threadpool.h>
 #include <exception>
 
 
@@ -101,6 +103,23 @@ crypto::public_key get_tx_pub_key_from_received_outs(const transaction &tx)
 
     return crypto::null_pkey;
 }
+
+// the same as wallet2::verify, but the message hash is computed by the caller
+bool decode_signature(const string &signature, crypto::signature &result)
+{
+    const size_t header_len = strlen("SigV1");
+    if (signature.size() < header_len || signature.compare(0, header_len, "SigV1") != 0) {
+        LOG_PRINT_L0("Signature header check error");
+        return false;
+    }
+    std::string decoded;
+    if (!tools::base58::decode(signature.substr(header_len), decoded) || decoded.size() != sizeof(result)) {
+        LOG_PRINT_L0("Signature decoding error");
+        return false;
+    }
+    memcpy(&result, decoded.data(), sizeof(result));
+    return true;
+}
 } // namespace helpers
 
 
@@ -166,37 +185,44 @@ FSN_Servant::LastBlocksResolvedByFSN(uint64_t startFromBlock, uint64_t blockNums
     LOG_PRINT_L3("block height " << block_height);
     uint64_t endBlock = std::min(block_height - 1, startFromBlock + blockNums - 1);
 
-    // TODO: read/write lock
-    All_FSN_Guard.lock();
-
-    for (uint64_t block_index = endBlock; block_index >= startFromBlock; --block_index) {
-//FIXME: Commented since blockchain loading disabled.
-//        const cryptonote::block block = m_bdb->get_block_from_height(block_index);
-        //2. for each blocks, apply function from xmrblocks (page.h:show_my_outputs)
-        // TODO: can be faster algorithm?
-        for (const auto & fsn_wallet : All_FSN) {
+    // keys are parsed once, not for every block
+    vector<pair<boost::shared_ptr<FSN_Data>, pair<cryptonote::account_public_address, crypto::secret_key>>> fsn_keys;
+    {
+        FSN_ListPtr all_fsn = GetFsnList();
+        fsn_keys.reserve(all_fsn->size());
+        for (const auto & fsn_wallet : *all_fsn) {
+            cryptonote::account_public_address address;
             crypto::secret_key viewkey;
-            epee::string_tools::hex_to_pod(fsn_wallet->Miner.ViewKey, viewkey);
-            cryptonote::address_parse_info address_info;
             LOG_PRINT_L3("parsing address : " << fsn_wallet->Miner.Addr << "; testnet: " << m_nettype);
 
-            if (!cryptonote::get_account_address_from_str(address_info, m_nettype, fsn_wallet->Miner.Addr)) {
+            if (!parseAddress(fsn_wallet->Miner.Addr, address)) {
                 LOG_ERROR("Error parsing address: " << fsn_wallet->Miner.Addr);
                 // throw exception here?
                 continue;
             }
+            parseViewKey(fsn_wallet->Miner.ViewKey, viewkey);
+
+            LOG_PRINT_L3("pub spend key: " << epee::string_tools::pod_to_hex(address.m_spend_public_key));
+            LOG_PRINT_L3("pub view key: " << epee::string_tools::pod_to_hex(address.m_view_public_key));
+            fsn_keys.push_back(std::make_pair(fsn_wallet, std::make_pair(address, viewkey)));
+        }
+    }
 
-            LOG_PRINT_L3("pub spend key: " << epee::string_tools::pod_to_hex(address_info.address.m_spend_public_key));
-            LOG_PRINT_L3("pub view key: " << epee::string_tools::pod_to_hex(address_info.address.m_view_public_key));
+    for (uint64_t block_index = endBlock; block_index >= startFromBlock; --block_index) {
+//FIXME: Commented since blockchain loading disabled.
+//        const cryptonote::block block = m_bdb->get_block_from_height(block_index);
+        //2. for each blocks, apply function from xmrblocks (page.h:show_my_outputs)
+        // TODO: can be faster algorithm?
+        for (const auto & fsn_key : fsn_keys) {
+            (void)fsn_key;
 //FIXME: Commented since blockchain loading disabled.
-//            if (proofCoinbaseTx(address_info.address, block, viewkey)) {
-//                result.push_back(std::make_pair(block_index, fsn_wallet));
+//            if (proofCoinbaseTx(fsn_key.second.first, block, fsn_key.second.second)) {
+//                result.push_back(std::make_pair(block_index, fsn_key.first));
 //                // stop wallets loop as we already found the wallet who solved block
 //                break;
 //            }
         }
     }
-    All_FSN_Guard.unlock();
 
     return result;
 }
@@ -226,9 +252,45 @@ string FSN_Servant::SignByWalletPrivateKey(const string& str, const string& wall
 
 bool FSN_Servant::IsSignValid(const string &message, const string &address, const string &signature) const
 {
-    // verify can be done by any wallet
-    // TODO: make is static in wallet2_api/wallet2;
-    return m_minerWallet->verifySignedMessage(message, address, signature);
+    cryptonote::account_public_address public_address;
+    crypto::signature sign;
+    if (!parseAddress(address, public_address) || !helpers::decode_signature(signature, sign))
+        return false;
+
+    crypto::hash hash;
+    crypto::cn_fast_hash(message.data(), message.size(), hash);
+    return crypto::check_signature(hash, public_address.m_spend_public_key, sign);
+}
+
+vector<bool> FSN_Servant::AreSignsValid(const string &message, const vector<pair<string, string>> &addressSigns) const
+{
+    crypto::hash hash;
+    crypto::cn_fast_hash(message.data(), message.size(), hash);
+
+    // vector<bool> can't be written from several threads
+    vector<char> valid(addressSigns.size(), 0);
+    vector<crypto::public_key> keys(addressSigns.size());
+    vector<crypto::signature> signs(addressSigns.size());
+    for (size_t i = 0; i < addressSigns.size(); ++i) {
+        cryptonote::account_public_address public_address;
+        if (!parseAddress(addressSigns[i].first, public_address) || !helpers::decode_signature(addressSigns[i].second, signs[i]))
+            continue;
+        keys[i] = public_address.m_spend_public_key;
+        valid[i] = 1;
+    }
+
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    for (size_t i = 0; i < addressSigns.size(); ++i) {
+        if (!valid[i])
+            continue;
+        tpool.submit(&waiter, [&hash, &keys, &signs, &valid, i]() {
+            valid[i] = crypto::check_signature(hash, keys[i], signs[i]) ? 1 : 0;
+        }, true);
+    }
+    waiter.wait(&tpool);
+
+    return vector<bool>(valid.begin(), valid.end());
 }
 
 
@@ -242,24 +304,41 @@ uint64_t FSN_Servant::GetWalletBalance(uint64_t block_num, const FSN_WalletData&
 }
 
 void FSN_Servant::AddFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
+    // view-only wallet for stake account is registered before the FSN is published,
+    // so the wallet of a listed FSN is always there
+    boost::lock_guard<boost::mutex> lock(m_viewOnlyWalletsGuard);
+    openViewOnlyWallet(fsn->Stake, m_nettype);
 	FSN_ServantBase::AddFsnAccount(fsn);
-    // create view-only wallet for stake account
-    initViewOnlyWallet(fsn->Stake, m_nettype);
 }
 
-bool FSN_Servant::RemoveFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
-    boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);// we use one mutex for All_FSN && for m_viewOnlyWallets
+bool FSN_Servant::AddFsnAccountIfNew(boost::shared_ptr<FSN_Data> fsn) {
+    boost::lock_guard<boost::mutex> lock(m_viewOnlyWalletsGuard);
+    const bool newWallet = m_viewOnlyWallets.find(fsn->Stake.Addr) == m_viewOnlyWallets.end();
+    openViewOnlyWallet(fsn->Stake, m_nettype);
+	if( FSN_ServantBase::AddFsnAccountIfNew(fsn) ) return true;
+
+    // FSN is already known, the wallet opened for it is not needed
+    const auto &it = m_viewOnlyWallets.find(fsn->Stake.Addr);
+    if (newWallet && it != m_viewOnlyWallets.end()) {
+        Monero::WalletManagerFactory::getWalletManager()->closeWallet(it->second);
+        m_viewOnlyWallets.erase(it);
+    }
+    return false;
+}
 
+bool FSN_Servant::RemoveFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
+    // list is updated first, so lookups don't see the FSN while its wallet is being closed;
+    // both are done under the wallets lock, so a concurrent add of the FSN doesn't lose its wallet
+    boost::lock_guard<boost::mutex> lock(m_viewOnlyWalletsGuard);
     if( !FSN_ServantBase::RemoveFsnAccount(fsn) ) return false;
 
-    // TODO: RAII based (scoped) locks
     const auto &it = m_viewOnlyWallets.find(fsn->Stake.Addr);
     if (it != m_viewOnlyWallets.end()) {
         Monero::Wallet * w = it->second;
         Monero::WalletManagerFactory::getWalletManager()->closeWallet(w);
         m_viewOnlyWallets.erase(it);
     } else {
-        LOG_ERROR("Internal error: All_FSN doesn't have corresponding wallet: " << fsn->Stake.Addr);
+        LOG_ERROR("Internal error: FSN list doesn't have corresponding wallet: " << fsn->Stake.Addr);
     }
 
     return true;
@@ -351,6 +430,32 @@ bool FSN_Servant::initBlockchain(const string &dbpath, network_type nettype)
     return result;
 }
 
+bool FSN_Servant::parseAddress(const string &address, account_public_address &result) const
+{
+    if (m_addressCache.Get(address, result))
+        return true;
+
+    cryptonote::address_parse_info address_info;
+    if (!cryptonote::get_account_address_from_str(address_info, m_nettype, address))
+        return false;
+
+    result = address_info.address;
+    m_addressCache.Put(address, result);
+    return true;
+}
+
+bool FSN_Servant::parseViewKey(const string &viewKey, crypto::secret_key &result) const
+{
+    if (m_viewKeyCache.Get(viewKey, result))
+        return true;
+
+    if (!epee::string_tools::hex_to_pod(viewKey, result))
+        return false;
+
+    m_viewKeyCache.Put(viewKey, result);
+    return true;
+}
+
 Wallet *FSN_Servant::initWallet(Wallet * existingWallet, const string &path, const string &password, network_type nettype)
 {
     WalletManager * wmgr = Monero::WalletManagerFactory::getWalletManager();
@@ -378,7 +483,13 @@ Wallet *FSN_Servant::initWallet(Wallet * existingWallet, const string &path, con
 
 Wallet *FSN_Servant::initViewOnlyWallet(const FSN_WalletData &walletData, network_type nettype) const
 {
+    // wallet may be slow to open, FSN list is not locked here
+    boost::lock_guard<boost::mutex> lock(m_viewOnlyWalletsGuard);
+    return openViewOnlyWallet(walletData, nettype);
+}
 
+Wallet *FSN_Servant::openViewOnlyWallet(const FSN_WalletData &walletData, network_type nettype) const
+{
     if (walletData.Addr.empty()) {
         LOG_ERROR("Adding wallet with empty address");
         return nullptr;
@@ -417,7 +528,6 @@ Wallet *FSN_Servant::initViewOnlyWallet(const FSN_WalletData &walletData, networ
 
     // add wallet to map
     m_viewOnlyWallets[walletData.Addr] = w;
-    // TODO: should have opened wallets in sync with the All_FSN ???
     return w;
 }
 
@@ -31,6 +31,7 @@
 #define FSN_SERVANT_H_
 
 #include "FSN_ServantBase.h"
+#include "LruCache.h"
 #include <cryptonote_core/cryptonote_core.h>
 #include <wallet/api/wallet2_api.h>
 #include <boost/thread/mutex.hpp>
@@ -105,10 +106,20 @@ public:
      */
     bool IsSignValid(const string& message, const string &address, const string &signature) const  override;
 
+    /*!
+     * \brief AreSignsValid - checks signatures of one message by several wallets,
+     *                       message is hashed once and signatures are checked in parallel
+     * \param message      - message
+     * \param addressSigns - pairs of wallet address and signature
+     * \return             - result per pair, in the same order
+     */
+    vector<bool> AreSignsValid(const string& message, const vector< pair<string, string> >& addressSigns) const override;
+
     // calc balance from chain begin to block_num
     uint64_t GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet) const  override;
 
     virtual void AddFsnAccount(boost::shared_ptr<FSN_Data> fsn) override;
+    virtual bool AddFsnAccountIfNew(boost::shared_ptr<FSN_Data> fsn) override;
     virtual bool RemoveFsnAccount(boost::shared_ptr<FSN_Data> fsn) override;
 
 
@@ -130,10 +141,24 @@ private:
      * \return                   - pointer to Monero::Wallet obj
      */
     Monero::Wallet * initViewOnlyWallet(const FSN_WalletData &walletData, cryptonote::network_type nettype) const;
+    // the same, m_viewOnlyWalletsGuard has to be locked by the caller
+    Monero::Wallet * openViewOnlyWallet(const FSN_WalletData &walletData, cryptonote::network_type nettype) const;
     static FSN_WalletData walletData(Monero::Wallet * wallet);
 
     Monero::Wallet * getMyWalletByAddress(const std::string &address) const;
 
+    /*!
+     * \brief parseAddress - parses wallet address, parsed addresses are cached
+     * \param address      - wallet address
+     * \param result       - parsed public keys
+     * \return             - false if address is invalid for the network
+     */
+    bool parseAddress(const std::string &address, cryptonote::account_public_address &result) const;
+    /*!
+     * \brief parseViewKey - decodes hex private view key, decoded keys are cached
+     */
+    bool parseViewKey(const std::string &viewKey, crypto::secret_key &result) const;
+
 private:
     // directory where view-only wallets for other FSNs will be stored
     std::string                  m_fsnWalletsDir;
@@ -144,6 +169,11 @@ private:
     mutable Monero::Wallet *m_stakeWallet = nullptr;
     mutable Monero::Wallet *m_minerWallet = nullptr;
     mutable std::map<std::string, Monero::Wallet*> m_viewOnlyWallets;
+    mutable boost::mutex m_viewOnlyWalletsGuard;// guards m_viewOnlyWallets only, FSN list has its own lock
+
+    // the same auth sample addresses are checked for every payment
+    mutable LruCache<std::string, cryptonote::account_public_address> m_addressCache { 1024 };
+    mutable LruCache<std::string, crypto::secret_key> m_viewKeyCache { 1024 };
 
 };
 
@@ -35,11 +35,26 @@ namespace supernode {
 
 
 boost::shared_ptr<FSN_Data> FSN_ServantBase::FSN_DataByStakeAddr(const string& addr) const {
-	boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);
-	for(auto a : All_FSN) if( a->Stake.Addr==addr ) return a;
+	FSN_ListPtr list = GetFsnList();
+	for(auto& a : *list) if( a->Stake.Addr==addr ) return a;
     return nullptr;
 }
 
+FSN_ServantBase::FSN_ListPtr FSN_ServantBase::GetFsnList() const {
+	return boost::atomic_load(&m_FsnList);
+}
+
+void FSN_ServantBase::SetFsnList(const FSN_ListPtr& list) {
+	boost::atomic_store(&m_FsnList, list);
+}
+
+vector<bool> FSN_ServantBase::AreSignsValid(const string& message, const vector< pair<string, string> >& addressSigns) const {
+	vector<bool> ret;
+	ret.reserve(addressSigns.size());
+	for(auto& a : addressSigns) ret.push_back( IsSignValid(message, a.first, a.second) );
+	return ret;
+}
+
 string FSN_ServantBase::GetNodeIp() const
 {
     return m_nodeIp;
@@ -85,18 +100,33 @@ void FSN_ServantBase::SetNodeAddress(const string &address)
 
 void FSN_ServantBase::AddFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
 	boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);
-    All_FSN.push_back(fsn);
+	boost::shared_ptr<FSN_List> list( new FSN_List(*GetFsnList()) );
+    list->push_back(fsn);
+    SetFsnList(list);
+}
+
+bool FSN_ServantBase::AddFsnAccountIfNew(boost::shared_ptr<FSN_Data> fsn) {
+	boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);
+	FSN_ListPtr current = GetFsnList();
+	for(auto& a : *current) if( a->IP==fsn->IP && a->Port==fsn->Port ) return false;
+	boost::shared_ptr<FSN_List> list( new FSN_List(*current) );
+    list->push_back(fsn);
+    SetFsnList(list);
+    return true;
 }
 
 bool FSN_ServantBase::RemoveFsnAccount(boost::shared_ptr<FSN_Data> fsn) {
 	boost::lock_guard<boost::recursive_mutex> lock(All_FSN_Guard);
-    const auto & it = std::find_if(All_FSN.begin(), All_FSN.end(),
+	FSN_ListPtr current = GetFsnList();
+    const auto & it = std::find_if(current->begin(), current->end(),
                                    [fsn] (const boost::shared_ptr<FSN_Data> &other) {
                     return *fsn == *other;
             });
 
-    if(it==All_FSN.end()) return false;
-    All_FSN.erase(it);
+    if(it==current->end()) return false;
+	boost::shared_ptr<FSN_List> list( new FSN_List(*current) );
+    list->erase(list->begin() + (it - current->begin()));
+    SetFsnList(list);
     return true;
 }
 
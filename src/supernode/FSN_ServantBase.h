@@ -48,12 +48,17 @@ namespace supernode {
 
 	    virtual bool IsSignValid(const string& message, const string &address, const string &signature) const=0;
 
+	    // checks signatures of the same message by several wallets, result[i] is the result for addressSigns[i]
+	    virtual vector<bool> AreSignsValid(const string& message, const vector< pair<string, string> >& addressSigns) const;
+
 
 	    virtual uint64_t GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet) const=0;
 
 	public:
 	    // Add WITHOUT any checks. And child add WITHOUT any checks for stake, ping or any other req FSN attrs
 	    virtual void AddFsnAccount(boost::shared_ptr<FSN_Data> fsn);
+	    // Adds unless FSN with the same IP and port is known, the check and the insert are one list update
+	    virtual bool AddFsnAccountIfNew(boost::shared_ptr<FSN_Data> fsn);
 	    virtual bool RemoveFsnAccount(boost::shared_ptr<FSN_Data> fsn);
 	    virtual boost::shared_ptr<FSN_Data> FSN_DataByStakeAddr(const string& addr) const;
         /*!
@@ -108,8 +113,17 @@ namespace supernode {
 
 
 	public:
-	    mutable boost::recursive_mutex All_FSN_Guard;// DO NOT block for long time. if need - use copy
-	    vector< boost::shared_ptr<FSN_Data> > All_FSN;// access to this data may be done from different threads
+	    typedef vector< boost::shared_ptr<FSN_Data> > FSN_List;
+	    typedef boost::shared_ptr<const FSN_List> FSN_ListPtr;
+
+	    // immutable snapshot of all FSN, readers don't take any lock and may keep it as long as needed
+	    FSN_ListPtr GetFsnList() const;
+
+	    mutable boost::recursive_mutex All_FSN_Guard;// serializes FSN list writers only, readers use GetFsnList
+
+	protected:
+	    // publishes new list, must be called with All_FSN_Guard locked
+	    void SetFsnList(const FSN_ListPtr& list);
 
     protected:
         cryptonote::network_type  m_nettype = cryptonote::MAINNET;
@@ -119,6 +133,9 @@ namespace supernode {
         int m_nodePort;
         std::string m_nodelogin;
         std::string m_nodePassword;
+
+	private:
+	    FSN_ListPtr m_FsnList = FSN_ListPtr(new FSN_List());// copy on write, accessed with atomic_load/atomic_store only
 	};
 
 
@@ -0,0 +1,94 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef LRU_CACHE_H_
+#define LRU_CACHE_H_
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace supernode {
+
+	// Thread safe cache of fixed capacity, the least recently used entry is evicted first.
+	template<class Key, class Value, class Hash = std::hash<Key> >
+	class LruCache {
+		public:
+		explicit LruCache(size_t capacity) : m_Capacity(capacity ? capacity : 1) {}
+
+		// copies cached value to value and marks entry as recently used, returns false on miss
+		bool Get(const Key& key, Value& value) {
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			auto it = m_Index.find(key);
+			if( it==m_Index.end() ) return false;
+			m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+			value = it->second->second;
+			return true;
+		}
+
+		void Put(const Key& key, const Value& value) {
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			auto it = m_Index.find(key);
+			if( it!=m_Index.end() ) {
+				it->second->second = value;
+				m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+				return;
+			}
+			if( m_Entries.size()>=m_Capacity ) {
+				m_Index.erase(m_Entries.back().first);
+				m_Entries.pop_back();
+			}
+			m_Entries.emplace_front(key, value);
+			m_Index.emplace(key, m_Entries.begin());
+		}
+
+		void Clear() {
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			m_Index.clear();
+			m_Entries.clear();
+		}
+
+		size_t Size() const {
+			boost::lock_guard<boost::mutex> lock(m_Guard);
+			return m_Entries.size();
+		}
+
+		protected:
+		typedef std::list< std::pair<Key, Value> > Entries;
+
+		const size_t m_Capacity;
+		mutable boost::mutex m_Guard;
+		Entries m_Entries;
+		std::unordered_map<Key, typename Entries::iterator, Hash> m_Index;
+	};
+
+}
+
+#endif /* LRU_CACHE_H_ */
@@ -29,6 +29,9 @@
 
 #include <supernode/P2P_Broadcast.h>
 
+// near sends (seeds list on start) return after this number of members has responded,
+// each member knows the whole ring, so waiting for the slowest ones adds nothing
+static const unsigned s_NearSendQuorum = 3;
 
 namespace supernode {
 
@@ -37,6 +40,7 @@ void P2P_Broadcast::Set(DAPI_RPC_Server* pa, const vector<string>& trustedRing)
 	m_SubNet.RetryCount = 1;
 	m_SubNet.CallTimeout = std::chrono::seconds(1);
 	m_SubNet.AllowSendSefl = false;
+	m_SubNet.Quorum = s_NearSendQuorum;
 	m_SubNet.Set(pa, "p2p", trustedRing);
 
 	AddHandler<rpc_command::P2P_ADD_NODE_TO_LIST>( p2p_call::AddSeed, bind(&P2P_Broadcast::AddSeed, this, _1) );
@@ -75,7 +75,7 @@ namespace supernode {
 
 		template<class IN_t, class OUT_t>
 		bool SendNear( const string& method, IN_t& data, vector<OUT_t>& outv ) {
-			// TODO: need limit number of sends
+			// returns when SubNetBroadcast::Quorum members have responded
 			data.PaymentID = "p2p";
 			return m_SubNet.Send(method, data, outv, false);
 		}
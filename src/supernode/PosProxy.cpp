@@ -52,7 +52,12 @@ bool supernode::PosProxy::Sale(const rpc_command::POS_SALE::request& in, rpc_com
         LOG_ERROR("ERROR_SALE_REQUEST_FAILED");
         return false;
     }
-	Add(data);
+	if( !Add(data) ) {
+        out.Result = ERROR_SALE_REQUEST_FAILED;
+        LOG_ERROR("Sale " << data->TransactionRecord.PaymentID << " is already in progress");
+        Remove(data);
+        return false;
+    }
 
 	m_Work.Service.post( [data](){
 		data->ContinueInit();
@@ -99,10 +99,9 @@ bool supernode::PosSaleObject::PoSTRSigned(const rpc_command::POS_TR_SIGNED::req
 	}
 
     // get tranaction from pool by in.TransactionPoolID
-    // TODO: make txPool as a member of PosProxy or FSN_Servant?
-    TxPool txPool(m_Servant->GetNodeAddress(), m_Servant->GetNodeLogin(), m_Servant->GetNodePassword());
+    boost::shared_ptr<TxPool> txPool = TxPool::shared(m_Servant->GetNodeAddress(), m_Servant->GetNodeLogin(), m_Servant->GetNodePassword());
     cryptonote::transaction tx;
-    if (!txPool.get(in.TransactionPoolID, tx)) {
+    if (!txPool->get(in.TransactionPoolID, tx)) {
         LOG_ERROR("TX " << in.TransactionPoolID << " was not found in pool");
         return false;
     }
@@ -122,10 +121,16 @@ bool supernode::PosSaleObject::PoSTRSigned(const rpc_command::POS_TR_SIGNED::req
         return false;
     }
 
+    vector< pair<string, string> > walletSigns;
+    walletSigns.reserve(graft_tx_extra.Signs.size());
+    for (unsigned i = 0; i < graft_tx_extra.Signs.size(); ++i)
+        walletSigns.push_back( make_pair(TransactionRecord.AuthNodes[i]->Stake.Addr, graft_tx_extra.Signs.at(i)) );
+
+    const vector<bool> signsValid = CheckSigns(walletSigns);
     for (unsigned i = 0; i < graft_tx_extra.Signs.size(); ++i) {
         const string &sign = graft_tx_extra.Signs.at(i);
 
-        if( CheckSign(TransactionRecord.AuthNodes[i]->Stake.Addr, sign) ) {
+        if( signsValid[i] ) {
         	m_Signs++;
         } else {
         	LOG_ERROR("TX " << in.TransactionPoolID << " : signature failed to check for all nodes: " << sign);
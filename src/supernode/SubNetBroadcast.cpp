@@ -84,13 +84,12 @@ void supernode::SubNetBroadcast::Set( DAPI_RPC_Server* pa, string subnet_id, con
 	}
 }
 
-void supernode::SubNetBroadcast::IncNoConnectAndRemove(const string& ip, const string& port) {
+void supernode::SubNetBroadcast::RemoveIfNotAvailable(const string& ip, const string& port) {
 	boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
+	// availability is tracked per endpoint by the client pool, so failures seen by other subnets count as well
+	if( DAPI_RPC_ClientPool::Instance().NotAvailCount(ip, port)<s_MaxNotAvailCount ) return;
 	for(unsigned i=0;i<m_Members.size();i++) if( m_Members[i].IP==ip && m_Members[i].Port==port ) {
-		m_Members[i].NotAvailCount++;
-		if( m_Members[i].NotAvailCount>=s_MaxNotAvailCount ) {
-			m_Members.erase( m_Members.begin()+i );
-		}
+		m_Members.erase( m_Members.begin()+i );
 		break;
 	}
 
@@ -35,6 +35,8 @@
 #include "DAPI_RPC_Client.h"
 #include "DAPI_RPC_Server.h"
 #include "WorkerPool.h"
+#include <boost/make_shared.hpp>
+#include <boost/thread/condition_variable.hpp>
 using namespace std;
 
 namespace supernode {
@@ -56,7 +58,6 @@ namespace supernode {
 			SMember(const string& ip, const string& p) { IP = ip; Port = p; }
 			string IP;
 			string Port;
-			unsigned NotAvailCount = 0;
 		};
 
 		vector< pair<string, string> > Members();//port, ip
@@ -66,65 +67,98 @@ namespace supernode {
 		std::chrono::milliseconds CallTimeout = std::chrono::seconds(5);
 		bool AllowSendSefl = true;
 
-		public:
-		template<class IN_t, class OUT_t>
-		bool Send( const string& method, const IN_t& in, vector<OUT_t>& out, bool reqAllResps=true ) {
-			if(m_SendsCount) throw string("m_SendsCount not zero");
+		// Send returns when this number of members has responded (0 - wait for all members), if not all responses are required
+		unsigned Quorum = 0;
 
-			m_MembersGuard.lock();
+		// results of one Send, shared with the member calls which may outlive the Send
+		template<class OUT_t>
+		struct SSendState {
+			explicit SSendState(unsigned membersCount) : Out(membersCount), Rets(membersCount, -1), Pending(membersCount) {}
 
-			out.resize( m_Members.size() );
-			vector<int> rets;
-			rets.resize( m_Members.size(), 0 );
-			m_SendsCount = m_Members.size();
-
-
-			for(unsigned i=0;i<m_Members.size();i++) {
-				OUT_t* outp = &out[i];
-				int* retp = &rets[i];
-				string ip = m_Members[i].IP;
-				string port = m_Members[i].Port;
-				m_Work.Service.post(
-					[this, method, in, outp, retp, ip, port]() {
-					DoCallInThread<IN_t, OUT_t>(method, in, outp, retp, ip, port);
-				} );
+			// result of the member call; responses which come after the end of the wait are not reported
+			void Complete(unsigned i, bool ok, OUT_t&& resp) {
+				boost::lock_guard<boost::mutex> lock(Guard);
+				if( ok && !Finished ) {
+					Out[i] = std::move(resp);
+					Succeeded++;
+				}
+				if( !Finished ) Rets[i] = ok?1:0;
+				Pending--;
+				Done.notify_all();
 			}
 
-			m_MembersGuard.unlock();
-
-			while(m_SendsCount) boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+			// waits until all members have answered, the first member has failed (reqAllResps) or the quorum is reached
+			// (0 - no quorum), but not later than the deadline; out is all responses in members order (reqAllResps)
+			// or the responses received
+			bool Wait(unsigned quorum, bool reqAllResps, boost::chrono::steady_clock::time_point deadline, vector<OUT_t>& out) {
+				boost::unique_lock<boost::mutex> lock(Guard);
+				while(Pending) {
+					if( reqAllResps && Succeeded+Pending<Rets.size() ) break;// some member has failed
+					if( quorum && Succeeded>=quorum ) break;
+					if( Done.wait_until(lock, deadline)==boost::cv_status::timeout ) break;
+				}
+				Finished = true;
+
+				bool ret = true;
+				out.clear();
+				if(reqAllResps) {
+					for(unsigned i=0;i<Rets.size();i++) if( Rets[i]!=1 ) {
+						ret = false; break;
+					}
+					if(ret) out = std::move(Out);
+				} else {
+					for(unsigned i=0;i<Rets.size();i++) if( Rets[i]==1 ) out.push_back( std::move(Out[i]) );
+				}
+				return ret;
+			}
 
-			bool ret = true;
+			boost::mutex Guard;
+			boost::condition_variable Done;
+			vector<OUT_t> Out;
+			vector<int> Rets;// -1 - pending, 0 - failed, 1 - succeeded
+			unsigned Pending = 0;
+			unsigned Succeeded = 0;
+			bool Finished = false;// the wait has ended, later results are dropped
+		};
 
-			if(reqAllResps) {
-				for(unsigned i=0;i<m_Members.size();i++) if( rets[i]==0 ) {
-					ret = false; break;
+		public:
+		// sends request to all members in parallel, returns as soon as the result is known:
+		// when all members have answered, the first member has failed (reqAllResps) or the quorum is reached,
+		// but not later than the time all members need to complete their calls with retries
+		template<class IN_t, class OUT_t>
+		bool Send( const string& method, const IN_t& in, vector<OUT_t>& out, bool reqAllResps=true ) {
+			boost::shared_ptr< SSendState<OUT_t> > state;
+			{
+				boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
+				state = boost::make_shared< SSendState<OUT_t> >( m_Members.size() );
+
+				for(unsigned i=0;i<m_Members.size();i++) {
+					string ip = m_Members[i].IP;
+					string port = m_Members[i].Port;
+					m_Work.Service.post(
+						[this, method, in, state, i, ip, port]() {
+						OUT_t resp;
+						bool ok = DoCallInThread<IN_t, OUT_t>(method, in, resp, ip, port);
+						state->Complete(i, ok, std::move(resp));
+					} );
 				}
-				if(!ret) out.clear();
-			} else {
-				 vector<OUT_t> vv;
-				 for(unsigned i=0;i<out.size();i++) if( rets[i]!=0 ) vv.push_back( out[i] );
-				 out = vv;
 			}
 
-			return ret;
+			const boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds( RetryCount*(CallTimeout.count()+s_RetryDelayMs)+s_DeadlineSlackMs );
+			return state->Wait(reqAllResps ? 0 : Quorum, reqAllResps, deadline, out);
 		}
 
 		template<class IN_t>
 		void Send( const string& method, const IN_t& in) {
-			if(m_SendsCount) throw string("m_SendsCount not zero");
-
-			rpc_command::P2P_DUMMY_RESP* outp = &m_DummyOut;
-			int* retp = &m_DummyRet;
-
 			boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
 
 			for(unsigned i=0;i<m_Members.size();i++) {
 				string ip = m_Members[i].IP;
 				string port = m_Members[i].Port;
 				m_Work.Service.post(
-					[this, method, in, outp, retp, ip, port]() {
-					DoCallInThread<IN_t, rpc_command::P2P_DUMMY_RESP>(method, in, outp, retp, ip, port);
+					[this, method, in, ip, port]() {
+					rpc_command::P2P_DUMMY_RESP resp;
+					DoCallInThread<IN_t, rpc_command::P2P_DUMMY_RESP>(method, in, resp, ip, port);
 				} );
 			}//for
 		}
@@ -139,30 +173,29 @@ namespace supernode {
 
 		public:
 		template<class IN_t, class OUT_t>
-		void DoCallInThread(string method, const IN_t in, OUT_t* outo, int* ret, string ip, string port) {
+		bool DoCallInThread(const string& method, const IN_t& in, OUT_t& out, const string& ip, const string& port) {
 			bool localcOk = false;
 			bool wasNoConnect = false;
 			for(unsigned k=0;k<RetryCount;k++) {
-				DAPI_RPC_Client client;
-				client.Set( ip, port );
-				if( !client.Invoke<IN_t, OUT_t>(method, in, *outo, CallTimeout) ) {
-					wasNoConnect = wasNoConnect || !client.WasConnected;
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+				bool wasConnected = false;
+				if( !DAPI_RPC_ClientPool::Instance().Invoke<IN_t, OUT_t>(ip, port, method, in, out, CallTimeout, &wasConnected, false) ) {
+					wasNoConnect = wasNoConnect || !wasConnected;
+					boost::this_thread::sleep_for(boost::chrono::milliseconds(s_RetryDelayMs));
 					continue;
 				}
 				localcOk = true;
 				break;
 			}//for K
-			*ret = localcOk?1:0;
-			if(!localcOk && wasNoConnect) IncNoConnectAndRemove(ip, port);
-
-			if(m_SendsCount) m_SendsCount--;
+			// retries are one call for the availability tracking
+			DAPI_RPC_ClientPool::Instance().CountCall(ip, port, localcOk, !wasNoConnect);
+			if(!localcOk && wasNoConnect) RemoveIfNotAvailable(ip, port);
+			return localcOk;
 		}//do work
 
 
 		protected:
 		void _AddMember(const string& ip, const string& port);
-		void IncNoConnectAndRemove(const string& ip, const string& port);
+		void RemoveIfNotAvailable(const string& ip, const string& port);
 
 		protected:
 		DAPI_RPC_Server* m_DAPIServer = nullptr;
@@ -172,12 +205,11 @@ namespace supernode {
 		vector<int> m_MyHandlers;
 
 		protected:
-		int m_SendsCount = 0;
-	    WorkerPool m_Work;
+		static const unsigned s_RetryDelayMs = 10;
+		static const unsigned s_DeadlineSlackMs = 100;
 
 		protected:
-		rpc_command::P2P_DUMMY_RESP m_DummyOut;
-		int m_DummyRet=0;
+	    WorkerPool m_Work;
 
 
 
@@ -0,0 +1,84 @@
+// Copyright (c) 2017, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace supernode {
+
+	// Timer wheel for items with bounded delay: scheduling and expiry are O(1) amortized.
+	// Wheel is advanced explicitly, items are scheduled relative to the time of the last advance.
+	template<class T>
+	class TimerWheel {
+		public:
+		typedef std::chrono::steady_clock Clock;
+
+		TimerWheel(std::chrono::milliseconds maxDelay, std::chrono::milliseconds resolution)
+			: m_Resolution(resolution), m_Slots(size_t(maxDelay / resolution) + 2), m_Start(Clock::now()) {}
+
+		// schedules item to expire after delay (delay is clamped to the max delay of the wheel)
+		void Schedule(const T& item, std::chrono::milliseconds delay) {
+			size_t ticks = size_t((delay + m_Resolution - std::chrono::milliseconds(1)) / m_Resolution);
+			if(ticks < 1) ticks = 1;
+			if(ticks > m_Slots.size() - 1) ticks = m_Slots.size() - 1;
+			m_Slots[(m_Tick + ticks) % m_Slots.size()].push_back(item);
+			m_Count++;
+		}
+
+		// moves wheel to the time point, items which have expired by then are appended to expired
+		void Advance(Clock::time_point now, std::vector<T>& expired) {
+			if(now < m_Start) return;
+			const uint64_t target = uint64_t((now - m_Start) / m_Resolution);
+			for(size_t i = 0; m_Tick < target && i < m_Slots.size(); i++) {
+				m_Tick++;
+				std::vector<T>& slot = m_Slots[m_Tick % m_Slots.size()];
+				m_Count -= slot.size();
+				for(auto& a : slot) expired.push_back(std::move(a));
+				slot.clear();
+			}
+			// all slots have been expired if the wheel hasn't been advanced for the whole period
+			if(m_Tick < target) m_Tick = target;
+		}
+
+		size_t Size() const { return m_Count; }
+
+		protected:
+		const std::chrono::milliseconds m_Resolution;
+		std::vector< std::vector<T> > m_Slots;
+		const Clock::time_point m_Start;
+		uint64_t m_Tick = 0;
+		size_t m_Count = 0;
+	};
+
+}
+
+#endif /* TIMER_WHEEL_H_ */
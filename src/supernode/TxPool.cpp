@@ -33,22 +33,35 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 
 #include <exception>
+#include <map>
+#include <unordered_set>
+#include <boost/make_shared.hpp>
+#include <boost/scope_exit.hpp>
+#include <boost/thread/mutex.hpp>
 
 using namespace std;
 
 namespace supernode {
 
+static const size_t s_max_idle_http_clients = 4;
+
 TxPool::TxPool(const std::string &daemon_addr, const std::string &daemon_login, const std::string &daemon_pass)
-  : m_rpc_timeout(std::chrono::seconds(30))
+  : m_daemon_address(daemon_addr)
+  , m_rpc_timeout(std::chrono::seconds(30))
 {
-
-    bool result = false;
-    boost::optional<epee::net_utils::http::login> login{};
     if (!daemon_login.empty() && !daemon_pass.empty()) {
-        login.emplace(daemon_login, daemon_pass);
+        m_daemon_login.emplace(daemon_login, daemon_pass);
     }
-    result = init(daemon_addr, login);
-    if (!result) {
+    const std::string address = m_daemon_address;
+    const boost::optional<epee::net_utils::http::login> login = m_daemon_login;
+    m_http_clients.reset(new http_client_pool([address, login]() {
+        http_client_pool::ClientPtr client(new epee::net_utils::http::http_simple_client());
+        client->set_server(address, login);
+        return client;
+    }, s_max_idle_http_clients));
+
+    epee::net_utils::http::http_simple_client client;
+    if (!client.set_server(daemon_addr, m_daemon_login)) {
         throw std::runtime_error("can't connect to node: " + daemon_addr);
     }
 }
@@ -58,72 +71,108 @@ TxPool::~TxPool()
 
 }
 
+boost::shared_ptr<TxPool> TxPool::shared(const std::string &daemon_addr, const std::string &daemon_login, const std::string &daemon_pass)
+{
+    static boost::mutex pools_lock;
+    static std::map<std::string, boost::shared_ptr<TxPool>> pools;
+
+    const std::string key = daemon_addr + "\n" + daemon_login + "\n" + daemon_pass;
+    boost::lock_guard<boost::mutex> lock(pools_lock);
+    boost::shared_ptr<TxPool> &pool = pools[key];
+    if (!pool)
+        pool = boost::make_shared<TxPool>(daemon_addr, daemon_login, daemon_pass);
+    return pool;
+}
+
 bool TxPool::get(const string &hash_str, cryptonote::transaction &out_tx)
 {
-    crypto::hash hash;
-    if (!epee::string_tools::hex_to_pod(hash_str, hash)) {
-        LOG_ERROR("error parsing input hash");
+    std::vector<cryptonote::transaction> txs;
+    if (!get(std::vector<std::string>{hash_str}, txs))
         return false;
+    out_tx = std::move(txs.front());
+    return true;
+}
+
+bool TxPool::get(const std::vector<std::string> &hash_strs, std::vector<cryptonote::transaction> &out_txs)
+{
+    std::vector<crypto::hash> hashes(hash_strs.size());
+    for (size_t i = 0; i < hash_strs.size(); ++i) {
+        if (!epee::string_tools::hex_to_pod(hash_strs[i], hashes[i])) {
+            LOG_ERROR("error parsing input hash");
+            return false;
+        }
     }
 
+    bool reused = false;
+    http_client_pool::ClientPtr http_client = m_http_clients->Acquire(&reused);
+    bool http_ok = false;
+    BOOST_SCOPE_EXIT_ALL(&) { m_http_clients->Release(std::move(http_client), http_ok); };
+
     // get the pool state
     cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request req;
     cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response res;
 
-    bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, m_http_client, m_rpc_timeout);
+    bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, *http_client, m_rpc_timeout);
+    if (!r && reused) {
+        // idle keep-alive connection may have been closed by the daemon, retry once on a new one
+        MDEBUG("/get_transaction_pool_hashes.bin failed on a reused connection, retrying");
+        http_client = m_http_clients->Create();
+        r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, *http_client, m_rpc_timeout);
+    }
     if (!r) {
         LOG_ERROR("/get_transaction_pool_hashes.bin error");
         return r;
     }
 
     MDEBUG("got pool");
-    const auto it = std::find(res.tx_hashes.begin(), res.tx_hashes.end(), hash);
-    if (it == res.tx_hashes.end()) {
-       MWARNING("tx: " << hash_str << " was not found in pool");
-       return false;
+    const std::unordered_set<crypto::hash> pool_hashes(res.tx_hashes.begin(), res.tx_hashes.end());
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        if (pool_hashes.find(hashes[i]) == pool_hashes.end()) {
+            MWARNING("tx: " << hash_strs[i] << " was not found in pool");
+            http_ok = true;
+            return false;
+        }
     }
 
-    // get full tx
+    // get full txs
     cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request req_tx;
     cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response res_tx;
-    req_tx.txs_hashes.push_back(hash_str);
+    req_tx.txs_hashes = hash_strs;
 
     req_tx.decode_as_json = false;
-    r = epee::net_utils::invoke_http_json("/gettransactions", req_tx, res_tx, m_http_client, m_rpc_timeout);
-    if (!r && res.status != CORE_RPC_STATUS_OK) {
+    r = epee::net_utils::invoke_http_json("/gettransactions", req_tx, res_tx, *http_client, m_rpc_timeout);
+    if (!r || res_tx.status != CORE_RPC_STATUS_OK) {
         LOG_ERROR("/getransactions error");
         return false;
     }
+    http_ok = true;
 
-    // parse transaction
-    if (res_tx.txs.size() != 1) {
+    // parse transactions
+    if (res_tx.txs.size() != hashes.size()) {
         LOG_ERROR("Wrong number of tx returned: " << res_tx.txs.size());
         return false;
     }
 
-    cryptonote::blobdata bd;
-    crypto::hash tx_hash, tx_prefix_hash;
-    if (!epee::string_tools::parse_hexstr_to_binbuff(res_tx.txs[0].as_hex, bd)) {
-        LOG_ERROR("failed to parse tx from hex");
-        return false;
-    }
-
-    if (!cryptonote::parse_and_validate_tx_from_blob(bd, out_tx, tx_hash, tx_prefix_hash)) {
-        LOG_ERROR("failed to parse tx from blob");
-        return false;
-    }
-
-    if (hash != tx_hash) {
-        LOG_ERROR("wrong tx received from daemon");
-        return false;
+    out_txs.resize(hashes.size());
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        cryptonote::blobdata bd;
+        crypto::hash tx_hash, tx_prefix_hash;
+        if (!epee::string_tools::parse_hexstr_to_binbuff(res_tx.txs[i].as_hex, bd)) {
+            LOG_ERROR("failed to parse tx from hex");
+            return false;
+        }
+
+        if (!cryptonote::parse_and_validate_tx_from_blob(bd, out_txs[i], tx_hash, tx_prefix_hash)) {
+            LOG_ERROR("failed to parse tx from blob");
+            return false;
+        }
+
+        if (hashes[i] != tx_hash) {
+            LOG_ERROR("wrong tx received from daemon");
+            return false;
+        }
     }
     return true;
 }
 
-bool TxPool::init(const string &daemon_address, boost::optional<epee::net_utils::http::login> daemon_login)
-{
-    return m_http_client.set_server(daemon_address, daemon_login);
-    return false;
-}
-
 } // namespace
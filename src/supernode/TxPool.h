@@ -33,11 +33,14 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <memory>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "net/http_client.h"
 #include "net/http_auth.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "ClientPool.h"
 
 
 namespace supernode {
@@ -47,15 +50,21 @@ class TxPool
 public:
     TxPool(const std::string &daemon_addr, const std::string &daemon_login, const std::string &daemon_pass);
     virtual ~TxPool();
-    bool get(const std::string &hash_str, cryptonote::transaction &out_tx);
 
+    // pool shared by all callers which use the same daemon, its connections are kept alive between calls
+    static boost::shared_ptr<TxPool> shared(const std::string &daemon_addr, const std::string &daemon_login, const std::string &daemon_pass);
 
-protected:
-    bool init(const std::string &daemon_address, boost::optional<epee::net_utils::http::login> daemon_login);
+    bool get(const std::string &hash_str, cryptonote::transaction &out_tx);
+    // gets the transactions in one request, fails if any of them is not in the pool
+    bool get(const std::vector<std::string> &hash_strs, std::vector<cryptonote::transaction> &out_txs);
 
 
 private:
-    epee::net_utils::http::http_simple_client m_http_client;
+    typedef ClientPool<epee::net_utils::http::http_simple_client> http_client_pool;
+
+    std::string m_daemon_address;
+    boost::optional<epee::net_utils::http::login> m_daemon_login;
+    std::unique_ptr<http_client_pool> m_http_clients;
     std::chrono::seconds m_rpc_timeout;
 
 };
@@ -101,9 +101,15 @@ bool supernode::WalletPayObject::_Init(const rpc_command::WALLET_PAY::request& s
         return false;// not all signs gotted
     }
 
+    vector< pair<string, string> > walletSigns;
+    walletSigns.reserve(outv.size());
+    for (auto& a : outv) walletSigns.push_back( make_pair(a.FSN_StakeWalletAddr, a.Sign) );
+
+    const vector<bool> signsValid = CheckSigns(walletSigns);
+    for (size_t i = 0; i < signsValid.size(); ++i) if( !signsValid[i] ) return false;
+
     for (auto& a : outv) {
 
-        if( !CheckSign(a.FSN_StakeWalletAddr, a.Sign) ) return false;
         m_Signs.push_back(a.Sign);
         LOG_PRINT_L0("pushing sign " << a.Sign << " to tx,  checked with address: " << a.FSN_StakeWalletAddr);
 
@@ -56,10 +56,16 @@ bool supernode::WalletProxy::Pay(const rpc_command::WALLET_PAY::request& in, rpc
 	data->Owner(this);
 	Setup(data);
 	data->BeforStart();
-	Add(data);
 
-	m_Work.Service.post( [data, in](){
-	    if (!data->Init(in)) {
+	m_Work.Service.post( [this, data, in](){
+	    bool ret = data->Init(in);
+	    // payment id is known after Init, failed object is kept as well so its status can be requested until it expires
+	    if (!Add(data)) {
+	        LOG_ERROR("Payment " << data->TransactionRecord.PaymentID << " is already in progress");
+	        Remove(data);
+	        return;
+	    }
+	    if (!ret) {
 	        LOG_ERROR("Failed to init WalletPayObject");
 	        return;
 	    }
@@ -76,7 +82,5 @@ bool supernode::WalletProxy::WalletGetPosData(const rpc_command::WALLET_GET_POS_
 
 	boost::shared_ptr<FSN_Data> data = *vv.begin();
 
-	DAPI_RPC_Client call;
-	call.Set(data->IP, data->Port);
-	return call.Invoke(dapi_call::WalletProxyGetPosData, in, out);
+	return DAPI_RPC_ClientPool::Instance().Invoke(data->IP, data->Port, dapi_call::WalletProxyGetPosData, in, out);
 }
@@ -0,0 +1,123 @@
+// Copyright (c) 2014-2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "chaingen.h"
+#include "block_template.h"
+
+using namespace epee;
+using namespace cryptonote;
+
+namespace
+{
+  bool get_template_tx_hashes(cryptonote::core& c, std::vector<crypto::hash>& tx_hashes)
+  {
+    block b;
+    difficulty_type diffic;
+    uint64_t height;
+    uint64_t expected_reward;
+    account_base miner;
+    miner.generate();
+    if (!c.get_block_template(b, miner.get_keys().m_account_address, diffic, height, expected_reward, blobdata()))
+      return false;
+    tx_hashes = b.tx_hashes;
+    return true;
+  }
+}
+
+gen_block_template_incremental::gen_block_template_incremental()
+{
+  REGISTER_CALLBACK_METHOD(gen_block_template_incremental, check_block_template_filled);
+  REGISTER_CALLBACK_METHOD(gen_block_template_incremental, check_block_template_updated);
+  REGISTER_CALLBACK_METHOD(gen_block_template_incremental, check_block_template_rebuilt);
+}
+
+bool gen_block_template_incremental::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+
+  GENERATE_ACCOUNT(miner_account);
+  GENERATE_ACCOUNT(bob_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  REWIND_BLOCKS(events, blk_3r, blk_3, miner_account);
+
+  construct_tx_with_fee(events, blk_3, miner_account, bob_account, MK_COINS(1), TESTS_DEFAULT_FEE);
+  DO_CALLBACK(events, "check_block_template_filled");
+
+  // a full rebuild would put the better paying transaction first, the incremental update appends it
+  construct_tx_with_fee(events, blk_3, miner_account, bob_account, MK_COINS(1), 5 * TESTS_DEFAULT_FEE);
+  DO_CALLBACK(events, "check_block_template_updated");
+
+  // a block changes the chain, so the template is filled from scratch in the fee order
+  MAKE_NEXT_BLOCK(events, blk_4, blk_3r, miner_account);
+  DO_CALLBACK(events, "check_block_template_rebuilt");
+
+  return true;
+}
+
+bool gen_block_template_incremental::check_block_template_filled(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_incremental::check_block_template_filled");
+
+  CHECK_EQ(1, c.get_pool_transactions_count());
+  m_pool_txs.push_back(get_transaction_hash(boost::get<transaction>(events[ev_index - 1])));
+
+  std::vector<crypto::hash> tx_hashes;
+  CHECK_TEST_CONDITION(get_template_tx_hashes(c, tx_hashes));
+  CHECK_TEST_CONDITION(tx_hashes == m_pool_txs);
+  return true;
+}
+
+bool gen_block_template_incremental::check_block_template_updated(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_incremental::check_block_template_updated");
+
+  CHECK_EQ(2, c.get_pool_transactions_count());
+  m_pool_txs.push_back(get_transaction_hash(boost::get<transaction>(events[ev_index - 1])));
+
+  std::vector<crypto::hash> tx_hashes;
+  CHECK_TEST_CONDITION(get_template_tx_hashes(c, tx_hashes));
+  CHECK_TEST_CONDITION(tx_hashes == m_pool_txs);
+  return true;
+}
+
+bool gen_block_template_incremental::check_block_template_rebuilt(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_template_incremental::check_block_template_rebuilt");
+
+  CHECK_EQ(2, c.get_pool_transactions_count());
+
+  std::vector<crypto::hash> tx_hashes;
+  CHECK_TEST_CONDITION(get_template_tx_hashes(c, tx_hashes));
+  CHECK_EQ(2, tx_hashes.size());
+  CHECK_TEST_CONDITION(tx_hashes[0] == m_pool_txs[1]);
+  CHECK_TEST_CONDITION(tx_hashes[1] == m_pool_txs[0]);
+  return true;
+}
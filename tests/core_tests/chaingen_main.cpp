@@ -168,6 +168,8 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(gen_uint_overflow_2);
 
     GENERATE_AND_PLAY(gen_block_reward);
+    GENERATE_AND_PLAY(gen_block_template_incremental);
+    GENERATE_AND_PLAY(gen_tx_pool_concurrent_admission);
 
     GENERATE_AND_PLAY(gen_v2_tx_mixable_0_mixin);
     GENERATE_AND_PLAY(gen_v2_tx_mixable_low_mixin);
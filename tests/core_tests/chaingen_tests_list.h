@@ -32,12 +32,14 @@
 
 #include "chaingen.h"
 #include "block_reward.h"
+#include "block_template.h"
 #include "block_validation.h"
 #include "chain_split_1.h"
 #include "chain_switch_1.h"
 #include "double_spend.h"
 #include "integer_overflow.h"
 #include "ring_signature_1.h"
+#include "tx_pool_concurrency.h"
 #include "tx_validation.h"
 #include "v2_tests.h"
 #include "rct.h"
@@ -0,0 +1,132 @@
+// Copyright (c) 2014-2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <boost/thread/thread.hpp>
+#include "chaingen.h"
+#include "tx_pool_concurrency.h"
+
+using namespace epee;
+using namespace cryptonote;
+
+namespace
+{
+  const size_t SENDERS_COUNT = 16;
+  const size_t THREADS_COUNT = 4;
+}
+
+gen_tx_pool_concurrent_admission::gen_tx_pool_concurrent_admission()
+{
+  REGISTER_CALLBACK_METHOD(gen_tx_pool_concurrent_admission, check_concurrent_admission);
+}
+
+bool gen_tx_pool_concurrent_admission::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+
+  GENERATE_ACCOUNT(miner_account);
+  GENERATE_ACCOUNT(bob_account);
+  GENERATE_ACCOUNT(alice_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+
+  std::vector<account_base> senders(SENDERS_COUNT);
+  block blk_last = blk_0;
+  for (account_base& sender : senders)
+  {
+    sender.generate();
+    block blk;
+    generator.construct_block(blk, blk_last, sender);
+    events.push_back(blk);
+    blk_last = blk;
+  }
+  REWIND_BLOCKS(events, blk_r, blk_last, miner_account);
+
+  m_txs.clear();
+  for (const account_base& sender : senders)
+  {
+    transaction tx;
+    CHECK_AND_ASSERT_MES(construct_tx_to_key(events, tx, blk_r, sender, bob_account, MK_COINS(1), TESTS_DEFAULT_FEE, 0), false, "failed to construct tx");
+    m_txs.push_back(tx);
+  }
+
+  // spends the same outputs as the first transaction
+  transaction double_spend;
+  CHECK_AND_ASSERT_MES(construct_tx_to_key(events, double_spend, blk_r, senders[0], alice_account, MK_COINS(1), TESTS_DEFAULT_FEE, 0), false, "failed to construct tx");
+  m_txs.push_back(double_spend);
+
+  DO_CALLBACK(events, "check_concurrent_admission");
+  return true;
+}
+
+bool gen_tx_pool_concurrent_admission::check_concurrent_admission(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_tx_pool_concurrent_admission::check_concurrent_admission");
+
+  std::vector<blobdata> blobs;
+  for (const transaction& tx : m_txs)
+    blobs.push_back(tx_to_blob(tx));
+
+  // every thread submits all transactions, each starting from a different one
+  std::vector<std::vector<tx_verification_context>> tvcs(THREADS_COUNT, std::vector<tx_verification_context>(blobs.size()));
+  std::vector<boost::thread> threads;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < THREADS_COUNT; ++t)
+  {
+    threads.emplace_back([&c, &blobs, &tvcs, t]() {
+      for (size_t n = 0; n < blobs.size(); ++n)
+      {
+        const size_t i = (t * blobs.size() / THREADS_COUNT + n) % blobs.size();
+        c.handle_incoming_tx(blobs[i], tvcs[t][i], false, false, false);
+      }
+    });
+  }
+  for (boost::thread& thread : threads)
+    thread.join();
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  MGINFO("Submitted " << THREADS_COUNT * blobs.size() << " txes from " << THREADS_COUNT << " threads in " << elapsed << " us ("
+      << (elapsed ? THREADS_COUNT * blobs.size() * 1000000 / elapsed : 0) << " tx/s)");
+
+  // the double spend pair is the only conflict, so all the other transactions are admitted once
+  CHECK_EQ(SENDERS_COUNT, c.get_pool_transactions_count());
+  size_t added = 0;
+  for (size_t t = 0; t < THREADS_COUNT; ++t)
+  {
+    for (size_t i = 1; i < SENDERS_COUNT; ++i)
+      CHECK_TEST_CONDITION(!tvcs[t][i].m_verifivation_failed);
+    for (size_t i = 0; i < blobs.size(); ++i)
+      added += tvcs[t][i].m_added_to_pool ? 1 : 0;
+  }
+  CHECK_EQ(SENDERS_COUNT, added);
+
+  for (size_t i = 1; i < SENDERS_COUNT; ++i)
+    CHECK_TEST_CONDITION(c.pool_has_tx(get_transaction_hash(m_txs[i])));
+  const bool first_in_pool = c.pool_has_tx(get_transaction_hash(m_txs.front()));
+  const bool double_spend_in_pool = c.pool_has_tx(get_transaction_hash(m_txs.back()));
+  CHECK_TEST_CONDITION(first_in_pool != double_spend_in_pool);
+  return true;
+}
@@ -0,0 +1,286 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "crypto/crypto.h"
+#include "string_tools.h"
+#include "cryptonote_config.h"
+#include "graft_rta_config.h"
+#include "cryptonote_core/blockchain_based_list.h"
+#include "cryptonote_core/stake_transaction_storage.h"
+
+/// Per block cost of blockchain based list construction for a large number of supernodes:
+///   incremental=true  - BlockchainBasedList::apply_block() with tier indexes updated from stake changes
+///   incremental=false - full rebuild: filter and sort all stakes of each tier for every block (previous algorithm)
+/// Both variants produce the same lists; the incremental one is checked against the full rebuild during init.
+/// Stakes snapshot of each block is built in the same call, its share of the time is reported separately.
+template<size_t supernodes_count, bool incremental>
+class test_blockchain_based_list_apply
+{
+public:
+  static const size_t loop_count = incremental ? 100 : (supernodes_count > 10000 ? 5 : 20);
+  static const size_t checked_blocks_count = 10;
+  static const size_t stake_txs_per_block = 4;
+  static const size_t list_size = 32;
+  static const size_t prev_list_max_size = 16;
+  static const uint64_t first_block_height = 100;
+
+  typedef cryptonote::BlockchainBasedList::supernode            supernode;
+  typedef cryptonote::BlockchainBasedList::supernode_array      supernode_array;
+  typedef cryptonote::BlockchainBasedList::supernode_tier_array supernode_tier_array;
+
+  test_blockchain_based_list_apply()
+    : m_stakes("", 0)
+    , m_list("", first_block_height)
+    , m_block_height(first_block_height)
+    , m_blocks_count()
+    , m_stakes_update_time()
+  {
+  }
+
+  ~test_blockchain_based_list_apply()
+  {
+    if (m_blocks_count)
+      std::cout << "  stakes snapshot: " << m_stakes_update_time / m_blocks_count << " us per block" << std::endl;
+  }
+
+  bool init()
+  {
+    m_supernode_ids.reserve(supernodes_count);
+
+    for (size_t i=0; i<supernodes_count; i++)
+      m_supernode_ids.push_back(epee::string_tools::pod_to_hex(crypto::rand<crypto::hash>()));
+
+    for (size_t i=0; i<supernodes_count; i++)
+      add_stake_tx(m_supernode_ids[i], 1 + i % first_block_height);
+
+    for (size_t i=0; i<checked_blocks_count; i++)
+    {
+      crypto::hash block_hash = next_block();
+
+      m_list.apply_block(m_block_height, block_hash, m_stakes);
+
+      supernode_tier_array expected_tiers;
+
+      rebuild(block_hash, expected_tiers);
+
+      if (!equal(expected_tiers, m_list.tiers()))
+      {
+        std::cerr << "Blockchain based list for block " << m_block_height << " differs from the full rebuild" << std::endl;
+        return false;
+      }
+
+      m_tiers = expected_tiers;
+    }
+
+    m_blocks_count = 0;
+    m_stakes_update_time = 0;
+
+    return true;
+  }
+
+  bool test()
+  {
+    crypto::hash block_hash = next_block();
+
+    if (incremental)
+    {
+      m_list.apply_block(m_block_height, block_hash, m_stakes);
+    }
+    else
+    {
+      supernode_tier_array new_tiers;
+
+      rebuild(block_hash, new_tiers);
+
+      m_tiers = std::move(new_tiers);
+    }
+
+    m_blocks_count++;
+
+    return true;
+  }
+
+private:
+  void add_stake_tx(const std::string& supernode_public_id, uint64_t block_height)
+  {
+    static const uint64_t tier_stake_amounts[] = {config::graft::TIER1_STAKE_AMOUNT, config::graft::TIER2_STAKE_AMOUNT,
+      config::graft::TIER3_STAKE_AMOUNT, config::graft::TIER4_STAKE_AMOUNT};
+
+    cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+
+    tx.hash                = crypto::rand<crypto::hash>();
+    tx.amount              = tier_stake_amounts[crypto::rand<size_t>() % config::graft::TIERS_COUNT];
+    tx.block_height        = block_height;
+    tx.unlock_time         = 1000000;
+    tx.supernode_public_id = supernode_public_id;
+
+    m_stakes.add_tx(tx);
+  }
+
+  /// Simulate new block with a few restakes of existing supernodes (stakes change tier after validation period)
+  crypto::hash next_block()
+  {
+    crypto::hash block_hash = crypto::rand<crypto::hash>();
+
+    m_block_height++;
+
+    for (size_t i=0; i<stake_txs_per_block; i++)
+      add_stake_tx(m_supernode_ids[crypto::rand<size_t>() % supernodes_count], m_block_height);
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    m_stakes.update_supernode_stakes(m_block_height);
+
+    m_stakes_update_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+    return block_hash;
+  }
+
+  void select_supernodes(size_t items_count, const supernode_array& src_list, supernode_array& dst_list)
+  {
+    size_t src_list_size = src_list.size();
+
+    if (items_count > src_list_size)
+      items_count = src_list_size;
+
+    for (size_t i=0; i<src_list_size; i++)
+    {
+      size_t random_value = m_rng() % (src_list_size - i);
+
+      if (random_value >= items_count)
+        continue;
+
+      dst_list.push_back(src_list[i]);
+
+      items_count--;
+    }
+  }
+
+  /// Build lists from scratch using all stakes of the block
+  void rebuild(const crypto::hash& block_hash, supernode_tier_array& new_tiers)
+  {
+    cryptonote::supernode_stake_snapshot_ptr stakes = m_stakes.get_supernode_stake_snapshot(m_block_height);
+
+    supernode_array prev_supernodes, current_supernodes;
+
+    for (size_t i=0; i<config::graft::TIERS_COUNT; i++)
+    {
+      prev_supernodes.clear();
+      current_supernodes.clear();
+
+      if (!m_tiers.empty())
+      {
+        for (const supernode& sn : m_tiers[i])
+        {
+          const cryptonote::supernode_stake* stake = stakes->find(sn.supernode_public_id);
+
+          if (stake && stake->amount && stake->tier == i + 1)
+            prev_supernodes.push_back(sn);
+        }
+      }
+
+      for (const cryptonote::supernode_stake& stake : stakes->stakes)
+      {
+        if (!stake.amount || stake.tier != i + 1)
+          continue;
+
+        supernode sn;
+
+        sn.supernode_public_id      = stake.supernode_public_id;
+        sn.supernode_public_address = stake.supernode_public_address;
+        sn.amount                   = stake.amount;
+        sn.block_height             = stake.block_height;
+        sn.unlock_time              = stake.unlock_time;
+
+        current_supernodes.emplace_back(std::move(sn));
+      }
+
+      std::seed_seq seed(reinterpret_cast<const unsigned char*>(&block_hash.data[0]),
+                         reinterpret_cast<const unsigned char*>(&block_hash.data[sizeof block_hash.data]));
+
+      m_rng.seed(seed);
+
+      std::stable_sort(current_supernodes.begin(), current_supernodes.end(), [](const supernode& s1, const supernode& s2) {
+        return s1.block_height < s2.block_height || (s1.block_height == s2.block_height && s1.supernode_public_id < s2.supernode_public_id);
+      });
+
+      supernode_array new_supernodes;
+
+      select_supernodes(prev_list_max_size, prev_supernodes, new_supernodes);
+
+      auto duplicates_filter = [&](const supernode& sn1) {
+        for (const supernode& sn2 : new_supernodes)
+          if (sn1.supernode_public_id == sn2.supernode_public_id)
+            return true;
+
+        return false;
+      };
+
+      current_supernodes.erase(std::remove_if(current_supernodes.begin(), current_supernodes.end(), duplicates_filter), current_supernodes.end());
+
+      select_supernodes(list_size - new_supernodes.size(), current_supernodes, new_supernodes);
+
+      new_tiers.emplace_back(std::move(new_supernodes));
+    }
+  }
+
+  static bool equal(const supernode_tier_array& tiers1, const supernode_tier_array& tiers2)
+  {
+    if (tiers1.size() != tiers2.size())
+      return false;
+
+    for (size_t i=0; i<tiers1.size(); i++)
+    {
+      if (tiers1[i].size() != tiers2[i].size())
+        return false;
+
+      for (size_t j=0; j<tiers1[i].size(); j++)
+        if (tiers1[i][j].supernode_public_id != tiers2[i][j].supernode_public_id || tiers1[i][j].amount != tiers2[i][j].amount)
+          return false;
+    }
+
+    return true;
+  }
+
+private:
+  cryptonote::StakeTransactionStorage m_stakes;
+  cryptonote::BlockchainBasedList m_list;
+  std::vector<std::string> m_supernode_ids;
+  supernode_tier_array m_tiers;
+  std::mt19937_64 m_rng;
+  uint64_t m_block_height;
+  uint64_t m_blocks_count;
+  uint64_t m_stakes_update_time;
+};
@@ -0,0 +1,181 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <boost/filesystem.hpp>
+
+#include "crypto/crypto.h"
+#include "string_tools.h"
+#include "cryptonote_config.h"
+#include "graft_rta_config.h"
+#include "cryptonote_core/blockchain_based_list.h"
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "serialization/binary_archive.h"
+
+/// Per block cost of blockchain based list persistence:
+///   journaled=true  - BlockchainBasedList::store() with append-only journal and periodic checkpoints (synced to disk)
+///   journaled=false - full rewrite of the list history with binary_archive after each block (previous file format)
+template<bool journaled>
+class test_blockchain_based_list_store
+{
+public:
+  static const size_t loop_count = journaled ? 1000 : 20;
+  static const size_t history_depth = 1000;
+  static const size_t supernodes_count = 400;
+
+  test_blockchain_based_list_store()
+    : m_dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    , m_block_height()
+    , m_blocks_count()
+    , m_written_bytes_count()
+    , m_base_written_bytes_count()
+  {
+  }
+
+  ~test_blockchain_based_list_store()
+  {
+    if (m_blocks_count)
+      std::cout << "  " << (journaled ? "journal" : "full rewrite") << ": " << get_written_bytes_count() / m_blocks_count << " byte(s) written per block" << std::endl;
+
+    m_list.reset();
+    m_stakes.reset();
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(m_dir, ec);
+  }
+
+  bool init()
+  {
+    if (!boost::filesystem::create_directories(m_dir))
+      return false;
+
+    m_stakes.reset(new cryptonote::StakeTransactionStorage((m_dir / "stake_transactions").string(), 0));
+    m_list.reset(new cryptonote::BlockchainBasedList((m_dir / "blockchain_based_list").string(), 0));
+
+    static const uint64_t tier_stake_amounts[] = {config::graft::TIER1_STAKE_AMOUNT, config::graft::TIER2_STAKE_AMOUNT,
+      config::graft::TIER3_STAKE_AMOUNT, config::graft::TIER4_STAKE_AMOUNT};
+
+    for (size_t i=0; i<supernodes_count; i++)
+    {
+      cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+
+      tx.hash                = crypto::rand<crypto::hash>();
+      tx.amount              = tier_stake_amounts[i % config::graft::TIERS_COUNT];
+      tx.block_height        = 1;
+      tx.unlock_time         = 1000000;
+      tx.supernode_public_id = epee::string_tools::pod_to_hex(crypto::rand<crypto::hash>());
+
+      m_stakes->add_tx(tx);
+    }
+
+    for (size_t i=0; i<history_depth; i++)
+      apply_block();
+
+    store();
+
+    m_blocks_count = 0;
+    m_written_bytes_count = 0;
+    m_base_written_bytes_count = m_list->get_stored_bytes_count();
+
+    return true;
+  }
+
+  bool test()
+  {
+    apply_block();
+    store();
+    m_blocks_count++;
+    return true;
+  }
+
+private:
+  struct list_container
+  {
+    uint64_t block_height;
+    size_t history_depth;
+    cryptonote::BlockchainBasedList::list_history& history;
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELD(block_height)
+      FIELD(history_depth)
+      FIELD(history)
+    END_SERIALIZE()
+  };
+
+  void apply_block()
+  {
+    m_list->apply_block(++m_block_height, crypto::rand<crypto::hash>(), *m_stakes);
+
+    if (journaled)
+      return;
+
+    m_history.push_back(m_list->tiers());
+
+    if (m_history.size() > m_list->history_depth())
+      m_history.pop_front();
+  }
+
+  void store()
+  {
+    if (journaled)
+    {
+      m_list->store();
+      return;
+    }
+
+    list_container data = {m_block_height, m_history.size(), m_history};
+    std::string file_name = (m_dir / "blockchain_based_list.full").string();
+
+    std::ofstream ostr;
+    ostr.open(file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+
+    binary_archive<true> oar(ostr);
+
+    ::serialization::serialize(oar, data);
+
+    m_written_bytes_count += ostr.tellp();
+  }
+
+  uint64_t get_written_bytes_count() const
+  {
+    return journaled ? m_list->get_stored_bytes_count() - m_base_written_bytes_count : m_written_bytes_count;
+  }
+
+private:
+  boost::filesystem::path m_dir;
+  std::unique_ptr<cryptonote::StakeTransactionStorage> m_stakes;
+  std::unique_ptr<cryptonote::BlockchainBasedList> m_list;
+  cryptonote::BlockchainBasedList::list_history m_history;
+  uint64_t m_block_height;
+  uint64_t m_blocks_count;
+  uint64_t m_written_bytes_count;
+  uint64_t m_base_written_bytes_count;
+};
@@ -61,6 +61,8 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "blockchain_based_list_store.h"
+#include "blockchain_based_list_apply.h"
 
 namespace po = boost::program_options;
 
@@ -547,6 +549,13 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger, 4096, 9);
 #endif
 
+  TEST_PERFORMANCE1(filter, p, test_blockchain_based_list_store, false);
+  TEST_PERFORMANCE1(filter, p, test_blockchain_based_list_store, true);
+  TEST_PERFORMANCE2(filter, p, test_blockchain_based_list_apply, 10000, false);
+  TEST_PERFORMANCE2(filter, p, test_blockchain_based_list_apply, 10000, true);
+  TEST_PERFORMANCE2(filter, p, test_blockchain_based_list_apply, 100000, false);
+  TEST_PERFORMANCE2(filter, p, test_blockchain_based_list_apply, 100000, true);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
   return 0;
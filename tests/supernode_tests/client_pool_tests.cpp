@@ -0,0 +1,78 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "supernode/ClientPool.h"
+
+using namespace supernode;
+
+namespace {
+
+	struct TestClient {
+		explicit TestClient(int id) : Id(id) {}
+		int Id;
+	};
+
+}
+
+TEST(ClientPool, AcquireAndRelease) {
+	int created = 0;
+	ClientPool<TestClient> pool([&created]() { return ClientPool<TestClient>::ClientPtr(new TestClient(++created)); }, 2);
+
+	// new clients are not reused ones
+	bool reused = true;
+	ClientPool<TestClient>::ClientPtr c1 = pool.Acquire(&reused);
+	ASSERT_FALSE(reused);
+	ClientPool<TestClient>::ClientPtr c2 = pool.Acquire(&reused);
+	ClientPool<TestClient>::ClientPtr c3 = pool.Acquire(&reused);
+	ASSERT_FALSE(reused);
+	ASSERT_EQ(3, created);
+
+	// failed clients are dropped, the number of idle clients is bounded
+	pool.Release(std::move(c1), false);
+	pool.Release(std::move(c2), true);
+	pool.Release(std::move(c3), true);
+	pool.Release(pool.Create(), true);
+	ASSERT_EQ(4, created);
+
+	ClientPool<TestClient>::ClientPtr c = pool.Acquire(&reused);
+	ASSERT_TRUE(reused);
+	ASSERT_EQ(3, c->Id);
+	c = pool.Acquire(&reused);
+	ASSERT_TRUE(reused);
+	ASSERT_EQ(2, c->Id);
+	c = pool.Acquire(&reused);
+	ASSERT_FALSE(reused);
+	ASSERT_EQ(5, c->Id);
+
+	// a retry gets a new client even if there are idle ones
+	pool.Release(std::move(c), true);
+	ASSERT_EQ(6, pool.Create()->Id);
+	ASSERT_EQ(5, pool.Acquire()->Id);
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <boost/thread/thread.hpp>
+
+#include "supernode/DAPI_RPC_Server.h"
+
+using namespace supernode;
+
+namespace {
+
+	struct TEST_HANDLER_CALL {
+		struct request : public SubNetData {
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Data)
+				KV_SERIALIZE(PaymentID)
+			END_KV_SERIALIZE_MAP()
+
+			int Data = 0;
+		};
+		struct response {
+			BEGIN_KV_SERIALIZE_MAP()
+				KV_SERIALIZE(Data)
+			END_KV_SERIALIZE_MAP()
+
+			int Data = 0;
+		};
+	};
+
+	typedef boost::function<bool (const TEST_HANDLER_CALL::request&, TEST_HANDLER_CALL::response&)> TestHandler;
+
+	// handler which answers with the given value
+	TestHandler Answer(int value) {
+		return [value](const TEST_HANDLER_CALL::request&, TEST_HANDLER_CALL::response& out) -> bool {
+			out.Data = value;
+			return true;
+		};
+	}
+
+	struct TestDAPIServer : public DAPI_RPC_Server {
+		int Add(const string& method, TestHandler handler) {
+			return AddHandler<TEST_HANDLER_CALL::request, TEST_HANDLER_CALL::response>(method, handler);
+		}
+
+		int Add(const string& payment_id, const string& method, TestHandler handler) {
+			return Add_UUID_MethodHandler<TEST_HANDLER_CALL::request, TEST_HANDLER_CALL::response>(payment_id, method, handler);
+		}
+
+		// dispatches the call as the http server does, -1 if there is no handler for it
+		int Dispatch(const string& method, const string& payment_id, int data = 0) {
+			rpc_command::RequestContainer<TEST_HANDLER_CALL::request> req;
+			req.method = method;
+			req.params.PaymentID = payment_id;
+			req.params.Data = data;
+
+			epee::net_utils::http::http_request_info query;
+			query.m_URI = rpc_command::DAPI_URI;
+			query.m_http_method = epee::net_utils::http::http_method_post;
+			epee::serialization::store_t_to_json(req, query.m_body);
+
+			epee::net_utils::http::http_response_info response;
+			connection_context context;
+			handle_http_request(query, response, context);
+			if( response.m_response_code!=200 ) return -1;
+
+			epee::json_rpc::response<TEST_HANDLER_CALL::response, epee::json_rpc::dummy_error> resp;
+			if( !epee::serialization::load_t_from_json(resp, response.m_body) ) return -1;
+			return resp.result.Data;
+		}
+	};
+
+}
+
+TEST(DAPI_RPC_Server, Handlers) {
+	TestDAPIServer server;
+	ASSERT_EQ(-1, server.Dispatch("Call", ""));
+
+	const int global = server.Add("Call", Answer(1));
+	const int payment1 = server.Add("p1", "Call", Answer(2));
+	const int payment2 = server.Add("p2", "Pay", Answer(3));
+	const int payment2_later = server.Add("p2", "Pay", Answer(4));
+
+	// the earliest registered handler wins, payment handlers are used only for their payment id
+	ASSERT_EQ(1, server.Dispatch("Call", ""));
+	ASSERT_EQ(1, server.Dispatch("Call", "p1"));
+	ASSERT_EQ(3, server.Dispatch("Pay", "p2"));
+	ASSERT_EQ(-1, server.Dispatch("Pay", "p1"));
+	ASSERT_EQ(-1, server.Dispatch("Pay", ""));
+	ASSERT_EQ(-1, server.Dispatch("Unknown", "p2"));
+
+	server.RemoveHandler(global);
+	ASSERT_EQ(-1, server.Dispatch("Call", ""));
+	ASSERT_EQ(2, server.Dispatch("Call", "p1"));
+
+	server.RemoveHandler(payment2);
+	ASSERT_EQ(4, server.Dispatch("Pay", "p2"));
+
+	// removal of unknown or already removed handlers does nothing
+	server.RemoveHandler(global);
+	server.RemoveHandler(100);
+	ASSERT_EQ(2, server.Dispatch("Call", "p1"));
+	ASSERT_EQ(4, server.Dispatch("Pay", "p2"));
+
+	server.RemoveHandler(payment1);
+	server.RemoveHandler(payment2_later);
+	ASSERT_EQ(-1, server.Dispatch("Call", "p1"));
+	ASSERT_EQ(-1, server.Dispatch("Pay", "p2"));
+
+	// indexes are not reused
+	ASSERT_GT(server.Add("Call", Answer(5)), payment2_later);
+	ASSERT_EQ(5, server.Dispatch("Call", "p1"));
+}
+
+TEST(DAPI_RPC_Server, RemoveHandlerWhileDispatching) {
+	TestDAPIServer server;
+
+	// RTA objects remove their handlers from the handlers, the call completes with the removed handler
+	int idx = -1;
+	std::atomic<int> calls(0);
+	idx = server.Add("p1", "Pay", [&](const TEST_HANDLER_CALL::request& in, TEST_HANDLER_CALL::response& out) -> bool {
+		server.RemoveHandler(idx);
+		out.Data = in.Data + 1;
+		calls++;
+		return true;
+	});
+	ASSERT_EQ(11, server.Dispatch("Pay", "p1", 10));
+	ASSERT_EQ(-1, server.Dispatch("Pay", "p1", 10));
+	ASSERT_EQ(1, calls);
+
+	// and may add new ones
+	server.Add("Call", [&](const TEST_HANDLER_CALL::request&, TEST_HANDLER_CALL::response& out) -> bool {
+		server.Add("p1", "Pay", Answer(7));
+		out.Data = 6;
+		return true;
+	});
+	ASSERT_EQ(6, server.Dispatch("Call", ""));
+	ASSERT_EQ(7, server.Dispatch("Pay", "p1"));
+}
+
+TEST(DAPI_RPC_Server, ConcurrentUpdates) {
+	TestDAPIServer server;
+	const int paymentsCount = 8;
+	server.Add("Global", Answer(-2));
+
+	std::atomic<bool> stop(false);
+	std::atomic<int> errors(0);
+	std::atomic<int> answered(0);
+	vector<boost::thread> dispatchers;
+	for(int t = 0; t < 4; t++) {
+		dispatchers.emplace_back([&, t]() {
+			for(int i = t; !stop; i++) {
+				const int payment = i % paymentsCount;
+				const int res = server.Dispatch("Pay", "p" + std::to_string(payment));
+				// either there is no handler at the moment or the handler is of the payment
+				if( res!=-1 && res!=payment ) errors++;
+				if( res==payment ) answered++;
+				if( server.Dispatch("Global", "p" + std::to_string(payment))!=-2 ) errors++;
+			}
+		});
+	}
+
+	// handlers of RTA objects are added and removed while requests are dispatched
+	for(int round = 0; round < 200; round++) {
+		vector<int> idx;
+		for(int payment = 0; payment < paymentsCount; payment++)
+			idx.push_back(server.Add("p" + std::to_string(payment), "Pay", Answer(payment)));
+		boost::this_thread::sleep_for(boost::chrono::microseconds(200));
+		for(int i : idx) server.RemoveHandler(i);
+	}
+	stop = true;
+	for(auto& t : dispatchers) t.join();
+
+	ASSERT_EQ(0, errors);
+	ASSERT_GT(answered, 0);
+	for(int payment = 0; payment < paymentsCount; payment++)
+		ASSERT_EQ(-1, server.Dispatch("Pay", "p" + std::to_string(payment)));
+}
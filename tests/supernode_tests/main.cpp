@@ -690,8 +690,8 @@ struct TestActualList {
 
 	void Print() {
 		LOG_PRINT_L0( "\n\n"<<m_DAPIServer->Port() );
-		for(unsigned i=0;i<Servant->All_FSN.size();i++) {
-				auto a = Servant->All_FSN[i];
+		for(unsigned i=0;i<Servant->GetFsnList()->size();i++) {
+				auto a = (*Servant->GetFsnList())[i];
 				LOG_PRINT_L0(a->Port<<" : "<<a->Stake.Addr<<" : "<<a->Stake.ViewKey);
 		}//for
 	}
@@ -708,8 +708,8 @@ struct TestActualList {
 	}
 
 	bool FindFSN(const string& port, const string& stakeW, const string& stakeKey) {
-		for(unsigned i=0;i<Servant->All_FSN.size();i++) {
-			auto a = Servant->All_FSN[i];
+		for(unsigned i=0;i<Servant->GetFsnList()->size();i++) {
+			auto a = (*Servant->GetFsnList())[i];
 			//LOG_PRINT_L0(a->IP<<":"<<a->Port<<"  "<<a->Stake.Addr<<"  "<<a->Stake.ViewKey);
 			if( a->IP=="127.0.0.1" && a->Port==port && a->Stake.Addr==stakeW && a->Stake.ViewKey==stakeKey ) return true;
 		}
@@ -747,7 +747,7 @@ TEST_F(Test_ActualFSNList_Strut, Test_ActualFSNList) {
     while(!node1.List->AuditDone || !node1.List->AuditDone) sleep(1);
     sleep(2);
 		for(unsigned i=0;i<15;i++) {
-			if( node1.Servant->All_FSN.size()==2 && node2.Servant->All_FSN.size()==2 ) break;
+			if( node1.Servant->GetFsnList()->size()==2 && node2.Servant->GetFsnList()->size()==2 ) break;
 			sleep(1);
 		}
 
@@ -762,11 +762,11 @@ TEST_F(Test_ActualFSNList_Strut, Test_ActualFSNList) {
     bool found4 = node2.FindFSN("8510", "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE", "0ae7176e5332974de64713c329d406956e8ff2fd60c85e7ee6d8c88318111007");
 
 
-		bool size1 = node1.Servant->All_FSN.size()==2;
-		bool size2 = node2.Servant->All_FSN.size()==2;
+		bool size1 = node1.Servant->GetFsnList()->size()==2;
+		bool size2 = node2.Servant->GetFsnList()->size()==2;
 
-    LOG_PRINT_L0("IN "<<node1.m_DAPIServer->Port()<<"  size: "<<node1.Servant->All_FSN.size() );
-    LOG_PRINT_L0("IN "<<node2.m_DAPIServer->Port()<<"  size: "<<node2.Servant->All_FSN.size() );
+    LOG_PRINT_L0("IN "<<node1.m_DAPIServer->Port()<<"  size: "<<node1.Servant->GetFsnList()->size() );
+    LOG_PRINT_L0("IN "<<node2.m_DAPIServer->Port()<<"  size: "<<node2.Servant->GetFsnList()->size() );
 
     // -------------
     node2.Stop();
@@ -778,7 +778,7 @@ TEST_F(Test_ActualFSNList_Strut, Test_ActualFSNList) {
     bool found5 = node1.FindFSN("7510", "T6SnKmirXp6geLAoB7fn2eV51Ctr1WH1xWDnEGzS9pvQARTJQUXupiRKGR7czL7b5XdDnYXosVJu6Wj3Y3NYfiEA2sU2QiGVa", "8c0ccff03e9f2a9805e200f887731129495ff793dc678db6c5b53df814084f04");
     bool found6 = node1.FindFSN("8510", "T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE", "0ae7176e5332974de64713c329d406956e8ff2fd60c85e7ee6d8c88318111007");
 		
-		bool size3 = node1.Servant->All_FSN.size()==1; 
+		bool size3 = node1.Servant->GetFsnList()->size()==1; 
 		
 
     sleep(1);
@@ -0,0 +1,139 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "supernode/SubNetBroadcast.h"
+
+using namespace supernode;
+
+namespace {
+
+	typedef SubNetBroadcast::SSendState<int> SendState;
+
+	boost::chrono::steady_clock::time_point After(int ms) {
+		return boost::chrono::steady_clock::now() + boost::chrono::milliseconds(ms);
+	}
+
+	// member call which completes after the delay
+	boost::thread Respond(boost::shared_ptr<SendState> state, unsigned i, bool ok, int value, int delayMs) {
+		return boost::thread([state, i, ok, value, delayMs]() {
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(delayMs));
+			int resp = value;
+			state->Complete(i, ok, std::move(resp));
+		});
+	}
+
+}
+
+TEST(SubNetBroadcast, AllResponses) {
+	boost::shared_ptr<SendState> state = boost::make_shared<SendState>(3);
+	vector<boost::thread> members;
+	members.push_back( Respond(state, 2, true, 30, 20) );
+	members.push_back( Respond(state, 0, true, 10, 0) );
+	members.push_back( Respond(state, 1, true, 20, 10) );
+
+	vector<int> out;
+	ASSERT_TRUE( state->Wait(0, true, After(5000), out) );
+	ASSERT_EQ(vector<int>({10, 20, 30}), out);
+	for(auto& m : members) m.join();
+}
+
+TEST(SubNetBroadcast, FirstFailure) {
+	boost::shared_ptr<SendState> state = boost::make_shared<SendState>(3);
+	vector<boost::thread> members;
+	members.push_back( Respond(state, 0, true, 10, 0) );
+	members.push_back( Respond(state, 1, false, 0, 0) );
+	members.push_back( Respond(state, 2, true, 30, 500) );
+
+	// the wait ends on the failure, not on the slow member
+	const auto start = boost::chrono::steady_clock::now();
+	vector<int> out(1, 1);
+	ASSERT_FALSE( state->Wait(0, true, After(5000), out) );
+	ASSERT_LT(boost::chrono::steady_clock::now() - start, boost::chrono::milliseconds(400));
+	ASSERT_TRUE(out.empty());
+	for(auto& m : members) m.join();
+}
+
+TEST(SubNetBroadcast, Quorum) {
+	boost::shared_ptr<SendState> state = boost::make_shared<SendState>(4);
+	vector<boost::thread> members;
+	members.push_back( Respond(state, 0, false, 0, 0) );
+	members.push_back( Respond(state, 1, true, 20, 10) );
+	members.push_back( Respond(state, 2, true, 30, 20) );
+	members.push_back( Respond(state, 3, true, 40, 500) );
+
+	// failures don't end the wait without reqAllResps, the quorum does
+	const auto start = boost::chrono::steady_clock::now();
+	vector<int> out;
+	ASSERT_TRUE( state->Wait(2, false, After(5000), out) );
+	ASSERT_LT(boost::chrono::steady_clock::now() - start, boost::chrono::milliseconds(400));
+	ASSERT_EQ(vector<int>({20, 30}), out);
+
+	// the late response is dropped, not reported and not lost in a moved out vector
+	for(auto& m : members) m.join();
+	{
+		boost::lock_guard<boost::mutex> lock(state->Guard);
+		ASSERT_EQ(0, state->Pending);
+		ASSERT_EQ(2, state->Succeeded);
+		ASSERT_EQ(-1, state->Rets[3]);
+	}
+	ASSERT_EQ(vector<int>({20, 30}), out);
+}
+
+TEST(SubNetBroadcast, LateResponses) {
+	boost::shared_ptr<SendState> state = boost::make_shared<SendState>(3);
+	vector<boost::thread> members;
+	members.push_back( Respond(state, 0, true, 10, 0) );
+	members.push_back( Respond(state, 1, true, 20, 300) );
+	members.push_back( Respond(state, 2, false, 0, 300) );
+
+	// the deadline ends the wait, the answered member is reported
+	vector<int> out;
+	ASSERT_TRUE( state->Wait(0, false, After(50), out) );
+	ASSERT_EQ(vector<int>({10}), out);
+
+	// with reqAllResps the pending members make the send fail
+	boost::shared_ptr<SendState> all = boost::make_shared<SendState>(2);
+	members.push_back( Respond(all, 0, true, 10, 0) );
+	members.push_back( Respond(all, 1, true, 20, 300) );
+	vector<int> allOut;
+	ASSERT_FALSE( all->Wait(0, true, After(50), allOut) );
+	ASSERT_TRUE(allOut.empty());
+
+	// responses after the end of the wait complete the state which the send has already left
+	for(auto& m : members) m.join();
+	ASSERT_EQ(0, state->Pending);
+	ASSERT_EQ(1, state->Succeeded);
+	ASSERT_EQ(vector<int>({1, -1, -1}), state->Rets);
+	ASSERT_EQ(0, all->Pending);
+	ASSERT_EQ(1, all->Succeeded);
+	ASSERT_EQ(vector<int>({10}), out);
+}
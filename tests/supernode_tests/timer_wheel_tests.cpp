@@ -0,0 +1,188 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/make_shared.hpp>
+
+#include "supernode/TimerWheel.h"
+#include "supernode/BaseRTAProcessor.h"
+
+using namespace supernode;
+
+namespace {
+
+	typedef std::chrono::milliseconds ms;
+
+	// wheel with 10ms resolution for 100ms, i.e. 12 slots
+	struct TestTimerWheel : public TimerWheel<int> {
+		TestTimerWheel() : TimerWheel<int>(ms(100), ms(10)) {}
+
+		// expired items after advance to the time relative to the wheel start
+		std::vector<int> AdvanceTo(ms time) {
+			std::vector<int> expired;
+			Advance(m_Start + time, expired);
+			return expired;
+		}
+
+		size_t SlotsCount() const { return m_Slots.size(); }
+	};
+
+	struct TestRTAProcessor : public BaseRTAProcessor {
+		using BaseRTAProcessor::Add;
+		using BaseRTAProcessor::Remove;
+		using BaseRTAProcessor::ObjectByPayment;
+
+		void Init() override {}
+	};
+
+	boost::shared_ptr<BaseRTAObject> MakeObject(const string& payment_id) {
+		boost::shared_ptr<BaseRTAObject> obj = boost::make_shared<BaseRTAObject>();
+		obj->TransactionRecord.PaymentID = payment_id;
+		return obj;
+	}
+
+}
+
+TEST(TimerWheel, Schedule) {
+	TestTimerWheel wheel;
+	ASSERT_EQ(12, wheel.SlotsCount());
+
+	wheel.Schedule(1, ms(25));
+	wheel.Schedule(2, ms(10));
+	wheel.Schedule(3, ms(0));
+	ASSERT_EQ(3, wheel.Size());
+
+	// delay is rounded up to the resolution, zero delay expires on the next tick
+	ASSERT_EQ(std::vector<int>({2, 3}), wheel.AdvanceTo(ms(19)));
+	ASSERT_TRUE(wheel.AdvanceTo(ms(29)).empty());
+	ASSERT_EQ(1, wheel.Size());
+	ASSERT_EQ(std::vector<int>({1}), wheel.AdvanceTo(ms(30)));
+	ASSERT_EQ(0, wheel.Size());
+
+	// going back in time does nothing
+	wheel.Schedule(4, ms(10));
+	ASSERT_TRUE(wheel.AdvanceTo(ms(5)).empty());
+	ASSERT_EQ(std::vector<int>({4}), wheel.AdvanceTo(ms(40)));
+}
+
+TEST(TimerWheel, MaxDelay) {
+	TestTimerWheel wheel;
+	wheel.Schedule(1, ms(100));
+	wheel.Schedule(2, ms(1000));
+
+	// delay above the max one is clamped to the wheel size
+	ASSERT_TRUE(wheel.AdvanceTo(ms(99)).empty());
+	ASSERT_EQ(std::vector<int>({1}), wheel.AdvanceTo(ms(100)));
+	ASSERT_TRUE(wheel.AdvanceTo(ms(109)).empty());
+	ASSERT_EQ(std::vector<int>({2}), wheel.AdvanceTo(ms(110)));
+}
+
+TEST(TimerWheel, Wrap) {
+	TestTimerWheel wheel;
+	std::vector<int> expired;
+	ASSERT_TRUE(wheel.AdvanceTo(ms(100)).empty());
+
+	// slots of items scheduled near the end of the wheel wrap around to its start
+	wheel.Schedule(1, ms(50));
+	wheel.Schedule(2, ms(110));
+	wheel.Schedule(3, ms(20));
+	for(int t = 101; t < 120; t++) ASSERT_TRUE(wheel.AdvanceTo(ms(t)).empty());
+	ASSERT_EQ(std::vector<int>({3}), wheel.AdvanceTo(ms(120)));
+	for(int t = 121; t < 150; t++) ASSERT_TRUE(wheel.AdvanceTo(ms(t)).empty());
+	ASSERT_EQ(std::vector<int>({1}), wheel.AdvanceTo(ms(150)));
+
+	// the item with the max delay expires after the whole wheel
+	for(int t = 151; t < 210; t++) ASSERT_TRUE(wheel.AdvanceTo(ms(t)).empty());
+	ASSERT_EQ(std::vector<int>({2}), wheel.AdvanceTo(ms(210)));
+	ASSERT_EQ(0, wheel.Size());
+
+	// many wraps
+	for(int i = 0; i < 100; i++) {
+		wheel.Schedule(i, ms(10 * (i % 10 + 1)));
+		std::vector<int> e = wheel.AdvanceTo(ms(210 + 10 * (i + 1)));
+		expired.insert(expired.end(), e.begin(), e.end());
+	}
+	for(int t = 1210; t <= 1320; t += 10) {
+		std::vector<int> e = wheel.AdvanceTo(ms(t));
+		expired.insert(expired.end(), e.begin(), e.end());
+	}
+	ASSERT_EQ(100, expired.size());
+	ASSERT_EQ(0, wheel.Size());
+}
+
+TEST(TimerWheel, LongPause) {
+	TestTimerWheel wheel;
+	for(int i = 0; i < 10; i++) wheel.Schedule(i, ms(10 * (i + 1)));
+
+	// everything expires if the wheel hasn't been advanced for longer than its period
+	std::vector<int> expired = wheel.AdvanceTo(ms(10000));
+	ASSERT_EQ(10, expired.size());
+	ASSERT_EQ(0, wheel.Size());
+
+	// and the wheel goes on from the new time
+	wheel.Schedule(10, ms(20));
+	ASSERT_TRUE(wheel.AdvanceTo(ms(10019)).empty());
+	ASSERT_EQ(std::vector<int>({10}), wheel.AdvanceTo(ms(10020)));
+}
+
+TEST(BaseRTAProcessor, AddAndRemove) {
+	TestRTAProcessor processor;
+	boost::shared_ptr<BaseRTAObject> obj1 = MakeObject("payment 1");
+	boost::shared_ptr<BaseRTAObject> obj2 = MakeObject("payment 2");
+
+	ASSERT_TRUE(processor.Add(obj1));
+	ASSERT_TRUE(processor.Add(obj2));
+	ASSERT_EQ(obj1, processor.ObjectByPayment("payment 1"));
+	ASSERT_EQ(obj2, processor.ObjectByPayment("payment 2"));
+
+	// the same object may be added again, other object with the same payment id is rejected
+	ASSERT_TRUE(processor.Add(obj1));
+	boost::shared_ptr<BaseRTAObject> duplicate = MakeObject("payment 1");
+	ASSERT_FALSE(processor.Add(duplicate));
+	ASSERT_EQ(obj1, processor.ObjectByPayment("payment 1"));
+
+	// removal of the rejected object doesn't remove the live one
+	processor.Remove(duplicate);
+	ASSERT_EQ(obj1, processor.ObjectByPayment("payment 1"));
+
+	processor.Remove(obj1);
+	ASSERT_FALSE(processor.ObjectByPayment("payment 1"));
+	ASSERT_EQ(obj2, processor.ObjectByPayment("payment 2"));
+
+	// removed objects are kept alive until their handlers may complete
+	boost::weak_ptr<BaseRTAObject> removed = obj1;
+	obj1.reset();
+	processor.Tick();
+	ASSERT_FALSE(removed.expired());
+
+	// the payment id is free again
+	boost::shared_ptr<BaseRTAObject> obj3 = MakeObject("payment 1");
+	ASSERT_TRUE(processor.Add(obj3));
+	ASSERT_EQ(obj3, processor.ObjectByPayment("payment 1"));
+}
@@ -152,6 +152,43 @@ std::string h2b(const std::string& s)
   return result;
 }
 
+class test_rta_state_provider : public RtaStateProvider
+{
+public:
+  test_rta_state_provider() : m_build_state(true), m_aborted_count(0) {}
+
+  bool get_block_rta_state(uint64_t height, const block& blk, const crypto::hash& blk_hash, const std::vector<transaction>& txs,
+    blobdata& stake_txs, blobdata& blockchain_based_list)
+  {
+    if (!m_build_state)
+      return false;
+    if (!txs.empty())
+      stake_txs = "stake txs " + std::to_string(height);
+    blockchain_based_list = "list " + std::to_string(height);
+    m_built_heights.push_back(height);
+    return true;
+  }
+
+  void on_block_rta_state_removed(uint64_t height) { m_removed_heights.push_back(height); }
+
+  void on_block_rta_state_aborted() { m_aborted_count++; }
+
+  bool m_build_state;
+  std::vector<uint64_t> m_built_heights;
+  std::vector<uint64_t> m_removed_heights;
+  size_t m_aborted_count;
+};
+
+std::vector<std::pair<uint64_t, blobdata>> get_rta_stake_txs(const BlockchainDB& db)
+{
+  std::vector<std::pair<uint64_t, blobdata>> result;
+  db.for_all_rta_stake_txs([&](uint64_t height, const blobdata& stake_txs) {
+    result.emplace_back(height, stake_txs);
+    return true;
+  });
+  return result;
+}
+
 template <typename T>
 class BlockchainDBTest : public testing::Test
 {
@@ -344,4 +381,99 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RtaStateAddAndPop)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  if (!this->m_db->has_rta_state())
+    return;
+
+  test_rta_state_provider provider;
+  this->m_db->set_rta_state_provider(&provider);
+
+  // the state is written along with each block, stake txs only for blocks which have them
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  ASSERT_EQ(std::vector<uint64_t>({0, 1}), provider.m_built_heights);
+  ASSERT_EQ(2, this->m_db->get_rta_state_height());
+
+  blobdata list;
+  ASSERT_TRUE(this->m_db->get_block_rta_blockchain_based_list(0, list));
+  ASSERT_EQ("list 0", list);
+  ASSERT_TRUE(this->m_db->get_block_rta_blockchain_based_list(1, list));
+  ASSERT_EQ("list 1", list);
+  ASSERT_EQ((std::vector<std::pair<uint64_t, blobdata>>{{0, "stake txs 0"}}), get_rta_stake_txs(*this->m_db));
+
+  // the state of the popped block goes with it
+  block blk;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+  ASSERT_EQ(std::vector<uint64_t>({1}), provider.m_removed_heights);
+  ASSERT_EQ(1, this->m_db->height());
+  ASSERT_EQ(1, this->m_db->get_rta_state_height());
+  ASSERT_FALSE(this->m_db->get_block_rta_blockchain_based_list(1, list));
+
+  ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+  ASSERT_EQ(std::vector<uint64_t>({1, 0}), provider.m_removed_heights);
+  ASSERT_EQ(0, this->m_db->get_rta_state_height());
+  ASSERT_TRUE(get_rta_stake_txs(*this->m_db).empty());
+
+  // a block the provider can't build the state for is added without it
+  provider.m_build_state = false;
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_EQ(1, this->m_db->height());
+  ASSERT_EQ(0, this->m_db->get_rta_state_height());
+  ASSERT_TRUE(get_rta_stake_txs(*this->m_db).empty());
+  ASSERT_EQ(0, provider.m_aborted_count);
+
+  this->m_db->set_rta_state_provider(nullptr);
+}
+
+TYPED_TEST(BlockchainDBTest, RtaStateBatchAbort)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  BlockchainLMDB* lmdb = dynamic_cast<BlockchainLMDB*>(this->m_db);
+  if (!lmdb || !this->m_db->has_rta_state())
+    return;
+
+  test_rta_state_provider provider;
+  this->m_db->set_rta_state_provider(&provider);
+  this->m_db->set_batch_transactions(true);
+
+  // the provider is told to roll back the state it has built for the discarded blocks
+  ASSERT_TRUE(this->m_db->batch_start());
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_EQ(std::vector<uint64_t>({0}), provider.m_built_heights);
+  ASSERT_NO_THROW(lmdb->batch_abort());
+  ASSERT_EQ(1, provider.m_aborted_count);
+  ASSERT_EQ(0, this->m_db->height());
+  ASSERT_EQ(0, this->m_db->get_rta_state_height());
+  ASSERT_TRUE(get_rta_stake_txs(*this->m_db).empty());
+
+  // a committed batch keeps the state
+  ASSERT_TRUE(this->m_db->batch_start());
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+  ASSERT_EQ(1, provider.m_aborted_count);
+  ASSERT_EQ(1, this->m_db->get_rta_state_height());
+  ASSERT_EQ((std::vector<std::pair<uint64_t, blobdata>>{{0, "stake txs 0"}}), get_rta_stake_txs(*this->m_db));
+
+  this->m_db->set_rta_state_provider(nullptr);
+}
+
 }  // anonymous namespace
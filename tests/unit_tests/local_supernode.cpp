@@ -0,0 +1,67 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "p2p/local_supernode.h"
+
+using nodetool::local_supernode;
+
+namespace
+{
+  bool wait_for(const std::function<bool()> &condition)
+  {
+    for (int i = 0; i < 1000 && !condition(); ++i)
+      boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+    return condition();
+  }
+}
+
+TEST(local_supernode, deltas_discarded_after_failure)
+{
+  // nothing listens on the port, every delivery fails
+  local_supernode supernode("id", "127.0.0.1", 1, "");
+
+  supernode.set_stakes_version(1);
+  ASSERT_TRUE(supernode.post_serialized("/stakes", "full", true, local_supernode::feed_stakes));
+  ASSERT_TRUE(wait_for([&supernode]() { return supernode.get_failed_count() == 1; }));
+  ASSERT_EQ(0, supernode.get_stakes_version());
+
+  // the supernode can't apply deltas of the feed until it gets the full state
+  ASSERT_FALSE(supernode.post_serialized("/stakes", "delta", true, local_supernode::feed_stakes, true));
+  ASSERT_EQ(1, supernode.get_dropped_count());
+
+  // other feeds are not affected
+  ASSERT_TRUE(supernode.post_serialized("/list", "delta", true, local_supernode::feed_list, true));
+  ASSERT_TRUE(wait_for([&supernode]() { return supernode.get_failed_count() == 2; }));
+
+  ASSERT_TRUE(supernode.post_serialized("/stakes", "full", true, local_supernode::feed_stakes));
+  ASSERT_TRUE(wait_for([&supernode]() { return supernode.get_failed_count() == 3; }));
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "string_tools.h"
+#include "p2p/request_id_cache.h"
+
+using nodetool::request_id_cache;
+
+namespace
+{
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  crypto::hash make_id(uint64_t n)
+  {
+    return crypto::cn_fast_hash(&n, sizeof(n));
+  }
+}
+
+TEST(request_id_cache, duplicates)
+{
+  request_id_cache cache;
+  ASSERT_TRUE(cache.insert("message 1"));
+  ASSERT_TRUE(cache.insert("message 2"));
+  ASSERT_FALSE(cache.insert("message 1"));
+  ASSERT_FALSE(cache.insert("message 2"));
+
+  // hex encoded id is the same id as its binary form
+  const crypto::hash id = make_id(1);
+  const std::string hex = epee::string_tools::pod_to_hex(id);
+  ASSERT_TRUE(cache.insert(hex));
+  ASSERT_FALSE(cache.insert(id));
+  ASSERT_FALSE(cache.insert(epee::string_tools::pod_to_hex(id)));
+
+  ASSERT_TRUE(cache.insert(make_id(2)));
+  ASSERT_FALSE(cache.insert(epee::string_tools::pod_to_hex(make_id(2))));
+}
+
+TEST(request_id_cache, expiry)
+{
+  const time_point start = std::chrono::steady_clock::now();
+  const std::chrono::milliseconds lifetime(request_id_cache::LIFETIME_MILLIS);
+  const std::chrono::milliseconds generation(request_id_cache::GENERATION_MILLIS);
+  request_id_cache cache;
+
+  ASSERT_TRUE(cache.insert("message 1", start));
+  ASSERT_TRUE(cache.insert("message 2", start + generation));
+
+  // ids are remembered for the whole lifetime
+  ASSERT_FALSE(cache.insert("message 1", start + lifetime - std::chrono::seconds(1)));
+  ASSERT_FALSE(cache.insert("message 2", start + generation + lifetime - std::chrono::seconds(1)));
+
+  // and are forgotten after the lifetime and a generation
+  ASSERT_TRUE(cache.insert("message 1", start + lifetime + generation + std::chrono::seconds(1)));
+  ASSERT_TRUE(cache.insert("message 2", start + lifetime + 2 * generation + std::chrono::seconds(1)));
+  ASSERT_FALSE(cache.insert("message 1", start + lifetime + 2 * generation + std::chrono::seconds(1)));
+
+  // a long pause forgets everything at once
+  ASSERT_TRUE(cache.insert("message 1", start + 10 * lifetime));
+  ASSERT_TRUE(cache.insert("message 2", start + 10 * lifetime));
+}
+
+TEST(request_id_cache, capacity)
+{
+  const time_point now = std::chrono::steady_clock::now();
+  const uint64_t capacity = request_id_cache::SHARDS_COUNT * request_id_cache::GENERATIONS_COUNT * request_id_cache::GENERATION_MAX_IDS_COUNT;
+  request_id_cache cache;
+
+  // well below the capacity nothing is forgotten
+  for (uint64_t n = 0; n < 1000; ++n)
+    ASSERT_TRUE(cache.insert(make_id(n), now));
+  for (uint64_t n = 0; n < 1000; ++n)
+    ASSERT_FALSE(cache.insert(make_id(n), now));
+
+  // a message storm rotates generations before their time, so the oldest ids are forgotten
+  // while the memory stays the same and the latest ids are still remembered
+  const uint64_t storm = 2 * capacity;
+  for (uint64_t n = 1000; n < storm; ++n)
+    ASSERT_TRUE(cache.insert(make_id(n), now));
+  for (uint64_t n = storm - 1000; n < storm; ++n)
+    ASSERT_FALSE(cache.insert(make_id(n), now));
+  for (uint64_t n = 0; n < 1000; ++n)
+    ASSERT_TRUE(cache.insert(make_id(n), now));
+}
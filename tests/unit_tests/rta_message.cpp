@@ -0,0 +1,109 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "p2p/rta_message.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace
+{
+  std::list<std::string> make_receivers(size_t count)
+  {
+    std::list<std::string> receivers;
+    for (size_t i = 0; i < count; ++i)
+    {
+      crypto::public_key key;
+      crypto::secret_key secret_key;
+      crypto::generate_keys(key, secret_key);
+      receivers.push_back(epee::string_tools::pod_to_hex(key));
+    }
+    return receivers;
+  }
+}
+
+TEST(rta_message, serialize_parse)
+{
+  const crypto::hash id = crypto::cn_fast_hash("message", 7);
+  const std::list<std::string> receivers = make_receivers(3);
+  const std::string data("binary\0data", 11);
+  std::string buffer;
+  ASSERT_TRUE(nodetool::rta_message::serialize(nodetool::rta_message::multicast, 5, epee::string_tools::pod_to_hex(id), receivers,
+                                               "sender", "/callback", data, true, buffer));
+
+  nodetool::rta_message msg;
+  ASSERT_TRUE(msg.parse(buffer));
+  ASSERT_EQ(nodetool::rta_message::multicast, msg.type);
+  ASSERT_EQ(5, msg.hop);
+  ASSERT_TRUE(msg.wait_answer);
+  ASSERT_EQ(id, msg.message_id);
+  ASSERT_EQ(receivers, msg.get_receiver_addresses());
+  ASSERT_EQ("sender", msg.sender_address);
+  ASSERT_EQ("/callback", msg.callback_uri);
+
+  cryptonote::COMMAND_RPC_MULTICAST::request req;
+  msg.to_request(req);
+  ASSERT_EQ(data, req.data);
+  ASSERT_EQ("sender", req.sender_address);
+  ASSERT_EQ("/callback", req.callback_uri);
+  ASSERT_TRUE(req.wait_answer);
+}
+
+TEST(rta_message, set_hop)
+{
+  std::string buffer;
+  ASSERT_TRUE(nodetool::rta_message::serialize(nodetool::rta_message::broadcast, 10, epee::string_tools::pod_to_hex(crypto::null_hash),
+                                               std::list<std::string>(), "sender", "", "data", false, buffer));
+  std::string relayed = buffer;
+  nodetool::rta_message::set_hop(relayed, 9);
+
+  nodetool::rta_message msg;
+  ASSERT_TRUE(msg.parse(relayed));
+  ASSERT_EQ(9, msg.hop);
+  ASSERT_EQ(buffer.substr(nodetool::rta_message::MESSAGE_ID_OFFSET), relayed.substr(nodetool::rta_message::MESSAGE_ID_OFFSET));
+}
+
+TEST(rta_message, invalid)
+{
+  std::string buffer;
+  ASSERT_FALSE(nodetool::rta_message::serialize(nodetool::rta_message::unicast, 1, "not a hash", make_receivers(1), "", "", "", false, buffer));
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_FALSE(nodetool::rta_message::serialize(nodetool::rta_message::unicast, 1, epee::string_tools::pod_to_hex(crypto::null_hash),
+                                                std::list<std::string>{"sender"}, "", "", "", false, buffer));
+  ASSERT_TRUE(buffer.empty());
+
+  ASSERT_TRUE(nodetool::rta_message::serialize(nodetool::rta_message::unicast, 1, epee::string_tools::pod_to_hex(crypto::null_hash),
+                                               make_receivers(1), "sender", "", "data", false, buffer));
+  nodetool::rta_message msg;
+  ASSERT_FALSE(msg.parse(buffer.substr(0, buffer.size() - 1)));
+  ASSERT_FALSE(msg.parse(buffer + "x"));
+  ASSERT_FALSE(msg.parse(buffer.substr(0, nodetool::rta_message::HEADER_SIZE - 1)));
+  std::string wrong_version = buffer;
+  wrong_version[0] = nodetool::rta_message::VERSION + 1;
+  ASSERT_FALSE(msg.parse(wrong_version));
+}
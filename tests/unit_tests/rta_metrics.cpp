@@ -0,0 +1,110 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "p2p/rta_metrics.h"
+
+using nodetool::rta_metrics;
+
+TEST(rta_metrics, histogram_buckets)
+{
+  const size_t last = rta_metrics::histogram::BOUNDED_BUCKETS_COUNT;
+  const uint64_t top = rta_metrics::histogram::get_bucket_bound(last - 1);
+  // value and the bucket it is counted in, buckets are (2^(i-1), 2^i]
+  const std::vector<std::pair<uint64_t, size_t>> values = {
+    {0, 0}, {1, 0}, {2, 1}, {3, 2}, {4, 2}, {5, 3}, {1024, 10}, {1025, 11}, {top, last - 1}, {top + 1, last}, {uint64_t(-1) / 2, last}
+  };
+
+  rta_metrics::histogram h;
+  std::vector<uint64_t> expected(last + 1, 0);
+  uint64_t sum = 0;
+  for (const auto &v : values)
+  {
+    h.observe(v.first);
+    ++expected[v.second];
+    sum += v.first;
+  }
+
+  for (size_t i = 0; i <= last; ++i)
+    ASSERT_EQ(expected[i], h.get_bucket(i)) << "bucket " << i;
+  ASSERT_EQ(sum, h.get_sum());
+  ASSERT_EQ(values.size(), h.get_count());
+
+  cryptonote::COMMAND_RPC_RTA_METRICS::histogram res;
+  h.get(res);
+  ASSERT_EQ(last, res.bounds.size());
+  ASSERT_EQ(last + 1, res.buckets.size());
+  ASSERT_EQ(1, res.bounds[0]);
+  ASSERT_EQ(top, res.bounds[last - 1]);
+  ASSERT_EQ(expected, res.buckets);
+  ASSERT_EQ(sum, res.sum);
+  ASSERT_EQ(values.size(), res.count);
+}
+
+TEST(rta_metrics, prometheus_histogram)
+{
+  rta_metrics::histogram h;
+  h.observe(1);
+  h.observe(1);
+  h.observe(3);
+  h.observe(uint64_t(1) << 30);
+  cryptonote::COMMAND_RPC_RTA_METRICS::histogram res;
+  h.get(res);
+
+  std::ostringstream out;
+  rta_metrics::write_histogram(out, "fanout", "type=\"announce\"", res);
+
+  // bucket counts are cumulative, the +Inf bucket equals the count
+  std::ostringstream expected;
+  const uint64_t cumulative[] = {2, 2, 3};
+  for (size_t i = 0; i < rta_metrics::histogram::BOUNDED_BUCKETS_COUNT; ++i)
+    expected << "graft_rta_fanout_bucket{type=\"announce\",le=\"" << (uint64_t(1) << i) << "\"} " << (i < 3 ? cumulative[i] : 3) << '\n';
+  expected << "graft_rta_fanout_bucket{type=\"announce\",le=\"+Inf\"} 4\n";
+  expected << "graft_rta_fanout_sum{type=\"announce\"} " << (5 + (uint64_t(1) << 30)) << '\n';
+  expected << "graft_rta_fanout_count{type=\"announce\"} 4\n";
+  ASSERT_EQ(expected.str(), out.str());
+}
+
+TEST(rta_metrics, prometheus_histogram_without_labels)
+{
+  rta_metrics::histogram h;
+  h.observe(2);
+  cryptonote::COMMAND_RPC_RTA_METRICS::histogram res;
+  h.get(res);
+
+  std::ostringstream out;
+  rta_metrics::write_histogram(out, "lock_wait", "", res);
+  const std::string text = out.str();
+
+  ASSERT_EQ(0, text.find("graft_rta_lock_wait_bucket{le=\"1\"} 0\ngraft_rta_lock_wait_bucket{le=\"2\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("graft_rta_lock_wait_bucket{le=\"+Inf\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("\ngraft_rta_lock_wait_sum 2\ngraft_rta_lock_wait_count 1\n"));
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "graft_rta_config.h"
+
+namespace
+{
+  const uint64_t FIRST_BLOCK = 1000;
+
+  cryptonote::stake_transaction make_stake_tx(const std::string& supernode_public_id, uint64_t amount, uint64_t block_height, uint64_t unlock_time)
+  {
+    cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+    tx.hash                = crypto::rand<crypto::hash>();
+    tx.amount              = amount;
+    tx.block_height        = block_height;
+    tx.unlock_time         = unlock_time;
+    tx.supernode_public_id = supernode_public_id;
+    return tx;
+  }
+
+  /// Feeds the same blocks to a storage which builds snapshots incrementally and to one which rebuilds them from scratch
+  class stake_snapshots : public ::testing::Test
+  {
+  protected:
+    stake_snapshots() : m_incremental("", FIRST_BLOCK), m_full("", FIRST_BLOCK), m_block(FIRST_BLOCK) {}
+
+    void add_block(const std::vector<cryptonote::stake_transaction>& txs = std::vector<cryptonote::stake_transaction>())
+    {
+      m_block++;
+      const crypto::hash block_hash = crypto::rand<crypto::hash>();
+      for (const cryptonote::stake_transaction& tx : txs)
+      {
+        m_incremental.add_tx(tx);
+        m_full.add_tx(tx);
+      }
+      m_incremental.add_last_processed_block(m_block, block_hash);
+      m_full.add_last_processed_block(m_block, block_hash);
+      check_snapshot();
+    }
+
+    void pop_block()
+    {
+      m_incremental.remove_last_processed_block();
+      m_full.remove_last_processed_block();
+      m_block--;
+      check_snapshot();
+    }
+
+    void check_snapshot()
+    {
+      cryptonote::supernode_stake_snapshot_ptr snapshot = m_incremental.get_supernode_stake_snapshot(m_block);
+      m_full.clear_supernode_stakes();
+      cryptonote::supernode_stake_snapshot_ptr expected = m_full.get_supernode_stake_snapshot(m_block);
+      ASSERT_EQ(0, expected->base_id);
+      if (snapshot->base_id)
+        m_incremental_count++;
+
+      ASSERT_EQ(expected->stakes.size(), snapshot->stakes.size()) << "block " << m_block;
+      ASSERT_EQ(expected->first_tx_indexes, snapshot->first_tx_indexes) << "block " << m_block;
+      for (size_t i = 0; i < expected->stakes.size(); ++i)
+      {
+        const cryptonote::supernode_stake& s = snapshot->stakes[i], &e = expected->stakes[i];
+        ASSERT_EQ(e.supernode_public_id, s.supernode_public_id) << "block " << m_block;
+        ASSERT_EQ(e.amount, s.amount) << "block " << m_block << ", supernode " << e.supernode_public_id;
+        ASSERT_EQ(e.tier, s.tier) << "block " << m_block << ", supernode " << e.supernode_public_id;
+        ASSERT_EQ(e.block_height, s.block_height) << "block " << m_block << ", supernode " << e.supernode_public_id;
+        ASSERT_EQ(e.unlock_time, s.unlock_time) << "block " << m_block << ", supernode " << e.supernode_public_id;
+        ASSERT_EQ(&s, snapshot->find(e.supernode_public_id));
+      }
+    }
+
+    cryptonote::StakeTransactionStorage m_incremental;
+    cryptonote::StakeTransactionStorage m_full;
+    uint64_t m_block;
+    size_t m_incremental_count = 0;
+  };
+}
+
+TEST_F(stake_snapshots, incremental_matches_full_build)
+{
+  add_block({make_stake_tx("sn1", config::graft::TIER1_STAKE_AMOUNT, FIRST_BLOCK + 1, 20),
+             make_stake_tx("sn2", config::graft::TIER2_STAKE_AMOUNT, FIRST_BLOCK + 1, 100)});
+  for (size_t i = 0; i < 8; ++i)
+    add_block();
+
+  // sn1 moves to a higher tier, sn3 appears with a short stake
+  add_block({make_stake_tx("sn1", config::graft::TIER1_STAKE_AMOUNT, m_block + 1, 40),
+             make_stake_tx("sn3", config::graft::TIER3_STAKE_AMOUNT, m_block + 1, 10)});
+
+  // walk through validation, unlock and history expiry of all the stakes
+  while (m_block < FIRST_BLOCK + 250)
+  {
+    if (m_block == FIRST_BLOCK + 40)
+      add_block({make_stake_tx("sn3", config::graft::TIER4_STAKE_AMOUNT, m_block + 1, 30)});
+    else
+      add_block();
+  }
+
+  EXPECT_GT(m_incremental_count, 200u);
+}
+
+TEST_F(stake_snapshots, rollback)
+{
+  for (size_t i = 0; i < 10; ++i)
+    add_block();
+  add_block({make_stake_tx("sn1", config::graft::TIER2_STAKE_AMOUNT, m_block + 1, 20)});
+  add_block();
+  add_block({make_stake_tx("sn2", config::graft::TIER1_STAKE_AMOUNT, m_block + 1, 20),
+             make_stake_tx("sn1", config::graft::TIER1_STAKE_AMOUNT, m_block + 1, 20)});
+  for (size_t i = 0; i < 5; ++i)
+    add_block();
+
+  // roll back below the block with the sn2 stake and replace it by another chain
+  for (size_t i = 0; i < 7; ++i)
+    pop_block();
+  add_block({make_stake_tx("sn3", config::graft::TIER3_STAKE_AMOUNT, m_block + 1, 20)});
+  for (size_t i = 0; i < 30; ++i)
+    add_block();
+}
@@ -0,0 +1,214 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "file_io_utils.h"
+#include "cryptonote_core/storage_journal.h"
+#include "cryptonote_core/stake_transaction_storage.h"
+
+namespace
+{
+  class storage_journal : public ::testing::Test
+  {
+  protected:
+    storage_journal()
+      : m_dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+      , m_file_name((m_dir / "storage").string())
+      , m_journal_file_name(m_file_name + ".journal")
+    {
+      boost::filesystem::create_directories(m_dir);
+    }
+
+    ~storage_journal()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    /// Write checkpoint and the records to the journal
+    void write(const std::string& checkpoint, const std::vector<std::string>& records)
+    {
+      cryptonote::StorageJournal journal(m_file_name);
+      journal.write_checkpoint(checkpoint);
+      for (const std::string& record : records)
+        journal.add_record(record);
+      journal.flush();
+    }
+
+    uint64_t journal_size() const { return boost::filesystem::file_size(m_journal_file_name); }
+
+    void truncate_journal(uint64_t size) { boost::filesystem::resize_file(m_journal_file_name, size); }
+
+    boost::filesystem::path m_dir;
+    std::string m_file_name;
+    std::string m_journal_file_name;
+  };
+}
+
+TEST_F(storage_journal, load_records)
+{
+  const std::vector<std::string> records = {"first", std::string("sec\0ond", 7), ""};
+  write("checkpoint", records);
+
+  cryptonote::StorageJournal journal(m_file_name);
+  std::string checkpoint;
+  std::vector<std::string> loaded;
+  ASSERT_TRUE(journal.load(checkpoint, loaded));
+  ASSERT_EQ("checkpoint", checkpoint);
+  ASSERT_EQ(records, loaded);
+}
+
+TEST_F(storage_journal, no_checkpoint)
+{
+  cryptonote::StorageJournal journal(m_file_name);
+  std::string checkpoint;
+  std::vector<std::string> loaded;
+  ASSERT_FALSE(journal.load(checkpoint, loaded));
+  ASSERT_TRUE(journal.need_checkpoint());
+}
+
+TEST_F(storage_journal, truncated_record)
+{
+  write("checkpoint", {"first", "second", "third"});
+  const uint64_t full_size = journal_size();
+  const uint64_t last_record_size = 2 * sizeof(uint32_t) + 5;
+
+  // a torn write may leave any prefix of the last record
+  for (uint64_t cut = 1; cut <= last_record_size; ++cut)
+  {
+    write("checkpoint", {"first", "second", "third"});
+    ASSERT_EQ(full_size, journal_size());
+    truncate_journal(full_size - cut);
+
+    cryptonote::StorageJournal journal(m_file_name);
+    std::string checkpoint;
+    std::vector<std::string> loaded;
+    ASSERT_TRUE(journal.load(checkpoint, loaded));
+    ASSERT_EQ(std::vector<std::string>({"first", "second"}), loaded) << "cut " << cut;
+    ASSERT_EQ(full_size - last_record_size, journal_size()) << "cut " << cut;
+  }
+}
+
+TEST_F(storage_journal, append_after_truncated_record)
+{
+  write("checkpoint", {"first", "second"});
+  truncate_journal(journal_size() - 3);
+
+  {
+    cryptonote::StorageJournal journal(m_file_name);
+    std::string checkpoint;
+    std::vector<std::string> loaded;
+    ASSERT_TRUE(journal.load(checkpoint, loaded));
+    ASSERT_FALSE(journal.need_checkpoint());
+    journal.add_record("third");
+    journal.flush();
+  }
+
+  cryptonote::StorageJournal journal(m_file_name);
+  std::string checkpoint;
+  std::vector<std::string> loaded;
+  ASSERT_TRUE(journal.load(checkpoint, loaded));
+  ASSERT_EQ(std::vector<std::string>({"first", "third"}), loaded);
+}
+
+TEST_F(storage_journal, corrupted_record)
+{
+  write("checkpoint", {"first", "second", "third"});
+
+  std::string buffer;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(m_journal_file_name, buffer));
+  const size_t third_record_size = 2 * sizeof(uint32_t) + 5;
+  buffer[buffer.size() - third_record_size - sizeof(uint32_t) - 1] ^= 1; // last byte of "second"
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(m_journal_file_name, buffer));
+
+  cryptonote::StorageJournal journal(m_file_name);
+  std::string checkpoint;
+  std::vector<std::string> loaded;
+  ASSERT_TRUE(journal.load(checkpoint, loaded));
+  ASSERT_EQ(std::vector<std::string>({"first"}), loaded);
+}
+
+TEST_F(storage_journal, journal_of_previous_checkpoint)
+{
+  write("checkpoint", {"first"});
+
+  // crash after the checkpoint has been replaced and before the new journal has been started
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(m_file_name, "new checkpoint"));
+
+  cryptonote::StorageJournal journal(m_file_name);
+  std::string checkpoint;
+  std::vector<std::string> loaded;
+  ASSERT_TRUE(journal.load(checkpoint, loaded));
+  ASSERT_EQ("new checkpoint", checkpoint);
+  ASSERT_TRUE(loaded.empty());
+}
+
+TEST_F(storage_journal, stake_storage_replay)
+{
+  const uint64_t first_block = 1000;
+  std::vector<crypto::hash> block_hashes;
+
+  {
+    cryptonote::StakeTransactionStorage storage(m_file_name, first_block);
+    storage.add_last_processed_block(first_block + 1, crypto::rand<crypto::hash>());
+    storage.store();
+
+    for (uint64_t block = first_block + 2; block <= first_block + 4; ++block)
+    {
+      cryptonote::stake_transaction tx = AUTO_VAL_INIT(tx);
+      tx.hash = crypto::rand<crypto::hash>();
+      tx.amount = block;
+      tx.block_height = block;
+      tx.unlock_time = 100;
+      tx.supernode_public_id = "sn";
+      storage.add_tx(tx);
+      block_hashes.push_back(crypto::rand<crypto::hash>());
+      storage.add_last_processed_block(block, block_hashes.back());
+      storage.store();
+    }
+  }
+
+  {
+    cryptonote::StakeTransactionStorage storage(m_file_name, first_block);
+    ASSERT_EQ(first_block + 4, storage.get_last_processed_block_index());
+    ASSERT_EQ(block_hashes.back(), storage.get_last_processed_block_hash());
+    ASSERT_EQ(3u, storage.get_tx_count());
+  }
+
+  // the record of the last block is torn, storage is restored for the block before it
+  truncate_journal(journal_size() - 1);
+
+  cryptonote::StakeTransactionStorage storage(m_file_name, first_block);
+  ASSERT_EQ(first_block + 3, storage.get_last_processed_block_index());
+  ASSERT_EQ(block_hashes[1], storage.get_last_processed_block_hash());
+  ASSERT_EQ(2u, storage.get_tx_count());
+  ASSERT_EQ(first_block + 3, storage.get_txs().back().amount);
+}
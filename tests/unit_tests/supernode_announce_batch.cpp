@@ -0,0 +1,203 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "p2p/supernode_announce_batch.h"
+#include "storages/portable_storage_template_helper.h"
+
+using nodetool::peerlist_entry;
+using nodetool::supernode_announce_batch;
+
+namespace
+{
+  struct supernode_keys
+  {
+    crypto::public_key pub;
+    crypto::secret_key sec;
+    std::string id;
+
+    supernode_keys()
+    {
+      crypto::generate_keys(pub, sec);
+      id = epee::string_tools::pod_to_hex(pub);
+    }
+  };
+
+  supernode_announce_batch::announce_request make_announce(const supernode_keys &keys, uint64_t height, uint64_t hop = 0)
+  {
+    supernode_announce_batch::announce_request announce = AUTO_VAL_INIT(announce);
+    announce.supernode_public_id = keys.id;
+    announce.height = height;
+    announce.network_address = "http://127.0.0.1:28690/dapi/v2.0";
+    announce.hop = hop;
+    crypto::signature signature;
+    crypto::generate_signature(supernode_announce_batch::get_signed_hash(announce), keys.pub, keys.sec, signature);
+    announce.signature = epee::string_tools::pod_to_hex(signature);
+    return announce;
+  }
+
+  peerlist_entry make_peer(nodetool::peerid_type id)
+  {
+    peerlist_entry pe = AUTO_VAL_INIT(pe);
+    pe.id = id;
+    pe.adr = epee::net_utils::ipv4_network_address(0x0100007f, 18980 + id);
+    return pe;
+  }
+
+  const supernode_announce_batch::entry *find(const std::vector<supernode_announce_batch::entry> &entries, const std::string &id)
+  {
+    for (const supernode_announce_batch::entry &e : entries)
+      if (e.announce.supernode_public_id == id)
+        return &e;
+    return nullptr;
+  }
+}
+
+TEST(supernode_announce_batch, coalescing)
+{
+  supernode_keys sn1, sn2;
+  supernode_announce_batch batch;
+  const peerlist_entry peer1 = make_peer(1), peer2 = make_peer(2);
+
+  ASSERT_TRUE(batch.add(make_announce(sn1, 10, 1), &peer1));
+  ASSERT_TRUE(batch.add(make_announce(sn1, 10, 3), &peer2));
+  ASSERT_FALSE(batch.add(make_announce(sn1, 10, 4), &peer2));
+  ASSERT_FALSE(batch.add(make_announce(sn1, 9), &peer1));
+  ASSERT_TRUE(batch.add(make_announce(sn2, 10), &peer1));
+  ASSERT_TRUE(batch.add(make_announce(sn2, 11), &peer2));
+  ASSERT_FALSE(batch.add(make_announce(sn2, 11), &peer2));
+  ASSERT_TRUE(batch.add(make_announce(sn2, 12), nullptr));
+  ASSERT_FALSE(batch.add(make_announce(sn2, 12), nullptr));
+  ASSERT_EQ(2, batch.size());
+
+  std::vector<supernode_announce_batch::entry> entries = batch.take();
+  ASSERT_EQ(0, batch.size());
+  ASSERT_EQ(2, entries.size());
+
+  const supernode_announce_batch::entry *e1 = find(entries, sn1.id);
+  ASSERT_NE(nullptr, e1);
+  ASSERT_EQ(10, e1->announce.height);
+  ASSERT_EQ(3, e1->announce.hop);
+  ASSERT_EQ(2, e1->peers.size());
+  ASSERT_FALSE(e1->local);
+  ASSERT_TRUE(e1->valid);
+
+  // announce for a new height replaces peers of the old one
+  const supernode_announce_batch::entry *e2 = find(entries, sn2.id);
+  ASSERT_NE(nullptr, e2);
+  ASSERT_EQ(12, e2->announce.height);
+  ASSERT_TRUE(e2->peers.empty());
+  ASSERT_TRUE(e2->local);
+  ASSERT_TRUE(e2->valid);
+}
+
+TEST(supernode_announce_batch, validation)
+{
+  supernode_keys sn1, sn2, sn3;
+  const peerlist_entry peer = make_peer(1);
+
+  supernode_announce_batch::announce_request forged = make_announce(sn2, 10);
+  forged.network_address = "http://127.0.0.2:28690/dapi/v2.0";
+  supernode_announce_batch::announce_request bad_id = make_announce(sn3, 10);
+  bad_id.supernode_public_id = "sn3";
+
+  std::vector<supernode_announce_batch::entry> entries;
+  supernode_announce_batch batch;
+
+  // signatures are not checked by default, only the id and the signature format
+  batch.add(make_announce(sn1, 10), &peer);
+  batch.add(forged, &peer);
+  batch.add(bad_id, &peer);
+  entries = batch.take();
+  ASSERT_TRUE(find(entries, sn1.id)->valid);
+  ASSERT_TRUE(find(entries, sn2.id)->valid);
+  ASSERT_FALSE(find(entries, "sn3")->valid);
+
+  batch.set_check_signatures(true);
+  batch.add(make_announce(sn1, 10), &peer);
+  batch.add(forged, &peer);
+  entries = batch.take();
+  ASSERT_TRUE(find(entries, sn1.id)->valid);
+  ASSERT_FALSE(find(entries, sn2.id)->valid);
+
+  // relayed announces of supernodes without stakes are invalid, local ones are accepted
+  batch.set_staked_supernodes(std::make_shared<supernode_announce_batch::supernode_id_set>(supernode_announce_batch::supernode_id_set{sn1.id}));
+  batch.add(make_announce(sn1, 11), &peer);
+  batch.add(make_announce(sn2, 11), &peer);
+  batch.add(make_announce(sn3, 11), nullptr);
+  entries = batch.take();
+  ASSERT_TRUE(find(entries, sn1.id)->valid);
+  ASSERT_FALSE(find(entries, sn2.id)->valid);
+  ASSERT_TRUE(find(entries, sn3.id)->valid);
+}
+
+TEST(supernode_announce_batch, supernode_request)
+{
+  supernode_keys sn1, sn2;
+  supernode_announce_batch batch;
+  const peerlist_entry peer = make_peer(1);
+  batch.add(make_announce(sn1, 10), &peer);
+  batch.add(make_announce(sn2, 12), nullptr);
+  std::vector<supernode_announce_batch::entry> entries = batch.take();
+  std::vector<const supernode_announce_batch::entry*> new_announces;
+  for (const supernode_announce_batch::entry &e : entries)
+    new_announces.push_back(&e);
+
+  // the supernode doesn't get its own announce
+  cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES::request req;
+  ASSERT_TRUE(supernode_announce_batch::make_supernode_request(new_announces, sn2.id, req));
+  ASSERT_EQ(1, req.announces.size());
+  ASSERT_EQ(sn1.id, req.announces[0].supernode_public_id);
+  ASSERT_EQ(10, req.announces[0].height);
+  ASSERT_EQ(find(entries, sn1.id)->announce.signature, req.announces[0].signature);
+  ASSERT_EQ(find(entries, sn1.id)->announce.network_address, req.announces[0].network_address);
+
+  std::string json;
+  ASSERT_TRUE(epee::serialization::store_t_to_json(req, json));
+  cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES::request loaded;
+  ASSERT_TRUE(epee::serialization::load_t_from_json(loaded, json));
+  ASSERT_EQ(1, loaded.announces.size());
+  ASSERT_EQ(req.announces[0].supernode_public_id, loaded.announces[0].supernode_public_id);
+  ASSERT_EQ(req.announces[0].height, loaded.announces[0].height);
+  ASSERT_EQ(req.announces[0].signature, loaded.announces[0].signature);
+  ASSERT_EQ(req.announces[0].network_address, loaded.announces[0].network_address);
+
+  const std::vector<const supernode_announce_batch::entry*> own_announce(1, find(entries, sn2.id));
+  ASSERT_FALSE(supernode_announce_batch::make_supernode_request(own_announce, sn2.id, req));
+  ASSERT_TRUE(req.announces.empty());
+}
+
+TEST(supernode_announce_batch, batch_announces_option)
+{
+  cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE::request req;
+  ASSERT_TRUE(epee::serialization::load_t_from_json(req, "{\"supernode_public_id\":\"sn1\",\"height\":10,\"signature\":\"\",\"network_address\":\"\"}"));
+  ASSERT_FALSE(req.batch_announces);
+  ASSERT_TRUE(epee::serialization::load_t_from_json(req, "{\"supernode_public_id\":\"sn1\",\"height\":10,\"signature\":\"\",\"network_address\":\"\",\"batch_announces\":true}"));
+  ASSERT_TRUE(req.batch_announces);
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "p2p/supernode_route_table.h"
+
+using nodetool::peerlist_entry;
+using nodetool::supernode_route;
+using nodetool::supernode_route_table;
+
+namespace
+{
+  peerlist_entry make_peer(nodetool::peerid_type id)
+  {
+    peerlist_entry pe = AUTO_VAL_INIT(pe);
+    pe.id = id;
+    pe.adr = epee::net_utils::ipv4_network_address(0x0100007f, 18980 + id);
+    return pe;
+  }
+
+  std::vector<nodetool::peerid_type> get_peer_ids(const supernode_route &route)
+  {
+    std::vector<nodetool::peerid_type> ids;
+    for (const peerlist_entry &pe : route.peers)
+      ids.push_back(pe.id);
+    return ids;
+  }
+
+  /// Applies announce of the supernode received from the peers to the table
+  bool announce(supernode_route_table &table, const std::string &id, uint64_t height, uint64_t hop, const std::vector<peerlist_entry> &peers, uint64_t now)
+  {
+    bool existing = false;
+    table.update(id, [&](const supernode_route *route) {
+      return supernode_route_table::make_announced_route(route, height, hop, peers, now, existing);
+    });
+    return existing;
+  }
+}
+
+TEST(supernode_route_table, insert_and_find)
+{
+  supernode_route_table table;
+  ASSERT_EQ(nullptr, table.find("sn1"));
+
+  ASSERT_FALSE(announce(table, "sn1", 10, 2, {make_peer(1), make_peer(2)}, 1000));
+  ASSERT_FALSE(announce(table, "sn2", 10, 5, {make_peer(3)}, 1000));
+  ASSERT_EQ(2, table.size());
+
+  supernode_route_table::route_ptr route = table.find("sn1");
+  ASSERT_NE(nullptr, route);
+  ASSERT_EQ(10, route->last_announce_height);
+  ASSERT_EQ(1000, route->last_announce_time);
+  ASSERT_EQ(2, route->max_hop);
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({1, 2}), get_peer_ids(*route));
+
+  // update which keeps the route doesn't touch it
+  table.update("sn1", [](const supernode_route *) { return supernode_route_table::route_ptr(); });
+  table.update("sn3", [](const supernode_route *) { return supernode_route_table::route_ptr(); });
+  ASSERT_EQ(route, table.find("sn1"));
+  ASSERT_EQ(nullptr, table.find("sn3"));
+  ASSERT_EQ(2, table.size());
+
+  std::map<std::string, uint64_t> hops;
+  table.for_each([&hops](const std::string &id, const supernode_route &r) { hops[id] = r.max_hop; });
+  ASSERT_EQ((std::map<std::string, uint64_t>{{"sn1", 2}, {"sn2", 5}}), hops);
+}
+
+TEST(supernode_route_table, announce_adds_peers_to_actual_route)
+{
+  supernode_route_table table;
+  announce(table, "sn1", 10, 2, {make_peer(1)}, 1000);
+  supernode_route_table::route_ptr first = table.find("sn1");
+
+  // the same announce from other peers adds them, the published route is not changed in place
+  ASSERT_TRUE(announce(table, "sn1", 10, 4, {make_peer(2), make_peer(1), make_peer(3)}, 1010));
+  supernode_route_table::route_ptr second = table.find("sn1");
+  ASSERT_NE(first, second);
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({1}), get_peer_ids(*first));
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({1, 2, 3}), get_peer_ids(*second));
+  ASSERT_EQ(4, second->max_hop);
+  ASSERT_EQ(1000, second->last_announce_time);
+
+  // nothing new keeps the route
+  ASSERT_TRUE(announce(table, "sn1", 10, 3, {make_peer(2)}, 1020));
+  ASSERT_EQ(second, table.find("sn1"));
+  ASSERT_EQ(nullptr, supernode_route_table::add_route_peers(*second, 4, {make_peer(3)}));
+  ASSERT_EQ(1, table.size());
+}
+
+TEST(supernode_route_table, expired_route_is_replaced)
+{
+  const uint64_t lifetime = supernode_route_table::ANNOUNCE_LIFETIME;
+  supernode_route_table table;
+  announce(table, "sn1", 10, 5, {make_peer(1), make_peer(2)}, 1000);
+
+  ASSERT_TRUE(supernode_route_table::is_actual(*table.find("sn1"), 10, 1000 + lifetime - 1));
+  ASSERT_FALSE(supernode_route_table::is_actual(*table.find("sn1"), 10, 1000 + lifetime));
+  ASSERT_FALSE(supernode_route_table::is_actual(*table.find("sn1"), 11, 1001));
+
+  // the announce of the same height after the lifetime starts a new route
+  ASSERT_FALSE(announce(table, "sn1", 10, 1, {make_peer(3)}, 1000 + lifetime));
+  supernode_route_table::route_ptr route = table.find("sn1");
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({3}), get_peer_ids(*route));
+  ASSERT_EQ(1, route->max_hop);
+  ASSERT_EQ(1000 + lifetime, route->last_announce_time);
+
+  // so does the announce for a new height
+  ASSERT_FALSE(announce(table, "sn1", 11, 2, {make_peer(1)}, 1000 + lifetime + 1));
+  route = table.find("sn1");
+  ASSERT_EQ(11, route->last_announce_height);
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({1}), get_peer_ids(*route));
+  ASSERT_EQ(1, table.size());
+}
+
+TEST(supernode_route_table, select_peers)
+{
+  supernode_route route = AUTO_VAL_INIT(route);
+  for (nodetool::peerid_type id = 1; id <= 6; ++id)
+    route.peers.push_back(make_peer(id));
+
+  // the first usable peers are taken in announce order
+  std::vector<nodetool::peerid_type> selected;
+  ASSERT_EQ(3, supernode_route_table::select_peers(route, 3, [&selected](const peerlist_entry &pe) -> bool {
+    if (pe.id == 2)
+      return false;
+    selected.push_back(pe.id);
+    return true;
+  }));
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({1, 3, 4}), selected);
+
+  selected.clear();
+  ASSERT_EQ(1, supernode_route_table::select_peers(route, 3, [&selected](const peerlist_entry &pe) -> bool {
+    if (pe.id != 5)
+      return false;
+    selected.push_back(pe.id);
+    return true;
+  }));
+  ASSERT_EQ(std::vector<nodetool::peerid_type>({5}), selected);
+}
+
+TEST(supernode_route_table, max_hop)
+{
+  supernode_route_table table;
+  ASSERT_EQ(0, table.max_hop());
+  announce(table, "sn1", 10, 2, {make_peer(1)}, 1000);
+  announce(table, "sn2", 10, 7, {make_peer(2)}, 1000);
+  announce(table, "sn3", 10, 4, {make_peer(3)}, 1000);
+
+  ASSERT_EQ(7, table.max_hop());
+  ASSERT_EQ(4, table.max_hop(std::vector<std::string>({"sn1", "sn3", "unknown"})));
+  ASSERT_EQ(0, table.max_hop(std::vector<std::string>({"unknown"})));
+}
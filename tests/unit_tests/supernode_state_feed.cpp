@@ -0,0 +1,187 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "p2p/supernode_state_feed.h"
+
+using nodetool::supernode_state_feed;
+
+namespace
+{
+  typedef supernode_state_feed::list_delta list_delta;
+  typedef std::vector<std::vector<list_delta::supernode>> tiers_type;
+
+  list_delta::supernode make_supernode(const std::string &id, uint64_t amount = 0)
+  {
+    list_delta::supernode sn = AUTO_VAL_INIT(sn);
+    sn.supernode_public_id = id;
+    sn.amount = amount;
+    return sn;
+  }
+
+  supernode_state_feed::stake_array make_stakes(size_t count)
+  {
+    supernode_state_feed::stake_array stakes(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      stakes[i].supernode_public_id = std::string(1, 'a' + i);
+      stakes[i].amount = 1000 + i;
+      stakes[i].block_height = 1;
+      stakes[i].unlock_time = 100;
+    }
+    return stakes;
+  }
+
+  supernode_state_feed::stakes_delta::request load_stakes(const std::string &blob)
+  {
+    supernode_state_feed::stakes_delta::request request = AUTO_VAL_INIT(request);
+    EXPECT_TRUE(epee::serialization::load_t_from_binary(request, blob));
+    return request;
+  }
+}
+
+TEST(supernode_state_feed, tiers_delta)
+{
+  tiers_type base(2), tiers(2);
+  base[0] = {make_supernode("a"), make_supernode("b"), make_supernode("c")};
+  tiers[0] = {make_supernode("a"), make_supernode("c", 5), make_supernode("d")};
+  base[1] = {make_supernode("e")};
+  tiers[1] = {make_supernode("e")};
+
+  std::vector<list_delta::tier> delta;
+  ASSERT_TRUE(supernode_state_feed::make_tiers_delta(base, tiers, delta));
+  ASSERT_EQ(2, delta.size());
+  ASSERT_EQ(std::vector<std::string>({"b"}), delta[0].removed_supernodes);
+  ASSERT_EQ(1, delta[0].changed_supernodes.size());
+  ASSERT_EQ("c", delta[0].changed_supernodes[0].supernode_public_id);
+  ASSERT_EQ(5, delta[0].changed_supernodes[0].amount);
+  ASSERT_EQ(1, delta[0].added_supernodes.size());
+  ASSERT_EQ("d", delta[0].added_supernodes[0].supernode_public_id);
+  ASSERT_TRUE(delta[1].removed_supernodes.empty());
+  ASSERT_TRUE(delta[1].changed_supernodes.empty());
+  ASSERT_TRUE(delta[1].added_supernodes.empty());
+}
+
+TEST(supernode_state_feed, tiers_delta_not_expressible)
+{
+  tiers_type base(1), tiers(1);
+  base[0] = {make_supernode("a"), make_supernode("b")};
+  std::vector<list_delta::tier> delta;
+
+  // supernodes kept from the base tier are reordered
+  tiers[0] = {make_supernode("b"), make_supernode("a")};
+  ASSERT_FALSE(supernode_state_feed::make_tiers_delta(base, tiers, delta));
+
+  // a new supernode is put before the kept ones
+  tiers[0] = {make_supernode("c"), make_supernode("a"), make_supernode("b")};
+  ASSERT_FALSE(supernode_state_feed::make_tiers_delta(base, tiers, delta));
+
+  // number of tiers changed
+  ASSERT_FALSE(supernode_state_feed::make_tiers_delta(base, tiers_type(2), delta));
+}
+
+TEST(supernode_state_feed, stakes_update)
+{
+  supernode_state_feed feed;
+  supernode_state_feed::stake_array stakes = make_stakes(3);
+  std::vector<supernode_state_feed::supernode_state> supernodes = {{true, 0}, {false, 0}};
+  supernode_state_feed::update update;
+
+  // the first update is the full state only
+  ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 10, stakes, supernodes, update));
+  ASSERT_NE(0, update.version);
+  ASSERT_EQ(feed.get_stakes_version(), update.version);
+  ASSERT_TRUE(update.delta.empty());
+  ASSERT_TRUE(update.is_full_needed(supernodes[0].version));
+  ASSERT_EQ(3, load_stakes(update.full).stakes.size());
+  ASSERT_FALSE(update.json.empty());
+  supernodes[0].version = update.version;
+  supernodes.pop_back();
+
+  // nothing changed, the supernode is up to date
+  const uint64_t version = update.version;
+  ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 10, stakes, supernodes, update));
+  ASSERT_EQ(version, update.version);
+  ASSERT_EQ(version, update.base_version);
+  ASSERT_FALSE(update.is_full_needed(supernodes[0].version));
+  ASSERT_TRUE(update.full.empty());
+  ASSERT_TRUE(update.json.empty());
+
+  // one stake changed and one removed
+  stakes[1].amount += 1;
+  stakes.pop_back();
+  ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 11, stakes, supernodes, update));
+  ASSERT_EQ(version, update.base_version);
+  ASSERT_NE(version, update.version);
+  ASSERT_FALSE(update.is_full_needed(supernodes[0].version));
+  ASSERT_TRUE(update.full.empty());
+  const supernode_state_feed::stakes_delta::request delta = load_stakes(update.delta);
+  ASSERT_EQ(version, delta.base_version);
+  ASSERT_EQ(update.version, delta.version);
+  ASSERT_EQ(11, delta.block_height);
+  ASSERT_EQ(1, delta.stakes.size());
+  ASSERT_EQ("b", delta.stakes[0].supernode_public_id);
+  ASSERT_EQ(stakes[1].amount, delta.stakes[0].amount);
+  ASSERT_EQ(std::vector<std::string>({"c"}), delta.removed_supernodes);
+
+  // a supernode which missed the delta gets the full state
+  ASSERT_TRUE(update.is_full_needed(version - 1));
+  ASSERT_TRUE(update.is_full_needed(0));
+}
+
+TEST(supernode_state_feed, full_snapshot_period)
+{
+  supernode_state_feed feed;
+  supernode_state_feed::stake_array stakes = make_stakes(2);
+  std::vector<supernode_state_feed::supernode_state> supernodes = {{true, 0}};
+  supernode_state_feed::update update;
+
+  ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 1, stakes, supernodes, update));
+  supernodes[0].version = update.version;
+
+  for (size_t i = 1; i < supernode_state_feed::FULL_SNAPSHOT_PERIOD; ++i)
+  {
+    ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 1 + i, stakes, supernodes, update));
+    ASSERT_FALSE(update.delta.empty()) << "update " << i;
+    ASSERT_FALSE(update.is_full_needed(supernodes[0].version));
+    supernodes[0].version = update.version;
+  }
+
+  // the full state is pushed to everybody, the supernode is up to date
+  ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 1 + supernode_state_feed::FULL_SNAPSHOT_PERIOD, stakes, supernodes, update));
+  ASSERT_TRUE(update.delta.empty());
+  ASSERT_TRUE(update.is_full_needed(supernodes[0].version));
+  ASSERT_EQ(update.version, load_stakes(update.full).version);
+  supernodes[0].version = update.version;
+
+  // deltas are built again against the snapshot
+  ASSERT_TRUE(feed.make_stakes_update(cryptonote::MAINNET, 2 + supernode_state_feed::FULL_SNAPSHOT_PERIOD, stakes, supernodes, update));
+  ASSERT_FALSE(update.delta.empty());
+  ASSERT_FALSE(update.is_full_needed(supernodes[0].version));
+}
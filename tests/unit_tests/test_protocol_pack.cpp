@@ -31,6 +31,7 @@
 #include "gtest/gtest.h"
 
 #include "include_base_utils.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "storages/portable_storage_template_helper.h"
 
@@ -53,3 +54,100 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+TEST(protocol_pack, tx_inventory_commands)
+{
+  std::string buff;
+  cryptonote::NOTIFY_NEW_TRANSACTION_HASHES::request announce;
+  for (size_t i = 0; i < 3; ++i)
+    announce.tx_hashes.push_back(crypto::rand<crypto::hash>());
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(announce, buff));
+
+  cryptonote::NOTIFY_NEW_TRANSACTION_HASHES::request announce2;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(announce2, buff));
+  ASSERT_EQ(announce.tx_hashes, announce2.tx_hashes);
+
+  cryptonote::NOTIFY_REQUEST_TRANSACTIONS::request request;
+  request.tx_hashes = announce.tx_hashes;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(request, buff));
+
+  cryptonote::NOTIFY_REQUEST_TRANSACTIONS::request request2;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(request2, buff));
+  ASSERT_EQ(request.tx_hashes, request2.tx_hashes);
+}
+
+TEST(protocol_pack, compact_block_short_tx_ids)
+{
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const uint64_t salt = crypto::rand<uint64_t>();
+  std::vector<uint64_t> short_ids;
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request r;
+  r.block_hash = block_hash;
+  r.tx_tree_hash = crypto::rand<crypto::hash>();
+  r.salt = salt;
+  for (size_t i = 0; i < 10; ++i)
+  {
+    short_ids.push_back(cryptonote::NOTIFY_NEW_COMPACT_BLOCK::get_short_tx_id(block_hash, salt, crypto::rand<crypto::hash>()));
+    ASSERT_LT(short_ids.back(), (uint64_t)1 << (cryptonote::NOTIFY_NEW_COMPACT_BLOCK::SHORT_TX_ID_SIZE * 8));
+    r.add_short_tx_id(short_ids.back());
+  }
+  // only the low SHORT_TX_ID_SIZE bytes are kept
+  r.add_short_tx_id(0xffeeddccbbaa9988);
+  short_ids.push_back(0xddccbbaa9988);
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request r2;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(r2, buff));
+  ASSERT_EQ(r.tx_tree_hash, r2.tx_tree_hash);
+  ASSERT_EQ(short_ids.size(), r2.get_short_tx_ids_count());
+  for (size_t i = 0; i < short_ids.size(); ++i)
+    ASSERT_EQ(short_ids[i], r2.get_short_tx_id(i));
+}
+
+TEST(protocol_pack, compact_block_reconstruction)
+{
+  cryptonote::block b;
+  b.major_version = 12;
+  b.prev_id = crypto::rand<crypto::hash>();
+  b.nonce = 42;
+  for (size_t i = 0; i < 5; ++i)
+    b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+  const crypto::hash block_hash = cryptonote::get_block_hash(b);
+
+  // tx 2 is prefilled, tx 4 is not in the pool
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request r;
+  r.block_hash = block_hash;
+  r.tx_tree_hash = cryptonote::get_tx_tree_hash(b);
+  r.salt = crypto::rand<uint64_t>();
+  const std::vector<size_t> prefilled_tx_indices = {2};
+  for (size_t i = 0; i < b.tx_hashes.size(); ++i)
+    if (i != 2)
+      r.add_short_tx_id(cryptonote::NOTIFY_NEW_COMPACT_BLOCK::get_short_tx_id(block_hash, r.salt, b.tx_hashes[i]));
+
+  cryptonote::block header = b;
+  header.tx_hashes.clear();
+  crypto::hash header_hash;
+  ASSERT_TRUE(cryptonote::get_object_hash(cryptonote::get_block_hashing_blob(header, r.tx_tree_hash, b.tx_hashes.size()), header_hash));
+  ASSERT_EQ(block_hash, header_hash);
+
+  std::vector<crypto::hash> pool_tx_hashes = {crypto::rand<crypto::hash>(), b.tx_hashes[3], b.tx_hashes[0], b.tx_hashes[1], crypto::rand<crypto::hash>()};
+  std::vector<crypto::hash> tx_hashes(b.tx_hashes.size());
+  tx_hashes[2] = b.tx_hashes[2];
+  std::vector<uint64_t> need_tx_indices;
+  std::vector<size_t> found_tx_indices;
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::match_short_tx_ids(r, prefilled_tx_indices, pool_tx_hashes, tx_hashes, need_tx_indices, found_tx_indices);
+  ASSERT_EQ(std::vector<uint64_t>({4}), need_tx_indices);
+  ASSERT_EQ(std::vector<size_t>({0, 1, 3}), found_tx_indices);
+
+  pool_tx_hashes.push_back(b.tx_hashes[4]);
+  need_tx_indices.clear();
+  found_tx_indices.clear();
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::match_short_tx_ids(r, prefilled_tx_indices, pool_tx_hashes, tx_hashes, need_tx_indices, found_tx_indices);
+  ASSERT_TRUE(need_tx_indices.empty());
+  ASSERT_EQ(std::vector<size_t>({0, 1, 3, 4}), found_tx_indices);
+
+  header.tx_hashes = tx_hashes;
+  ASSERT_EQ(b.tx_hashes, header.tx_hashes);
+  ASSERT_EQ(block_hash, cryptonote::get_block_hash(header));
+}
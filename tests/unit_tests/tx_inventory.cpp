@@ -0,0 +1,132 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/uuid/uuid.hpp>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/tx_inventory.h"
+
+namespace
+{
+  const time_t timeout = 30;
+
+  const boost::uuids::uuid &peer(size_t i)
+  {
+    static const boost::uuids::uuid peers[] = {crypto::rand<boost::uuids::uuid>(), crypto::rand<boost::uuids::uuid>(), crypto::rand<boost::uuids::uuid>()};
+    return peers[i];
+  }
+
+  bool have_no_tx(const crypto::hash&) { return false; }
+}
+
+TEST(tx_inventory, request_from_first_announcer)
+{
+  cryptonote::tx_inventory inventory(timeout, 8);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_TRUE(inventory.on_announce(txid, peer(0), 100));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(1), 101));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(0), 102));
+  ASSERT_EQ(inventory.size(), 1);
+
+  cryptonote::tx_inventory::peer_requests requests;
+  inventory.get_timed_out_requests(100 + timeout - 1, have_no_tx, requests);
+  ASSERT_TRUE(requests.empty());
+}
+
+TEST(tx_inventory, rerequest_from_next_announcer)
+{
+  cryptonote::tx_inventory inventory(timeout, 8);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_TRUE(inventory.on_announce(txid, peer(0), 100));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(1), 101));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(2), 102));
+
+  cryptonote::tx_inventory::peer_requests requests;
+  inventory.get_timed_out_requests(100 + timeout, have_no_tx, requests);
+  ASSERT_EQ(requests.size(), 1);
+  ASSERT_EQ(requests[peer(1)], std::vector<crypto::hash>(1, txid));
+
+  requests.clear();
+  inventory.get_timed_out_requests(100 + 2 * timeout, have_no_tx, requests);
+  ASSERT_EQ(requests.size(), 1);
+  ASSERT_EQ(requests[peer(2)], std::vector<crypto::hash>(1, txid));
+
+  // no more announcers, the transaction is forgotten
+  requests.clear();
+  inventory.get_timed_out_requests(100 + 3 * timeout, have_no_tx, requests);
+  ASSERT_TRUE(requests.empty());
+  ASSERT_EQ(inventory.size(), 0);
+}
+
+TEST(tx_inventory, received_tx_is_not_requested)
+{
+  cryptonote::tx_inventory inventory(timeout, 8);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_TRUE(inventory.on_announce(txid, peer(0), 100));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(1), 101));
+
+  cryptonote::tx_inventory::peer_requests requests;
+  inventory.get_timed_out_requests(100 + timeout, [](const crypto::hash&) { return true; }, requests);
+  ASSERT_TRUE(requests.empty());
+  ASSERT_EQ(inventory.size(), 0);
+}
+
+TEST(tx_inventory, closed_connection)
+{
+  cryptonote::tx_inventory inventory(timeout, 8);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_TRUE(inventory.on_announce(txid, peer(0), 100));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(1), 101));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(2), 102));
+
+  // the request to the closed connection is moved to the next announcer without waiting for the timeout
+  inventory.remove_peer(peer(1));
+  inventory.remove_peer(peer(0));
+  cryptonote::tx_inventory::peer_requests requests;
+  inventory.get_timed_out_requests(103, have_no_tx, requests);
+  ASSERT_EQ(requests.size(), 1);
+  ASSERT_EQ(requests[peer(2)], std::vector<crypto::hash>(1, txid));
+}
+
+TEST(tx_inventory, max_announcers)
+{
+  cryptonote::tx_inventory inventory(timeout, 1);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_TRUE(inventory.on_announce(txid, peer(0), 100));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(1), 101));
+  ASSERT_FALSE(inventory.on_announce(txid, peer(2), 102));
+
+  cryptonote::tx_inventory::peer_requests requests;
+  inventory.get_timed_out_requests(100 + timeout, have_no_tx, requests);
+  ASSERT_EQ(requests.size(), 1);
+  ASSERT_EQ(requests.count(peer(1)), 1);
+
+  requests.clear();
+  inventory.get_timed_out_requests(100 + 2 * timeout, have_no_tx, requests);
+  ASSERT_TRUE(requests.empty());
+}